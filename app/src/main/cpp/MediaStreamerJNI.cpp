@@ -2,6 +2,7 @@
 #include "ffmpeg/Muxer.h"
 #include "ffmpeg/MuxerBuilder.h"
 #include "ffmpeg/Demuxer.h"
+#include "ffmpeg/FramePool.h"
 #include "streamer/MediaStreamer.h"
 #include "streamer/MediaStreamerBuilder.h"
 #include "JNIHelper.h"
@@ -18,6 +19,17 @@ static Demuxer *demuxer = nullptr;
 static Muxer *muxer = nullptr;
 static RendererES3 *renderer = nullptr;
 
+/** Logs video decoding quality changes, called from decoding thread. */
+class DegradationLogger : public DegradationListener {
+public:
+    void onDegradationChanged(DegradationLevel oldLevel, DegradationLevel newLevel, int64_t latenessMs) override {
+        LOGD("Video decoding level %d -> %d, video %lldms late", (int) oldLevel, (int) newLevel,
+             (long long) latenessMs);
+    }
+};
+
+static DegradationLogger degradationLogger;
+
 extern "C"
 JNIEXPORT void JNICALL
 Java_com_example_videostreamer_MediaStreamer_create(JNIEnv *env, jobject thiz, jstring jurl, jstring jouturl) {
@@ -61,6 +73,7 @@ Java_com_example_videostreamer_MediaStreamer_create(JNIEnv *env, jobject thiz, j
 
     demuxer->addAudioSink(mediaStreamer);
     demuxer->addVideoSink(mediaStreamer);
+    demuxer->setDegradationListener(&degradationLogger);
 
     MuxerBuilder muxerBuilder;
     muxerBuilder.setFileName(outUrl)
@@ -69,6 +82,8 @@ Java_com_example_videostreamer_MediaStreamer_create(JNIEnv *env, jobject thiz, j
             ->setSrcChannelLayout(demuxer->getChannelLayout())
             ->setSrcNbSamples(demuxer->getNbSamples())
             ->setSrcSampleFmt(demuxer->getSampleFormat())
+            // Recording is not real time, it can afford best quality
+            ->setResamplerProfile(ResamplerProfile::HIGH)
             ->setVideoTimeBase(demuxer->getVideoTimebase())
             ->setSrcWidth(demuxer->getWidth())
             ->setSrcHeight(demuxer->getHeight())
@@ -92,13 +107,65 @@ JNIEXPORT void JNICALL
 Java_com_example_videostreamer_MediaStreamer_pause(JNIEnv *env, jobject thiz) {
     if (demuxer) demuxer->pause();
     if (audioStreamer) audioStreamer->pause();
+    if (mediaStreamer) mediaStreamer->pause();
 }
 
 extern "C"
 JNIEXPORT void JNICALL
 Java_com_example_videostreamer_MediaStreamer_resume(JNIEnv *env, jobject thiz) {
     if (demuxer && demuxer->mState == DemuxerState::PAUSED) demuxer->resume();
-    if (audioStreamer) audioStreamer->resume();
+    // Audio output stays held while trick playing
+    if (audioStreamer && !(demuxer && demuxer->isTrickPlay())) audioStreamer->resume();
+    if (mediaStreamer) mediaStreamer->resume();
+}
+
+extern "C"
+JNIEXPORT jobject JNICALL
+Java_com_example_videostreamer_MediaStreamer_getDegradationStats(JNIEnv *env, jobject thiz) {
+    if (!demuxer) return nullptr;
+    DegradationStats stats = demuxer->getDegradationStats();
+
+    jclass statsClass = env->FindClass("com/example/videostreamer/MediaStreamer$DegradationStats");
+    jmethodID constructor = env->GetMethodID(statsClass, "<init>", "(IJJ[J)V");
+    jlongArray timeAtLevelMs = env->NewLongArray(NB_DEGRADATION_LEVELS);
+    if (!statsClass || !constructor || !timeAtLevelMs) return nullptr;
+    jlong times[NB_DEGRADATION_LEVELS];
+    for (int i = 0; i < NB_DEGRADATION_LEVELS; i++) times[i] = stats.mTimeAtLevelMs[i];
+    env->SetLongArrayRegion(timeAtLevelMs, 0, NB_DEGRADATION_LEVELS, times);
+    return env->NewObject(statsClass, constructor, (jint) stats.mLevel, (jlong) stats.mNbDegrades,
+                          (jlong) stats.mNbRecovers, timeAtLevelMs);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_example_videostreamer_MediaStreamer_setSpeed(JNIEnv *env, jobject thiz, jfloat speed) {
+    // Speeds too fast to decode every frame, or backward, are played with video keyframes only
+    bool isTrickPlay = MediaStreamer::isTrickPlaySpeed(speed);
+    if (demuxer) demuxer->setTrickPlay(isTrickPlay ? speed : 0);
+    if (mediaStreamer) {
+        mediaStreamer->setTrickPlay(isTrickPlay);
+        if (!isTrickPlay) mediaStreamer->setSpeed(speed);
+    }
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_example_videostreamer_MediaStreamer_setGopCache(JNIEnv *env, jobject thiz, jlong maxBytes, jint lowres) {
+    if (demuxer) demuxer->setGopCache(maxBytes, lowres);
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_com_example_videostreamer_MediaStreamer_scrub(JNIEnv *env, jobject thiz, jlong positionMs) {
+    if (!demuxer) return false;
+    return demuxer->scrub(positionMs);
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_com_example_videostreamer_MediaStreamer_stepBackward(JNIEnv *env, jobject thiz) {
+    if (!demuxer || !videoStreamer) return false;
+    return demuxer->stepBackward(videoStreamer->getFramePts());
 }
 
 extern "C"
@@ -131,18 +198,24 @@ Java_com_example_videostreamer_MediaStreamer_clean(JNIEnv *env, jobject thiz) {
     audioStreamer = nullptr;
     delete videoStreamer;
     videoStreamer = nullptr;
+    // Nothing plays anymore, give idle frame buffers back
+    FramePool::getInstance()->trim();
 }
 
 // GLES Renderer function
 extern "C"
 JNIEXPORT void JNICALL
-Java_com_example_videostreamer_GLES3JNILib_00024Companion_init(JNIEnv *env, jobject thiz) {
+Java_com_example_videostreamer_GLES3JNILib_00024Companion_init(JNIEnv *env, jobject thiz, jstring jcacheDir) {
     if (renderer) {
         delete renderer;
         renderer = nullptr;
     }
     renderer = new RendererES3();
-    if (!renderer->init()) {
+
+    const char *cacheDir = jcacheDir ? env->GetStringUTFChars(jcacheDir, nullptr) : nullptr;
+    bool isInitiated = renderer->init(cacheDir);
+    if (cacheDir) env->ReleaseStringUTFChars(jcacheDir, cacheDir);
+    if (!isInitiated) {
         LOGE("Failed to initiate GLES renderer.");
         return;
     }
@@ -162,10 +235,11 @@ Java_com_example_videostreamer_GLES3JNILib_00024Companion_resize(JNIEnv *env, jo
 // GLES Renderer function
 extern "C"
 JNIEXPORT void JNICALL
-Java_com_example_videostreamer_GLES3JNILib_00024Companion_draw(JNIEnv *env, jobject thiz) {
+Java_com_example_videostreamer_GLES3JNILib_00024Companion_draw(JNIEnv *env, jobject thiz, jlong vsyncNs,
+                                                               jlong vsyncPeriodNs) {
     std::unique_lock<std::mutex> lck(mutex);
     if (videoStreamer && renderer) {
-        videoStreamer->render();
+        videoStreamer->render(vsyncNs, vsyncPeriodNs);
     } else if (renderer) {
         renderer->clearSurface();
     }
@@ -1,9 +1,10 @@
-
-#include <android/log.h>
 // Redefine macro in each file
 //#define LOG_TAG "NDK"
 #define DEBUG 1
 
+#ifdef __ANDROID__
+#include <android/log.h>
+
 #define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
 
 #if DEBUG
@@ -14,4 +15,22 @@
 #define LOGI(...)
 #define LOGV(...)
 #define LOGD(...)
-#endif
\ No newline at end of file
+#endif
+#else
+// Host builds, such as renderer running on a desktop EGL context, log to stderr
+#include <cstdio>
+
+#define HOST_LOG(level, ...) (fprintf(stderr, "%s/%s: ", level, LOG_TAG), fprintf(stderr, __VA_ARGS__), fputc('\n', stderr))
+
+#define LOGE(...) HOST_LOG("E", __VA_ARGS__)
+
+#if DEBUG
+#define LOGI(...) HOST_LOG("I", __VA_ARGS__)
+#define LOGV(...) HOST_LOG("V", __VA_ARGS__)
+#define LOGD(...) HOST_LOG("D", __VA_ARGS__)
+#else
+#define LOGI(...)
+#define LOGV(...)
+#define LOGD(...)
+#endif
+#endif
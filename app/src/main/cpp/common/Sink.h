@@ -14,11 +14,37 @@ public:
 class VideoSink : public Sink {
 public:
     virtual int onVideoFrame(AVFrame *frame) = 0;
+
+    /** Return how far incoming frames are behind sink clock in millis, 0 or negative if they are on time.
+     * Decoder degrades quality only as long as every presenting sink is behind. */
+    virtual int64_t getLatenessMs() { return 0; }
+
+    /** Return true if sink shows frames against a clock, so that frames can be late for it.
+     * Sinks taking every frame at their own pace, like recorders, are left out of lateness. */
+    virtual bool isPresenting() { return false; }
+
+    /** Get smallest picture size sink can use without losing visible detail.
+     * Decoder may output pictures down to that size. Every sink must agree, so by default full size is needed.
+     * @return false if sink needs full size pictures */
+    virtual bool getPreferredSize(int * /*width*/, int * /*height*/) { return false; }
+
+    /** Show a frame out of playback order right away, e.g. a cached frame while scrubbing.
+     * Sinks taking frames in playback order only, like recorders, ignore it.
+     * @return true if frame is shown */
+    virtual bool onPreviewFrame(AVFrame * /*frame*/) { return false; }
+
+    /** Drop frames buffered so far, e.g. after a seek, following frames start over from another position.
+     * Called while no frame is being written into sink. A frame shown with onPreviewFrame is kept. */
+    virtual void onVideoFlush() {}
 };
 
 class AudioSink : public Sink {
 public:
     virtual int onAudioFrame(AVFrame *frame) = 0;
+
+    /** Drop samples buffered so far, e.g. after a seek, following frames start over from another position.
+     * Called while no frame is being written into sink. */
+    virtual void onAudioFlush() {}
 };
 
 typedef struct VideoSinkNode {
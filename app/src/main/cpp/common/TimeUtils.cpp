@@ -9,6 +9,11 @@ int64_t getCurrentTimeMs() {
     return integralDuration;
 }
 
+int64_t getMonotonicTimeNs() {
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
 int64_t ptsToMs(int64_t pts, AVRational timebase) {
     return av_rescale(pts * 1000, timebase.num, timebase.den);
 }
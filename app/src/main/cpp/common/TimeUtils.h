@@ -10,6 +10,17 @@ extern "C" {
 
 int64_t getCurrentTimeMs();
 
+/** Return time of monotonic clock in nanos, same base as Choreographer vsync timestamps. */
+int64_t getMonotonicTimeNs();
+
+/** Source of monotonic time in nanos, standing in for the monotonic clock, e.g. a virtual audio output clock. */
+class TimeSource {
+public:
+    virtual ~TimeSource() = default;
+
+    virtual int64_t getTimeNs() = 0;
+};
+
 int64_t ptsToMs(int64_t pts, AVRational timebase);
 
 int64_t msToPts(int64_t ms, AVRational timebase);
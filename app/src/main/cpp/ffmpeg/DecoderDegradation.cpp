@@ -0,0 +1,86 @@
+#include "DecoderDegradation.h"
+#include "../common/JNILogHelper.h"
+
+#define LOG_TAG "DecoderDegradation"
+
+void DecoderDegradation::setListener(DegradationListener *listener) {
+    std::unique_lock<std::mutex> lck(mMutex);
+    mListener = listener;
+}
+
+void DecoderDegradation::changeLevel(DegradationLevel level, int64_t latenessMs, int64_t nowMs) {
+    DegradationLevel oldLevel = mLevel;
+    if (mLevelSinceMs != 0) mStats.mTimeAtLevelMs[(int) oldLevel] += nowMs - mLevelSinceMs;
+    mLevelSinceMs = nowMs;
+
+    if (level > oldLevel) mStats.mNbDegrades++;
+    else mStats.mNbRecovers++;
+    mLevel = level;
+
+    // Start a new streak at the new level
+    mBehindSinceMs = 0;
+    mCaughtUpSinceMs = 0;
+
+    LOGI("Decoder degradation level %d -> %d, %lldms late", (int) oldLevel, (int) level, (long long) latenessMs);
+    if (mListener) mListener->onDegradationChanged(oldLevel, level, latenessMs);
+}
+
+bool DecoderDegradation::update(int64_t latenessMs, int64_t nowMs) {
+    std::unique_lock<std::mutex> lck(mMutex);
+    if (mLevelSinceMs == 0) mLevelSinceMs = nowMs;
+
+    if (latenessMs > DEGRADE_LATENESS_MS) {
+        mCaughtUpSinceMs = 0;
+        if (mBehindSinceMs == 0) mBehindSinceMs = nowMs;
+        if (nowMs - mBehindSinceMs >= DEGRADE_DELAY_MS && mLevel < DegradationLevel::KEY_FRAMES_ONLY) {
+            changeLevel((DegradationLevel) ((int) mLevel + 1), latenessMs, nowMs);
+            return true;
+        }
+    } else if (latenessMs < RECOVER_LATENESS_MS) {
+        mBehindSinceMs = 0;
+        if (mCaughtUpSinceMs == 0) mCaughtUpSinceMs = nowMs;
+        if (nowMs - mCaughtUpSinceMs >= RECOVER_DELAY_MS && mLevel > DegradationLevel::NONE) {
+            changeLevel((DegradationLevel) ((int) mLevel - 1), latenessMs, nowMs);
+            return true;
+        }
+    } else {
+        // In between, neither behind nor caught up
+        mBehindSinceMs = 0;
+        mCaughtUpSinceMs = 0;
+    }
+    return false;
+}
+
+void DecoderDegradation::apply(AVCodecContext *codecCtx) {
+    DegradationLevel level = getLevel();
+
+    codecCtx->skip_loop_filter = (level >= DegradationLevel::SKIP_LOOP_FILTER) ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+
+    if (level >= DegradationLevel::FAST_DECODE) codecCtx->flags2 |= AV_CODEC_FLAG2_FAST;
+    else codecCtx->flags2 &= ~AV_CODEC_FLAG2_FAST;
+
+    if (level >= DegradationLevel::KEY_FRAMES_ONLY) codecCtx->skip_frame = AVDISCARD_NONKEY;
+    else if (level >= DegradationLevel::SKIP_NON_REF) codecCtx->skip_frame = AVDISCARD_NONREF;
+    else codecCtx->skip_frame = AVDISCARD_DEFAULT;
+}
+
+void DecoderDegradation::reset(int64_t nowMs) {
+    std::unique_lock<std::mutex> lck(mMutex);
+    if (mLevel != DegradationLevel::NONE) changeLevel(DegradationLevel::NONE, 0, nowMs);
+    mBehindSinceMs = 0;
+    mCaughtUpSinceMs = 0;
+}
+
+DegradationLevel DecoderDegradation::getLevel() {
+    std::unique_lock<std::mutex> lck(mMutex);
+    return mLevel;
+}
+
+DegradationStats DecoderDegradation::getStats(int64_t nowMs) {
+    std::unique_lock<std::mutex> lck(mMutex);
+    DegradationStats stats = mStats;
+    stats.mLevel = mLevel;
+    // Include time spent at current level so far
+    if (mLevelSinceMs != 0) stats.mTimeAtLevelMs[(int) mLevel] += nowMs - mLevelSinceMs;
+    return stats;
+}
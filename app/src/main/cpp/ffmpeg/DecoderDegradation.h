@@ -0,0 +1,81 @@
+#ifndef DECODER_DEGRADATION_H
+#define DECODER_DEGRADATION_H
+
+extern "C" {
+#include "libavcodec/avcodec.h"
+}
+#include "mutex"
+
+/** Steps of decoder degradation, each step keeps every measure of the previous ones. */
+enum class DegradationLevel {
+    NONE = 0,
+    SKIP_LOOP_FILTER = 1, // Skip loop filter on non-reference frames
+    FAST_DECODE = 2, // Allow non spec compliant speedup tricks
+    SKIP_NON_REF = 3, // Skip decoding non-reference frames
+    KEY_FRAMES_ONLY = 4 // Decode key frames only
+};
+
+static const int NB_DEGRADATION_LEVELS = 5;
+
+/** Snapshot of degradation counters. */
+struct DegradationStats {
+    DegradationLevel mLevel = DegradationLevel::NONE;
+    int64_t mNbDegrades = 0; // Number of steps down the ladder
+    int64_t mNbRecovers = 0; // Number of steps back up the ladder
+    int64_t mTimeAtLevelMs[NB_DEGRADATION_LEVELS] = {}; // Time spent at each level
+};
+
+/** Receives degradation level changes. Called from decoding thread. */
+class DegradationListener {
+public:
+    virtual void onDegradationChanged(DegradationLevel oldLevel, DegradationLevel newLevel, int64_t latenessMs) = 0;
+};
+
+/** Steps a decoder through a degradation ladder based on how far its output is behind the master clock.
+ * Degrades one step after being late for a while and recovers one step after being on time for longer,
+ * so that the level does not oscillate. */
+class DecoderDegradation {
+private:
+    // Output later than this is considered behind
+    static const int64_t DEGRADE_LATENESS_MS = 100;
+    // Output earlier than this is considered caught up
+    static const int64_t RECOVER_LATENESS_MS = 20;
+    // How long output must stay behind before degrading one more step
+    static const int64_t DEGRADE_DELAY_MS = 500;
+    // How long output must stay caught up before recovering one step
+    static const int64_t RECOVER_DELAY_MS = 2000;
+
+    std::mutex mMutex;
+    DegradationLevel mLevel = DegradationLevel::NONE;
+    DegradationListener *mListener = nullptr;
+
+    // Start time of current behind or caught up streak, 0 if there is none
+    int64_t mBehindSinceMs = 0;
+    int64_t mCaughtUpSinceMs = 0;
+    // Time of last level change
+    int64_t mLevelSinceMs = 0;
+
+    DegradationStats mStats;
+
+private:
+    void changeLevel(DegradationLevel level, int64_t latenessMs, int64_t nowMs);
+
+public:
+    void setListener(DegradationListener *listener);
+
+    /** Feed lateness of decoder output against master clock.
+     * @return true if degradation level changed */
+    bool update(int64_t latenessMs, int64_t nowMs);
+
+    /** Apply current degradation level to decoder options. Must be called from decoding thread. */
+    void apply(AVCodecContext *codecCtx);
+
+    /** Go back to full quality decoding, e.g. after a seek. */
+    void reset(int64_t nowMs);
+
+    DegradationLevel getLevel();
+
+    DegradationStats getStats(int64_t nowMs);
+};
+
+#endif //DECODER_DEGRADATION_H
@@ -77,20 +77,20 @@ void Demuxer::initiateDemuxer() {
         mAudioStream->mTimebase = mAudioStream->mStream->time_base;
     }
 
-    if (!mVideoStream && !mAudioStream) {
+    if (!mVideoStream->mCodecCtx && !mAudioStream->mCodecCtx) {
         LOGE("No audio or video stream found, aborting.");
         return;
     }
 
-    mFrame = av_frame_alloc();
-    if (!mFrame) {
-        LOGE("Could not allocate frame.");
-        return;
-    }
+    // Create packet queues feeding decoding threads
+    mPacketPool = new PacketPool();
+    if (mVideoStream->mCodecCtx && !initiateDecodeStream(mVideoStream)) return;
+    if (mAudioStream->mCodecCtx && !initiateDecodeStream(mAudioStream)) return;
 
     mPacket = av_packet_alloc();
-    if (!mPacket) {
-        LOGE("Could not allocate packet.");
+    mStepFrame = av_frame_alloc();
+    if (!mPacket || !mStepFrame) {
+        LOGE("Could not allocate packet or frame.");
         return;
     }
 
@@ -147,6 +147,27 @@ int Demuxer::openCodecContext(DecodeStream *dst, AVMediaType type) {
     return 1;
 }
 
+bool Demuxer::initiateDecodeStream(DecodeStream *dst) {
+    dst->mDemuxer = this;
+
+    dst->mFrame = av_frame_alloc();
+    if (!dst->mFrame) {
+        LOGE("Could not allocate frame.");
+        return false;
+    }
+
+    dst->mPacketQueue = new PacketQueue(mPacketPool, &mContinueReadCond);
+    return true;
+}
+
+void Demuxer::releaseDecodeStream(DecodeStream *dst) {
+    if (!dst) return;
+    avcodec_free_context(&dst->mCodecCtx);
+    av_frame_free(&dst->mFrame);
+    delete dst->mPacketQueue;
+    dst->mPacketQueue = nullptr;
+}
+
 int Demuxer::decodePacket(DecodeStream *dst, AVPacket *pkt) {
     int ret;
 
@@ -162,7 +183,7 @@ int Demuxer::decodePacket(DecodeStream *dst, AVPacket *pkt) {
     // Get all available frames from the decoder
     while (ret >= 0) {
         if (mState == DemuxerState::STOPPED) return 0;
-        ret = avcodec_receive_frame(dst->mCodecCtx, mFrame);
+        ret = avcodec_receive_frame(dst->mCodecCtx, dst->mFrame);
         if (ret < 0) {
             // Those two return values are special and mean there is no output
             // frame available, but there were no errors during decoding
@@ -172,43 +193,81 @@ int Demuxer::decodePacket(DecodeStream *dst, AVPacket *pkt) {
             return ret;
         }
 
-        // Maximum number of times to try to write frame into sinks
-        int numRetries;
         // Write the frame data to video/audio sinks
         if (dst->mCodecCtx->codec->type == AVMEDIA_TYPE_VIDEO) {
-            VideoSinkNode *videoSink = mVideoSinks;
-            while (videoSink != nullptr) {
-                numRetries = 30;
-                // Try to write frame into sink, retry after a while if not succeeded
-                while (!videoSink->sink->onVideoFrame(mFrame) && numRetries){
-                    if (mState == DemuxerState::STOPPED) return 0;
-                    if (mState == DemuxerState::RUNNING) numRetries--;
-                    usleep(10000); // Sleep for 10ms
-                }
-                videoSink = videoSink->next;
-            }
-        } else {
-            AudioSinkNode *audioSink = mAudioSinks;
-            while (audioSink != nullptr) {
-                numRetries = 30;
-                // Try to write frame into sink, retry after a while if not succeeded
-                while (!audioSink->sink->onAudioFrame(mFrame) && numRetries){
-                    if (mState == DemuxerState::STOPPED) return 0;
-                    if (mState == DemuxerState::RUNNING) numRetries--;
-                    usleep(10000); // Sleep for 10ms
-                }
-                audioSink = audioSink->next;
+            if (dst->mFrame->best_effort_timestamp != AV_NOPTS_VALUE) {
+                mVideoPtsUs = av_rescale_q(dst->mFrame->best_effort_timestamp, dst->mTimebase, AV_TIME_BASE_Q);
             }
+            mGopCache.put(dst->mFrame);
+            if (!isFrameStale(dst)) updateStepBackward(dst->mFrame);
         }
+        writeFrame(dst, dst->mFrame);
 
-        av_frame_unref(mFrame);
+        av_frame_unref(dst->mFrame);
     }
 
     return 0;
 }
 
-int Demuxer::decodePacket(DecodeStream *dst) {
-    return decodePacket(dst, mPacket);
+void Demuxer::updateSinks(DecodeStream *dst) {
+    if (dst->mSinkVersion == mSinkVersion) return;
+    std::unique_lock<std::mutex> lck(mSinkMutex);
+    dst->mVideoSinks.clear();
+    dst->mAudioSinks.clear();
+    if (dst == mVideoStream) {
+        for (VideoSinkNode *node = mVideoSinks; node != nullptr; node = node->next) {
+            dst->mVideoSinks.push_back(node->sink);
+        }
+    } else {
+        for (AudioSinkNode *node = mAudioSinks; node != nullptr; node = node->next) {
+            dst->mAudioSinks.push_back(node->sink);
+        }
+    }
+    dst->mSinkVersion = mSinkVersion;
+}
+
+bool Demuxer::isFrameStale(DecodeStream *dst) {
+    return dst->mSerial != dst->mPacketQueue->getSerial();
+}
+
+void Demuxer::writeFrame(DecodeStream *dst, AVFrame *frame) {
+    std::unique_lock<std::mutex> lck(dst->mDeliveryMutex);
+    bool isVideo = dst == mVideoStream;
+    dst->mWrittenSinks.clear();
+    // Sinks are gone over again whenever they change meanwhile, skipping those frame was written into
+    while (mState != DemuxerState::STOPPED && !isFrameStale(dst)) {
+        updateSinks(dst);
+        size_t nbSinks = isVideo ? dst->mVideoSinks.size() : dst->mAudioSinks.size();
+        for (size_t i = 0; i < nbSinks && dst->mSinkVersion == mSinkVersion; i++) {
+            Sink *sink = isVideo ? (Sink *) dst->mVideoSinks[i] : (Sink *) dst->mAudioSinks[i];
+            if (std::find(dst->mWrittenSinks.begin(), dst->mWrittenSinks.end(), sink) != dst->mWrittenSinks.end()) {
+                continue;
+            }
+
+            // Maximum number of times to try to write frame into sink
+            int numRetries = 30;
+            bool isDone = false;
+            // Try to write frame into sink, retry after a while if not succeeded. Retrying stops right away once a
+            // seek made frame stale, or once sinks changed as sink removal waits for it
+            while (mState != DemuxerState::STOPPED && !isFrameStale(dst) && dst->mSinkVersion == mSinkVersion) {
+                int ret = isVideo ? dst->mVideoSinks[i]->onVideoFrame(frame) : dst->mAudioSinks[i]->onAudioFrame(frame);
+                if (ret || !numRetries) {
+                    isDone = true;
+                    break;
+                }
+                if (mState == DemuxerState::RUNNING) numRetries--;
+                usleep(10000); // Sleep for 10ms
+            }
+            if (isDone) dst->mWrittenSinks.push_back(sink);
+        }
+        if (dst->mSinkVersion == mSinkVersion) return;
+    }
+}
+
+void Demuxer::waitForDelivery() {
+    for (DecodeStream *dst : {mVideoStream, mAudioStream}) {
+        if (dst) std::unique_lock<std::mutex> lck(dst->mDeliveryMutex);
+    }
 }
 
 void Demuxer::flushDecoder(DecodeStream *dst) {
@@ -267,68 +326,52 @@ int64_t Demuxer::getDuration() const {
 
 void Demuxer::addVideoSink(VideoSink *videoSink) {
     if (!videoSink) return;
-    std::unique_lock<std::mutex> lck(mMutex);
-    if (mVideoSinks == nullptr) mVideoSinks = new VideoSinkNode(videoSink);
-    else {
-        auto *node = new VideoSinkNode(videoSink);
-        node->next = nullptr;
-        mVideoSinks->next = node;
-    }
+    std::unique_lock<std::mutex> lck(mSinkMutex);
+    // Sinks get frames in the order they were added
+    VideoSinkNode **tail = &mVideoSinks;
+    while (*tail != nullptr) tail = &(*tail)->next;
+    *tail = new VideoSinkNode(videoSink);
+    mSinkVersion++;
 }
 
 void Demuxer::addAudioSink(AudioSink *audioSink) {
     if (!audioSink) return;
-    std::unique_lock<std::mutex> lck(mMutex);
-    if (mAudioSinks == nullptr) mAudioSinks = new AudioSinkNode(audioSink);
-    else {
-        auto *node = new AudioSinkNode(audioSink);
-        node->next = nullptr;
-        mAudioSinks->next = node;
-    }
+    std::unique_lock<std::mutex> lck(mSinkMutex);
+    AudioSinkNode **tail = &mAudioSinks;
+    while (*tail != nullptr) tail = &(*tail)->next;
+    *tail = new AudioSinkNode(audioSink);
+    mSinkVersion++;
 }
 
 void Demuxer::removeVideoSink(int id) {
-    std::unique_lock<std::mutex> lck(mMutex);
-    if (mVideoSinks == nullptr) return;
-    VideoSinkNode *node = mVideoSinks;
-    if (node->sink->mId == id) {
-        VideoSinkNode *tmp = mVideoSinks;
-        mVideoSinks = mVideoSinks->next;
-        delete tmp;
-    }
-    while (node->next != nullptr) {
-        if (node->next->sink->mId == id) {
-            VideoSinkNode *tmp = node->next;
-            node->next = node->next->next;
-            delete tmp;
-            return;
-        }
-        node = node->next;
-    }
+    std::unique_lock<std::mutex> lck(mSinkMutex);
+    VideoSinkNode **node = &mVideoSinks;
+    while (*node != nullptr && (*node)->sink->mId != id) node = &(*node)->next;
+    if (*node == nullptr) return;
+    VideoSinkNode *tmp = *node;
+    *node = tmp->next;
+    delete tmp;
+    mSinkVersion++;
+    lck.unlock();
+    waitForDelivery();
 }
 
 void Demuxer::removeAudioSink(int id) {
-    std::unique_lock<std::mutex> lck(mMutex);
-    if (mAudioSinks == nullptr) return;
-    AudioSinkNode *node = mAudioSinks;
-    if (node->sink->mId == id) {
-        AudioSinkNode *tmp = mAudioSinks;
-        mAudioSinks = mAudioSinks->next;
-        delete (tmp);
-    }
-    while (node->next != nullptr) {
-        if (node->next->sink->mId == id) {
-            AudioSinkNode *tmp = node->next;
-            node->next = node->next->next;
-            delete (tmp);
-            return;
-        }
-        node = node->next;
-    }
+    std::unique_lock<std::mutex> lck(mSinkMutex);
+    AudioSinkNode **node = &mAudioSinks;
+    while (*node != nullptr && (*node)->sink->mId != id) node = &(*node)->next;
+    if (*node == nullptr) return;
+    AudioSinkNode *tmp = *node;
+    *node = tmp->next;
+    delete tmp;
+    mSinkVersion++;
+    lck.unlock();
+    waitForDelivery();
 }
 
 void Demuxer::removeAllSinks() {
     LOGV("Removing all sinks...");
+    std::unique_lock<std::mutex> lck(mSinkMutex);
     if (mVideoSinks != nullptr) {
         VideoSinkNode *tmp;
         while (mVideoSinks != nullptr) {
@@ -346,6 +389,9 @@ void Demuxer::removeAllSinks() {
             delete tmp;
         }
     }
+    mSinkVersion++;
+    lck.unlock();
+    waitForDelivery();
     LOGV("All sinks removed.");
 }
 
@@ -377,14 +423,143 @@ void Demuxer::seek(int64_t ts) {
         return;
     }
     mMutex.lock();
+    seekTo(ts * 1000);
+    mMutex.unlock();
+}
 
-    av_seek_frame(mFmtCtx, -1, ts * 1000, AVSEEK_FLAG_BACKWARD);
+void Demuxer::flushQueues() {
+    // Decoding threads flush codec buffers once they reach packets of the new serial
+    if (mAudioStream->mPacketQueue) mAudioStream->mPacketQueue->flush();
+    if (mVideoStream->mPacketQueue) mVideoStream->mPacketQueue->flush();
+    // A step backward still decoding is given up
+    mStepTargetPts = AV_NOPTS_VALUE;
+    flushSinks();
+    // Lateness measured before does not apply anymore
+    mVideoDegradation.reset(getMonotonicTimeNs() / 1000000);
+}
 
-    // Flush codec buffer
-    avcodec_flush_buffers(mAudioStream->mCodecCtx);
-    avcodec_flush_buffers(mVideoStream->mCodecCtx);
+void Demuxer::flushSinks() {
+    for (DecodeStream *dst : {mAudioStream, mVideoStream}) {
+        if (!dst || !dst->mPacketQueue) continue;
+        // Frame being written is stale once queue was flushed, its delivery stops at its next retry, so every frame
+        // sinks get from now on comes after the flush
+        std::unique_lock<std::mutex> lck(dst->mDeliveryMutex);
+        updateSinks(dst);
+        if (dst == mVideoStream) {
+            for (VideoSink *sink : dst->mVideoSinks) sink->onVideoFlush();
+        } else {
+            for (AudioSink *sink : dst->mAudioSinks) sink->onAudioFlush();
+        }
+    }
+}
 
-    mMutex.unlock();
+void Demuxer::seekTo(int64_t tsUs) {
+    av_seek_frame(mFmtCtx, -1, tsUs, AVSEEK_FLAG_BACKWARD);
+    flushQueues();
+}
+
+void Demuxer::setTrickPlay(double speed) {
+    if (!mVideoStream || !mVideoStream->mPacketQueue) {
+        LOGE("No video stream. Cannot trick play.");
+        return;
+    }
+    std::unique_lock<std::mutex> lck(mMutex);
+    double prevSpeed = mTrickPlaySpeed;
+    if (speed == prevSpeed) return;
+
+    if (prevSpeed == 0) {
+        LOGD("Trick play started at %.2fx", speed);
+        // Keyframes are sought one by one from the last frame decoded, packets queued for normal playback are dropped
+        mTrickPlayTargetUs = mVideoPtsUs;
+        mTrickPlayIndexTs = AV_NOPTS_VALUE;
+        mTrickPlayKeyTs = AV_NOPTS_VALUE;
+        mTrickPlayDueNs = 0;
+        mNbTrickPlayKeyframes = 0;
+        mNbTrickPlaySkips = 0;
+        flushQueues();
+    } else if (speed == 0) {
+        LOGD("Trick play stopped, %lld keyframes queued, %lld skipped",
+             (long long) mNbTrickPlayKeyframes, (long long) mNbTrickPlaySkips);
+        // Every stream is read again from the last keyframe shown
+        seekTo(mVideoPtsUs);
+    }
+    mTrickPlaySpeed = speed;
+}
+
+bool Demuxer::isTrickPlay() const {
+    return mTrickPlaySpeed != 0;
+}
+
+int64_t Demuxer::demuxTrickPlay() {
+    int64_t nowNs = getMonotonicTimeNs();
+    if (nowNs < mTrickPlayDueNs) return (mTrickPlayDueNs - nowNs) / 1000;
+    // Fell behind schedule, e.g. while paused, start it again from now rather than catching up
+    if (nowNs - mTrickPlayDueNs > TRICK_PLAY_PERIOD_NS) mTrickPlayDueNs = nowNs;
+    mTrickPlayDueNs += TRICK_PLAY_PERIOD_NS;
+
+    double speed = mTrickPlaySpeed;
+    int64_t startUs = mFmtCtx->start_time != AV_NOPTS_VALUE ? mFmtCtx->start_time : 0;
+    mTrickPlayTargetUs += (int64_t) (speed * TRICK_PLAY_PERIOD_NS / 1000);
+    mTrickPlayTargetUs = std::max(mTrickPlayTargetUs, startUs);
+    if (mHasDuration) mTrickPlayTargetUs = std::min(mTrickPlayTargetUs, startUs + mDuration);
+
+    // Decoder is still busy with previous keyframe, skip this one rather than showing keyframes late
+    if (mVideoStream->mPacketQueue->getBytes() > 0) {
+        mNbTrickPlaySkips++;
+        return 0;
+    }
+
+    // Forward shows the last keyframe at or before target, backward the first one at or after it
+    AVStream *stream = mVideoStream->mStream;
+    int seekFlags = speed > 0 ? AVSEEK_FLAG_BACKWARD : 0;
+    int64_t targetTs = av_rescale_q(mTrickPlayTargetUs, AV_TIME_BASE_Q, mVideoStream->mTimebase);
+    // Keyframe index tells without seeking if target went past another keyframe, streams without index are sought
+    // every time and keyframes found again are dropped
+    int idx = av_index_search_timestamp(stream, targetTs, seekFlags);
+    const AVIndexEntry *entry = idx >= 0 ? avformat_index_get_entry(stream, idx) : nullptr;
+    if (entry) {
+        if (entry->timestamp == mTrickPlayIndexTs) return 0;
+        mTrickPlayIndexTs = entry->timestamp;
+        targetTs = entry->timestamp;
+    }
+
+    int64_t keyTs = queueKeyframe(targetTs, seekFlags);
+    if (keyTs != AV_NOPTS_VALUE && keyTs != mTrickPlayKeyTs) {
+        mTrickPlayKeyTs = keyTs;
+        mNbTrickPlayKeyframes++;
+    }
+    return 0;
+}
+
+int64_t Demuxer::queueKeyframe(int64_t ts, int seekFlags) {
+    int ret = av_seek_frame(mFmtCtx, mVideoStream->mStreamIdx, ts, seekFlags);
+    if (ret < 0) {
+        LOGE("Trick play failed to seek: %s", av_err2str(ret));
+        return AV_NOPTS_VALUE;
+    }
+
+    for (int i = 0; i < TRICK_PLAY_MAX_READS; i++) {
+        if (av_read_frame(mFmtCtx, mPacket) < 0) return AV_NOPTS_VALUE;
+        // Audio and anything read before keyframe is skipped
+        if (mPacket->stream_index != mVideoStream->mStreamIdx || !(mPacket->flags & AV_PKT_FLAG_KEY)) {
+            av_packet_unref(mPacket);
+            continue;
+        }
+
+        int64_t keyTs = mPacket->dts != AV_NOPTS_VALUE ? mPacket->dts : mPacket->pts;
+        if (keyTs != mTrickPlayKeyTs) {
+            AVPacket *pkt = mPacketPool->acquire();
+            if (pkt && mPacketPool->copyPacket(pkt, mPacket) >= 0) {
+                mVideoStream->mPacketQueue->put(pkt);
+            } else {
+                LOGE("Could not queue keyframe, dropping it.");
+                mPacketPool->release(pkt);
+            }
+        }
+        av_packet_unref(mPacket);
+        return keyTs;
+    }
+    return AV_NOPTS_VALUE;
 }
 
 void Demuxer::pause() {
@@ -418,8 +593,12 @@ void Demuxer::resume() {
 void Demuxer::stop() {
     LOGV("Stopping demuxer...");
     mState = DemuxerState::STOPPED;
-    // Wait for demuxing thread to stop
-    pthread_join(mThread, nullptr);
+    // Wake up decoding threads waiting for packets
+    if (mAudioStream->mPacketQueue) mAudioStream->mPacketQueue->abort();
+    if (mVideoStream->mPacketQueue) mVideoStream->mPacketQueue->abort();
+    // Wait for demuxing thread to stop, it waits for decoding threads itself
+    if (mThread) pthread_join(mThread, nullptr);
+    mThread = 0;
     LOGV("Demuxer stopped.");
 }
 
@@ -431,16 +610,27 @@ void Demuxer::release() {
         case DemuxerState::READY:
         case DemuxerState::PAUSED:
         case DemuxerState::STOPPED:
-            avcodec_free_context(&mVideoStream->mCodecCtx);
-            avcodec_free_context(&mAudioStream->mCodecCtx);
+            releaseDecodeStream(mVideoStream);
+            releaseDecodeStream(mAudioStream);
 
             av_packet_free(&mPacket);
-            av_frame_free(&mFrame);
+            av_frame_free(&mStepFrame);
+            if (mPacketPool) {
+                PacketPoolStats stats = mPacketPool->getStats();
+                LOGD("Packet pool: %lld packets queued, %lld packet and %lld payload allocations",
+                     (long long) stats.mNbRequests, (long long) stats.mNbPacketAllocs, (long long) stats.mNbPayloadAllocs);
+                delete mPacketPool;
+                mPacketPool = nullptr;
+            }
+            logDegradationStats();
+            logGopCacheStats();
+            mGopCache.clear();
 
             removeAllSinks();
 
             delete mAudioStream;
             delete mVideoStream;
+            mAudioStream = mVideoStream = nullptr;
             avformat_close_input(&mFmtCtx);
             delete mFmtCtx;
 
@@ -453,11 +643,160 @@ void Demuxer::release() {
     LOGV("Demuxer released.");
 }
 
+int64_t Demuxer::getVideoLatenessMs() {
+    std::unique_lock<std::mutex> lck(mSinkMutex);
+    int64_t latenessMs = INT64_MAX;
+    for (VideoSinkNode *videoSink = mVideoSinks; videoSink != nullptr; videoSink = videoSink->next) {
+        // Recorders take every frame whenever it comes, they are never late nor on time
+        if (!videoSink->sink->isPresenting()) continue;
+        latenessMs = std::min(latenessMs, videoSink->sink->getLatenessMs());
+    }
+    return latenessMs == INT64_MAX ? 0 : latenessMs;
+}
+
+int Demuxer::getVideoLowres(int maxLowres) {
+    std::unique_lock<std::mutex> lck(mSinkMutex);
+    VideoSinkNode *videoSink = mVideoSinks;
+    if (videoSink == nullptr) return 0;
+
+    int lowres = maxLowres;
+    while (videoSink != nullptr && lowres > 0) {
+        int width, height;
+        if (!videoSink->sink->getPreferredSize(&width, &height)) return 0;
+        // Each lowres step halves both dimensions
+        while (lowres > 0 && (AV_CEIL_RSHIFT(mVideoStream->mWidth, lowres) < width ||
+                              AV_CEIL_RSHIFT(mVideoStream->mHeight, lowres) < height)) {
+            lowres--;
+        }
+        videoSink = videoSink->next;
+    }
+    return lowres;
+}
+
+void Demuxer::updateVideoLowres(DecodeStream *dst, const AVPacket *pkt) {
+    const AVCodec *codec = dst->mCodecCtx->codec;
+    if (!codec || codec->max_lowres == 0 || !(pkt->flags & AV_PKT_FLAG_KEY)) return;
+
+    const AVCodecDescriptor *desc = avcodec_descriptor_get(codec->id);
+    if (!desc || !(desc->props & AV_CODEC_PROP_INTRA_ONLY)) return;
+
+    int lowres = getVideoLowres(codec->max_lowres);
+    if (lowres == dst->mCodecCtx->lowres) return;
+    LOGD("Video decoder lowres %d -> %d", dst->mCodecCtx->lowres, lowres);
+    dst->mCodecCtx->lowres = lowres;
+}
+
+void Demuxer::logDegradationStats() {
+    DegradationStats stats = mVideoDegradation.getStats(getMonotonicTimeNs() / 1000000);
+    int64_t degradedMs = 0;
+    for (int i = 1; i < NB_DEGRADATION_LEVELS; i++) degradedMs += stats.mTimeAtLevelMs[i];
+    LOGD("Video decoder degraded %lld times, recovered %lld times, %lldms spent degraded",
+         (long long) stats.mNbDegrades, (long long) stats.mNbRecovers, (long long) degradedMs);
+}
+
+void Demuxer::logGopCacheStats() {
+    GopCacheStats stats = mGopCache.getStats();
+    if (stats.mNbLookups == 0) return;
+    LOGD("GOP cache: %lld of %lld frames served from cache, %lld GOPs evicted, %lld frames held in %lld bytes",
+         (long long) stats.mNbHits, (long long) stats.mNbLookups, (long long) stats.mNbEvictions,
+         (long long) stats.mNbFrames, (long long) stats.mBytes);
+}
+
+void Demuxer::setGopCache(int64_t maxBytes, int lowres) {
+    mGopCache.configure(maxBytes, lowres);
+}
+
+void Demuxer::writePreviewFrame(AVFrame *frame) {
+    std::unique_lock<std::mutex> lck(mSinkMutex);
+    VideoSinkNode *videoSink = mVideoSinks;
+    while (videoSink != nullptr) {
+        videoSink->sink->onPreviewFrame(frame);
+        videoSink = videoSink->next;
+    }
+}
+
+bool Demuxer::scrub(int64_t ts) {
+    if (!mVideoStream || !mVideoStream->mPacketQueue) return false;
+    AVFrame *frame = av_frame_alloc();
+    if (!frame) return false;
+    bool isCached = mGopCache.get(msToPts(ts, mVideoStream->mTimebase), frame);
+    if (isCached) writePreviewFrame(frame);
+    av_frame_free(&frame);
+
+    seek(ts);
+    return isCached;
+}
+
+bool Demuxer::stepBackward(int64_t pts) {
+    if (!mVideoStream || !mVideoStream->mPacketQueue || pts == AV_NOPTS_VALUE) return false;
+    AVFrame *frame = av_frame_alloc();
+    if (!frame) return false;
+    bool isCached = mGopCache.getPrevious(pts, frame);
+    if (isCached) {
+        writePreviewFrame(frame);
+        seek(ptsToMs(frame->pts, mVideoStream->mTimebase));
+    } else if (mHasDuration) {
+        // Decode again from the keyframe before the previous frame, video decoding thread shows it once there.
+        // Target is set once frames decoded before the seek are stale, so that none of them is taken for it.
+        std::unique_lock<std::mutex> lck(mMutex);
+        seekTo(av_rescale_q(pts - 1, mVideoStream->mTimebase, AV_TIME_BASE_Q));
+        mStepTargetPts = pts;
+    }
+    av_frame_free(&frame);
+    return isCached;
+}
+
+void Demuxer::updateStepBackward(const AVFrame *frame) {
+    int64_t targetPts = mStepTargetPts;
+    if (targetPts == AV_NOPTS_VALUE || frame->best_effort_timestamp == AV_NOPTS_VALUE) return;
+    if (frame->best_effort_timestamp < targetPts) {
+        av_frame_unref(mStepFrame);
+        if (av_frame_ref(mStepFrame, frame) < 0) LOGE("Could not keep frame before step target.");
+        return;
+    }
+
+    // Nothing before target when stepping back from first frame, target is left alone if another step replaced it
+    if (mStepFrame->buf[0]) {
+        mStepFrame->pts = mStepFrame->best_effort_timestamp;
+        writePreviewFrame(mStepFrame);
+    }
+    av_frame_unref(mStepFrame);
+    mStepTargetPts.compare_exchange_strong(targetPts, AV_NOPTS_VALUE);
+}
+
+GopCacheStats Demuxer::getGopCacheStats() {
+    return mGopCache.getStats();
+}
+
+void Demuxer::setDegradationListener(DegradationListener *listener) {
+    mVideoDegradation.setListener(listener);
+}
+
+DegradationStats Demuxer::getDegradationStats() {
+    return mVideoDegradation.getStats(getMonotonicTimeNs() / 1000000);
+}
+
+bool Demuxer::hasEnoughPackets() {
+    int64_t bytes = 0;
+    bool isEnough = true;
+    for (DecodeStream *dst : {mVideoStream, mAudioStream}) {
+        if (!dst->mPacketQueue) continue;
+        bytes += dst->mPacketQueue->getBytes();
+        isEnough = isEnough && dst->mPacketQueue->hasEnoughPackets();
+    }
+    return bytes > MAX_QUEUE_BYTES || isEnough;
+}
+
 void *Demuxer::threadDemux(void *args) {
     LOGV("Demuxing thread started.");
     auto *demuxer = (Demuxer *) args;
     std::unique_lock<std::mutex> lck(demuxer->mMutex, std::defer_lock);
 
+    // Start decoding threads
+    for (DecodeStream *dst : {demuxer->mVideoStream, demuxer->mAudioStream}) {
+        if (dst->mPacketQueue) pthread_create(&dst->mThread, nullptr, Demuxer::threadDecode, dst);
+    }
+
     int ret;
     while (true) {
         lck.lock();
@@ -467,9 +806,21 @@ void *Demuxer::threadDemux(void *args) {
             break;
         }
 
-        if (demuxer->mState == DemuxerState::PAUSED) {
+        // Trick play reads only keyframes it shows, once each is due
+        if (demuxer->mState == DemuxerState::RUNNING && demuxer->isTrickPlay()) {
+            int64_t waitUs = demuxer->demuxTrickPlay();
+            lck.unlock();
+            if (waitUs > 0) usleep(std::min(waitUs, (int64_t) 10000)); // Sleep 10ms at most
+            continue;
+        }
+
+        // Take a break when paused or when decoders have enough packets to work on. A step backward is decoded
+        // while paused too.
+        bool isStepping = demuxer->mStepTargetPts != AV_NOPTS_VALUE;
+        if ((demuxer->mState == DemuxerState::PAUSED && !isStepping) || demuxer->hasEnoughPackets()) {
+            // Wait 10ms at most, decoders wake demuxing up as soon as a queue runs low
+            demuxer->mContinueReadCond.wait_for(lck, std::chrono::milliseconds(10));
             lck.unlock();
-            usleep(10000); // Sleep 10ms
             continue;
         }
 
@@ -480,24 +831,94 @@ void *Demuxer::threadDemux(void *args) {
         }
 
         // check if the packet belongs to a stream we are interested in, otherwise skip it
+        DecodeStream *dst = nullptr;
         if (demuxer->mPacket->stream_index == demuxer->mVideoStream->mStreamIdx) {
-            ret = demuxer->decodePacket(demuxer->mVideoStream);
+            dst = demuxer->mVideoStream;
         } else if (demuxer->mPacket->stream_index == demuxer->mAudioStream->mStreamIdx) {
-            ret = demuxer->decodePacket(demuxer->mAudioStream);
+            dst = demuxer->mAudioStream;
         }
 
-        av_packet_unref(demuxer->mPacket);
-
-        if (ret < 0) {
-            lck.unlock();
-            break;
+        if (dst && dst->mPacketQueue) {
+            // Move packet into pooled storage so that read packet can be reused right away
+            AVPacket *pkt = demuxer->mPacketPool->acquire();
+            if (pkt && demuxer->mPacketPool->copyPacket(pkt, demuxer->mPacket) >= 0) {
+                dst->mPacketQueue->put(pkt);
+            } else {
+                LOGE("Could not queue packet, dropping it.");
+                demuxer->mPacketPool->release(pkt);
+            }
         }
 
+        av_packet_unref(demuxer->mPacket);
         lck.unlock();
     }
 
-    if (lck.owns_lock()) lck.unlock();
+    // Signal end of stream so decoders output leftover frames, then wait for them
+    for (DecodeStream *dst : {demuxer->mVideoStream, demuxer->mAudioStream}) {
+        if (dst->mPacketQueue) dst->mPacketQueue->put(nullptr);
+    }
+    for (DecodeStream *dst : {demuxer->mVideoStream, demuxer->mAudioStream}) {
+        if (dst->mThread) pthread_join(dst->mThread, nullptr);
+        dst->mThread = 0;
+    }
+
     demuxer->mState = DemuxerState::STOPPED;
     LOGV("Demuxing thread finished.");
     return nullptr;
 }
+
+void *Demuxer::threadDecode(void *args) {
+    auto *dst = (DecodeStream *) args;
+    Demuxer *demuxer = dst->mDemuxer;
+    LOGV("%s decoding thread started.", av_get_media_type_string(dst->mCodecCtx->codec_type));
+
+    AVPacket *pkt;
+    int serial;
+    while (dst->mPacketQueue->get(&pkt, &serial)) {
+        // Packets after a seek, drop frames buffered inside decoder
+        if (serial != dst->mSerial) {
+            avcodec_flush_buffers(dst->mCodecCtx);
+            dst->mSerial = serial;
+            // Frames after a seek do not follow on from the GOP being cached, nor from frames kept for a step backward
+            if (dst == demuxer->mVideoStream) {
+                demuxer->mGopCache.endGop();
+                av_frame_unref(demuxer->mStepFrame);
+            }
+        }
+
+        // Null packet is end of stream, flush leftover frames and finish
+        if (!pkt) {
+            demuxer->flushDecoder(dst);
+            break;
+        }
+
+        bool isTrickPlay = dst == demuxer->mVideoStream && demuxer->isTrickPlay();
+        if (isTrickPlay) {
+            // Only keyframes are queued, anything else slipping through is not decoded
+            dst->mCodecCtx->skip_frame = AVDISCARD_NONKEY;
+        } else if (dst == demuxer->mVideoStream) {
+            // Step video decoding quality down while video sinks stay behind their clock, back up once they catch up
+            demuxer->mVideoDegradation.update(demuxer->getVideoLatenessMs(), getMonotonicTimeNs() / 1000000);
+            demuxer->mVideoDegradation.apply(dst->mCodecCtx);
+            // Decode at reduced resolution while every sink draws on a small surface
+            demuxer->updateVideoLowres(dst, pkt);
+        }
+
+        int ret = demuxer->decodePacket(dst, pkt);
+        if (isTrickPlay && ret >= 0) {
+            // Keyframes are far apart and may go backward, drain each one out of decoder instead of letting it
+            // wait for following pictures to be reordered with
+            demuxer->flushDecoder(dst);
+            avcodec_flush_buffers(dst->mCodecCtx);
+        }
+        demuxer->mPacketPool->release(pkt);
+        if (ret < 0) {
+            // Stop accepting packets so demuxing does not wait for this stream
+            dst->mPacketQueue->abort();
+            break;
+        }
+    }
+
+    LOGV("%s decoding thread finished.", av_get_media_type_string(dst->mCodecCtx->codec_type));
+    return nullptr;
+}
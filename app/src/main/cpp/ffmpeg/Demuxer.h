@@ -1,5 +1,9 @@
 
 #include "Sink.h"
+#include "PacketQueue.h"
+#include "DecoderDegradation.h"
+#include "GopCache.h"
+#include "TimeUtils.h"
 
 extern "C" {
 #include "libavformat/avformat.h"
@@ -9,14 +13,36 @@ extern "C" {
 #include "pthread.h"
 }
 #include "mutex"
+#include "atomic"
+#include "condition_variable"
+#include "vector"
+#include "algorithm"
 #include "unistd.h"
 
+class Demuxer;
+
 class DecodeStream {
 public:
     int mStreamIdx = -1;
     AVCodecContext *mCodecCtx = nullptr;
     AVStream *mStream = nullptr;
 
+    // Decoding thread attributes {
+    Demuxer *mDemuxer = nullptr;
+    pthread_t mThread = 0;
+    PacketQueue *mPacketQueue = nullptr; // Packets waiting to be decoded
+    int mSerial = 0; // Serial of packet queue the decoder was last flushed for
+    AVFrame *mFrame = nullptr; // Storage for decoded frame
+    // } Decoding thread attributes
+
+    // Sinks decoded frames are written into, copied from demuxer sink lists whenever those change {
+    std::mutex mDeliveryMutex; // Held while a frame is written into sinks, sink removal waits for it
+    std::vector<VideoSink *> mVideoSinks;
+    std::vector<AudioSink *> mAudioSinks;
+    std::vector<Sink *> mWrittenSinks; // Sinks frame being written was written into
+    int mSinkVersion = -1; // Demuxer sink version sinks were copied at
+    // } Sinks
+
     AVRational mTimebase = av_make_q(0, 1);
     // Video only attributes {
     int mWidth = 0, mHeight = 0;
@@ -44,11 +70,23 @@ public:
 
     char *mUrl = nullptr;
     DecodeStream *mAudioStream = nullptr, *mVideoStream = nullptr;
+    // Packet read by demuxing thread, copied into a pooled packet before being queued
     AVPacket *mPacket = nullptr;
-    AVFrame *mFrame = nullptr;
+    // Recycles queued packets of every stream
+    PacketPool *mPacketPool = nullptr;
+    // Lowers video decoding quality while video sinks are behind their clock
+    DecoderDegradation mVideoDegradation;
+    // Keeps recently decoded video GOPs so that scrubbing and stepping backward inside them need no decoding
+    GopCache mGopCache;
 
     pthread_t mThread = 0;
     std::mutex mMutex;
+    // Signaled by decoding threads when their queue runs low, so that demuxing resumes without waiting its break out
+    std::condition_variable mContinueReadCond;
+    // Guards sink lists, apart from mMutex which is held while reading packets
+    std::mutex mSinkMutex;
+    // Increased on every sink list change, decoding threads copy sink lists again when it moves
+    std::atomic_int mSinkVersion = {0};
 
     std::atomic<DemuxerState> mState = {DemuxerState::INITIATE};
 
@@ -56,6 +94,31 @@ public:
     int64_t mDuration = 0;
 
 private:
+    // Maximum number of payload bytes queued across all streams
+    static const int64_t MAX_QUEUE_BYTES = 15 * 1024 * 1024;
+
+    // Trick play reads and decodes video keyframes only, queued one at a time by demuxing thread at its own pace {
+    // Time between keyframes shown, stream time between them is this times speed
+    static const int64_t TRICK_PLAY_PERIOD_NS = 125000000;
+    // Most packets read after a seek looking for the keyframe it landed on
+    static const int TRICK_PLAY_MAX_READS = 256;
+    std::atomic<double> mTrickPlaySpeed = {0}; // 0 for normal playback, negative to play backward
+    int64_t mTrickPlayTargetUs = 0; // Stream time trick play got to, keyframe shown is the last one it went past
+    int64_t mTrickPlayIndexTs = AV_NOPTS_VALUE; // Index entry last sought to, in video timebase
+    int64_t mTrickPlayKeyTs = AV_NOPTS_VALUE; // Timestamp of last keyframe queued, in video timebase
+    int64_t mTrickPlayDueNs = 0; // Monotonic time next keyframe is due
+    int64_t mNbTrickPlayKeyframes = 0; // Keyframes queued since trick play started
+    int64_t mNbTrickPlaySkips = 0; // Keyframes skipped because decoder had not taken previous one yet
+    // } Trick play
+
+    // Stream time of last decoded video frame, trick play starts and ends there
+    std::atomic_int64_t mVideoPtsUs = {0};
+
+    // Stepping backward past GOP cache decodes from the keyframe before, frame before target is shown once decoded {
+    std::atomic_int64_t mStepTargetPts = {AV_NOPTS_VALUE}; // Frame stepped back from, in video timebase
+    AVFrame *mStepFrame = nullptr; // Latest frame decoded before target, only used from video decoding thread
+    // } Stepping backward
+
     void logPacket(AVPacket *pkt);
 
     void initiateDemuxer();
@@ -63,14 +126,77 @@ private:
     /** Allocate codec context and stream index respective to given media type. */
     int openCodecContext(DecodeStream *dst, AVMediaType type);
 
-    /** Decode given mPacket and output mFrame into mFrame field inside this class. */
+    /** Create packet queue and frame storage of a stream with an opened decoder. */
+    bool initiateDecodeStream(DecodeStream *dst);
+
+    /** Release decoder, packet queue and frame storage of a stream. */
+    void releaseDecodeStream(DecodeStream *dst);
+
+    /** Decode given packet and write decoded frames, stored in stream mFrame, into sinks. */
     int decodePacket(DecodeStream *dst, AVPacket *pkt);
 
-    /** Decode mPacket field from this class and output mFrame into mFrame field inside this class. */
-    int decodePacket(DecodeStream *dst);
+    /** Copy sink lists into stream if they changed since last copy. Caller holds stream delivery mutex. */
+    void updateSinks(DecodeStream *dst);
+
+    /** Check if a seek happened since packet being decoded was queued, its frames are not written anymore then. */
+    bool isFrameStale(DecodeStream *dst);
+
+    /** Write frame into every sink of stream, retrying a while on sinks that are full.
+     * Sinks added or removed meanwhile are taken into account, frame is dropped once it is stale. */
+    void writeFrame(DecodeStream *dst, AVFrame *frame);
+
+    /** Wait for frames being written into sinks, so that sinks removed before are not used once it returns. */
+    void waitForDelivery();
+
+    /** Return lateness of the least late presenting video sink, only then frames can be degraded without any sink
+     * missing them. 0 if no sink presents frames. */
+    int64_t getVideoLatenessMs();
+
+    void logDegradationStats();
+
+    void logGopCacheStats();
+
+    /** Show frame in every video sink out of playback order. */
+    void writePreviewFrame(AVFrame *frame);
+
+    /** Keep decoded video frames before step target, show the last one as preview once target is reached. */
+    void updateStepBackward(const AVFrame *frame);
+
+    /** Return largest lowres every video sink accepts, given decoder limits. */
+    int getVideoLowres(int maxLowres);
+
+    /** Switch video decoder resolution to what video sinks need. Only done on key frames of intra-only codecs,
+     * where no frame references pictures decoded at another resolution. */
+    void updateVideoLowres(DecodeStream *dst, const AVPacket *pkt);
 
+    /** Check if every stream has enough packets queued or queues are too big, so demuxing can take a break. */
+    bool hasEnoughPackets();
+
+    /** Drop queued packets of every stream and frames buffered by sinks, decoding threads flush codec buffers once
+     * they reach newer packets. */
+    void flushQueues();
+
+    /** Make every sink drop what it buffered, waiting for the frame being written into sinks to be given up. */
+    void flushSinks();
+
+    /** Seek every stream to stream time tsUs and drop queued packets. Caller holds mMutex. */
+    void seekTo(int64_t tsUs);
+
+    /** Move trick play target on and queue keyframe it went past, if it is a new one. Caller holds mMutex.
+     * @return micros to wait until next keyframe is due, 0 if one was just handled */
+    int64_t demuxTrickPlay();
+
+    /** Seek video stream to keyframe at or around ts and queue that keyframe, skipping every other packet read.
+     * Keyframe is not queued again if it was the last one queued.
+     * @return timestamp of keyframe found, AV_NOPTS_VALUE if none was found */
+    int64_t queueKeyframe(int64_t ts, int seekFlags);
+
+    /** Read packets and queue them into stream packet queues. */
     static void *threadDemux(void *args);
 
+    /** Take packets from a stream packet queue and decode them. */
+    static void *threadDecode(void *args);
+
 public:
     Demuxer(const char *url);
 
@@ -127,6 +253,13 @@ public:
     /** Seek to timestamp. Only usable if media has duration. */
     void seek(int64_t ts);
 
+    /** Play video keyframes only, speed times faster than normal and backward if speed is negative, audio is skipped.
+     * Keyframes are queued at a steady pace, the one shown is the last one passed at that speed,
+     * so sinks should show frames as they come. Speed 0 goes back to normal playback from the last frame decoded. */
+    void setTrickPlay(double speed);
+
+    bool isTrickPlay() const;
+
     /** Pause demuxer. Resume by calling resume(). */
     void pause();
 
@@ -137,6 +270,29 @@ public:
      * This method will block until thread is terminated. */
     void stop();
 
+    /** Set memory budget of decoded GOP cache, 0 disables it. Frames are cached scaled down by 2^lowres. */
+    void setGopCache(int64_t maxBytes, int lowres = 0);
+
+    /** Show frame at timestamp in video sinks right away and seek there. Frame is taken from GOP cache if it holds it,
+     * otherwise it shows once its GOP is decoded, which caches that GOP for following scrubs.
+     * @return true if frame was shown from cache, without decoding */
+    bool scrub(int64_t ts);
+
+    /** Show frame right before the one at pts in video sinks and seek there, e.g. from frame on screen.
+     * Served from GOP cache if it holds it, repeating it plays cached GOPs in reverse. Otherwise decoding starts over
+     * from the keyframe before, also while paused, and the frame shows once decoded, caching its GOP on the way.
+     * @param pts timestamp in video timebase
+     * @return true if frame was shown from cache, without decoding */
+    bool stepBackward(int64_t pts);
+
+    GopCacheStats getGopCacheStats();
+
+    /** Set listener notified on every video decoder degradation level change. */
+    void setDegradationListener(DegradationListener *listener);
+
+    /** Return video decoder degradation counters. */
+    DegradationStats getDegradationStats();
+
     /** Signal end of stream, flush any leftover frames inside buffer. */
     void flushDecoder(DecodeStream *dst);
 
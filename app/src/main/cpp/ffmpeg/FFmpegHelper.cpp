@@ -1,5 +1,10 @@
 #include "FFmpegHelper.h"
+#include "FramePool.h"
 #include "../common/JNILogHelper.h"
+#include "cstring"
+extern "C" {
+#include "libavutil/opt.h"
+}
 
 #define LOG_TAG "FrameHelper"
 
@@ -19,9 +24,10 @@ AVFrame *FFmpegHelper::allocatePictureFrame(int width, int height, AVPixelFormat
     frame->height = height;
 
     /* allocate the buffers for the mFrame data */
-    ret = av_frame_get_buffer(frame, 0);
+    ret = FramePool::getInstance()->getBuffer(frame, 0);
     if (ret < 0) {
         LOGE("Could not allocate mFrame data: %s", av_err2str(ret));
+        av_frame_free(&frame);
         return nullptr;
     }
     return frame;
@@ -35,6 +41,10 @@ AVFrame *FFmpegHelper::allocateAudioFrame(int sampleRate, uint64_t channelLayout
     int ret;
     AVFrame *frame;
     frame = av_frame_alloc();
+    if (!frame) {
+        LOGE("Could not allocate mFrame.");
+        return nullptr;
+    }
 
     frame->format = sampleFmt;
     frame->channel_layout = channelLayout;
@@ -42,12 +52,78 @@ AVFrame *FFmpegHelper::allocateAudioFrame(int sampleRate, uint64_t channelLayout
     frame->nb_samples = nbSamples;
 
     if (nbSamples) {
-        ret = av_frame_get_buffer(frame, 0);
+        ret = FramePool::getInstance()->getBuffer(frame, 0);
         if (ret < 0) {
             LOGE("Error allocating an audio buffer: %s", av_err2str(ret));
+            av_frame_free(&frame);
             return nullptr;
         }
     }
 
     return frame;
-}
\ No newline at end of file
+}
+
+int FFmpegHelper::makeFrameWritable(AVFrame *frame) {
+    int ret = FramePool::getInstance()->makeWritable(frame);
+    if (ret < 0) {
+        LOGE("Cannot make frame writable: %s", av_err2str(ret));
+        return 0;
+    }
+    return 1;
+}
+
+ResamplerProfile FFmpegHelper::getResamplerProfile(const char *name) {
+    if (name && strcmp(name, "fastest") == 0) return ResamplerProfile::FASTEST;
+    if (name && strcmp(name, "high") == 0) return ResamplerProfile::HIGH;
+    return ResamplerProfile::DEFAULT;
+}
+
+const char *FFmpegHelper::getResamplerProfileName(ResamplerProfile profile) {
+    switch (profile) {
+        case ResamplerProfile::FASTEST:
+            return "fastest";
+        case ResamplerProfile::DEFAULT:
+            return "default";
+        case ResamplerProfile::HIGH:
+            return "high";
+    }
+    return "default";
+}
+
+/** Set swr engine filter length in taps and cutoff relative to Nyquist. Phases are left to exact rational
+ * resampling, which picks one polyphase filter per output position and beats interpolating between phases. */
+static void setSwrFilter(SwrContext *swrCtx, int filterSize, double cutoff, bool isCompensated) {
+    av_opt_set(swrCtx, "resampler", "swr", 0);
+    av_opt_set_int(swrCtx, "filter_size", filterSize, 0);
+    av_opt_set_double(swrCtx, "cutoff", cutoff, 0);
+    // Compensation moves off exact ratio, interpolating between phases keeps its filter accurate
+    if (isCompensated) av_opt_set_int(swrCtx, "linear_interp", 1, 0);
+}
+
+int FFmpegHelper::initResampler(SwrContext *swrCtx, ResamplerProfile profile, bool isCompensated) {
+    int ret;
+    switch (profile) {
+        case ResamplerProfile::FASTEST:
+            setSwrFilter(swrCtx, 8, 0.8, isCompensated);
+            break;
+        case ResamplerProfile::DEFAULT:
+            break;
+        case ResamplerProfile::HIGH:
+            if (!isCompensated) {
+                av_opt_set(swrCtx, "resampler", "soxr", 0);
+                av_opt_set_int(swrCtx, "precision", 28, 0);
+                av_opt_set_double(swrCtx, "cutoff", 0.91, 0);
+                if (swr_init(swrCtx) >= 0) return 0;
+                LOGD("soxr resampler unavailable, using swr");
+            }
+            setSwrFilter(swrCtx, 64, 0.97, isCompensated);
+            // s16 would otherwise be filtered in s16, whose rounded taps and sums undo a longer filter
+            av_opt_set_sample_fmt(swrCtx, "internal_sample_fmt", AV_SAMPLE_FMT_FLTP, 0);
+            break;
+    }
+
+    if ((ret = swr_init(swrCtx)) < 0) {
+        LOGE("Failed to initialize %s resampler: %s", getResamplerProfileName(profile), av_err2str(ret));
+    }
+    return ret;
+}
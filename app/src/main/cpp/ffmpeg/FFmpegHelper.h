@@ -5,18 +5,42 @@ extern "C" {
 #include "libavutil/frame.h"
 #include "libavutil/pixdesc.h"
 #include "libavutil/channel_layout.h"
+#include "libswresample/swresample.h"
 }
 
+/** Trade-off between cost and quality of a resampler. */
+enum class ResamplerProfile {
+    FASTEST, // Short filter with early cutoff, top of the band is lost and some of it aliases
+    DEFAULT, // libswresample defaults
+    HIGH // soxr when available, otherwise a long filter with cutoff close to Nyquist, computed in float
+};
+
 namespace FFmpegHelper {
 
-    /** Allocate a picture frame based on parameters provided
+    /** Allocate a picture frame based on parameters provided, frame buffers are taken from shared FramePool
     * @return allocated frame or null if allocation failed */
     AVFrame *allocatePictureFrame(int width, int height, AVPixelFormat pixFmt);
 
-    /** Allocate an audio frame based on parameters provided
+    /** Allocate an audio frame based on parameters provided, frame buffers are taken from shared FramePool
     * @return allocated frame or null if allocation failed */
     AVFrame *allocateAudioFrame(int sampleRate, uint64_t channelLayout, int nbSamples, enum AVSampleFormat sampleFmt);
 
+    /** Give frame fresh pooled buffers if its buffers are still referenced elsewhere (frame buffer, encoder),
+    * so it can be overwritten. Frame content is not preserved.
+    * @return 1 if frame is writable, 0 if failed */
+    int makeFrameWritable(AVFrame *frame);
+
+    /** Return profile named "fastest", "default" or "high", DEFAULT for any other name. */
+    ResamplerProfile getResamplerProfile(const char *name);
+
+    const char *getResamplerProfileName(ResamplerProfile profile);
+
+    /** Set resampling options of profile on a resampler whose formats are set, then initialize it.
+     * soxr is only used if library was built with it and resampler needs no compensation, which soxr lacks.
+     * @param isCompensated resampler will be given swr_set_compensation
+     * @return 0 if success, negative AVERROR if failed */
+    int initResampler(SwrContext *swrCtx, ResamplerProfile profile, bool isCompensated = false);
+
 }
 
 #endif // FFMPEG_FRAME_HELPER_H
@@ -0,0 +1,251 @@
+#include "FramePool.h"
+#include "../common/JNILogHelper.h"
+
+#define LOG_TAG "FramePool"
+
+FramePool::FramePool(int64_t maxBytes) : mMaxBytes(maxBytes) {}
+
+FramePool::~FramePool() {
+    trim();
+}
+
+FramePool *FramePool::getInstance() {
+    // Never destroyed, frames may still be released while the library unloads
+    static auto *instance = new FramePool(DEFAULT_MAX_BYTES);
+    return instance;
+}
+
+void FramePool::setMaxBytes(int64_t maxBytes) {
+    mMaxBytes = maxBytes;
+}
+
+AVBufferRef *FramePool::poolAlloc(void *opaque, size_t size) {
+    auto *entry = (PoolEntry *) opaque;
+    FramePool *owner = entry->mOwner;
+
+    int64_t maxBytes = owner->mMaxBytes.load();
+    if (maxBytes > 0 && owner->mBytesHeld.load() + (int64_t) size > maxBytes) return nullptr;
+
+    // Buffers of a released pool are freed one by one as they are returned, count each of them on its own
+    auto *data = (uint8_t *) av_malloc(size);
+    if (!data) return nullptr;
+    AVBufferRef *ref = av_buffer_create(data, size, FramePool::bufferFree, entry, 0);
+    if (!ref) {
+        av_free(data);
+        return nullptr;
+    }
+
+    owner->mMisses++;
+    owner->mBytesHeld += (int64_t) size;
+    return ref;
+}
+
+void FramePool::bufferFree(void *opaque, uint8_t *data) {
+    // Entry is still alive, pool frees its buffers before itself
+    auto *entry = (PoolEntry *) opaque;
+    entry->mOwner->mBytesHeld -= (int64_t) entry->mSize;
+    av_free(data);
+}
+
+void FramePool::poolFree(void *opaque) {
+    delete (PoolEntry *) opaque;
+}
+
+int FramePool::releaseIdlePools(const PoolKey &keptKey) {
+    int nbReleased = 0;
+    int64_t nbRequests = mNbRequests;
+    for (auto it = mPools.begin(); it != mPools.end();) {
+        PoolEntry *entry = it->second;
+        if (it->first == keptKey || nbRequests - entry->mLastRequest < IDLE_POOL_REQUESTS) {
+            ++it;
+            continue;
+        }
+        // Idle buffers are freed right away, buffers still in use once returned
+        AVBufferPool *pool = entry->mPool;
+        av_buffer_pool_uninit(&pool);
+        it = mPools.erase(it);
+        nbReleased++;
+    }
+    mNbReleasedPools += nbReleased;
+    return nbReleased;
+}
+
+AVBufferRef *FramePool::getBufferRef(const PoolKey &key, size_t size) {
+    std::unique_lock<std::mutex> lck(mMutex);
+
+    int64_t nbRequests = ++mNbRequests;
+    PoolEntry *entry;
+    auto it = mPools.find(key);
+    if (it == mPools.end() || nbRequests % IDLE_POOL_REQUESTS == 0) {
+        // A new key often means an old one stopped being used
+        releaseIdlePools(key);
+    }
+    if (it == mPools.end()) {
+        entry = new PoolEntry();
+        entry->mOwner = this;
+        entry->mSize = size;
+        entry->mPool = av_buffer_pool_init2(size, entry, FramePool::poolAlloc, FramePool::poolFree);
+        if (!entry->mPool) {
+            LOGE("Could not create buffer pool of size %zu", size);
+            delete entry;
+            mOverflows++;
+            return av_buffer_alloc(size);
+        }
+        mPools[key] = entry;
+    } else {
+        entry = it->second;
+    }
+
+    entry->mLastRequest = nbRequests;
+    AVBufferRef *ref = av_buffer_pool_get(entry->mPool);
+    if (!ref && releaseIdlePools(key) > 0) {
+        // Idle buffers of unused keys may have made room
+        ref = av_buffer_pool_get(entry->mPool);
+    }
+    if (!ref) {
+        // High-water mark reached, this buffer is freed instead of going back to a pool
+        mOverflows++;
+        ref = av_buffer_alloc(size);
+    }
+    return ref;
+}
+
+int FramePool::getVideoBuffer(AVFrame *frame, int align) {
+    auto pixFmt = (AVPixelFormat) frame->format;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(pixFmt);
+    if (!desc) return AVERROR(EINVAL);
+
+    int ret = av_image_check_size(frame->width, frame->height, 0, nullptr);
+    if (ret < 0) return ret;
+
+    // Pick the smallest width alignment giving an aligned first plane, same as av_frame_get_buffer
+    for (int i = 1; i <= align; i += i) {
+        ret = av_image_fill_linesizes(frame->linesize, pixFmt, FFALIGN(frame->width, i));
+        if (ret < 0) return ret;
+        if (!(frame->linesize[0] & (align - 1))) break;
+    }
+    ptrdiff_t linesizes[4];
+    for (int i = 0; i < 4; i++) {
+        frame->linesize[i] = FFALIGN(frame->linesize[i], align);
+        linesizes[i] = frame->linesize[i];
+    }
+
+    // Pad height and planes so that SIMD code may safely over-read
+    int paddedHeight = FFALIGN(frame->height, 32);
+    size_t planePadding = FFMAX(16 + 16 - 1, align);
+    size_t sizes[4];
+    ret = av_image_fill_plane_sizes(sizes, pixFmt, paddedHeight, linesizes);
+    if (ret < 0) return ret;
+
+    size_t totalSize = 4 * planePadding;
+    for (size_t size : sizes) totalSize += size;
+
+    frame->buf[0] = getBufferRef(PoolKey(AVMEDIA_TYPE_VIDEO, pixFmt, frame->width, frame->height, align), totalSize);
+    if (!frame->buf[0]) return AVERROR(ENOMEM);
+
+    ret = av_image_fill_pointers(frame->data, pixFmt, paddedHeight, frame->buf[0]->data, frame->linesize);
+    if (ret < 0) {
+        av_frame_unref(frame);
+        return ret;
+    }
+    for (int i = 1; i < 4; i++) {
+        if (frame->data[i]) frame->data[i] += i * planePadding;
+    }
+
+    frame->extended_data = frame->data;
+    return 0;
+}
+
+int FramePool::getAudioBuffer(AVFrame *frame, int align) {
+    auto sampleFmt = (AVSampleFormat) frame->format;
+    if (!frame->channels) frame->channels = av_get_channel_layout_nb_channels(frame->channel_layout);
+    int channels = frame->channels;
+    if (channels <= 0) return AVERROR(EINVAL);
+
+    // Frames with more planes than data pointers need extended data, leave those to ffmpeg
+    int planes = av_sample_fmt_is_planar(sampleFmt) ? channels : 1;
+    if (planes > AV_NUM_DATA_POINTERS) return av_frame_get_buffer(frame, align);
+
+    int size = av_samples_get_buffer_size(&frame->linesize[0], channels, frame->nb_samples, sampleFmt, align);
+    if (size < 0) return size;
+
+    frame->buf[0] = getBufferRef(PoolKey(AVMEDIA_TYPE_AUDIO, sampleFmt, channels, frame->nb_samples, align), size);
+    if (!frame->buf[0]) return AVERROR(ENOMEM);
+
+    int ret = av_samples_fill_arrays(frame->data, &frame->linesize[0], frame->buf[0]->data,
+                                     channels, frame->nb_samples, sampleFmt, align);
+    if (ret < 0) {
+        av_frame_unref(frame);
+        return ret;
+    }
+
+    frame->extended_data = frame->data;
+    return 0;
+}
+
+int FramePool::getBuffer(AVFrame *frame, int align) {
+    if (frame->format < 0) return AVERROR(EINVAL);
+    if (align <= 0) align = DEFAULT_ALIGN;
+
+    if (frame->width > 0 && frame->height > 0) return getVideoBuffer(frame, align);
+    if (frame->nb_samples > 0 && (frame->channel_layout || frame->channels > 0)) return getAudioBuffer(frame, align);
+
+    return AVERROR(EINVAL);
+}
+
+int FramePool::makeWritable(AVFrame *frame) {
+    if (frame->buf[0] && av_frame_is_writable(frame)) return 0;
+
+    AVFrame *tmp = av_frame_alloc();
+    if (!tmp) return AVERROR(ENOMEM);
+
+    tmp->format = frame->format;
+    tmp->width = frame->width;
+    tmp->height = frame->height;
+    tmp->channel_layout = frame->channel_layout;
+    tmp->channels = frame->channels;
+    tmp->sample_rate = frame->sample_rate;
+    tmp->nb_samples = frame->nb_samples;
+
+    int ret = getBuffer(tmp, 0);
+    if (ret < 0) {
+        av_frame_free(&tmp);
+        return ret;
+    }
+
+    ret = av_frame_copy_props(tmp, frame);
+    if (ret < 0) {
+        av_frame_free(&tmp);
+        return ret;
+    }
+
+    av_frame_unref(frame);
+    av_frame_move_ref(frame, tmp);
+    av_frame_free(&tmp);
+    return 0;
+}
+
+void FramePool::trim() {
+    std::unique_lock<std::mutex> lck(mMutex);
+    for (auto &it : mPools) {
+        // Entry is deleted by poolFree, possibly right inside uninit
+        AVBufferPool *pool = it.second->mPool;
+        av_buffer_pool_uninit(&pool);
+    }
+    mPools.clear();
+}
+
+int FramePool::getNbPools() {
+    std::unique_lock<std::mutex> lck(mMutex);
+    return (int) mPools.size();
+}
+
+FramePoolStats FramePool::getStats() {
+    FramePoolStats stats;
+    stats.mMisses = mMisses.load();
+    stats.mOverflows = mOverflows.load();
+    stats.mHits = mNbRequests.load() - stats.mMisses - stats.mOverflows;
+    stats.mBytesHeld = mBytesHeld.load();
+    stats.mNbReleasedPools = mNbReleasedPools.load();
+    return stats;
+}
@@ -0,0 +1,116 @@
+#ifndef FFMPEG_FRAME_POOL_H
+#define FFMPEG_FRAME_POOL_H
+
+extern "C" {
+#include "libavutil/frame.h"
+#include "libavutil/buffer.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/samplefmt.h"
+#include "libavutil/channel_layout.h"
+}
+#include "map"
+#include "tuple"
+#include "mutex"
+#include "atomic"
+
+/** Snapshot of frame pool counters. */
+struct FramePoolStats {
+    int64_t mHits = 0; // Buffers reused from a pool
+    int64_t mMisses = 0; // Buffers newly allocated into a pool
+    int64_t mOverflows = 0; // Buffers allocated outside of pools because high-water mark was reached
+    int64_t mBytesHeld = 0; // Bytes owned by pools, in use or idle
+    int64_t mNbReleasedPools = 0; // Pools released because their key was not requested anymore
+};
+
+/** Hands out reference counted frame buffers taken from AVBufferPools keyed by format, dimensions and alignment.
+ * A buffer goes back to its pool once every reference to it is released, so frames can be passed around
+ * by reference without allocating new picture/sample buffers every time. Thread-safe. */
+class FramePool {
+private:
+    // Media type, format, width or channels, height or number of samples, alignment
+    typedef std::tuple<int, int, int, int, int> PoolKey;
+
+    struct PoolEntry {
+        FramePool *mOwner = nullptr;
+        AVBufferPool *mPool = nullptr;
+        size_t mSize = 0; // Size in bytes of every buffer in the pool
+        int64_t mLastRequest = 0; // Number of requests made to frame pool when this pool was last asked for a buffer
+    };
+
+    // Default limit of bytes held by all pools of shared instance
+    static const int64_t DEFAULT_MAX_BYTES = 256LL * 1024 * 1024;
+    // Default buffer alignment, large enough for any SIMD code path
+    static const int DEFAULT_ALIGN = 64;
+    // Pools not asked for a buffer during this many requests are released, their key stopped being used,
+    // as when pictures are converted to another size after surface resized
+    static const int64_t IDLE_POOL_REQUESTS = 512;
+
+    std::mutex mMutex;
+    std::map<PoolKey, PoolEntry *> mPools;
+    // High-water mark of bytes held by pools, 0 for unlimited
+    std::atomic_int64_t mMaxBytes = {0};
+
+    std::atomic_int64_t mNbRequests = {0};
+    std::atomic_int64_t mMisses = {0};
+    std::atomic_int64_t mOverflows = {0};
+    std::atomic_int64_t mBytesHeld = {0};
+    std::atomic_int64_t mNbReleasedPools = {0};
+
+private:
+    /** Called by AVBufferPool when it has no free buffer left.
+     * Return nothing when high-water mark is reached so caller falls back to an unpooled buffer. */
+    static AVBufferRef *poolAlloc(void *opaque, size_t size);
+
+    /** Called by AVBufferPool when pool is uninitialized and every buffer returned. */
+    static void poolFree(void *opaque);
+
+    /** Called when a buffer allocated into a pool is freed, rather than returned to its pool. */
+    static void bufferFree(void *opaque, uint8_t *data);
+
+    /** Release pools whose key was not requested for a while, except pool of given key. Called under mMutex.
+     * @return number of pools released */
+    int releaseIdlePools(const PoolKey &keptKey);
+
+    /** Take a buffer of given size from pool with given key, creating the pool if needed. */
+    AVBufferRef *getBufferRef(const PoolKey &key, size_t size);
+
+    int getVideoBuffer(AVFrame *frame, int align);
+
+    int getAudioBuffer(AVFrame *frame, int align);
+
+public:
+    explicit FramePool(int64_t maxBytes);
+
+    /** Pools still holding buffers in use are released once those buffers are returned,
+     * the frame pool must outlive every pool it owns. */
+    ~FramePool();
+
+    /** Shared frame pool used by FFmpegHelper allocation functions. */
+    static FramePool *getInstance();
+
+    /** Set high-water mark of bytes held by pools, 0 for unlimited. */
+    void setMaxBytes(int64_t maxBytes);
+
+    /** Allocate pooled buffers for a frame, pooled equivalent of av_frame_get_buffer.
+     * Video frames must have format, width and height set.
+     * Audio frames must have format, channel layout and number of samples set.
+     * @param align buffer size alignment, 0 to use default alignment
+     * @return 0 if success, negative AVERROR if failed */
+    int getBuffer(AVFrame *frame, int align);
+
+    /** Make sure frame buffers are not shared with any other reference, replacing them with pooled buffers if needed.
+     * Unlike av_frame_make_writable, frame content is not preserved, only its properties.
+     * @return 0 if success, negative AVERROR if failed */
+    int makeWritable(AVFrame *frame);
+
+    /** Release every pool. Idle buffers are freed right away, buffers in use are freed when returned.
+     * Pools of keys no longer requested are released on their own, this frees everything at once. */
+    void trim();
+
+    /** Return number of pools, one for each key requested lately. */
+    int getNbPools();
+
+    FramePoolStats getStats();
+};
+
+#endif // FFMPEG_FRAME_POOL_H
@@ -0,0 +1,190 @@
+#include "GopCache.h"
+#include "FFmpegHelper.h"
+#include "../common/JNILogHelper.h"
+#include "algorithm"
+
+#define LOG_TAG "GopCache"
+
+GopCache::~GopCache() {
+    dropAll();
+    sws_freeContext(mSwsCtx);
+}
+
+void GopCache::configure(int64_t maxBytes, int lowres) {
+    std::unique_lock<std::mutex> lck(mMutex);
+    LOGD("GOP cache budget %lld bytes, lowres %d", (long long) maxBytes, lowres);
+    if (lowres != mLowres) {
+        dropAll();
+        mLowres = lowres;
+    }
+    mMaxBytes = maxBytes;
+    // Open GOP is kept as far as it got if it alone is over new budget
+    if (!evict(0)) mOpenGop = nullptr;
+}
+
+bool GopCache::isEnabled() {
+    std::unique_lock<std::mutex> lck(mMutex);
+    return mMaxBytes > 0;
+}
+
+int64_t GopCache::getFrameBytes(const AVFrame *frame) {
+    int64_t bytes = 0;
+    for (AVBufferRef *buf : frame->buf) {
+        if (buf) bytes += (int64_t) buf->size;
+    }
+    return bytes;
+}
+
+AVFrame *GopCache::makeCachedFrame(const AVFrame *frame) {
+    if (mLowres == 0) {
+        // Share decoder output, nothing is copied
+        AVFrame *ref = av_frame_clone(frame);
+        if (!ref) return nullptr;
+        ref->pts = frame->best_effort_timestamp;
+        return ref;
+    }
+
+    int width = AV_CEIL_RSHIFT(frame->width, mLowres), height = AV_CEIL_RSHIFT(frame->height, mLowres);
+    mSwsCtx = sws_getCachedContext(mSwsCtx, frame->width, frame->height, (AVPixelFormat) frame->format,
+                                   width, height, (AVPixelFormat) frame->format, SWS_FAST_BILINEAR,
+                                   nullptr, nullptr, nullptr);
+    if (!mSwsCtx) return nullptr;
+    AVFrame *scaled = FFmpegHelper::allocatePictureFrame(width, height, (AVPixelFormat) frame->format);
+    if (!scaled) return nullptr;
+    if (sws_scale_frame(mSwsCtx, scaled, frame) < 0) {
+        av_frame_free(&scaled);
+        return nullptr;
+    }
+    // Both dimensions shrink alike, pixel aspect ratio stays the same
+    av_frame_copy_props(scaled, frame);
+    scaled->pts = frame->best_effort_timestamp;
+    return scaled;
+}
+
+void GopCache::freeGop(CachedGop *gop) {
+    for (AVFrame *frame : gop->mFrames) av_frame_free(&frame);
+    mBytes -= gop->mBytes;
+    mNbFrames -= (int64_t) gop->mFrames.size();
+    delete gop;
+}
+
+bool GopCache::evict(int64_t bytes) {
+    auto it = mGops.end();
+    while (mBytes + bytes > mMaxBytes && it != mGops.begin()) {
+        --it;
+        if (*it == mOpenGop) continue;
+        freeGop(*it);
+        it = mGops.erase(it);
+        mNbEvictions++;
+    }
+    return mBytes + bytes <= mMaxBytes;
+}
+
+void GopCache::put(const AVFrame *frame) {
+    std::unique_lock<std::mutex> lck(mMutex);
+    if (mMaxBytes <= 0 || frame->best_effort_timestamp == AV_NOPTS_VALUE) return;
+    int64_t pts = frame->best_effort_timestamp;
+
+    if (frame->key_frame) {
+        // Same GOP decoded again, e.g. after seeking back into it, replaces the cached one
+        for (auto it = mGops.begin(); it != mGops.end(); ++it) {
+            if ((*it)->mStartPts != pts) continue;
+            freeGop(*it);
+            mGops.erase(it);
+            break;
+        }
+        mOpenGop = new CachedGop();
+        mOpenGop->mStartPts = pts;
+        mOpenGop->mEndPts = pts;
+        mGops.push_front(mOpenGop);
+    } else if (!mOpenGop || pts < mOpenGop->mEndPts || (frame->pkt_duration > 0 && pts > mOpenGop->mEndPts)) {
+        // Frames out of order or missing, GOP ends at the last frame known to follow on from its keyframe
+        mOpenGop = nullptr;
+        return;
+    }
+
+    AVFrame *cached = makeCachedFrame(frame);
+    if (!cached) {
+        mOpenGop = nullptr;
+        return;
+    }
+    int64_t bytes = getFrameBytes(cached);
+    if (!evict(bytes)) {
+        // A single GOP does not fit in budget, it is kept as far as it got
+        av_frame_free(&cached);
+        if (mOpenGop->mFrames.empty()) {
+            mGops.remove(mOpenGop);
+            delete mOpenGop;
+        }
+        mOpenGop = nullptr;
+        return;
+    }
+
+    mOpenGop->mFrames.push_back(cached);
+    mOpenGop->mEndPts = pts + std::max(frame->pkt_duration, (int64_t) 1);
+    mOpenGop->mBytes += bytes;
+    mBytes += bytes;
+    mNbFrames++;
+}
+
+void GopCache::endGop() {
+    std::unique_lock<std::mutex> lck(mMutex);
+    mOpenGop = nullptr;
+}
+
+const AVFrame *GopCache::find(int64_t pts) {
+    for (auto it = mGops.begin(); it != mGops.end(); ++it) {
+        CachedGop *gop = *it;
+        if (pts < gop->mStartPts || pts >= gop->mEndPts || gop->mFrames.empty()) continue;
+
+        mGops.splice(mGops.begin(), mGops, it);
+        // Latest frame starting at or before pts
+        auto frame = std::upper_bound(gop->mFrames.begin(), gop->mFrames.end(), pts,
+                                      [](int64_t pts, const AVFrame *frame) { return pts < frame->pts; });
+        return *(frame - 1);
+    }
+    return nullptr;
+}
+
+bool GopCache::get(int64_t pts, AVFrame *dst) {
+    std::unique_lock<std::mutex> lck(mMutex);
+    mNbLookups++;
+    const AVFrame *frame = find(pts);
+    if (!frame || av_frame_ref(dst, frame) < 0) return false;
+    mNbHits++;
+    return true;
+}
+
+bool GopCache::getPrevious(int64_t pts, AVFrame *dst) {
+    std::unique_lock<std::mutex> lck(mMutex);
+    mNbLookups++;
+    // Frame shown at pts starts at or before it, the one before ends right where it starts
+    const AVFrame *current = find(pts);
+    const AVFrame *frame = find((current ? current->pts : pts) - 1);
+    if (!frame || av_frame_ref(dst, frame) < 0) return false;
+    mNbHits++;
+    return true;
+}
+
+void GopCache::dropAll() {
+    for (CachedGop *gop : mGops) freeGop(gop);
+    mGops.clear();
+    mOpenGop = nullptr;
+}
+
+void GopCache::clear() {
+    std::unique_lock<std::mutex> lck(mMutex);
+    dropAll();
+}
+
+GopCacheStats GopCache::getStats() {
+    std::unique_lock<std::mutex> lck(mMutex);
+    GopCacheStats stats;
+    stats.mNbLookups = mNbLookups;
+    stats.mNbHits = mNbHits;
+    stats.mNbGops = (int64_t) mGops.size();
+    stats.mNbFrames = mNbFrames;
+    stats.mBytes = mBytes;
+    stats.mNbEvictions = mNbEvictions;
+    return stats;
+}
@@ -0,0 +1,105 @@
+#ifndef GOP_CACHE_H
+#define GOP_CACHE_H
+
+extern "C" {
+#include "libavutil/frame.h"
+#include "libswscale/swscale.h"
+}
+#include "list"
+#include "vector"
+#include "mutex"
+
+/** Snapshot of GOP cache counters. */
+struct GopCacheStats {
+    int64_t mNbLookups = 0; // Frames asked for
+    int64_t mNbHits = 0; // Frames served from cache
+    int64_t mNbGops = 0; // GOPs held
+    int64_t mNbFrames = 0; // Frames held
+    int64_t mBytes = 0; // Picture bytes held
+    int64_t mNbEvictions = 0; // GOPs dropped to stay within memory budget
+};
+
+/** LRU cache of decoded GOPs, so that stepping backward or scrubbing inside a recently decoded GOP needs no seek
+ * and no decoding. Frames are held by reference, either sharing decoder output or scaled down into pooled buffers.
+ * Decoded frames go in with put(), a keyframe starts a new GOP. A GOP covers from its keyframe to the end of its
+ * last frame, it stops growing at any gap, e.g. frames skipped by decoder degradation, so that a frame found
+ * inside a GOP is always the one that would be shown. Timestamps are in stream timebase. Thread-safe. */
+class GopCache {
+private:
+    struct CachedGop {
+        std::vector<AVFrame *> mFrames; // In presentation order
+        int64_t mStartPts = 0; // Keyframe timestamp
+        int64_t mEndPts = 0; // End of last frame
+        int64_t mBytes = 0;
+    };
+
+    std::mutex mMutex;
+    // Most recently used first
+    std::list<CachedGop *> mGops;
+    // GOP decoded frames are added to, null until next keyframe
+    CachedGop *mOpenGop = nullptr;
+
+    int64_t mMaxBytes = 0; // Memory budget, 0 disables cache
+    int mLowres = 0; // Frames are cached scaled down by 2^lowres
+    SwsContext *mSwsCtx = nullptr;
+
+    int64_t mBytes = 0;
+    int64_t mNbFrames = 0;
+    int64_t mNbLookups = 0;
+    int64_t mNbHits = 0;
+    int64_t mNbEvictions = 0;
+
+private:
+    /** Return a reference to frame as it is cached, scaled down if cache is at reduced resolution.
+     * @return frame or null if failed */
+    AVFrame *makeCachedFrame(const AVFrame *frame);
+
+    /** Return size in bytes of buffers held by frame. */
+    static int64_t getFrameBytes(const AVFrame *frame);
+
+    /** Drop least recently used GOPs, never the open one, until bytes fit in budget.
+     * @return false if budget cannot be met without dropping open GOP */
+    bool evict(int64_t bytes);
+
+    void freeGop(CachedGop *gop);
+
+    /** Free every GOP, caller holds mMutex. */
+    void dropAll();
+
+    /** Move GOP covering pts to front of LRU list and return frame shown at pts, null if not cached. */
+    const AVFrame *find(int64_t pts);
+
+public:
+    GopCache() = default;
+
+    ~GopCache();
+
+    /** Set memory budget and resolution of cached frames, 0 bytes disables cache.
+     * Frames cached at another resolution are dropped. */
+    void configure(int64_t maxBytes, int lowres);
+
+    bool isEnabled();
+
+    /** Add a decoded frame, its best effort timestamp is used as pts. */
+    void put(const AVFrame *frame);
+
+    /** Stop growing current GOP, frames added afterwards are ignored until next keyframe, e.g. after a seek. */
+    void endGop();
+
+    /** Reference cached frame shown at pts, the latest frame starting at or before it, into dst.
+     * @return false if pts is not inside a cached GOP */
+    bool get(int64_t pts, AVFrame *dst);
+
+    /** Reference cached frame right before the one shown at pts into dst, pts is taken as the start of a frame
+     * if it is not cached itself. Walking back from frame to frame plays
+     * cached GOPs in reverse, crossing into previous GOP when it was cached up to this one.
+     * @return false if previous frame is not cached */
+    bool getPrevious(int64_t pts, AVFrame *dst);
+
+    /** Drop every cached GOP. */
+    void clear();
+
+    GopCacheStats getStats();
+};
+
+#endif //GOP_CACHE_H
@@ -107,18 +107,24 @@ bool Muxer::initiate() {
 
     // Check if resampler is needed
     OutputStream *st = mAudioSt;
-    if (!(st->mSrcSampleRate == st->mDstSampleRate &&
-          st->mSrcChannelLayout == st->mDstChannelLayout &&
-          st->mSrcSampleFmt == st->mDstSampleFmt)) {
+    bool isSameLayout = mHasAudio && st->mSrcSampleRate == st->mDstSampleRate &&
+                        st->mSrcChannelLayout == st->mDstChannelLayout;
+    if (!mHasAudio) {
+        // Nothing to convert
+    } else if (isSameLayout && st->mSrcSampleFmt != st->mDstSampleFmt &&
+               SampleConverter::isSupported(st->mSrcSampleFmt, st->mDstSampleFmt)) {
+        st->mSampleConverter = SampleConverter::create(st->mSrcSampleFmt, st->mDstSampleFmt,
+                                                       av_get_channel_layout_nb_channels(st->mDstChannelLayout));
+    } else if (!(isSameLayout && st->mSrcSampleFmt == st->mDstSampleFmt)) {
         ret = createResampler();
         if (!ret) return false;
     }
 
     // Check if scaler is needed
     st = mVideoSt;
-    if (!(st->mSrcWidth == st->mDstWidth &&
-          st->mSrcHeight == st->mDstHeight &&
-          st->mSrcPixFmt == st->mDstPixFmt)) {
+    if (mHasVideo && !(st->mSrcWidth == st->mDstWidth &&
+                       st->mSrcHeight == st->mDstHeight &&
+                       st->mSrcPixFmt == st->mDstPixFmt)) {
         ret = createScaler();
         if (!ret) return false;
     }
@@ -279,15 +285,21 @@ int Muxer::openAudio(OutputStream *ost) {
         return 0;
     }
 
-    if (codecCtx->codec->capabilities & AV_CODEC_CAP_VARIABLE_FRAME_SIZE) ost->mDstNbSamples = 10000;
-    else ost->mDstNbSamples = codecCtx->frame_size;
+    // Fixed frame size encoders must be fed exactly frame_size samples per frame,
+    // other encoders accept any size so keep the requested number of samples per frame
+    if (!(codecCtx->codec->capabilities & AV_CODEC_CAP_VARIABLE_FRAME_SIZE) && codecCtx->frame_size > 0) {
+        ost->mDstNbSamples = codecCtx->frame_size;
+    } else if (ost->mDstNbSamples <= 0) {
+        ost->mDstNbSamples = 1024;
+    }
+    ost->mDstSampleFmt = codecCtx->sample_fmt;
 
     // Allocate and init a re-usable frame
     ost->mFrame = allocateAudioFrame();
     if (!ost->mFrame) return 0;
 
     // Create sample buffer
-    ost->mSampleBuffer = new SampleBuffer(codecCtx->channels, codecCtx->sample_fmt, codecCtx->frame_size);
+    ost->mSampleBuffer = new SampleBuffer(codecCtx->channels, codecCtx->sample_fmt, ost->mDstNbSamples);
 
     // Copy the stream parameters to the muxer
     ret = avcodec_parameters_from_context(ost->mStream->codecpar, codecCtx);
@@ -346,15 +358,12 @@ int Muxer::createResampler() {
     av_opt_set_sample_fmt(ost->mSwrCtx, "out_sample_fmt", ost->mDstSampleFmt, 0);
 
     // Initialize the resampling context
-    if ((ret = swr_init(ost->mSwrCtx)) < 0) {
+    if ((ret = FFmpegHelper::initResampler(ost->mSwrCtx, ost->mResamplerProfile)) < 0) {
         LOGE("Failed to initialize the resampling context: %s", av_err2str(ret));
         return 0;
     }
 
-    // Allocate tmp audio mFrame for source data
-    ost->mTmpFrame = FFmpegHelper::allocateAudioFrame(ost->mSrcSampleRate, ost->mSrcChannelLayout, ost->mSrcNbSamples, ost->mSrcSampleFmt);
-    if (!ost->mTmpFrame) return 0;
-
+    LOGV("Resampler created with %s profile", FFmpegHelper::getResamplerProfileName(ost->mResamplerProfile));
     mIsResamplerCreated = 1;
     return 1;
 }
@@ -429,56 +438,106 @@ int Muxer::writeFrame(OutputStream *ost) {
     return writeFrame(ost, ost->mFrame);
 }
 
-int Muxer::writeAudioFrame(uint8_t *buffer, int offset, int nbSamples, int64_t frameTimestamp) {
+int Muxer::writeAudioSamples(const uint8_t **data, int nbSamples, int64_t firstPts) {
     OutputStream *ost = mAudioSt;
     AVCodecContext *c = ost->mCodecCtx;
-
     int ret, dstNbSamples;
-    AVFrame *frame = ost->mTmpFrame;
-    if (!frame) {
-        LOGE("Frame is not allocated.");
-        return 0;
+
+    // Anchor output timestamps on the first incoming samples
+    if (ost->mFirstPts == AV_NOPTS_VALUE) ost->mFirstPts = (firstPts == AV_NOPTS_VALUE) ? 0 : firstPts;
+
+    // Convert to destination format straight into the sample buffer
+    if (ost->mSwrCtx) {
+        dstNbSamples = (int) av_rescale_rnd(swr_get_delay(ost->mSwrCtx, ost->mSrcSampleRate) + nbSamples,
+                                            c->sample_rate, ost->mSrcSampleRate, AV_ROUND_UP);
+        uint8_t **buf = ost->mSampleBuffer->prepareBuffer(dstNbSamples);
+        ret = swr_convert(ost->mSwrCtx, buf, dstNbSamples, data, nbSamples);
+        if (ret < 0) {
+            LOGE("Error while converting: %s", av_err2str(ret));
+            return 0;
+        }
+    } else if (ost->mSampleConverter) {
+        uint8_t **buf = ost->mSampleBuffer->prepareBuffer(nbSamples);
+        ost->mSampleConverter->convert(data, buf, nbSamples);
+        ret = nbSamples;
+    } else {
+        uint8_t **buf = ost->mSampleBuffer->prepareBuffer(nbSamples);
+        av_samples_copy(buf, (uint8_t *const *) data, 0, 0, nbSamples, c->channels, c->sample_fmt);
+        ret = nbSamples;
     }
+    ost->mSampleBuffer->commit_data(ret);
+
+    // Write every full encoder frame into format context
+    while (ost->mSampleBuffer->available()) {
+        if (!encodeBufferedSamples(false)) return 0;
+    }
+
+    return 1;
+}
 
-    av_samples_copy(frame->data, &buffer, 0, offset, nbSamples,
-                    av_get_channel_layout_nb_channels(ost->mSrcChannelLayout), ost->mSrcSampleFmt);
-    dstNbSamples = (int) av_rescale_rnd(swr_get_delay(ost->mSwrCtx, c->sample_rate) + frame->nb_samples,
-                                        c->sample_rate, frame->sample_rate, AV_ROUND_UP);
+int Muxer::encodeBufferedSamples(bool partial) {
+    OutputStream *ost = mAudioSt;
+    AVCodecContext *c = ost->mCodecCtx;
+    AVFrame *frame = ost->mFrame;
 
-    /* When we pass a mFrame to the encoder, it may keep a reference to it internally;
+    /* When we pass a frame to the encoder, it may keep a reference to it internally;
      * make sure we do not overwrite it here */
-    ret = av_frame_make_writable(ost->mFrame);
-    if (ret < 0) {
-        LOGE("Cannot make frame writable: %s", av_err2str(ret));
-        return 0;
+    frame->nb_samples = ost->mDstNbSamples;
+    if (!FFmpegHelper::makeFrameWritable(frame)) return 0;
+
+    if (partial) {
+        frame->nb_samples = ost->mSampleBuffer->getRemaining(frame->data, 0);
+        if (frame->nb_samples == 0) return 0;
+    } else {
+        if (!ost->mSampleBuffer->getChunk(frame->data, 0)) return 0;
+        frame->nb_samples = ost->mSampleBuffer->mChunkSize;
     }
 
-    // Convert to destination format
-    uint8_t **buf = ost->mSampleBuffer->prepareBuffer(dstNbSamples);
-    ret = swr_convert(ost->mSwrCtx, buf, dstNbSamples, (const uint8_t **) frame->data, frame->nb_samples);
-    if (ret < 0) {
-        LOGE("Error while converting: %s", av_err2str(ret));
-        return ret;
+    // Sample accurate pts: first pts plus duration of every sample encoded so far
+    frame->pts = ost->mFirstPts + av_rescale_q(ost->mNbEncodedSamples, (AVRational) {1, c->sample_rate}, c->time_base);
+    ost->mNbEncodedSamples += frame->nb_samples;
+
+    return writeFrame(ost);
+}
+
+int Muxer::flushAudio() {
+    OutputStream *ost = mAudioSt;
+    if (!ost || !ost->mSampleBuffer || ost->mFirstPts == AV_NOPTS_VALUE) return 1;
+    AVCodecContext *c = ost->mCodecCtx;
+
+    // Drain samples delayed inside resampler
+    if (ost->mSwrCtx) {
+        int dstNbSamples = (int) av_rescale_rnd(swr_get_delay(ost->mSwrCtx, ost->mSrcSampleRate),
+                                                c->sample_rate, ost->mSrcSampleRate, AV_ROUND_UP);
+        if (dstNbSamples > 0) {
+            uint8_t **buf = ost->mSampleBuffer->prepareBuffer(dstNbSamples);
+            int ret = swr_convert(ost->mSwrCtx, buf, dstNbSamples, nullptr, 0);
+            if (ret > 0) ost->mSampleBuffer->commit_data(ret);
+        }
     }
-    ost->mSampleBuffer->commit_data(ret);
-    frame = ost->mFrame;
 
-    // Write converted samples into format context
-    int64_t advancedTime = 0;
     while (ost->mSampleBuffer->available()) {
-        ost->mSampleBuffer->getChunk(frame->data, 0);
-
-        if (ost->mStartTimestamp == 0) {
-            frame->pts = 0;
-            ost->mStartTimestamp = frameTimestamp;
-        } else frame->pts = frameTimestamp - ost->mStartTimestamp + advancedTime;
-        advancedTime += av_rescale_q(c->frame_size, (AVRational) {1, c->sample_rate}, c->time_base);
+        if (!encodeBufferedSamples(false)) return 0;
+    }
 
-        ret = writeFrame(ost);
-        if (ret != 0) break;
+    // Only the last frame may be smaller than encoder frame size
+    if (ost->mSampleBuffer->mCurrSampleCount > 0 &&
+        c->codec->capabilities & (AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_VARIABLE_FRAME_SIZE)) {
+        return encodeBufferedSamples(true);
     }
 
-    return ret;
+    return 1;
+}
+
+int Muxer::writeAudioFrame(uint8_t *buffer, int offset, int nbSamples, int64_t /*frameTimestamp*/) {
+    OutputStream *ost = mAudioSt;
+
+    // Input buffer holds packed samples, point right at the requested offset
+    int nbChannels = av_get_channel_layout_nb_channels(ost->mSrcChannelLayout);
+    const uint8_t *srcData = buffer + offset * av_get_bytes_per_sample(ost->mSrcSampleFmt) * nbChannels;
+
+    // Starts at 0 as video frames written by writeVideoFrame do, following pts come from samples encoded
+    return writeAudioSamples(&srcData, nbSamples, 0);
 }
 
 int Muxer::writeVideoFrame(uint8_t *srcData, int64_t frameTimestamp) {
@@ -487,6 +546,8 @@ int Muxer::writeVideoFrame(uint8_t *srcData, int64_t frameTimestamp) {
     int ret;
 
     if (mVideoSt->mSwsCtx) {
+        // Encoder may still reference previous frame
+        if (!FFmpegHelper::makeFrameWritable(ost->mFrame)) return 0;
         av_image_fill_linesizes(frame->linesize, ost->mSrcPixFmt, ost->mSrcWidth);
         av_image_fill_pointers(frame->data, ost->mSrcPixFmt, ost->mSrcHeight, srcData, frame->linesize);
 
@@ -513,6 +574,8 @@ int Muxer::writeVideoFrame(uint8_t *srcData, int64_t frameTimestamp) {
 int Muxer::onVideoFrame(AVFrame *frame) {
     AVFrame *tmpFrame = frame;
     if (mVideoSt->mSwsCtx) {
+        // Encoder may still reference previous frame
+        if (!FFmpegHelper::makeFrameWritable(mVideoSt->mFrame)) return 0;
         sws_scale_frame(mVideoSt->mSwsCtx, mVideoSt->mFrame, frame);
         tmpFrame = mVideoSt->mFrame;
         tmpFrame->pts = frame->pts;
@@ -522,14 +585,7 @@ int Muxer::onVideoFrame(AVFrame *frame) {
 }
 
 int Muxer::onAudioFrame(AVFrame *frame) {
-    AVFrame *tmpFrame = frame;
-    if (mAudioSt->mSwrCtx) {
-        swr_convert_frame(mAudioSt->mSwrCtx, mAudioSt->mFrame, frame);
-        tmpFrame = mAudioSt->mFrame;
-        tmpFrame->pts = frame->pts;
-    }
-
-    return writeFrame(mAudioSt, tmpFrame);
+    return writeAudioSamples((const uint8_t **) frame->extended_data, frame->nb_samples, frame->pts);
 }
 
 int Muxer::flushCodec(OutputStream *ost) {
@@ -567,9 +623,10 @@ int Muxer::start() {
 void Muxer::stop() {
     LOGV("Stopping muxer...");
 
-    // Flush any packets left in encoder
-    flushCodec(mAudioSt);
-    flushCodec(mVideoSt);
+    // Encode any samples left in resampler and sample buffer, then flush any packets left in encoder
+    flushAudio();
+    if (mHasAudio) flushCodec(mAudioSt);
+    if (mHasVideo) flushCodec(mVideoSt);
 
     /* Write the trailer, if any. The trailer must be written before you
      * close the CodecContexts open when you wrote the header; otherwise
@@ -592,6 +649,8 @@ void Muxer::closeStream(OutputStream *ost) {
         if (ost->mTmpFrame) av_frame_free(&ost->mTmpFrame);
         if (ost->mPacket) av_packet_free(&ost->mPacket);
         if (ost->mSwrCtx) swr_free(&ost->mSwrCtx);
+        delete ost->mSampleConverter;
+        ost->mSampleConverter = nullptr;
         if (ost->mSwsCtx) sws_freeContext(ost->mSwsCtx);
         if (ost->mSampleBuffer) ost->mSampleBuffer->freeBuffer();
     }
@@ -12,10 +12,10 @@ extern "C" {
 #include "libswscale/swscale.h"
 }
 #include <cstdint>
-#include "jni.h"
 #include "Sink.h"
 #include "SampleBuffer.h"
 #include "FFmpegHelper.h"
+#include "SampleConverter.h"
 
 class OutputStream {
 public:
@@ -38,10 +38,16 @@ public:
 
     // Audio only attributes {
     SwrContext *mSwrCtx;
+    // Replaces resampler when only sample format or planarity differs
+    SampleConverter *mSampleConverter = nullptr;
     SampleBuffer *mSampleBuffer;
     uint64_t mSrcChannelLayout, mDstChannelLayout;
     int mSrcSampleRate, mSrcNbSamples, mDstSampleRate, mDstNbSamples;
     AVSampleFormat mSrcSampleFmt = AV_SAMPLE_FMT_NONE, mDstSampleFmt = AV_SAMPLE_FMT_NONE;
+    ResamplerProfile mResamplerProfile = ResamplerProfile::DEFAULT;
+    // Pts of first encoded sample in codec time base, output pts are derived from number of encoded samples
+    int64_t mFirstPts = AV_NOPTS_VALUE;
+    int64_t mNbEncodedSamples = 0;
     // } Audio only attributes
 };
 
@@ -105,6 +111,20 @@ private:
      * @return 1 if mFrame written, 0 if failed */
     int writeFrame(OutputStream *ost);
 
+    /** Resample given samples into the sample buffer and encode every full encoder frame available.
+     * Shared audio stage of writeAudioFrame and onAudioFrame.
+     * @param firstPts pts in codec time base of the first sample, only used if nothing was encoded yet
+     * @return 1 if all available frames were written, 0 if failed */
+    int writeAudioSamples(const uint8_t **data, int nbSamples, int64_t firstPts);
+
+    /** Take one frame of samples out of the sample buffer and encode it.
+     * @param partial allow encoding a frame smaller than encoder frame size, used at end of stream
+     * @return 1 if frame written, 0 if failed or no samples available */
+    int encodeBufferedSamples(bool partial);
+
+    /** Drain samples left inside resampler and sample buffer into the encoder. */
+    int flushAudio();
+
     /** Flush leftover packets from a codec inside an OutputStream. */
     int flushCodec(OutputStream *ost);
 
@@ -144,7 +164,8 @@ public:
     int writeVideoFrame(uint8_t *srcData, int64_t frameTimestamp);
 
     /** Given audio frame data from input, convert it using resampler, put it inside sample buffer
-     * and write to muxer if a full frame after conversion if available. */
+     * and write to muxer if a full frame after conversion if available.
+     * Output pts start at 0 and follow number of samples written, frameTimestamp is not used. */
     int writeAudioFrame(uint8_t *buffer, int offset, int nbSamples, int64_t frameTimestamp);
 
     /** Callback, will be called if an input video frame is available. */
@@ -89,6 +89,11 @@ MuxerBuilder *MuxerBuilder::setSampleFmt(AVSampleFormat sampleFmt) {
     return this;
 }
 
+MuxerBuilder *MuxerBuilder::setResamplerProfile(ResamplerProfile profile) {
+    mResamplerProfile = profile;
+    return this;
+}
+
 MuxerBuilder *MuxerBuilder::setVideoTimeBase(AVRational timebase) {
     mVideoTimebase = timebase;
     return this;
@@ -132,14 +137,14 @@ Muxer *MuxerBuilder::buildMuxer() {
     }
 
     // Validate audio parameters
-    if (mSrcSampleRate <= 0 || mSrcChannelLayout == 0 || mSrcNbChannels == 0 ||
-        mSrcNbSamples == 0 || mSrcSampleFmt == AV_SAMPLE_FMT_NONE) {
+    if (mHasAudio && (mSrcSampleRate <= 0 || mSrcChannelLayout == 0 || mSrcNbChannels == 0 ||
+                      mSrcNbSamples == 0 || mSrcSampleFmt == AV_SAMPLE_FMT_NONE)) {
         LOGE("Failed to create muxer. Missing or invalid audio params.");
         return nullptr;
     }
 
     // Validate all parameters
-    if (mSrcWidth <= 0 || mSrcHeight <= 0 || mSrcPixFmt == AV_PIX_FMT_NONE) {
+    if (mHasVideo && (mSrcWidth <= 0 || mSrcHeight <= 0 || mSrcPixFmt == AV_PIX_FMT_NONE)) {
         LOGE("Failed to create muxer. Missing or invalid video params.");
         return nullptr;
     }
@@ -168,6 +173,7 @@ Muxer *MuxerBuilder::buildMuxer() {
         audioSt->mDstChannelLayout = (mDstChannelLayout == 0) ? mSrcChannelLayout : mDstChannelLayout;
         audioSt->mDstSampleFmt = mDstSampleFmt;
         audioSt->mDstNbSamples = (mDstNbSamples <= 0) ? mSrcNbSamples : mDstNbSamples;
+        audioSt->mResamplerProfile = mResamplerProfile;
     }
 
     // Initiate video stream
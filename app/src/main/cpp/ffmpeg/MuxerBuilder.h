@@ -34,6 +34,7 @@ private:
     int mDstNbChannels = 0;
     int mDstNbSamples = 0;
     AVSampleFormat mDstSampleFmt = AV_SAMPLE_FMT_FLTP;
+    ResamplerProfile mResamplerProfile = ResamplerProfile::DEFAULT;
     // } Audio output attributes
 
     AVRational mVideoTimebase = av_make_q(0, 1);
@@ -90,6 +91,9 @@ public:
     /** Set output sample format.
      * If this value is not set, use default value instead. */
     MuxerBuilder *setSampleFmt(AVSampleFormat sampleFmt);
+    /** Set how much resampling may cost for its quality.
+     * If this value is not set, default profile is used. */
+    MuxerBuilder *setResamplerProfile(ResamplerProfile profile);
 
     /** Set video time base */
     MuxerBuilder *setVideoTimeBase(AVRational timebase);
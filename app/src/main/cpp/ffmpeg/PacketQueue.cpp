@@ -0,0 +1,221 @@
+#include "PacketQueue.h"
+#include "../common/JNILogHelper.h"
+
+#define LOG_TAG "PacketQueue"
+
+PacketPool::PacketPool() {
+    mFreePackets.reserve(1024);
+}
+
+PacketPool::~PacketPool() {
+    for (AVPacket *pkt : mFreePackets) av_packet_free(&pkt);
+    mFreePackets.clear();
+
+    for (std::vector<AVBufferRef *> &payloads : mFreePayloads) {
+        for (AVBufferRef *buf : payloads) av_buffer_unref(&buf);
+        payloads.clear();
+    }
+    // Pools are freed once every payload still referenced elsewhere is released
+    for (AVBufferPool *&pool : mPayloadPools) {
+        if (pool) av_buffer_pool_uninit(&pool);
+    }
+}
+
+int PacketPool::getSizeClass(size_t size) {
+    for (int i = 0; i < NB_SIZE_CLASSES; i++) {
+        if (size <= ((size_t) 1 << (MIN_SIZE_CLASS_BITS + i))) return i;
+    }
+    return -1;
+}
+
+int PacketPool::getPayloadSizeClass(const AVBufferRef *buf) {
+    // Pooled payloads are exactly as big as their class, oversized ones are bigger than any class
+    int sizeClass = getSizeClass(buf->size);
+    return sizeClass >= 0 && buf->size == ((size_t) 1 << (MIN_SIZE_CLASS_BITS + sizeClass)) ? sizeClass : -1;
+}
+
+AVBufferRef *PacketPool::getPayload(size_t size) {
+    int sizeClass = getSizeClass(size);
+    if (sizeClass < 0) {
+        // Too big for any size class, allocate directly
+        mNbPayloadAllocs++;
+        return av_buffer_alloc(size);
+    }
+
+    std::unique_lock<std::mutex> lck(mMutex);
+    std::vector<AVBufferRef *> &payloads = mFreePayloads[sizeClass];
+    if (!payloads.empty()) {
+        AVBufferRef *buf = payloads.back();
+        payloads.pop_back();
+        return buf;
+    }
+    AVBufferPool *&pool = mPayloadPools[sizeClass];
+    if (!pool) {
+        pool = av_buffer_pool_init((size_t) 1 << (MIN_SIZE_CLASS_BITS + sizeClass), nullptr);
+        if (!pool) return nullptr;
+    }
+    // Reference is allocated, memory comes back from pool once every reference to it is gone
+    mNbPayloadAllocs++;
+    return av_buffer_pool_get(pool);
+}
+
+void PacketPool::recyclePayload(AVBufferRef **buf) {
+    int sizeClass = getPayloadSizeClass(*buf);
+    if (sizeClass < 0 || !av_buffer_is_writable(*buf)) {
+        av_buffer_unref(buf);
+        return;
+    }
+    std::unique_lock<std::mutex> lck(mMutex);
+    mFreePayloads[sizeClass].push_back(*buf);
+    *buf = nullptr;
+}
+
+AVPacket *PacketPool::acquire() {
+    {
+        std::unique_lock<std::mutex> lck(mMutex);
+        if (!mFreePackets.empty()) {
+            AVPacket *pkt = mFreePackets.back();
+            mFreePackets.pop_back();
+            return pkt;
+        }
+    }
+
+    mNbPacketAllocs++;
+    return av_packet_alloc();
+}
+
+void PacketPool::release(AVPacket *pkt) {
+    if (!pkt) return;
+    // Payload stays with packet unless a decoder still holds a reference to it, or it is oversized
+    AVBufferRef *buf = pkt->buf;
+    pkt->buf = nullptr;
+    av_packet_unref(pkt);
+    if (buf && (getPayloadSizeClass(buf) < 0 || !av_buffer_is_writable(buf))) av_buffer_unref(&buf);
+    pkt->buf = buf;
+
+    std::unique_lock<std::mutex> lck(mMutex);
+    mFreePackets.push_back(pkt);
+}
+
+int PacketPool::copyPacket(AVPacket *dst, const AVPacket *src) {
+    mNbRequests++;
+
+    // Keep payload packet holds if it is of the size class needed, otherwise swap it for one that is
+    size_t size = (size_t) src->size + AV_INPUT_BUFFER_PADDING_SIZE;
+    AVBufferRef *buf = dst->buf;
+    dst->buf = nullptr;
+    if (buf && getPayloadSizeClass(buf) != getSizeClass(size)) recyclePayload(&buf);
+    if (!buf) buf = getPayload(size);
+    if (!buf) return AVERROR(ENOMEM);
+
+    int ret = av_packet_copy_props(dst, src);
+    if (ret < 0) {
+        recyclePayload(&buf);
+        return ret;
+    }
+
+    if (src->size > 0) memcpy(buf->data, src->data, src->size);
+    memset(buf->data + src->size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+
+    dst->buf = buf;
+    dst->data = buf->data;
+    dst->size = src->size;
+    return 0;
+}
+
+PacketPoolStats PacketPool::getStats() {
+    PacketPoolStats stats;
+    stats.mNbRequests = mNbRequests.load();
+    stats.mNbPacketAllocs = mNbPacketAllocs.load();
+    stats.mNbPayloadAllocs = mNbPayloadAllocs.load();
+    return stats;
+}
+
+PacketQueue::PacketQueue(PacketPool *pool, std::condition_variable *lowCond) : mPool(pool), mLowCond(lowCond) {
+    mPackets.resize(64);
+}
+
+PacketQueue::~PacketQueue() {
+    flush();
+}
+
+void PacketQueue::grow() {
+    std::vector<QueuedPacket> packets(mPackets.size() * 2);
+    for (int i = 0; i < mCount; i++) {
+        packets[i] = mPackets[(mHead + i) % mPackets.size()];
+    }
+    mPackets.swap(packets);
+    mHead = 0;
+}
+
+void PacketQueue::put(AVPacket *pkt) {
+    std::unique_lock<std::mutex> lck(mMutex);
+    if (mIsAborted) {
+        lck.unlock();
+        mPool->release(pkt);
+        return;
+    }
+
+    if (mCount == (int) mPackets.size()) grow();
+
+    QueuedPacket &entry = mPackets[(mHead + mCount) % mPackets.size()];
+    entry.mPacket = pkt;
+    entry.mSerial = mSerial;
+    mCount++;
+    if (pkt) mBytes += pkt->size;
+
+    mCond.notify_one();
+}
+
+int PacketQueue::get(AVPacket **pkt, int *serial) {
+    std::unique_lock<std::mutex> lck(mMutex);
+    mCond.wait(lck, [this] { return mIsAborted || mCount > 0; });
+    if (mIsAborted) return 0;
+
+    QueuedPacket &entry = mPackets[mHead];
+    *pkt = entry.mPacket;
+    *serial = entry.mSerial;
+    entry.mPacket = nullptr;
+
+    mHead = (mHead + 1) % (int) mPackets.size();
+    mCount--;
+    if (*pkt) mBytes -= (*pkt)->size;
+    // Producer taking a break may fill queue up again
+    if (mLowCond && mCount <= MIN_PACKETS) mLowCond->notify_one();
+    return 1;
+}
+
+void PacketQueue::flush() {
+    std::unique_lock<std::mutex> lck(mMutex);
+    while (mCount > 0) {
+        QueuedPacket &entry = mPackets[mHead];
+        mPool->release(entry.mPacket);
+        entry.mPacket = nullptr;
+        mHead = (mHead + 1) % (int) mPackets.size();
+        mCount--;
+    }
+    mHead = 0;
+    mBytes = 0;
+    mSerial++;
+}
+
+void PacketQueue::abort() {
+    std::unique_lock<std::mutex> lck(mMutex);
+    mIsAborted = true;
+    mCond.notify_all();
+}
+
+bool PacketQueue::hasEnoughPackets() {
+    std::unique_lock<std::mutex> lck(mMutex);
+    return mIsAborted || mCount > MIN_PACKETS;
+}
+
+int64_t PacketQueue::getBytes() {
+    std::unique_lock<std::mutex> lck(mMutex);
+    return mBytes;
+}
+
+int PacketQueue::getSerial() {
+    std::unique_lock<std::mutex> lck(mMutex);
+    return mSerial;
+}
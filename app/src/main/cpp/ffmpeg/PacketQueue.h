@@ -0,0 +1,141 @@
+#ifndef PACKET_QUEUE_H
+#define PACKET_QUEUE_H
+
+extern "C" {
+#include "libavcodec/avcodec.h"
+#include "libavutil/buffer.h"
+}
+#include "vector"
+#include "mutex"
+#include "atomic"
+#include "condition_variable"
+
+/** Snapshot of packet pool counters. */
+struct PacketPoolStats {
+    int64_t mNbRequests = 0; // Number of packets copied into pooled payloads
+    int64_t mNbPacketAllocs = 0; // Number of packet structs allocated
+    int64_t mNbPayloadAllocs = 0; // Number of payload references taken from pools or allocated when oversized
+};
+
+/** Recycles AVPacket structs through a free list along with their payload, so that queueing packets does not
+ * allocate in steady state. A released packet keeps its payload buffer unless something else still references it,
+ * a copy reuses it when it falls in the same size class, otherwise swaps it for one from a free list of that class.
+ * Payload memory comes from size-class AVBufferPools, so that payloads dropped while referenced elsewhere come back
+ * to the pool once released. Thread-safe. */
+class PacketPool {
+private:
+    // Payload size classes are powers of two from 1 KiB up to 4 MiB, bigger payloads are allocated directly
+    static const int MIN_SIZE_CLASS_BITS = 10;
+    static const int NB_SIZE_CLASSES = 13;
+
+    std::mutex mMutex;
+    std::vector<AVPacket *> mFreePackets;
+    // Payload references no packet holds, by size class
+    std::vector<AVBufferRef *> mFreePayloads[NB_SIZE_CLASSES];
+    AVBufferPool *mPayloadPools[NB_SIZE_CLASSES] = {};
+
+    std::atomic_int64_t mNbRequests = {0};
+    std::atomic_int64_t mNbPacketAllocs = {0};
+    std::atomic_int64_t mNbPayloadAllocs = {0};
+
+private:
+    /** Return index of smallest size class that fits given size, -1 if no class is big enough. */
+    static int getSizeClass(size_t size);
+
+    /** Return size class payload was taken from, -1 if it was allocated directly. */
+    static int getPayloadSizeClass(const AVBufferRef *buf);
+
+    /** Take a payload buffer of at least given size. */
+    AVBufferRef *getPayload(size_t size);
+
+    /** Put a payload buffer nothing else references into the free list of its class, unreference it otherwise. */
+    void recyclePayload(AVBufferRef **buf);
+
+public:
+    PacketPool();
+
+    /** Free every recycled packet and release payload pools.
+     * Payloads still referenced elsewhere are freed once released. */
+    ~PacketPool();
+
+    /** Take an empty packet from the free list, allocate a new one if free list is empty.
+     * Packet may hold a payload buffer without data, kept for copyPacket.
+     * @return packet or null if allocation failed */
+    AVPacket *acquire();
+
+    /** Unreference packet and put it back into the free list, keeping its payload buffer if nothing else references
+     * it. */
+    void release(AVPacket *pkt);
+
+    /** Copy src packet data and properties into dst, a packet taken with acquire, with payload taken from size-class
+     * pools.
+     * @return 0 if success, negative AVERROR if failed */
+    int copyPacket(AVPacket *dst, const AVPacket *src);
+
+    PacketPoolStats getStats();
+};
+
+/** A packet with the serial of the queue at the time it was put in. */
+struct QueuedPacket {
+    AVPacket *mPacket = nullptr;
+    int mSerial = 0;
+};
+
+/** A blocking FIFO of pooled packets between demuxing thread and a decoding thread.
+ * Packets are stored in a growable ring so put and get do not allocate in steady state. */
+class PacketQueue {
+private:
+    // Minimum number of packets queued for the stream to be considered having enough data
+    static const int MIN_PACKETS = 25;
+
+    PacketPool *mPool;
+    // Signaled when queue no longer holds enough packets, producer may wait on it
+    std::condition_variable *mLowCond;
+
+    std::mutex mMutex;
+    std::condition_variable mCond;
+
+    std::vector<QueuedPacket> mPackets;
+    int mHead = 0;
+    int mCount = 0;
+    int64_t mBytes = 0;
+    // Increased on every flush so consumer knows when to flush its decoder
+    int mSerial = 0;
+    bool mIsAborted = false;
+
+private:
+    /** Double ring capacity, keeping queued packets in order. */
+    void grow();
+
+public:
+    /** @param lowCond signaled when a packet taken leaves queue without enough packets, may be null */
+    explicit PacketQueue(PacketPool *pool, std::condition_variable *lowCond = nullptr);
+
+    ~PacketQueue();
+
+    /** Put a packet at the end of the queue, queue takes ownership of it.
+     * A null packet marks end of stream. Packet is released right away if queue is aborted. */
+    void put(AVPacket *pkt);
+
+    /** Take a packet out of the queue, blocking while queue is empty.
+     * Caller owns returned packet and must release it into packet pool.
+     * @return 1 if a packet (or end of stream marker) was taken, 0 if queue was aborted */
+    int get(AVPacket **pkt, int *serial);
+
+    /** Release every queued packet and start a new serial. */
+    void flush();
+
+    /** Wake up every waiting consumer, queue will not accept or hand out packets anymore. */
+    void abort();
+
+    /** Check if queue holds enough packets for demuxing to take a break. */
+    bool hasEnoughPackets();
+
+    /** Return number of payload bytes queued. */
+    int64_t getBytes();
+
+    /** Return serial packets put now get, frames decoded from packets of an older serial are stale. */
+    int getSerial();
+};
+
+#endif //PACKET_QUEUE_H
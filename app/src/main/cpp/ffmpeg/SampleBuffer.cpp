@@ -1,5 +1,4 @@
 #include "../common/JNILogHelper.h"
-#include <android/log.h>
 #include "SampleBuffer.h"
 #define LOG_TAG "SampleBuffer"
 
@@ -8,12 +7,13 @@ SampleBuffer::SampleBuffer(int channels, AVSampleFormat sampleFmt, int chunkSize
     mSampleFmt = sampleFmt;
     mChunkSize = chunkSize;
 
+    while (mMaxNbSamples < mChunkSize * 2) mMaxNbSamples *= 2;
     av_samples_alloc_array_and_samples(&mBuffer, nullptr, mNbChannels, mMaxNbSamples, mSampleFmt, 0);
-    av_samples_alloc_array_and_samples(&mTmpBuffer, nullptr, mNbChannels, mMaxNbSamples, mSampleFmt, 0);
+    mTmpBuffer = (uint8_t **) av_calloc(mNbChannels, sizeof(uint8_t *));
 }
 
 SampleBuffer::~SampleBuffer() {
-
+    freeBuffer();
 }
 
 void SampleBuffer::expandBuffer() {
@@ -23,20 +23,32 @@ void SampleBuffer::expandBuffer() {
 void SampleBuffer::expandBuffer(int requiredSize) {
     LOGV("Not enough buffer, expanding");
     while (mMaxNbSamples < requiredSize) mMaxNbSamples *= 2;
-    freeBuffer();
 
-    av_samples_alloc_array_and_samples(&mBuffer, nullptr, mNbChannels, mMaxNbSamples, mSampleFmt, 0);
-    av_samples_alloc_array_and_samples(&mTmpBuffer, nullptr, mNbChannels, mMaxNbSamples, mSampleFmt, 0);
+    // Move leftover data into the new buffer before releasing the old one
+    uint8_t **newBuffer;
+    av_samples_alloc_array_and_samples(&newBuffer, nullptr, mNbChannels, mMaxNbSamples, mSampleFmt, 0);
+    if (mCurrSampleCount > 0) {
+        av_samples_copy(newBuffer, mBuffer, 0, mCurrPos, mCurrSampleCount, mNbChannels, mSampleFmt);
+    }
+    av_freep(&mBuffer[0]);
+    av_freep(&mBuffer);
+    mBuffer = newBuffer;
+    mCurrPos = 0;
 }
 
 void SampleBuffer::freeBuffer() {
     LOGV("Freeing buffer...");
-    if (mBuffer) av_freep(&mBuffer[0]);
-    if (mTmpBuffer) av_freep(&mTmpBuffer[0]);
+    if (mBuffer) {
+        av_freep(&mBuffer[0]);
+        av_freep(&mBuffer);
+    }
+    if (mTmpBuffer) av_freep(&mTmpBuffer);
+    mCurrSampleCount = 0;
+    mCurrPos = 0;
 }
 
 int SampleBuffer::available() {
-    return mCurrSampleCount >= mChunkSize;
+    return mChunkSize > 0 && mCurrSampleCount >= mChunkSize;
 }
 
 int SampleBuffer::getChunk(uint8_t **dst, int dstOffset) {
@@ -49,35 +61,44 @@ int SampleBuffer::getChunk(uint8_t **dst, int dstOffset) {
     return 0;
 }
 
-uint8_t **SampleBuffer::prepareBuffer(int nbSamples){
-    // Copy leftover data into a temp buffer
-    uint8_t **tmpBuf;
-    if (mCurrSampleCount > 0) {
-        av_samples_alloc_array_and_samples(&tmpBuf, nullptr, mNbChannels, mCurrSampleCount, mSampleFmt, 0);
-        av_samples_copy(tmpBuf, mBuffer, 0, mCurrPos, mCurrSampleCount, mNbChannels, mSampleFmt);
-    }
+int SampleBuffer::getRemaining(uint8_t **dst, int dstOffset) {
+    int nbSamples = FFMIN(mCurrSampleCount, mChunkSize);
+    if (nbSamples <= 0) return 0;
+    av_samples_copy(dst, mBuffer, dstOffset, mCurrPos, nbSamples, mNbChannels, mSampleFmt);
+    mCurrPos += nbSamples;
+    mCurrSampleCount -= nbSamples;
+    return nbSamples;
+}
 
+uint8_t **SampleBuffer::prepareBuffer(int nbSamples){
     // Expand the buffer if current size is not enough to hold additional data
     if (mCurrSampleCount + nbSamples > mMaxNbSamples) {
         expandBuffer(mCurrSampleCount + nbSamples);
     }
 
-    // Copy leftover data back into the buffer and free it
-    if (mCurrSampleCount > 0) {
-        av_samples_copy(mBuffer, tmpBuf, 0, 0, mCurrSampleCount, mNbChannels, mSampleFmt);
-        av_freep(&tmpBuf[0]);
+    // Move leftover data back to start, copy handles overlapping regions
+    if (mCurrPos > 0) {
+        if (mCurrSampleCount > 0) {
+            av_samples_copy(mBuffer, mBuffer, 0, mCurrPos, mCurrSampleCount, mNbChannels, mSampleFmt);
+        }
+        // Reset data point to start
+        mCurrPos = 0;
     }
 
-    // Reset data point to start
-    mCurrPos = 0;
+    // Point write buffer right after leftover data
+    int bytesPerSample = av_get_bytes_per_sample(mSampleFmt);
+    if (av_sample_fmt_is_planar(mSampleFmt)) {
+        for (int i = 0; i < mNbChannels; i++) mTmpBuffer[i] = mBuffer[i] + mCurrSampleCount * bytesPerSample;
+    } else {
+        mTmpBuffer[0] = mBuffer[0] + mCurrSampleCount * bytesPerSample * mNbChannels;
+    }
 
     mTmpNbSamples = nbSamples;
     return mTmpBuffer;
 }
 
 void SampleBuffer::commit_data(int nbSamples) {
-    // Put additional data in after leftover data (ends at curr_sample_count)
-    av_samples_copy(mBuffer, mTmpBuffer, mCurrSampleCount, 0, nbSamples, mNbChannels, mSampleFmt);
-
-    mCurrSampleCount += nbSamples;
-}
\ No newline at end of file
+    // Data was written in place right after leftover data (ends at curr_sample_count)
+    mCurrSampleCount += FFMIN(nbSamples, mTmpNbSamples);
+    mTmpNbSamples = 0;
+}
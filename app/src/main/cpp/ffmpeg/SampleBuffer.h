@@ -6,6 +6,8 @@ extern "C" {
 #include "libavcodec/avcodec.h"
 }
 
+/** A sample queue that collects converted samples of any size and hands them out in chunks of exactly chunk_size.
+ * Samples are written straight into the buffer, leftover samples are moved back to the start in place. */
 class SampleBuffer {
 private:
     /** Double buffer size, automatically called when trying to put data that exceeds current size. */
@@ -13,6 +15,7 @@ private:
     void expandBuffer(int requiredSize);
 public:
     uint8_t **mBuffer = nullptr;
+    // Plane pointers into mBuffer at the write position, handed out by prepareBuffer
     uint8_t **mTmpBuffer = nullptr;
     int mNbChannels = 0;
     AVSampleFormat mSampleFmt = AV_SAMPLE_FMT_NONE;
@@ -26,9 +29,7 @@ public:
     SampleBuffer(int nbChannels, AVSampleFormat sampleFmt, int chunkSize);
     ~SampleBuffer();
 
-    /** Allocate memory for buffer.
-     * Function will try to free the memory of the buffer if already allocated before re-allocating.
-     * @return success: 1, failure: 0 */
+    /** Free the memory of the buffer. */
     void freeBuffer();
 
     /** Check if buffer have enough samples for a chunk equals to chunk_size.
@@ -39,14 +40,20 @@ public:
      * @return 1 if success, 0 if failure or not available */
     int getChunk(uint8_t **dst, int dstOffset);
 
+    /** Copy every leftover sample (less than a chunk) from buffer into destination sample array.
+     * Used to drain the buffer at end of stream.
+     * @return number of samples copied */
+    int getRemaining(uint8_t **dst, int dstOffset);
+
     /** Preprocess buffer and return a tmp_buffer to write into.
-     * tmp_buffer will later be copied into main buffer by calling commit_data
+     * tmp_buffer points right after the leftover data inside main buffer, data written into it
+     * is committed by calling commit_data
      * @param nbSamples number of samples space the tmp_buffer will need to provide */
      uint8_t **prepareBuffer(int nbSamples);
 
-    /** Copy data from mTmpBuffer which was processed from prepareBuffer into main buffer.
-     * @param nbSamples actual number of samples will be written into buffer */
+    /** Commit data written into mTmpBuffer which was returned from prepareBuffer.
+     * @param nbSamples actual number of samples written into buffer */
     void commit_data(int nbSamples);
 };
 
-#endif //SAMPLE_BUFFER_H
\ No newline at end of file
+#endif //SAMPLE_BUFFER_H
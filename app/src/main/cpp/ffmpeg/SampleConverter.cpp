@@ -0,0 +1,408 @@
+#include "SampleConverter.h"
+#include "../common/JNILogHelper.h"
+#include "cmath"
+#include "cstring"
+
+extern "C" {
+#include "libavutil/common.h"
+}
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define LOG_TAG "SampleConverter"
+
+/** Same rounding as swr, clipping first keeps lrintf in range and gives the same result as clipping after. */
+static inline int16_t fltToS16(float x) {
+    return (int16_t) lrintf(av_clipf(x * 32768.0f, -32768.0f, 32767.0f));
+}
+
+static inline float s16ToFlt(int16_t x) {
+    return (float) x * (1.0f / 32768.0f);
+}
+
+template<typename T>
+static inline T copySample(T x) {
+    return x;
+}
+
+#if defined(__ARM_NEON)
+/** Same conversion as swr NEON kernels, unlike its C code: truncated to saturated Q31, then shifted down to s16 with
+ * saturation, rounding ties up. */
+static inline int16x4_t fltToS16x4(float32x4_t x) {
+    return vqrshrn_n_s32(vcvtq_n_s32_f32(x, 31), 16);
+}
+
+static inline int16x8_t fltToS16x8(const float *src) {
+    return vcombine_s16(fltToS16x4(vld1q_f32(src)), fltToS16x4(vld1q_f32(src + 4)));
+}
+
+/** Round a single sample as SIMD kernels do. */
+static inline int16_t fltToS16Simd(float x) {
+    return vget_lane_s16(fltToS16x4(vdupq_n_f32(x)), 0);
+}
+
+static inline void s16ToFltx8(int16x8_t x, float *dst) {
+    vst1q_f32(dst, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))), 1.0f / 32768.0f));
+    vst1q_f32(dst + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(x))), 1.0f / 32768.0f));
+}
+#elif defined(__SSE2__)
+/** cvtps2dq rounds to nearest even as lrintf does under default rounding mode. */
+static inline __m128i fltToS32(__m128 x) {
+    x = _mm_min_ps(_mm_max_ps(_mm_mul_ps(x, _mm_set1_ps(32768.0f)), _mm_set1_ps(-32768.0f)), _mm_set1_ps(32767.0f));
+    return _mm_cvtps_epi32(x);
+}
+
+static inline __m128i fltToS16x8(const float *src) {
+    return _mm_packs_epi32(fltToS32(_mm_loadu_ps(src)), fltToS32(_mm_loadu_ps(src + 4)));
+}
+
+static inline int16_t fltToS16Simd(float x) {
+    return fltToS16(x);
+}
+
+static inline __m128 s32ToFlt(__m128i x) {
+    return _mm_mul_ps(_mm_cvtepi32_ps(x), _mm_set1_ps(1.0f / 32768.0f));
+}
+
+/** Sign extend even and odd 16 bit lanes, i.e. first and second channel of interleaved stereo. */
+static inline __m128i getEvenS16(__m128i x) {
+    return _mm_srai_epi32(_mm_slli_epi32(x, 16), 16);
+}
+
+static inline __m128i getOddS16(__m128i x) {
+    return _mm_srai_epi32(x, 16);
+}
+#else
+static inline int16_t fltToS16Simd(float x) {
+    return fltToS16(x);
+}
+#endif
+
+/** Convert the first nbSimd samples on SIMD, nbSimd a multiple of 8 or n. */
+static void convertFltToS16(const float *src, int16_t *dst, int n, int nbSimd) {
+    int i = 0;
+#if defined(__ARM_NEON)
+    for (; i + 8 <= nbSimd; i += 8) vst1q_s16(dst + i, fltToS16x8(src + i));
+#elif defined(__SSE2__)
+    for (; i + 8 <= nbSimd; i += 8) _mm_storeu_si128((__m128i *) (dst + i), fltToS16x8(src + i));
+#endif
+    for (; i < n; i++) dst[i] = fltToS16(src[i]);
+}
+
+static void convertS16ToFlt(const int16_t *src, float *dst, int n) {
+    int i = 0;
+#if defined(__ARM_NEON)
+    for (; i + 8 <= n; i += 8) s16ToFltx8(vld1q_s16(src + i), dst + i);
+#elif defined(__SSE2__)
+    for (; i + 8 <= n; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *) (src + i));
+        // Sign extend by moving each sample to the top of a 32 bit lane
+        _mm_storeu_ps(dst + i, s32ToFlt(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16)));
+        _mm_storeu_ps(dst + i + 4, s32ToFlt(_mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16)));
+    }
+#endif
+    for (; i < n; i++) dst[i] = s16ToFlt(src[i]);
+}
+
+/** fltp to s16 stereo, the usual path from AAC decoder to audio output. First nbSimd samples are converted on SIMD,
+ * nbSimd a multiple of 8 or n. */
+static void interleaveFltToS16Stereo(const float *left, const float *right, int16_t *dst, int n, int nbSimd) {
+    int i = 0;
+#if defined(__ARM_NEON)
+    for (; i + 8 <= nbSimd; i += 8) {
+        int16x8x2_t x = {{fltToS16x8(left + i), fltToS16x8(right + i)}};
+        vst2q_s16(dst + 2 * i, x);
+    }
+#elif defined(__SSE2__)
+    for (; i + 8 <= nbSimd; i += 8) {
+        __m128i l = fltToS16x8(left + i), r = fltToS16x8(right + i);
+        _mm_storeu_si128((__m128i *) (dst + 2 * i), _mm_unpacklo_epi16(l, r));
+        _mm_storeu_si128((__m128i *) (dst + 2 * i + 8), _mm_unpackhi_epi16(l, r));
+    }
+#endif
+    for (; i < n; i++) {
+        dst[2 * i] = fltToS16(left[i]);
+        dst[2 * i + 1] = fltToS16(right[i]);
+    }
+}
+
+/** s16 to fltp stereo, the usual path into AAC encoder. */
+static void deinterleaveS16ToFltStereo(const int16_t *src, float *left, float *right, int n) {
+    int i = 0;
+#if defined(__ARM_NEON)
+    for (; i + 8 <= n; i += 8) {
+        int16x8x2_t x = vld2q_s16(src + 2 * i);
+        s16ToFltx8(x.val[0], left + i);
+        s16ToFltx8(x.val[1], right + i);
+    }
+#elif defined(__SSE2__)
+    for (; i + 4 <= n; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i *) (src + 2 * i));
+        _mm_storeu_ps(left + i, s32ToFlt(getEvenS16(x)));
+        _mm_storeu_ps(right + i, s32ToFlt(getOddS16(x)));
+    }
+#endif
+    for (; i < n; i++) {
+        left[i] = s16ToFlt(src[2 * i]);
+        right[i] = s16ToFlt(src[2 * i + 1]);
+    }
+}
+
+static void interleave32Stereo(const int32_t *left, const int32_t *right, int32_t *dst, int n) {
+    int i = 0;
+#if defined(__ARM_NEON)
+    for (; i + 4 <= n; i += 4) {
+        int32x4x2_t x = {{vld1q_s32(left + i), vld1q_s32(right + i)}};
+        vst2q_s32(dst + 2 * i, x);
+    }
+#elif defined(__SSE2__)
+    for (; i + 4 <= n; i += 4) {
+        __m128i l = _mm_loadu_si128((const __m128i *) (left + i)), r = _mm_loadu_si128((const __m128i *) (right + i));
+        _mm_storeu_si128((__m128i *) (dst + 2 * i), _mm_unpacklo_epi32(l, r));
+        _mm_storeu_si128((__m128i *) (dst + 2 * i + 4), _mm_unpackhi_epi32(l, r));
+    }
+#endif
+    for (; i < n; i++) {
+        dst[2 * i] = left[i];
+        dst[2 * i + 1] = right[i];
+    }
+}
+
+static void deinterleave32Stereo(const int32_t *src, int32_t *left, int32_t *right, int n) {
+    int i = 0;
+#if defined(__ARM_NEON)
+    for (; i + 4 <= n; i += 4) {
+        int32x4x2_t x = vld2q_s32(src + 2 * i);
+        vst1q_s32(left + i, x.val[0]);
+        vst1q_s32(right + i, x.val[1]);
+    }
+#elif defined(__SSE2__)
+    for (; i + 4 <= n; i += 4) {
+        __m128 a = _mm_loadu_ps((const float *) (src + 2 * i)), b = _mm_loadu_ps((const float *) (src + 2 * i + 4));
+        _mm_storeu_ps((float *) (left + i), _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps((float *) (right + i), _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+#endif
+    for (; i < n; i++) {
+        left[i] = src[2 * i];
+        right[i] = src[2 * i + 1];
+    }
+}
+
+static void interleave16Stereo(const int16_t *left, const int16_t *right, int16_t *dst, int n) {
+    int i = 0;
+#if defined(__ARM_NEON)
+    for (; i + 8 <= n; i += 8) {
+        int16x8x2_t x = {{vld1q_s16(left + i), vld1q_s16(right + i)}};
+        vst2q_s16(dst + 2 * i, x);
+    }
+#elif defined(__SSE2__)
+    for (; i + 8 <= n; i += 8) {
+        __m128i l = _mm_loadu_si128((const __m128i *) (left + i)), r = _mm_loadu_si128((const __m128i *) (right + i));
+        _mm_storeu_si128((__m128i *) (dst + 2 * i), _mm_unpacklo_epi16(l, r));
+        _mm_storeu_si128((__m128i *) (dst + 2 * i + 8), _mm_unpackhi_epi16(l, r));
+    }
+#endif
+    for (; i < n; i++) {
+        dst[2 * i] = left[i];
+        dst[2 * i + 1] = right[i];
+    }
+}
+
+static void deinterleave16Stereo(const int16_t *src, int16_t *left, int16_t *right, int n) {
+    int i = 0;
+#if defined(__ARM_NEON)
+    for (; i + 8 <= n; i += 8) {
+        int16x8x2_t x = vld2q_s16(src + 2 * i);
+        vst1q_s16(left + i, x.val[0]);
+        vst1q_s16(right + i, x.val[1]);
+    }
+#elif defined(__SSE2__)
+    for (; i + 8 <= n; i += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i *) (src + 2 * i));
+        __m128i b = _mm_loadu_si128((const __m128i *) (src + 2 * i + 8));
+        // Samples were 16 bit to begin with, packing them back never saturates
+        _mm_storeu_si128((__m128i *) (left + i), _mm_packs_epi32(getEvenS16(a), getEvenS16(b)));
+        _mm_storeu_si128((__m128i *) (right + i), _mm_packs_epi32(getOddS16(a), getOddS16(b)));
+    }
+#endif
+    for (; i < n; i++) {
+        left[i] = src[2 * i];
+        right[i] = src[2 * i + 1];
+    }
+}
+
+/** Interleave samples from start to n of planes of any number of channels, converting every sample. */
+template<typename Src, typename Dst, Dst (*convertSample)(Src)>
+static void interleave(const uint8_t *const *src, uint8_t *dst, int start, int n, int nbChannels) {
+    auto *out = (Dst *) dst;
+    for (int c = 0; c < nbChannels; c++) {
+        auto *in = (const Src *) src[c];
+        for (int i = start; i < n; i++) out[i * nbChannels + c] = convertSample(in[i]);
+    }
+}
+
+template<typename Src, typename Dst, Dst (*convertSample)(Src)>
+static void deinterleave(const uint8_t *src, uint8_t *const *dst, int n, int nbChannels) {
+    auto *in = (const Src *) src;
+    for (int c = 0; c < nbChannels; c++) {
+        auto *out = (Dst *) dst[c];
+        for (int i = 0; i < n; i++) out[i] = convertSample(in[i * nbChannels + c]);
+    }
+}
+
+SampleConverter::SampleConverter(SampleConversion sampleConversion, LayoutConversion layoutConversion, int nbChannels,
+                                 bool isPlanar, int srcBytesPerSample)
+        : mSampleConversion(sampleConversion), mLayoutConversion(layoutConversion), mNbChannels(nbChannels),
+          mIsPlanar(isPlanar), mSrcBytesPerSample(srcBytesPerSample) {
+}
+
+bool SampleConverter::isSupported(AVSampleFormat srcFmt, AVSampleFormat dstFmt) {
+    if (srcFmt == dstFmt) return false;
+    AVSampleFormat src = av_get_packed_sample_fmt(srcFmt), dst = av_get_packed_sample_fmt(dstFmt);
+    return (src == AV_SAMPLE_FMT_S16 || src == AV_SAMPLE_FMT_FLT) &&
+           (dst == AV_SAMPLE_FMT_S16 || dst == AV_SAMPLE_FMT_FLT);
+}
+
+SampleConverter *SampleConverter::create(AVSampleFormat srcFmt, AVSampleFormat dstFmt, int nbChannels) {
+    if (!isSupported(srcFmt, dstFmt) || nbChannels <= 0) return nullptr;
+
+    AVSampleFormat src = av_get_packed_sample_fmt(srcFmt), dst = av_get_packed_sample_fmt(dstFmt);
+    SampleConversion sampleConversion = SampleConversion::NONE;
+    if (src != dst) {
+        sampleConversion = (src == AV_SAMPLE_FMT_FLT) ? SampleConversion::FLT_TO_S16 : SampleConversion::S16_TO_FLT;
+    }
+
+    bool isSrcPlanar = av_sample_fmt_is_planar(srcFmt), isDstPlanar = av_sample_fmt_is_planar(dstFmt);
+    LayoutConversion layoutConversion = LayoutConversion::NONE;
+    // A single channel is laid out the same either way
+    if (isSrcPlanar != isDstPlanar && nbChannels > 1) {
+        layoutConversion = isSrcPlanar ? LayoutConversion::INTERLEAVE : LayoutConversion::DEINTERLEAVE;
+    }
+
+    LOGD("Sample converter %s -> %s, %d channels", av_get_sample_fmt_name(srcFmt), av_get_sample_fmt_name(dstFmt),
+         nbChannels);
+    bool isPlanar = isSrcPlanar && isDstPlanar;
+    return new SampleConverter(sampleConversion, layoutConversion, nbChannels, isPlanar, av_get_bytes_per_sample(src));
+}
+
+int SampleConverter::getSimdSamples([[maybe_unused]] const uint8_t *const *src,
+                                    [[maybe_unused]] const uint8_t *const *dst, int nbSamples) const {
+#if defined(__ARM_NEON)
+    // swr has no NEON kernel from flt to s16p
+    if (mLayoutConversion == LayoutConversion::DEINTERLEAVE) return 0;
+    int nbSrcPlanes = (mIsPlanar || mLayoutConversion == LayoutConversion::INTERLEAVE) ? mNbChannels : 1;
+    int nbDstPlanes = mIsPlanar ? mNbChannels : 1;
+    uintptr_t addresses = 0;
+    for (int c = 0; c < nbSrcPlanes; c++) addresses |= (uintptr_t) src[c];
+    for (int c = 0; c < nbDstPlanes; c++) addresses |= (uintptr_t) dst[c];
+    return (addresses & 15) ? 0 : nbSamples & ~15;
+#else
+    return nbSamples;
+#endif
+}
+
+void SampleConverter::convertRun(const uint8_t *src, uint8_t *dst, int n, int nbSimd) const {
+    switch (mSampleConversion) {
+        case SampleConversion::NONE:
+            memcpy(dst, src, (size_t) n * mSrcBytesPerSample);
+            break;
+        case SampleConversion::FLT_TO_S16:
+            convertFltToS16((const float *) src, (int16_t *) dst, n, nbSimd);
+            break;
+        case SampleConversion::S16_TO_FLT:
+            convertS16ToFlt((const int16_t *) src, (float *) dst, n);
+            break;
+    }
+}
+
+void SampleConverter::convert(const uint8_t *const *src, uint8_t *const *dst, int nbSamples) const {
+    int nbSimd = mSampleConversion == SampleConversion::FLT_TO_S16 ? getSimdSamples(src, dst, nbSamples) : nbSamples;
+    switch (mLayoutConversion) {
+        case LayoutConversion::NONE:
+            // Every plane is a run of samples of its own, interleaved samples are a single run
+            if (mIsPlanar) {
+                for (int c = 0; c < mNbChannels; c++) convertRun(src[c], dst[c], nbSamples, nbSimd);
+            } else {
+                convertRun(src[0], dst[0], nbSamples * mNbChannels, nbSimd * mNbChannels);
+            }
+            break;
+        case LayoutConversion::INTERLEAVE:
+            if (mNbChannels == 2) {
+                switch (mSampleConversion) {
+                    case SampleConversion::NONE:
+                        if (mSrcBytesPerSample == 4) {
+                            interleave32Stereo((const int32_t *) src[0], (const int32_t *) src[1], (int32_t *) dst[0],
+                                               nbSamples);
+                        } else {
+                            interleave16Stereo((const int16_t *) src[0], (const int16_t *) src[1], (int16_t *) dst[0],
+                                               nbSamples);
+                        }
+                        return;
+                    case SampleConversion::FLT_TO_S16:
+                        interleaveFltToS16Stereo((const float *) src[0], (const float *) src[1], (int16_t *) dst[0],
+                                                 nbSamples, nbSimd);
+                        return;
+                    case SampleConversion::S16_TO_FLT:
+                        break;
+                }
+            }
+            switch (mSampleConversion) {
+                case SampleConversion::NONE:
+                    if (mSrcBytesPerSample == 4) {
+                        interleave<int32_t, int32_t, copySample>(src, dst[0], 0, nbSamples, mNbChannels);
+                    } else {
+                        interleave<int16_t, int16_t, copySample>(src, dst[0], 0, nbSamples, mNbChannels);
+                    }
+                    break;
+                case SampleConversion::FLT_TO_S16:
+                    interleave<float, int16_t, fltToS16Simd>(src, dst[0], 0, nbSimd, mNbChannels);
+                    interleave<float, int16_t, fltToS16>(src, dst[0], nbSimd, nbSamples, mNbChannels);
+                    break;
+                case SampleConversion::S16_TO_FLT:
+                    interleave<int16_t, float, s16ToFlt>(src, dst[0], 0, nbSamples, mNbChannels);
+                    break;
+            }
+            break;
+        case LayoutConversion::DEINTERLEAVE:
+            if (mNbChannels == 2) {
+                switch (mSampleConversion) {
+                    case SampleConversion::NONE:
+                        if (mSrcBytesPerSample == 4) {
+                            deinterleave32Stereo((const int32_t *) src[0], (int32_t *) dst[0], (int32_t *) dst[1],
+                                                 nbSamples);
+                        } else {
+                            deinterleave16Stereo((const int16_t *) src[0], (int16_t *) dst[0], (int16_t *) dst[1],
+                                                 nbSamples);
+                        }
+                        return;
+                    case SampleConversion::S16_TO_FLT:
+                        deinterleaveS16ToFltStereo((const int16_t *) src[0], (float *) dst[0], (float *) dst[1],
+                                                   nbSamples);
+                        return;
+                    case SampleConversion::FLT_TO_S16:
+                        break;
+                }
+            }
+            switch (mSampleConversion) {
+                case SampleConversion::NONE:
+                    if (mSrcBytesPerSample == 4) {
+                        deinterleave<int32_t, int32_t, copySample>(src[0], dst, nbSamples, mNbChannels);
+                    } else {
+                        deinterleave<int16_t, int16_t, copySample>(src[0], dst, nbSamples, mNbChannels);
+                    }
+                    break;
+                case SampleConversion::FLT_TO_S16:
+                    deinterleave<float, int16_t, fltToS16>(src[0], dst, nbSamples, mNbChannels);
+                    break;
+                case SampleConversion::S16_TO_FLT:
+                    deinterleave<int16_t, float, s16ToFlt>(src[0], dst, nbSamples, mNbChannels);
+                    break;
+            }
+            break;
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef SAMPLE_CONVERTER_H
+#define SAMPLE_CONVERTER_H
+
+extern "C" {
+#include "libavutil/samplefmt.h"
+}
+#include "cstdint"
+
+/** Converts samples between s16, s16p, flt and fltp at the same rate and channel layout, without a resampler.
+ * Conversion and (de)interleaving are done in a single pass, on SIMD where available, with stereo given its own
+ * kernels. Output is bit-exact with swr: float is scaled by 2^15, clipped and rounded to nearest even. On NEON, swr
+ * converts blocks of 16 samples of aligned buffers to s16 rounding ties up instead, converter does the same. */
+class SampleConverter {
+private:
+    enum class SampleConversion {
+        NONE,
+        FLT_TO_S16,
+        S16_TO_FLT
+    };
+
+    enum class LayoutConversion {
+        NONE, // Planar to planar or interleaved to interleaved
+        INTERLEAVE,
+        DEINTERLEAVE
+    };
+
+    const SampleConversion mSampleConversion;
+    const LayoutConversion mLayoutConversion;
+    const int mNbChannels;
+    const bool mIsPlanar; // Both formats are planar, when layout is kept
+    const int mSrcBytesPerSample; // Bytes of one sample of one channel
+
+private:
+    SampleConverter(SampleConversion sampleConversion, LayoutConversion layoutConversion, int nbChannels,
+                    bool isPlanar, int srcBytesPerSample);
+
+    /** Return how many samples of each channel swr converts from float to s16 on SIMD, where rounding may differ. */
+    int getSimdSamples(const uint8_t *const *src, const uint8_t *const *dst, int nbSamples) const;
+
+    /** Convert a contiguous run of samples, first nbSimd of them on SIMD. */
+    void convertRun(const uint8_t *src, uint8_t *dst, int n, int nbSimd) const;
+
+public:
+    /** Return whether formats only differ in a way a converter handles. */
+    static bool isSupported(AVSampleFormat srcFmt, AVSampleFormat dstFmt);
+
+    /** Create converter from srcFmt to dstFmt.
+     * @return converter or null if formats are the same or not supported */
+    static SampleConverter *create(AVSampleFormat srcFmt, AVSampleFormat dstFmt, int nbChannels);
+
+    /** Convert nbSamples samples of every channel, dst must hold as many.
+     * @param src planes of input, only the first one for interleaved format
+     * @param dst planes of output, only the first one for interleaved format */
+    void convert(const uint8_t *const *src, uint8_t *const *dst, int nbSamples) const;
+};
+
+#endif //SAMPLE_CONVERTER_H
@@ -0,0 +1,251 @@
+#include "CompositorES3.h"
+#include "../common/JNILogHelper.h"
+#include "algorithm"
+
+#define LOG_TAG "CompositorES3"
+
+CompositorES3::CompositorES3() : mEglContext(eglGetCurrentContext()) {
+}
+
+CompositorES3::~CompositorES3() {
+    LOGD("Compositor draws: %lld, tile uploads: %lld", (long long) mNbDraws, (long long) mNbUploads);
+    // Objects are gone with their context, they can only be deleted while it is current
+    if (eglGetCurrentContext() != mEglContext) return;
+    glDeleteProgram(mProgram);
+    if (mTextureId != 0) glDeleteTextures(1, &mTextureId);
+    if (mQuadBufferId != 0) glDeleteBuffers(1, &mQuadBufferId);
+    if (mInstanceBufferId != 0) glDeleteBuffers(1, &mInstanceBufferId);
+    if (mVertexArrayId != 0) glDeleteVertexArrays(1, &mVertexArrayId);
+}
+
+bool CompositorES3::init(const char *programCacheDir) {
+    ProgramCache programCache(programCacheDir);
+    mProgram = programCache.getProgram(COMPOSITOR_VERTEX_SHADER, COMPOSITOR_FRAGMENT_SHADER);
+    if (!mProgram) return false;
+
+    // Texture array always stays on first unit, program stays in use
+    glUseProgram(mProgram);
+    glUniform1i(glGetUniformLocation(mProgram, "uTexArray"), 0);
+    glActiveTexture(GL_TEXTURE0);
+
+    mQuadBufferId = createVbo(sizeof(rect), rect, GL_STATIC_DRAW);
+    glGenBuffers(1, &mInstanceBufferId);
+
+    // Quad corners advance per vertex, tile attributes per instance
+    glGenVertexArrays(1, &mVertexArrayId);
+    glBindVertexArray(mVertexArrayId);
+    glBindBuffer(GL_ARRAY_BUFFER, mQuadBufferId);
+    glVertexAttribPointer(TEX_COORD_ATTRIB, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), BUFFER_OFFSET(2 * sizeof(GLfloat)));
+    glEnableVertexAttribArray(TEX_COORD_ATTRIB);
+
+    glBindBuffer(GL_ARRAY_BUFFER, mInstanceBufferId);
+    GLsizei stride = INSTANCE_SIZE * sizeof(GLfloat);
+    glVertexAttribPointer(TILE_RECT_ATTRIB, 4, GL_FLOAT, GL_FALSE, stride, BUFFER_OFFSET(0));
+    glVertexAttribPointer(TILE_TEX_RANGE_ATTRIB, 4, GL_FLOAT, GL_FALSE, stride, BUFFER_OFFSET(4 * sizeof(GLfloat)));
+    glVertexAttribPointer(TILE_LAYER_ATTRIB, 1, GL_FLOAT, GL_FALSE, stride, BUFFER_OFFSET(8 * sizeof(GLfloat)));
+    for (GLuint attrib : {TILE_RECT_ATTRIB, TILE_TEX_RANGE_ATTRIB, TILE_LAYER_ATTRIB}) {
+        glVertexAttribDivisor(attrib, 1);
+        glEnableVertexAttribArray(attrib);
+    }
+
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    return !checkGlError("CompositorES3::init");
+}
+
+void CompositorES3::resize(int w, int h) {
+    mSurfaceWidth = w;
+    mSurfaceHeight = h;
+    glViewport(0, 0, w, h);
+}
+
+void CompositorES3::setLayout(const TileRect *rects, int nbTiles) {
+    if (nbTiles != (int) mTiles.size()) mTiles.assign(nbTiles, Tile());
+    for (int i = 0; i < nbTiles; i++) mTiles[i].mRect = rects[i];
+}
+
+int CompositorES3::getNbTiles() const {
+    return (int) mTiles.size();
+}
+
+void CompositorES3::getTileSize(int tile, int *width, int *height) const {
+    const TileRect &rect = mTiles[tile].mRect;
+    *width = (int) lroundf(rect.mWidth * (float) mSurfaceWidth);
+    *height = (int) lroundf(rect.mHeight * (float) mSurfaceHeight);
+}
+
+bool CompositorES3::allocateLayers(int width, int height, int nbLayers, GLint internalPixFmt) {
+    GLenum sizedPixFmt = RendererES3::getSizedInternalPixFmt(internalPixFmt);
+    if (width <= mLayerWidth && height <= mLayerHeight && nbLayers <= mNbLayers && sizedPixFmt == mInternalPixFmt) {
+        return true;
+    }
+
+    // Only grow, so that sources alternating sizes do not reallocate every frame
+    int maxSize = RendererES3::getMaxTextureSize();
+    width = std::min(std::max(width, mLayerWidth) + LAYER_SIZE_ALIGN - 1, maxSize) / LAYER_SIZE_ALIGN * LAYER_SIZE_ALIGN;
+    height = std::min(std::max(height, mLayerHeight) + LAYER_SIZE_ALIGN - 1, maxSize) / LAYER_SIZE_ALIGN * LAYER_SIZE_ALIGN;
+    if (sizedPixFmt == mInternalPixFmt) nbLayers = std::max(nbLayers, mNbLayers);
+
+    // Immutable storage cannot be resized, start over with a new texture
+    if (mTextureId != 0) glDeleteTextures(1, &mTextureId);
+    glGenTextures(1, &mTextureId);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, mTextureId);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, sizedPixFmt, width, height, nbLayers);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    for (Tile &tile : mTiles) tile.mUploadedPixels = nullptr;
+    if (checkGlError("glTexStorage3D")) {
+        mLayerWidth = mLayerHeight = mNbLayers = 0;
+        mInternalPixFmt = GL_NONE;
+        return false;
+    }
+
+    LOGD("Allocated %d layers of %dx%d", nbLayers, width, height);
+    mLayerWidth = width;
+    mLayerHeight = height;
+    mNbLayers = nbLayers;
+    mInternalPixFmt = sizedPixFmt;
+    return true;
+}
+
+void CompositorES3::setTilePicture(int tile, int width, int height, GLenum pixFmt, GLint internalPixFmt, int linesize,
+                                   const void *pixels, bool isNewFrame, float sampleAspectRatio) {
+    if (tile < 0 || tile >= (int) mTiles.size()) return;
+    Tile &target = mTiles[tile];
+    if (!pixels || width <= 0 || height <= 0) {
+        target.mWidth = target.mHeight = 0;
+        target.mPixels = nullptr;
+        return;
+    }
+    target.mWidth = width;
+    target.mHeight = height;
+    target.mSampleAspectRatio = sampleAspectRatio > 0.0f ? sampleAspectRatio : 1.0f;
+    target.mPixFmt = pixFmt;
+    target.mInternalPixFmt = internalPixFmt;
+    target.mLinesize = linesize;
+    target.mPixels = pixels;
+    target.mIsNewFrame = target.mIsNewFrame || isNewFrame;
+}
+
+void CompositorES3::uploadTiles() {
+    // Layers are sized once for every picture, a bigger picture in a later tile never drops earlier uploads
+    int width = 0, height = 0;
+    GLint internalPixFmt = GL_NONE;
+    for (const Tile &tile : mTiles) {
+        if (!tile.mPixels) continue;
+        if (internalPixFmt == GL_NONE) internalPixFmt = tile.mInternalPixFmt;
+        if (tile.mInternalPixFmt != internalPixFmt) continue;
+        width = std::max(width, tile.mWidth);
+        height = std::max(height, tile.mHeight);
+    }
+    if (internalPixFmt == GL_NONE) return;
+    if (!allocateLayers(width, height, (int) mTiles.size(), internalPixFmt)) return;
+
+    for (int i = 0; i < (int) mTiles.size(); i++) {
+        Tile &tile = mTiles[i];
+        if (!tile.mPixels || tile.mInternalPixFmt != internalPixFmt) continue;
+        if (!tile.mIsNewFrame && tile.mPixels == tile.mUploadedPixels) continue;
+
+        // Pictures bigger than a layer can hold are cropped
+        int uploadWidth = std::min(tile.mWidth, mLayerWidth), uploadHeight = std::min(tile.mHeight, mLayerHeight);
+        mNbUploads++;
+        int bytesPerPixel = tile.mPixFmt == GL_RGBA ? 4 : 3;
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, tile.mLinesize / bytesPerPixel);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, uploadWidth, uploadHeight, 1, tile.mPixFmt, GL_UNSIGNED_BYTE,
+                        tile.mPixels);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        tile.mUploadedPixels = tile.mPixels;
+        tile.mIsNewFrame = false;
+    }
+}
+
+bool CompositorES3::isDrawable(const Tile &tile) const {
+    return tile.mPixels && tile.mPixels == tile.mUploadedPixels && tile.mRect.mWidth > 0.0f && tile.mRect.mHeight > 0.0f;
+}
+
+void CompositorES3::addInstance(const Tile &tile, int layer) {
+    // Picture only covers a corner of its layer, cropped if it is bigger
+    int pictureWidth = std::min(tile.mWidth, mLayerWidth), pictureHeight = std::min(tile.mHeight, mLayerHeight);
+
+    // Tile rectangle in pixels, picture is centered inside it keeping its aspect ratio
+    float tileX = tile.mRect.mX * (float) mSurfaceWidth, tileY = tile.mRect.mY * (float) mSurfaceHeight;
+    float tileWidth = tile.mRect.mWidth * (float) mSurfaceWidth, tileHeight = tile.mRect.mHeight * (float) mSurfaceHeight;
+    float pictureAspect = (float) pictureWidth * tile.mSampleAspectRatio / (float) pictureHeight;
+    float width = tileWidth, height = tileHeight;
+    if (pictureAspect > tileWidth / tileHeight) height = tileWidth / pictureAspect;
+    else width = tileHeight * pictureAspect;
+    float x = tileX + (tileWidth - width) / 2.0f, y = tileY + (tileHeight - height) / 2.0f;
+
+    // Normalized device coordinates start from bottom left corner
+    mInstances.push_back(2.0f * x / (float) mSurfaceWidth - 1.0f);
+    mInstances.push_back(1.0f - 2.0f * (y + height) / (float) mSurfaceHeight);
+    mInstances.push_back(2.0f * width / (float) mSurfaceWidth);
+    mInstances.push_back(2.0f * height / (float) mSurfaceHeight);
+    // Stop at center of last texel of picture
+    mInstances.push_back((float) pictureWidth / (float) mLayerWidth);
+    mInstances.push_back((float) pictureHeight / (float) mLayerHeight);
+    mInstances.push_back(((float) pictureWidth - 0.5f) / (float) mLayerWidth);
+    mInstances.push_back(((float) pictureHeight - 0.5f) / (float) mLayerHeight);
+    mInstances.push_back((float) layer);
+}
+
+void CompositorES3::render() {
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if (mProgram == 0 || mSurfaceWidth <= 0 || mSurfaceHeight <= 0) return;
+
+    uploadTiles();
+    mInstances.clear();
+    for (int i = 0; i < (int) mTiles.size(); i++) {
+        if (isDrawable(mTiles[i])) addInstance(mTiles[i], i);
+    }
+    int nbInstances = (int) mInstances.size() / INSTANCE_SIZE;
+    if (nbInstances == 0) return;
+
+    // Orphan instance buffer every draw, driver hands out fresh storage instead of waiting on previous draw
+    auto size = (GLsizeiptr) (mInstances.size() * sizeof(GLfloat));
+    glBindBuffer(GL_ARRAY_BUFFER, mInstanceBufferId);
+    if (size > mInstanceBufferSize) mInstanceBufferSize = size;
+    glBufferData(GL_ARRAY_BUFFER, mInstanceBufferSize, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, size, mInstances.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, nbInstances);
+    mNbDraws++;
+    checkGlError("CompositorES3::render");
+}
+
+void CompositorES3::getGridLayout(int nbTiles, std::vector<TileRect> *rects) {
+    rects->clear();
+    if (nbTiles <= 0) return;
+    int nbColumns = (int) ceil(sqrt((double) nbTiles));
+    int nbRows = (nbTiles + nbColumns - 1) / nbColumns;
+    for (int i = 0; i < nbTiles; i++) {
+        TileRect rect;
+        rect.mWidth = 1.0f / (float) nbColumns;
+        rect.mHeight = 1.0f / (float) nbRows;
+        rect.mX = (float) (i % nbColumns) * rect.mWidth;
+        rect.mY = (float) (i / nbColumns) * rect.mHeight;
+        rects->push_back(rect);
+    }
+}
+
+void CompositorES3::getPictureInPictureLayout(int nbTiles, std::vector<TileRect> *rects) {
+    static const float INSET_SIZE = 0.25f;
+    static const float MARGIN = 0.02f;
+    static const int INSETS_PER_ROW = 3;
+
+    rects->clear();
+    if (nbTiles <= 0) return;
+    rects->push_back(TileRect());
+    // Insets line up from bottom right corner toward the left, then in rows above
+    for (int i = 1; i < nbTiles; i++) {
+        int column = (i - 1) % INSETS_PER_ROW, row = (i - 1) / INSETS_PER_ROW;
+        TileRect rect;
+        rect.mWidth = rect.mHeight = INSET_SIZE;
+        rect.mX = 1.0f - (float) (column + 1) * (INSET_SIZE + MARGIN);
+        rect.mY = 1.0f - (float) (row + 1) * (INSET_SIZE + MARGIN);
+        rects->push_back(rect);
+    }
+}
@@ -0,0 +1,145 @@
+#ifndef COMPOSITOR_ES3_H
+#define COMPOSITOR_ES3_H
+
+#include "RendererES3.h"
+#include "vector"
+
+#define TILE_RECT_ATTRIB 2
+#define TILE_TEX_RANGE_ATTRIB 3
+#define TILE_LAYER_ATTRIB 4
+
+// Quad corners come from texture coordinates of rect, scaled into the tile rectangle of each instance.
+static const char COMPOSITOR_VERTEX_SHADER[] =
+        "#version 300 es\n"
+        "layout (location = " STRV(TEX_COORD_ATTRIB) ") in vec2 aTexCoord;\n"
+        "layout (location = " STRV(TILE_RECT_ATTRIB) ") in vec4 aTileRect;\n"       // Bottom left corner and size
+        "layout (location = " STRV(TILE_TEX_RANGE_ATTRIB) ") in vec4 aTexRange;\n"  // Scale and max of coordinates
+        "layout (location = " STRV(TILE_LAYER_ATTRIB) ") in float aLayer;\n"
+        "out vec2 vTexCoord;\n"
+        "flat out vec2 vTexMax;\n"
+        "flat out float vLayer;\n"
+        "void main() {\n"
+        "   gl_Position = vec4(aTileRect.xy + aTexCoord * aTileRect.zw, 0.0, 1.0);\n"
+        "   vTexCoord = vec2(aTexCoord.x, 1.0 - aTexCoord.y) * aTexRange.xy;\n"
+        "   vTexMax = aTexRange.zw;\n"
+        "   vLayer = aLayer;\n"
+        "}\n";
+
+// Layers are bigger than most pictures, coordinates are clamped so filtering never reads past a picture.
+static const char COMPOSITOR_FRAGMENT_SHADER[] =
+        "#version 300 es\n"
+        "precision mediump float;\n"
+        "in vec2 vTexCoord;\n"
+        "flat in vec2 vTexMax;\n"
+        "flat in float vLayer;\n"
+        "uniform mediump sampler2DArray uTexArray;\n"
+        "out vec4 colorOut;\n"
+        "void main() {\n"
+        "   colorOut = texture(uTexArray, vec3(min(vTexCoord, vTexMax), vLayer));\n"
+        "}\n";
+
+/** Area of surface a tile is drawn into, normalized so that 1 is full surface width or height.
+ * Origin is at top left corner of surface. */
+struct TileRect {
+    float mX = 0.0f, mY = 0.0f;
+    float mWidth = 1.0f, mHeight = 1.0f;
+};
+
+/** Draws pictures of several sources into tiles of one surface.
+ * Each tile has its own layer of a texture array, every tile is drawn by a single instanced draw call.
+ * Tiles are drawn in order, later tiles over earlier ones. Pictures must all have the same RGB pixel format,
+ * tiles holding pictures of another format than first tile are left empty.
+ * Pictures are uploaded when drawing, after layers were sized for every tile, in the context of the surface.
+ * Replaces RendererES3 on its surface, both must not draw into the same context. */
+class CompositorES3 {
+protected:
+    /** A tile with the picture last set into it. */
+    struct Tile {
+        TileRect mRect;
+        int mWidth = 0, mHeight = 0; // Picture size, 0 if tile has no picture
+        float mSampleAspectRatio = 1.0f;
+        GLenum mPixFmt = GL_NONE;
+        GLint mInternalPixFmt = GL_NONE;
+        int mLinesize = 0;
+        const void *mPixels = nullptr; // Picture set into tile, uploaded when drawing
+        bool mIsNewFrame = false; // Picture must be uploaded even if layer holds the same pixels
+        const void *mUploadedPixels = nullptr; // Pixels held by layer of tile, null if layer holds no picture
+    };
+
+    // Per instance floats: tile rect, texture scale and max coordinates, layer
+    static const int INSTANCE_SIZE = 9;
+    // Layer sizes are rounded up to limit reallocations when picture sizes change a little
+    static const int LAYER_SIZE_ALIGN = 64;
+
+    EGLContext mEglContext;
+    GLuint mProgram = 0;
+    GLuint mVertexArrayId = 0;
+    GLuint mQuadBufferId = 0;
+    GLuint mInstanceBufferId = 0;
+    GLsizeiptr mInstanceBufferSize = 0;
+
+    // Texture array with a layer per tile {
+    GLuint mTextureId = 0;
+    int mLayerWidth = 0, mLayerHeight = 0, mNbLayers = 0;
+    GLenum mInternalPixFmt = GL_NONE;
+    // } Texture array
+
+    std::vector<Tile> mTiles;
+    // Instance data of tiles with a picture, rebuilt every draw
+    std::vector<GLfloat> mInstances;
+
+    int mSurfaceWidth = 0, mSurfaceHeight = 0;
+
+    int64_t mNbDraws = 0;
+    int64_t mNbUploads = 0;
+
+private:
+    /** Make sure texture array holds layers of at least given size and count in given format.
+     * Reallocating drops every uploaded picture, tiles are uploaded again from the pictures set into them.
+     * @return true if texture array is ready */
+    bool allocateLayers(int width, int height, int nbLayers, GLint internalPixFmt);
+
+    /** Size layers for pictures of every tile, then upload pictures layers do not hold yet. */
+    void uploadTiles();
+
+    /** Return true if layer of tile holds its picture, so that tile can be drawn. */
+    bool isDrawable(const Tile &tile) const;
+
+    /** Append instance data of tile, picture letterboxed inside tile rectangle. */
+    void addInstance(const Tile &tile, int layer);
+
+public:
+    CompositorES3();
+
+    ~CompositorES3();
+
+    /** Create program and GL objects, program binaries are cached in programCacheDir if set. */
+    bool init(const char *programCacheDir = nullptr);
+
+    void resize(int w, int h);
+
+    /** Replace tile layout. Tiles keep their picture if tile count does not change. */
+    void setLayout(const TileRect *rects, int nbTiles);
+
+    int getNbTiles() const;
+
+    /** Return size of tile on surface in pixels. */
+    void getTileSize(int tile, int *width, int *height) const;
+
+    /** Set picture of a tile, uploaded into its layer when drawing if isNewFrame is set or layer does not hold
+     * these pixels. Pixels must stay valid until picture of tile is set again, layers being reallocated by a bigger
+     * picture of another tile upload them again. Null pixels leave tile empty. */
+    void setTilePicture(int tile, int width, int height, GLenum pixFmt, GLint internalPixFmt, int linesize,
+                        const void *pixels, bool isNewFrame = true, float sampleAspectRatio = 1.0f);
+
+    /** Clear surface and draw every tile holding a picture. */
+    void render();
+
+    /** Fill rects with a grid of equal tiles, as square as possible, row by row. */
+    static void getGridLayout(int nbTiles, std::vector<TileRect> *rects);
+
+    /** Fill rects with first tile covering surface and others as small insets along its bottom edge. */
+    static void getPictureInPictureLayout(int nbTiles, std::vector<TileRect> *rects);
+};
+
+#endif //COMPOSITOR_ES3_H
@@ -1,8 +1,11 @@
 #include "GLES3Helper.h"
 #include "JNILogHelper.h"
+#include "atomic"
 
 #define LOG_TAG "GLES3Helper"
 
+static std::atomic_int64_t sNbGlErrors = {0};
+
 GLuint createVbo(const GLsizeiptr size, const GLvoid *data, const GLenum usage) {
     assert(data != nullptr);
     GLuint vboObject;
@@ -20,11 +23,16 @@ bool checkGlError(const char *funcName) {
     auto err = (GLint) glGetError();
     if (err != GL_NO_ERROR) {
         LOGE("GL error after %s(): 0x%08x\n", funcName, err);
+        sNbGlErrors++;
         return true;
     }
     return false;
 }
 
+int64_t getNbGlErrors() {
+    return sNbGlErrors;
+}
+
 void printGlString(const char *name, GLenum s) {
     const char *v = (const char *) glGetString(s);
     LOGV("GL %s: %s\n", name, v);
@@ -61,7 +69,7 @@ GLuint createShader(GLenum shaderType, const char *src) {
     return shader;
 }
 
-GLuint createProgram(const char *vtxSrc, const char *fragSrc) {
+GLuint createProgram(const char *vtxSrc, const char *fragSrc, bool isRetrievable) {
     GLuint vtxShader = 0;
     GLuint fragShader = 0;
     GLuint program = 0;
@@ -82,6 +90,7 @@ GLuint createProgram(const char *vtxSrc, const char *fragSrc) {
     }
     glAttachShader(program, vtxShader);
     glAttachShader(program, fragShader);
+    if (isRetrievable) glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 
     glLinkProgram(program);
     glGetProgramiv(program, GL_LINK_STATUS, &linked);
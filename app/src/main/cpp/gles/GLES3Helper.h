@@ -1,3 +1,6 @@
+#ifndef GLES3_HELPER_H
+#define GLES3_HELPER_H
+
 #include "NDKHelper.h"
 #include "EGL/egl.h"
 #include "assert.h"
@@ -10,11 +13,16 @@ GLuint createVbo(const GLsizeiptr size, const GLvoid *data, const GLenum usage);
 
 bool checkGlError(const char *funcName);
 
+/** Return number of errors checkGlError() found so far on any thread, for tests and benchmarks. */
+int64_t getNbGlErrors();
+
 void printGlString(const char *name, GLenum s);
 
 GLuint createShader(GLenum shaderType, const char *src);
 
-GLuint createProgram(const char *vtxSrc, const char *fragSrc);
+/** Compile and link a program. If isRetrievable is set, driver is told its binary will be retrieved. */
+GLuint createProgram(const char *vtxSrc, const char *fragSrc, bool isRetrievable = false);
 
 GLuint loadTexture(const GLsizei width, const GLsizei height, const GLenum type, const GLvoid *pixels);
 
+#endif //GLES3_HELPER_H
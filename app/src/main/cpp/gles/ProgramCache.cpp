@@ -0,0 +1,135 @@
+#include "ProgramCache.h"
+#include "../common/JNILogHelper.h"
+#include "cstdio"
+#include "vector"
+
+#define LOG_TAG "ProgramCache"
+
+ProgramCache::ProgramCache(const char *dir) : mDir(dir ? dir : "") {
+    // Some drivers support no binary format at all
+    GLint nbFormats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &nbFormats);
+    mIsSupported = !mDir.empty() && nbFormats > 0;
+    if (!mIsSupported) LOGD("Program binaries are not cached.");
+}
+
+uint64_t ProgramCache::computeKey(const char *vtxSrc, const char *fragSrc) {
+    // FNV-1a over every string, separated by their terminating null
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    auto addString = [&hash](const char *str) {
+        if (!str) str = "";
+        do {
+            hash ^= (uint8_t) *str;
+            hash *= 0x100000001b3ULL;
+        } while (*str++);
+    };
+    addString(vtxSrc);
+    addString(fragSrc);
+    addString((const char *) glGetString(GL_VENDOR));
+    addString((const char *) glGetString(GL_RENDERER));
+    addString((const char *) glGetString(GL_VERSION));
+    return hash;
+}
+
+std::string ProgramCache::getPath(uint64_t key) const {
+    char name[32];
+    snprintf(name, sizeof(name), "/program_%016llx.bin", (unsigned long long) key);
+    return mDir + name;
+}
+
+GLuint ProgramCache::loadProgram(uint64_t key) {
+    std::string path = getPath(key);
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) return 0;
+
+    Header header;
+    std::vector<uint8_t> binary;
+    bool isValid = fread(&header, sizeof(header), 1, file) == 1 &&
+                   header.mMagic == MAGIC && header.mVersion == VERSION && header.mKey == key && header.mLength > 0;
+    if (isValid) {
+        binary.resize(header.mLength);
+        isValid = fread(binary.data(), 1, binary.size(), file) == binary.size();
+    }
+    fclose(file);
+    if (!isValid) {
+        LOGE("Discarding corrupted program binary %s", path.c_str());
+        remove(path.c_str());
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    if (!program) return 0;
+    glProgramBinary(program, header.mBinaryFormat, binary.data(), (GLsizei) binary.size());
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        // Driver changed in a way not covered by key, binary will be replaced
+        LOGD("Program binary rejected by driver.");
+        glDeleteProgram(program);
+        remove(path.c_str());
+        // Clear error raised by rejected binary
+        glGetError();
+        return 0;
+    }
+    return program;
+}
+
+void ProgramCache::storeProgram(uint64_t key, GLuint program) {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+
+    Header header;
+    header.mKey = key;
+    std::vector<uint8_t> binary(length);
+    GLsizei written = 0;
+    GLenum binaryFormat = 0;
+    glGetProgramBinary(program, length, &written, &binaryFormat, binary.data());
+    if (checkGlError("glGetProgramBinary") || written <= 0) return;
+    header.mBinaryFormat = binaryFormat;
+    header.mLength = (uint32_t) written;
+
+    // Write aside then rename, so that a crash never leaves a truncated binary behind
+    std::string path = getPath(key);
+    std::string tmpPath = path + ".tmp";
+    FILE *file = fopen(tmpPath.c_str(), "wb");
+    if (!file) {
+        LOGE("Cannot write program binary %s", tmpPath.c_str());
+        return;
+    }
+    bool isWritten = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                     fwrite(binary.data(), 1, written, file) == (size_t) written;
+    isWritten = fclose(file) == 0 && isWritten;
+    if (!isWritten || rename(tmpPath.c_str(), path.c_str()) != 0) {
+        LOGE("Cannot write program binary %s", path.c_str());
+        remove(tmpPath.c_str());
+    }
+}
+
+GLuint ProgramCache::getProgram(const char *vtxSrc, const char *fragSrc) {
+    if (!mIsSupported) {
+        mNbMisses++;
+        return createProgram(vtxSrc, fragSrc);
+    }
+
+    uint64_t key = computeKey(vtxSrc, fragSrc);
+    GLuint program = loadProgram(key);
+    if (program) {
+        mNbHits++;
+        return program;
+    }
+
+    mNbMisses++;
+    program = createProgram(vtxSrc, fragSrc, true);
+    if (program) storeProgram(key, program);
+    return program;
+}
+
+int ProgramCache::getNbHits() const {
+    return mNbHits;
+}
+
+int ProgramCache::getNbMisses() const {
+    return mNbMisses;
+}
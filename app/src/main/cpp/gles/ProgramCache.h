@@ -0,0 +1,57 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include "GLES3Helper.h"
+#include "string"
+
+/** Stores linked program binaries on disk so that later surfaces skip compiling and linking shaders.
+ * Binaries are keyed by shader sources and driver identity, a driver update simply misses the cache.
+ * Must be used on a thread with a current GL context. */
+class ProgramCache {
+private:
+    static const uint32_t MAGIC = 0x42475250; // "PRGB"
+    static const uint32_t VERSION = 1;
+
+    /** Header written in front of every program binary. */
+    struct Header {
+        uint32_t mMagic = MAGIC;
+        uint32_t mVersion = VERSION;
+        uint64_t mKey = 0;
+        uint32_t mBinaryFormat = 0;
+        uint32_t mLength = 0;
+    };
+
+    std::string mDir;
+    bool mIsSupported = false;
+
+    int mNbHits = 0;
+    int mNbMisses = 0;
+
+private:
+    /** Hash shader sources together with vendor, renderer and version strings of driver. */
+    static uint64_t computeKey(const char *vtxSrc, const char *fragSrc);
+
+    std::string getPath(uint64_t key) const;
+
+    /** Create a program from cached binary.
+     * @return program or 0 if binary is missing or rejected by driver */
+    GLuint loadProgram(uint64_t key);
+
+    /** Write binary of a linked program into cache. Failing to store is not an error. */
+    void storeProgram(uint64_t key, GLuint program);
+
+public:
+    /** Create a cache storing binaries inside given directory, which must exist. */
+    explicit ProgramCache(const char *dir);
+
+    /** Return program linked from given shaders, taken from cache if possible, compiled and cached otherwise.
+     * @return program or 0 if shaders fail to compile or link */
+    GLuint getProgram(const char *vtxSrc, const char *fragSrc);
+
+    int getNbHits() const;
+
+    /** Return number of programs compiled from sources, cache being off or missing them. */
+    int getNbMisses() const;
+};
+
+#endif //PROGRAM_CACHE_H
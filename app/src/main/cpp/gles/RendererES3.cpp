@@ -1,8 +1,11 @@
 #include "RendererES3.h"
 #include "../common/JNILogHelper.h"
+#include "chrono"
 
 #define LOG_TAG "RendererES3"
 
+std::atomic_int RendererES3::sMaxTextureSize = {RendererES3::MIN_MAX_TEXTURE_SIZE};
+
 RendererES3::RendererES3() : mEglContext(eglGetCurrentContext()), mProgram(0) {
     printGlString("Version", GL_VERSION);
     printGlString("Vendor", GL_VENDOR);
@@ -17,81 +20,392 @@ RendererES3::~RendererES3() {
      * If the context exists, it must be current. This only happens when we're
      * cleaning up after a failed init().
      */
-    if (eglGetCurrentContext() != mEglContext) return;
+    bool isContextCurrent = eglGetCurrentContext() == mEglContext;
+    // Pictures still written into unpack buffers are lost either way
+    mUploadPool->deleteBuffers(isContextCurrent);
+    if (!isContextCurrent) return;
     glDeleteProgram(mProgram);
+    glDeleteProgram(mYuvProgram);
 
-    if (mTextureId != 0) glDeleteTextures(1, &mTextureId);
+    for (PlaneTexture &plane : mPlanes) {
+        if (plane.mTextureId != 0) glDeleteTextures(1, &plane.mTextureId);
+    }
     if (mBufferId != 0) glDeleteBuffers(1, &mBufferId);
+    if (mVertexArrayId != 0) glDeleteVertexArrays(1, &mVertexArrayId);
+
+    LOGD("Texture uploads: %lld, written ahead: %lld, from client memory: %lld", (long long) mStats.mNbUploads,
+         (long long) mStats.mNbPrefilledUploads, (long long) mStats.mNbUploadFallbacks);
 }
 
-bool RendererES3::init() {
-    mProgram = createProgram(VERTEX_SHADER, FRAGMENT_SHADER);
+bool RendererES3::init(const char *programCacheDir) {
+    auto startTime = std::chrono::steady_clock::now();
+
+    ProgramCache programCache(programCacheDir);
+    mProgram = programCache.getProgram(VERTEX_SHADER, FRAGMENT_SHADER);
     if (!mProgram) return false;
+    // Explicit uniform locations need GLSL ES 3.10, look them up instead
+    mTexUnitLocation = glGetUniformLocation(mProgram, "uTexUnit");
+
+    mYuvProgram = programCache.getProgram(VERTEX_SHADER, YUV_FRAGMENT_SHADER);
+    if (!mYuvProgram) return false;
+    mYuvUniforms.mTexY = glGetUniformLocation(mYuvProgram, "uTexY");
+    mYuvUniforms.mTexU = glGetUniformLocation(mYuvProgram, "uTexU");
+    mYuvUniforms.mTexV = glGetUniformLocation(mYuvProgram, "uTexV");
+    mYuvUniforms.mIsSemiPlanar = glGetUniformLocation(mYuvProgram, "uIsSemiPlanar");
+    mYuvUniforms.mIsSwapped = glGetUniformLocation(mYuvProgram, "uIsSwapped");
+    mYuvUniforms.mIsWide = glGetUniformLocation(mYuvProgram, "uIsWide");
+    mYuvUniforms.mSampleScale = glGetUniformLocation(mYuvProgram, "uSampleScale");
+    mYuvUniforms.mYuvOffset = glGetUniformLocation(mYuvProgram, "uYuvOffset");
+    mYuvUniforms.mYuvToRgb = glGetUniformLocation(mYuvProgram, "uYuvToRgb");
+
+    // Samplers always read from the texture unit of their plane
+    glUseProgram(mProgram);
+    glUniform1i(mTexUnitLocation, 0);
+    glUseProgram(mYuvProgram);
+    glUniform1i(mYuvUniforms.mTexY, 0);
+    glUniform1i(mYuvUniforms.mTexU, 1);
+    glUniform1i(mYuvUniforms.mTexV, 2);
+    mCurrentProgram = mYuvProgram;
 
-    // Generate texture handler
-    glGenTextures(1, &mTextureId);
+    // Generate texture handlers, storage is allocated on first frame
+    for (PlaneTexture &plane : mPlanes) glGenTextures(1, &plane.mTextureId);
 
     // Generate buffer handler
     mBufferId = createVbo(sizeof(rect), rect, GL_STATIC_DRAW);
 
+    // Record quad layout once, vertex array stays bound for every draw
+    glGenVertexArrays(1, &mVertexArrayId);
+    glBindVertexArray(mVertexArrayId);
+    glBindBuffer(GL_ARRAY_BUFFER, mBufferId);
+    glVertexAttribPointer(POS_ATTRIB, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), BUFFER_OFFSET(0));
+    glVertexAttribPointer(TEX_COORD_ATTRIB, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), BUFFER_OFFSET(2 * sizeof(GLfloat)));
+    glEnableVertexAttribArray(POS_ATTRIB);
+    glEnableVertexAttribArray(TEX_COORD_ATTRIB);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+    GLint maxTextureSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    if (maxTextureSize > 0) sMaxTextureSize = maxTextureSize;
+    LOGV("Max texture size: %d", maxTextureSize);
+
+    mStats.mNbCachedPrograms = programCache.getNbHits();
+    mStats.mNbCompiledPrograms = programCache.getNbMisses();
+    auto initTimeUs = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - startTime).count();
+    LOGD("Renderer initiated in %lldus, cached programs: %d, compiled programs: %d",
+         (long long) initTimeUs, programCache.getNbHits(), programCache.getNbMisses());
+
     LOGV("Using OpenGL ES 3 renderer");
     return true;
 }
 
 void RendererES3::resize(int w, int h) {
-    glViewport(0, 0, w, h);
+    mSurfaceWidth = w;
+    mSurfaceHeight = h;
+    setViewport(0, 0, w, h);
 }
 
-void RendererES3::render(int width, int height, GLenum pixFmt, GLint internalPixFmt, const int linesize, const void *pixels) {
-    if (mTextureId == 0) return;
+void RendererES3::useProgram(GLuint program) {
+    if (program == mCurrentProgram) return;
+    glUseProgram(program);
+    mCurrentProgram = program;
+}
 
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glUseProgram(mProgram);
+void RendererES3::setViewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+    if (x == mViewport[0] && y == mViewport[1] && width == mViewport[2] && height == mViewport[3]) return;
+    glViewport(x, y, width, height);
+    mViewport[0] = x;
+    mViewport[1] = y;
+    mViewport[2] = width;
+    mViewport[3] = height;
+}
 
-    // Select texture unit 0 as the active unit to bind texture
-    glActiveTexture(GL_TEXTURE0);
-    // Set texture draw target
-    glBindTexture(GL_TEXTURE_2D, mTextureId);
-    // Bind the texture to texture unit 0
-    glUniform1i(TEX_UNIT_ATTRIB, 0);
-    // Set up texture attributes
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+int RendererES3::getSurfaceWidth() const {
+    return mSurfaceWidth;
+}
+
+int RendererES3::getSurfaceHeight() const {
+    return mSurfaceHeight;
+}
+
+int RendererES3::getMaxTextureSize() {
+    return sMaxTextureSize;
+}
+
+void RendererES3::setPictureViewport(int width, int height, float sampleAspectRatio) {
+    if (mSurfaceWidth <= 0 || mSurfaceHeight <= 0 || width <= 0 || height <= 0) return;
+    if (sampleAspectRatio <= 0.0f) sampleAspectRatio = 1.0f;
+
+    float pictureAspect = (float) width * sampleAspectRatio / (float) height;
+    float surfaceAspect = (float) mSurfaceWidth / (float) mSurfaceHeight;
+    int viewWidth = mSurfaceWidth, viewHeight = mSurfaceHeight;
+    if (pictureAspect > surfaceAspect) {
+        // Wider than surface, bars on top and bottom
+        viewHeight = (int) lroundf((float) mSurfaceWidth / pictureAspect);
+    } else {
+        // Narrower than surface, bars on left and right
+        viewWidth = (int) lroundf((float) mSurfaceHeight * pictureAspect);
+    }
+    // Surface is already cleared, only the picture area is drawn
+    setViewport((mSurfaceWidth - viewWidth) / 2, (mSurfaceHeight - viewHeight) / 2, viewWidth, viewHeight);
+}
+
+GLenum RendererES3::getSizedInternalPixFmt(GLint internalPixFmt) {
+    switch (internalPixFmt) {
+        case GL_RGB:
+            return GL_RGB8;
+        case GL_RGBA:
+            return GL_RGBA8;
+        default:
+            // Already sized
+            return internalPixFmt;
+    }
+}
+
+void RendererES3::getYuvToRgb(YuvMatrix matrix, bool isFullRange, int bitDepth, GLfloat *yuvToRgb, GLfloat *yuvOffset) {
+    // Luma coefficients of red and blue
+    float kr, kb;
+    switch (matrix) {
+        case YuvMatrix::BT601:
+            kr = 0.299f, kb = 0.114f;
+            break;
+        case YuvMatrix::BT2020:
+            kr = 0.2627f, kb = 0.0593f;
+            break;
+        case YuvMatrix::BT709:
+        default:
+            kr = 0.2126f, kb = 0.0722f;
+            break;
+    }
+    float kg = 1.0f - kr - kb;
+
+    // Offsets and ranges scale with depth, normalize them against max sample value
+    int shift = bitDepth - 8;
+    auto maxValue = (float) ((1 << bitDepth) - 1);
+    float yScale = isFullRange ? 1.0f : maxValue / (float) (219 << shift);
+    float cScale = isFullRange ? 1.0f : maxValue / (float) (224 << shift);
+    yuvOffset[0] = isFullRange ? 0.0f : (float) (16 << shift) / maxValue;
+    yuvOffset[1] = yuvOffset[2] = (float) (128 << shift) / maxValue;
+
+    // Column major, columns are contributions of Y, U and V
+    yuvToRgb[0] = yScale;
+    yuvToRgb[1] = yScale;
+    yuvToRgb[2] = yScale;
+    yuvToRgb[3] = 0.0f;
+    yuvToRgb[4] = -2.0f * kb * (1.0f - kb) / kg * cScale;
+    yuvToRgb[5] = 2.0f * (1.0f - kb) * cScale;
+    yuvToRgb[6] = 2.0f * (1.0f - kr) * cScale;
+    yuvToRgb[7] = -2.0f * kr * (1.0f - kr) / kg * cScale;
+    yuvToRgb[8] = 0.0f;
+}
+
+bool RendererES3::allocateTexture(int plane, int width, int height, GLint internalPixFmt) {
+    PlaneTexture &texture = mPlanes[plane];
+    GLenum sizedPixFmt = getSizedInternalPixFmt(internalPixFmt);
+    if (width == texture.mWidth && height == texture.mHeight && sizedPixFmt == texture.mInternalPixFmt) return true;
+
+    // Immutable storage cannot be resized, start over with a new texture.
+    // Each plane keeps its own texture unit, so the texture stays bound there for drawing.
+    glActiveTexture(GL_TEXTURE0 + plane);
+    if (texture.mTextureId != 0) glDeleteTextures(1, &texture.mTextureId);
+    glGenTextures(1, &texture.mTextureId);
+    glBindTexture(GL_TEXTURE_2D, texture.mTextureId);
+
+    // A single level, frames are drawn at about their size so mipmaps are never sampled
+    glTexStorage2D(GL_TEXTURE_2D, 1, sizedPixFmt, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    if (checkGlError("glTexStorage2D")) {
+        texture.mWidth = texture.mHeight = 0;
+        texture.mInternalPixFmt = GL_NONE;
+        return false;
+    }
+
+    LOGD("Allocated %dx%d texture storage for plane %d", width, height, plane);
+    texture.mWidth = width;
+    texture.mHeight = height;
+    texture.mInternalPixFmt = sizedPixFmt;
+    mUploadedPixels = nullptr;
+    return true;
+}
+
+bool RendererES3::uploadPlanes(const PlaneData *planes, int nbPlanes) {
+    mStats.mNbUploads++;
+    for (int i = 0; i < nbPlanes; i++) {
+        mStats.mNbUploadedBytes += (int64_t) planes[i].mLinesize * planes[i].mHeight;
+    }
+
+    // Producer wrote planes into an unpack buffer ahead, planes are read from it where they are
+    GLsizeiptr offsets[MAX_PLANES];
+    GLsizeiptr baseOffset;
+    int bufferIdx = mUploadPool->bindForUpload(planes[0].mPixels, &baseOffset);
+    if (bufferIdx >= 0) {
+        mStats.mNbPrefilledUploads++;
+        for (int i = 0; i < nbPlanes; i++) {
+            offsets[i] = baseOffset + ((const uint8_t *) planes[i].mPixels - (const uint8_t *) planes[0].mPixels);
+        }
+    } else if (mUploadPool->isUnmapped(planes[0].mPixels)) {
+        LOGE("Picture written into an unpack buffer got lost");
+        return false;
+    } else {
+        // Frame buffers are padded in height, whole lines can be copied. Keep planes aligned inside buffer.
+        GLsizeiptr size = 0;
+        for (int i = 0; i < nbPlanes; i++) {
+            offsets[i] = size;
+            size += ((GLsizeiptr) planes[i].mLinesize * planes[i].mHeight + 15) & ~15;
+        }
+        // Never waits on GPU, pixels are uploaded from client memory if no buffer is mapped
+        int copyIdx = mUploadPool->acquire(size);
+        if (copyIdx >= 0) {
+            uint8_t *ptr = mUploadPool->getPtr(copyIdx);
+            for (int i = 0; i < nbPlanes; i++) {
+                memcpy(ptr + offsets[i], planes[i].mPixels, (size_t) planes[i].mLinesize * planes[i].mHeight);
+            }
+            bufferIdx = mUploadPool->bindForUpload(ptr, &baseOffset);
+            // Buffer is mapped again once GPU is done reading
+            mUploadPool->release(copyIdx);
+        }
+    }
+    if (bufferIdx < 0) mStats.mNbUploadFallbacks++;
+
+    for (int i = 0; i < nbPlanes; i++) {
+        const PlaneData &plane = planes[i];
+        // Texture of plane is already bound to its unit
+        glActiveTexture(GL_TEXTURE0 + i);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, plane.mLinesize / plane.mBytesPerPixel);
+        // From an unpack buffer this returns right away, GPU copies into texture on its own
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, plane.mWidth, plane.mHeight, plane.mPixFmt, GL_UNSIGNED_BYTE,
+                        bufferIdx >= 0 ? BUFFER_OFFSET(offsets[i]) : plane.mPixels);
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+    if (bufferIdx >= 0) mUploadPool->fenceUpload(bufferIdx);
+    return true;
+}
+
+bool RendererES3::preparePlanes(const PlaneData *planes, int nbPlanes, bool isNewFrame) {
+    for (int i = 0; i < nbPlanes; i++) {
+        if (!allocateTexture(i, planes[i].mWidth, planes[i].mHeight, planes[i].mInternalPixFmt)) return false;
+    }
+
+    // Upload only new pictures, a picture presented again is still inside textures
+    if (isNewFrame || planes[0].mPixels != mUploadedPixels) {
+        if (!uploadPlanes(planes, nbPlanes)) return false;
+        mUploadedPixels = planes[0].mPixels;
+    }
+    // Buffers GPU is done with are mapped ahead of next pictures
+    mUploadPool->mapBuffers();
+    return true;
+}
+
+void RendererES3::drawQuad() {
+    // Attributes come from vertex array bound at init
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+
+void RendererES3::render(int width, int height, GLenum pixFmt, GLint internalPixFmt, const int linesize, const void *pixels,
+                         bool isNewFrame, float sampleAspectRatio) {
+    if (mProgram == 0) return;
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    // No picture to draw yet
+    if (!pixels) return;
+    useProgram(mProgram);
+
+    PlaneData plane;
+    plane.mWidth = width;
+    plane.mHeight = height;
+    plane.mPixFmt = pixFmt;
+    plane.mInternalPixFmt = internalPixFmt;
+    plane.mLinesize = linesize;
+    plane.mPixels = pixels;
     // Calculate exact each row size
-    int rowLength = width;
     switch (pixFmt) {
         case GL_RGB:
-            rowLength = linesize / 3;
+            plane.mBytesPerPixel = 3;
             break;
         case GL_RGBA:
-            rowLength = linesize / 4;
+            plane.mBytesPerPixel = 4;
             break;
         default:
             break;
     }
-    glPixelStorei(GL_UNPACK_ROW_LENGTH, rowLength);
-    // Upload the texture into texture unit
-    glTexImage2D(GL_TEXTURE_2D, 0, internalPixFmt, width, height, 0, pixFmt, GL_UNSIGNED_BYTE, pixels);
-    glGenerateMipmap(GL_TEXTURE_2D);
+    if (!preparePlanes(&plane, 1, isNewFrame)) return;
 
-    // Set up texture attributes
-    glBindBuffer(GL_ARRAY_BUFFER, mBufferId);
-    glVertexAttribPointer(POS_ATTRIB, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), BUFFER_OFFSET(0));
-    glVertexAttribPointer(TEX_COORD_ATTRIB, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), BUFFER_OFFSET(2 * sizeof(GLfloat)));
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glEnableVertexAttribArray(POS_ATTRIB);
-    glEnableVertexAttribArray(TEX_COORD_ATTRIB);
+    setPictureViewport(width, height, sampleAspectRatio);
+    drawQuad();
+    checkGlError("RendererES3::render");
+}
 
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+void RendererES3::setYuvUniforms(const YuvPicture &picture) {
+    YuvFormat format;
+    format.mLayout = picture.mLayout;
+    format.mIsSwapped = picture.mIsSwapped;
+    format.mBitDepth = picture.mBitDepth;
+    format.mBitShift = picture.mBitShift;
+    format.mMatrix = picture.mMatrix;
+    format.mIsFullRange = picture.mIsFullRange;
+    if (format == mYuvFormat) return;
+    mYuvFormat = format;
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    checkGlError("RendererES3::render");
+    GLfloat yuvToRgb[9];
+    GLfloat yuvOffset[3];
+    getYuvToRgb(picture.mMatrix, picture.mIsFullRange, picture.mBitDepth, yuvToRgb, yuvOffset);
+
+    glUniform1i(mYuvUniforms.mIsSemiPlanar, picture.mLayout == YuvLayout::SEMI_PLANAR);
+    glUniform1i(mYuvUniforms.mIsSwapped, picture.mIsSwapped);
+    glUniform1i(mYuvUniforms.mIsWide, picture.mBitDepth > 8);
+    glUniform1f(mYuvUniforms.mSampleScale, 1.0f / (float) (((1 << picture.mBitDepth) - 1) << picture.mBitShift));
+    glUniform3fv(mYuvUniforms.mYuvOffset, 1, yuvOffset);
+    glUniformMatrix3fv(mYuvUniforms.mYuvToRgb, 1, GL_FALSE, yuvToRgb);
+}
+
+void RendererES3::renderYuv(const YuvPicture &picture, bool isNewFrame) {
+    if (mYuvProgram == 0) return;
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    // No picture to draw yet
+    if (!picture.mData[0]) return;
+    useProgram(mYuvProgram);
+
+    bool isWide = picture.mBitDepth > 8;
+    bool isSemiPlanar = picture.mLayout == YuvLayout::SEMI_PLANAR;
+    int bytesPerSample = isWide ? 2 : 1;
+    int nbPlanes = isSemiPlanar ? 2 : 3;
+
+    // Wide samples take two 8 bit channels, interleaved chroma takes twice as many
+    PlaneData planes[MAX_PLANES];
+    for (int i = 0; i < nbPlanes; i++) {
+        PlaneData &plane = planes[i];
+        int nbChannels = (i > 0 && isSemiPlanar) ? 2 * bytesPerSample : bytesPerSample;
+        plane.mWidth = i == 0 ? picture.mWidth : picture.mChromaWidth;
+        plane.mHeight = i == 0 ? picture.mHeight : picture.mChromaHeight;
+        plane.mBytesPerPixel = nbChannels;
+        plane.mPixFmt = nbChannels == 1 ? GL_RED : nbChannels == 2 ? GL_RG : GL_RGBA;
+        plane.mInternalPixFmt = nbChannels == 1 ? GL_R8 : nbChannels == 2 ? GL_RG8 : GL_RGBA8;
+        plane.mLinesize = picture.mLinesize[i];
+        plane.mPixels = picture.mData[i];
+    }
+    if (!preparePlanes(planes, nbPlanes, isNewFrame)) return;
+    setYuvUniforms(picture);
+
+    setPictureViewport(picture.mWidth, picture.mHeight, picture.mSampleAspectRatio);
+    drawQuad();
+    checkGlError("RendererES3::renderYuv");
 }
 
 void RendererES3::clearSurface() {
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-}
\ No newline at end of file
+}
+
+RendererStats RendererES3::getStats() const {
+    return mStats;
+}
+
+std::shared_ptr<UploadBufferPool> RendererES3::getUploadPool() const {
+    return mUploadPool;
+}
@@ -1,15 +1,18 @@
+#ifndef RENDERER_ES3_H
+#define RENDERER_ES3_H
+
 #include <math.h>
 #include "GLES3Helper.h"
+#include "ProgramCache.h"
+#include "UploadBufferPool.h"
+#include "atomic"
+#include "memory"
 
 #define STR(s) #s
 #define STRV(s) STR(s)
 
 #define POS_ATTRIB 0
 #define TEX_COORD_ATTRIB 1
-#define TEX_UNIT_ATTRIB 2
-#define Y_ATTRIB 3
-#define U_ATTRIB 4
-#define V_ATTRIB 5
 
 // position X, Y, texture S, T
 static const float rect[] = {-1.0f, -1.0f, 0.0f, 0.0f,
@@ -35,49 +38,231 @@ static const char FRAGMENT_SHADER[] =
         "#version 300 es\n"
         "precision mediump float;\n"
         "in vec2 vTexCoord;\n"
-        "layout (location = " STRV(TEX_UNIT_ATTRIB) ") uniform sampler2D uTexUnit;\n"
+        "uniform sampler2D uTexUnit;\n"
         "out vec4 colorOut;\n"
         "void main() {\n"
         "   colorOut = texture(uTexUnit, vTexCoord);\n"
         "}\n";
-//        "layout (location = " STRV(Y_ATTRIB) " ) uniform sampler2D samplerY;\n"
-//        "layout (location = " STRV(U_ATTRIB) " ) uniform sampler2D samplerU;\n"
-//        "layout (location = " STRV(V_ATTRIB) " ) uniform sampler2D samplerV;\n"
-//        "out vec4 colorOut;\n"
-//        "void main() {\n"
-//        "   vec3 yuv;\n"
-//        "   vec3 rgb;\n"
-//        "   yuv.r = texture(samplerY, vTexCoord).g;\n"
-//        "   yuv.g = texture(samplerU, vTexCoord).g - 0.5;\n"
-//        "   yuv.b = texture(samplerV, vTexCoord).g - 0.5;\n"
-//        "   rgb = mat3(1.0, 1.0, 1.0,\n"
-//        "              0.0, -0.39465, 2.03211,\n"
-//        "              1.13983, -0.5806, 0.0) * yuv;\n"
-//        "   colorOut = vec4(rgb, 1.0);\n"
-//        "}\n";
+
+// Samples of wide pictures are 16 bit little endian, uploaded as two 8 bit channels and put back together here.
+// Linear filtering each byte separately gives the same result as filtering whole samples.
+static const char YUV_FRAGMENT_SHADER[] =
+        "#version 300 es\n"
+        "precision highp float;\n"
+        "in vec2 vTexCoord;\n"
+        "uniform sampler2D uTexY;\n"
+        "uniform sampler2D uTexU;\n"
+        "uniform sampler2D uTexV;\n"
+        "uniform bool uIsSemiPlanar;\n"         // Chroma interleaved inside uTexU, as in NV12
+        "uniform bool uIsSwapped;\n"            // V stored before U, as in NV21
+        "uniform bool uIsWide;\n"               // Samples split into two 8 bit channels
+        "uniform float uSampleScale;\n"         // Normalize a put back together wide sample
+        "uniform vec3 uYuvOffset;\n"
+        "uniform mat3 uYuvToRgb;\n"
+        "out vec4 colorOut;\n"
+        "float wide(vec2 s) {\n"
+        "   return (s.x * 255.0 + s.y * 65280.0) * uSampleScale;\n"
+        "}\n"
+        "void main() {\n"
+        "   vec3 yuv;\n"
+        "   vec4 y = texture(uTexY, vTexCoord);\n"
+        "   vec4 u = texture(uTexU, vTexCoord);\n"
+        "   vec4 v = uIsSemiPlanar ? u : texture(uTexV, vTexCoord);\n"
+        "   if (uIsWide) {\n"
+        "       yuv = vec3(wide(y.rg), wide(u.rg), uIsSemiPlanar ? wide(u.ba) : wide(v.rg));\n"
+        "   } else {\n"
+        "       yuv = vec3(y.r, u.r, uIsSemiPlanar ? u.g : v.r);\n"
+        "   }\n"
+        "   if (uIsSwapped) yuv.yz = yuv.zy;\n"
+        "   colorOut = vec4(clamp(uYuvToRgb * (yuv - uYuvOffset), 0.0, 1.0), 1.0);\n"
+        "}\n";
+
+/** How chroma planes of a YUV picture are stored. */
+enum class YuvLayout {
+    PLANAR, // Y, U and V in separate planes
+    SEMI_PLANAR // Y plane followed by a plane of interleaved U and V
+};
+
+/** Color matrix to convert YUV samples into RGB. */
+enum class YuvMatrix {
+    BT601, BT709, BT2020
+};
+
+/** A YUV picture to be drawn. Planes are not copied, they must stay valid while drawing. */
+struct YuvPicture {
+    YuvLayout mLayout = YuvLayout::PLANAR;
+    bool mIsSwapped = false; // V stored before U, as in NV21
+    int mWidth = 0, mHeight = 0;
+    int mChromaWidth = 0, mChromaHeight = 0;
+    int mBitDepth = 8; // Pictures deeper than 8 bit have 16 bit little endian samples
+    int mBitShift = 0; // How far samples are shifted from lowest bit, as in P010
+    YuvMatrix mMatrix = YuvMatrix::BT709;
+    bool mIsFullRange = false;
+    float mSampleAspectRatio = 1.0f; // Width of a pixel relative to its height
+    const uint8_t *mData[3] = {};
+    int mLinesize[3] = {};
+};
+
+/** Upload and startup counters of a renderer. */
+struct RendererStats {
+    int mNbCachedPrograms = 0; // Programs of last init() taken from binaries in program cache
+    int mNbCompiledPrograms = 0; // Programs of last init() compiled and linked from shader sources
+    int64_t mNbUploads = 0; // Pictures uploaded into textures
+    int64_t mNbUploadFallbacks = 0; // Uploads done from client memory because no unpack buffer was mapped
+    int64_t mNbPrefilledUploads = 0; // Uploads from unpack buffers pictures were written into before drawing
+    int64_t mNbUploadedBytes = 0; // Bytes of every uploaded plane, padding of lines included
+};
 
 class RendererES3 {
 protected:
+    /** Pixels of a single texture to upload. */
+    struct PlaneData {
+        int mWidth = 0, mHeight = 0; // Size in texels
+        GLenum mPixFmt = GL_RED;
+        GLint mInternalPixFmt = GL_R8;
+        int mBytesPerPixel = 1;
+        int mLinesize = 0;
+        const void *mPixels = nullptr;
+    };
+
+    /** A texture with its immutable storage. */
+    struct PlaneTexture {
+        GLuint mTextureId = 0;
+        int mWidth = 0, mHeight = 0;
+        GLenum mInternalPixFmt = GL_NONE;
+    };
+
+    /** Picture properties YUV program uniforms were last set for. */
+    struct YuvFormat {
+        YuvLayout mLayout = YuvLayout::PLANAR;
+        bool mIsSwapped = false;
+        int mBitDepth = 0, mBitShift = 0;
+        YuvMatrix mMatrix = YuvMatrix::BT709;
+        bool mIsFullRange = false;
+
+        bool operator==(const YuvFormat &other) const {
+            return mLayout == other.mLayout && mIsSwapped == other.mIsSwapped && mBitDepth == other.mBitDepth &&
+                   mBitShift == other.mBitShift && mMatrix == other.mMatrix && mIsFullRange == other.mIsFullRange;
+        }
+    };
+
+    /** Uniform locations of YUV program. */
+    struct YuvUniforms {
+        GLint mTexY = -1, mTexU = -1, mTexV = -1;
+        GLint mIsSemiPlanar = -1, mIsSwapped = -1, mIsWide = -1;
+        GLint mSampleScale = -1, mYuvOffset = -1, mYuvToRgb = -1;
+    };
+
+    static const int MAX_PLANES = 3;
+
+    // Texture size every GLES 3.0 device supports, used until a renderer queried the real limit
+    static const int MIN_MAX_TEXTURE_SIZE = 2048;
+    // Largest texture size of device, shared since frames are prepared before a renderer exists
+    static std::atomic_int sMaxTextureSize;
+
     EGLContext mEglContext;
     GLuint mProgram;
+    GLint mTexUnitLocation = -1;
+    GLuint mYuvProgram = 0;
+    YuvUniforms mYuvUniforms;
+    YuvFormat mYuvFormat; // Format YUV uniforms are set for, bit depth 0 until set
+
+    // GL state is only changed when it differs from what was last set {
+    GLuint mCurrentProgram = 0;
+    GLint mViewport[4] = {};
+    // } GL state
+
+    // Vertex array holding quad buffer and attribute layout
+    GLuint mVertexArrayId = 0;
 
     // Buffer handler
     GLuint mBufferId;
 
-    // Texture handler
-    GLuint mTextureId = 0;
+    // Surface size, pictures are scaled into it keeping their aspect ratio
+    int mSurfaceWidth = 0, mSurfaceHeight = 0;
+
+    // Texture of each plane, RGB pictures only use the first one
+    PlaneTexture mPlanes[MAX_PLANES];
+
+    // Pixels last uploaded into textures, null if textures hold no picture yet
+    const void *mUploadedPixels = nullptr;
+
+    // Pixel unpack buffers textures are uploaded from, filled by producers ahead or copied into on drawing
+    std::shared_ptr<UploadBufferPool> mUploadPool = std::make_shared<UploadBufferPool>();
+    RendererStats mStats;
+
+private:
+    /** Make sure texture of plane has storage of given size and format, storage is reallocated only if they change.
+     * @return true if texture storage is ready */
+    bool allocateTexture(int plane, int width, int height, GLint internalPixFmt);
+
+    /** Upload every plane into its texture. Planes written into an unpack buffer of the pool are read from it as
+     * they are, other planes are copied into a mapped unpack buffer if one is available.
+     * @return false if planes were written into an unpack buffer whose content got lost */
+    bool uploadPlanes(const PlaneData *planes, int nbPlanes);
+
+    /** Allocate plane textures and upload planes into them if picture is new, then bind them to texture units.
+     * @return true if textures are ready to be drawn */
+    bool preparePlanes(const PlaneData *planes, int nbPlanes, bool isNewFrame);
+
+    /** Set viewport to the largest centered area of surface with picture aspect ratio, leaving black bars around. */
+    void setPictureViewport(int width, int height, float sampleAspectRatio);
+
+    /** Use program if it is not in use already. */
+    void useProgram(GLuint program);
+
+    /** Set viewport if it differs from current one. */
+    void setViewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+    /** Set YUV program uniforms for picture, only if its format differs from previous picture. */
+    void setYuvUniforms(const YuvPicture &picture);
+
+    /** Draw the full viewport quad with program in use. */
+    void drawQuad();
 
 public:
     RendererES3();
 
     ~RendererES3();
 
-    bool init();
+    /** Create programs and GL objects. Programs are taken from binaries cached in programCacheDir,
+     * compiled and stored there on first run. No caching if programCacheDir is null. */
+    bool init(const char *programCacheDir = nullptr);
 
     void resize(int w, int h);
 
-    void render(int width, int height, GLenum pixFmt, GLint internalPixFmt, const int linesize, const void *pixels);
+    int getSurfaceWidth() const;
+
+    int getSurfaceHeight() const;
+
+    /** Return sized internal format required by immutable storage for given internal format. */
+    static GLenum getSizedInternalPixFmt(GLint internalPixFmt);
+
+    /** Return largest texture width and height device supports.
+     * Before any renderer is initiated, this is the minimum every GLES 3.0 device supports. */
+    static int getMaxTextureSize();
+
+    /** Compute matrix and offset converting normalized YUV samples of given depth into RGB.
+     * CPU conversion uses it too, so both paths give the same colors. */
+    static void getYuvToRgb(YuvMatrix matrix, bool isFullRange, int bitDepth, GLfloat *yuvToRgb, GLfloat *yuvOffset);
+
+    /** Draw a picture on surface, scaled by GPU to fit surface and letterboxed.
+     * Pixels are uploaded into texture only if isNewFrame is set,
+     * or if texture does not hold these pixels already, otherwise texture is drawn as is. */
+    void render(int width, int height, GLenum pixFmt, GLint internalPixFmt, const int linesize, const void *pixels,
+                bool isNewFrame = true, float sampleAspectRatio = 1.0f);
+
+    /** Draw a YUV picture on surface, converting it into RGB while sampling.
+     * Planes are uploaded under the same conditions as render(). */
+    void renderYuv(const YuvPicture &picture, bool isNewFrame = true);
 
     void clearSurface();
+
+    RendererStats getStats() const;
+
+    /** Return pool of unpack buffers this renderer uploads from, pictures written into its buffers from any thread
+     * are drawn without copying them on rendering thread. Buffers are mapped ahead on every draw. */
+    std::shared_ptr<UploadBufferPool> getUploadPool() const;
 };
 
+#endif //RENDERER_ES3_H
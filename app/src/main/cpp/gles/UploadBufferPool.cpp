@@ -0,0 +1,140 @@
+#include "UploadBufferPool.h"
+#include "../common/JNILogHelper.h"
+
+#define LOG_TAG "UploadBufferPool"
+
+int UploadBufferPool::findBuffer(const void *ptr, bool isMapped) {
+    auto *bytes = (const uint8_t *) ptr;
+    for (int i = 0; i < NB_BUFFERS; i++) {
+        const Buffer &buffer = mBuffers[i];
+        if (!buffer.mIsHeld || buffer.mIsMapped != isMapped || !buffer.mPtr) continue;
+        if (bytes >= buffer.mPtr && bytes < buffer.mPtr + buffer.mSize) return i;
+    }
+    return -1;
+}
+
+int UploadBufferPool::acquire(GLsizeiptr size) {
+    std::unique_lock<std::mutex> lck(mMutex);
+    if (mIsLost) return -1;
+    for (int i = 0; i < NB_BUFFERS; i++) {
+        Buffer &buffer = mBuffers[i];
+        if (buffer.mIsHeld || !buffer.mIsMapped || buffer.mSize < size) continue;
+        buffer.mIsHeld = true;
+        return i;
+    }
+    // Buffers of this size are mapped on next draw
+    if (size > mRequestedSize) mRequestedSize = size;
+    return -1;
+}
+
+uint8_t *UploadBufferPool::getPtr(int index) {
+    std::unique_lock<std::mutex> lck(mMutex);
+    return mBuffers[index].mPtr;
+}
+
+void UploadBufferPool::release(int index) {
+    std::unique_lock<std::mutex> lck(mMutex);
+    // A buffer still mapped is free to be written again right away
+    mBuffers[index].mIsHeld = false;
+}
+
+bool UploadBufferPool::isLost() {
+    std::unique_lock<std::mutex> lck(mMutex);
+    return mIsLost;
+}
+
+void UploadBufferPool::mapBuffers() {
+    std::unique_lock<std::mutex> lck(mMutex);
+    if (mIsLost || mRequestedSize == 0) return;
+
+    bool isBound = false;
+    for (Buffer &buffer : mBuffers) {
+        if (buffer.mIsHeld || (buffer.mIsMapped && buffer.mSize >= mRequestedSize)) continue;
+
+        // GPU may still be reading, buffer is mapped again on a later draw
+        if (buffer.mFence) {
+            GLenum status = glClientWaitSync(buffer.mFence, 0, 0);
+            if (status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED) continue;
+            glDeleteSync(buffer.mFence);
+            buffer.mFence = nullptr;
+        }
+
+        if (buffer.mBufferId == 0) glGenBuffers(1, &buffer.mBufferId);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.mBufferId);
+        isBound = true;
+        if (buffer.mIsMapped) {
+            // Too small for pictures now written, content does not matter
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            buffer.mIsMapped = false;
+            buffer.mPtr = nullptr;
+        }
+        if (buffer.mSize < mRequestedSize) {
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, mRequestedSize, nullptr, GL_STREAM_DRAW);
+            if (checkGlError("glBufferData")) {
+                buffer.mSize = 0;
+                continue;
+            }
+            LOGD("Allocated unpack buffer of %ld bytes", (long) mRequestedSize);
+            buffer.mSize = mRequestedSize;
+        }
+
+        // Buffer is known idle, no need for driver to synchronize or keep old content
+        buffer.mPtr = (uint8_t *) glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, buffer.mSize,
+                                                   GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT |
+                                                   GL_MAP_UNSYNCHRONIZED_BIT);
+        buffer.mIsMapped = buffer.mPtr != nullptr;
+        if (!buffer.mIsMapped) checkGlError("glMapBufferRange");
+    }
+    if (isBound) glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+int UploadBufferPool::bindForUpload(const void *pixels, GLsizeiptr *offset) {
+    std::unique_lock<std::mutex> lck(mMutex);
+    if (mIsLost) return -1;
+    int index = findBuffer(pixels, true);
+    if (index < 0) return -1;
+
+    Buffer &buffer = mBuffers[index];
+    *offset = (const uint8_t *) pixels - buffer.mPtr;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.mBufferId);
+    buffer.mIsMapped = false;
+    if (!glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER)) {
+        // Content got lost, pixels cannot be read anymore
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return -1;
+    }
+    return index;
+}
+
+bool UploadBufferPool::isUnmapped(const void *pixels) {
+    std::unique_lock<std::mutex> lck(mMutex);
+    // Buffers of a lost pool are all unmapped
+    return findBuffer(pixels, false) >= 0;
+}
+
+void UploadBufferPool::fenceUpload(int index) {
+    std::unique_lock<std::mutex> lck(mMutex);
+    Buffer &buffer = mBuffers[index];
+    if (buffer.mFence) glDeleteSync(buffer.mFence);
+    buffer.mFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void UploadBufferPool::deleteBuffers(bool isContextCurrent) {
+    std::unique_lock<std::mutex> lck(mMutex);
+    mIsLost = true;
+    for (Buffer &buffer : mBuffers) {
+        if (isContextCurrent) {
+            if (buffer.mFence) glDeleteSync(buffer.mFence);
+            if (buffer.mIsMapped) {
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.mBufferId);
+                glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            }
+            if (buffer.mBufferId != 0) glDeleteBuffers(1, &buffer.mBufferId);
+        }
+        buffer.mFence = nullptr;
+        buffer.mBufferId = 0;
+        buffer.mIsMapped = false;
+    }
+    if (isContextCurrent) glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
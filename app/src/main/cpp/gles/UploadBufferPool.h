@@ -0,0 +1,72 @@
+#ifndef UPLOAD_BUFFER_POOL_H
+#define UPLOAD_BUFFER_POOL_H
+
+#include "GLES3Helper.h"
+#include "mutex"
+
+/** Pixel unpack buffers mapped ahead by rendering thread, so that pictures can be written into them from any thread
+ * before they are drawn. A drawn buffer is unmapped and textures are read from it by GPU without copying pixels.
+ * Buffers go back to the pool once released by their writer and read by GPU, they are then mapped again.
+ * Methods marked GL thread must be called with the context of the pool current, others may be called from any thread.
+ * Pool outlives its renderer as long as buffers are held, memory of held buffers is lost with the renderer. */
+class UploadBufferPool {
+public:
+    static const int NB_BUFFERS = 4;
+
+private:
+    /** A buffer with its mapping. */
+    struct Buffer {
+        GLuint mBufferId = 0;
+        GLsizeiptr mSize = 0;
+        uint8_t *mPtr = nullptr; // Mapped memory, also kept while held after unmapping to find buffer of pixels
+        bool mIsMapped = false;
+        bool mIsHeld = false; // Acquired and not released yet
+        GLsync mFence = nullptr; // Signaled once GPU is done reading from buffer
+    };
+
+    std::mutex mMutex;
+    Buffer mBuffers[NB_BUFFERS];
+    // Largest size acquired, buffers smaller than this are reallocated when they are mapped again
+    GLsizeiptr mRequestedSize = 0;
+    // Buffers got deleted with their renderer, memory of held ones is gone
+    bool mIsLost = false;
+
+private:
+    /** Return index of held buffer, mapped or not as asked, whose memory holds ptr, -1 if none. */
+    int findBuffer(const void *ptr, bool isMapped);
+
+public:
+    /** Take a mapped buffer of at least size bytes for writing, from any thread.
+     * @return index of buffer, -1 if none is mapped yet, a later mapBuffers() maps one of that size */
+    int acquire(GLsizeiptr size);
+
+    /** Return mapped memory of an acquired buffer. */
+    uint8_t *getPtr(int index);
+
+    /** Give an acquired buffer back, from any thread. It is mapped again once GPU is done reading from it. */
+    void release(int index);
+
+    /** Return true if buffers were deleted with their renderer, pixels written into them are gone. */
+    bool isLost();
+
+    /** GL thread. Map every free buffer GPU is done reading from, never waiting on GPU.
+     * Buffers too small for the largest size acquired so far are reallocated first. */
+    void mapBuffers();
+
+    /** GL thread. Find the held buffer pixels were written into, unmap it and bind it for unpacking.
+     * @param offset receives offset of pixels inside buffer
+     * @return index of buffer, -1 if pixels are not inside a mapped buffer or content of buffer got lost */
+    int bindForUpload(const void *pixels, GLsizeiptr *offset);
+
+    /** Return true if pixels are inside a held buffer that is not mapped anymore, they cannot be read again. */
+    bool isUnmapped(const void *pixels);
+
+    /** GL thread. Mark point after which GPU is done reading buffer bound by bindForUpload() and unbind it. */
+    void fenceUpload(int index);
+
+    /** GL thread. Delete every buffer, held buffers are lost. Pool then never gives buffers anymore.
+     * @param isContextCurrent false if context is already destroyed, buffers went with it */
+    void deleteBuffers(bool isContextCurrent);
+};
+
+#endif //UPLOAD_BUFFER_POOL_H
@@ -0,0 +1,23 @@
+#ifndef HOST_COMPAT_H
+#define HOST_COMPAT_H
+
+// Included in front of every source of a host build.
+// FFmpeg string macros take the address of a compound literal, which clang accepts in C++ but GCC does not.
+// Same macros on top of a stack buffer instead, it lives until the calling function returns.
+
+extern "C" {
+#include "libavutil/error.h"
+#include "libavutil/timestamp.h"
+}
+
+#undef av_err2str
+#define av_err2str(errnum) \
+    av_make_error_string((char *) __builtin_alloca(AV_ERROR_MAX_STRING_SIZE), AV_ERROR_MAX_STRING_SIZE, errnum)
+
+#undef av_ts2str
+#define av_ts2str(ts) av_ts_make_string((char *) __builtin_alloca(AV_TS_MAX_STRING_SIZE), ts)
+
+#undef av_ts2timestr
+#define av_ts2timestr(ts, tb) av_ts_make_time_string((char *) __builtin_alloca(AV_TS_MAX_STRING_SIZE), ts, tb)
+
+#endif //HOST_COMPAT_H
@@ -0,0 +1,55 @@
+# Dependencies of a host build: FFmpeg 5 libraries of the host and a desktop EGL/GLES driver, such as Mesa.
+# Sources are built against vendored FFmpeg headers, host libraries must share their major versions.
+# VIDEOSTREAMER_HOST_DEPS_FOUND is set if everything was found, host targets are skipped otherwise.
+
+set(FFMPEG_HOST_LIB_DIR "" CACHE PATH "Directory holding host FFmpeg 5 libraries, pkg-config is used if empty")
+
+find_package(PkgConfig)
+set(VIDEOSTREAMER_HOST_DEPS_FOUND FALSE)
+set(FFMPEG_HOST_LIBS avutil avcodec avformat swscale swresample)
+
+if (FFMPEG_HOST_LIB_DIR)
+    foreach (lib ${FFMPEG_HOST_LIBS})
+        find_library(FFMPEG_HOST_${lib} NAMES ${lib} PATHS ${FFMPEG_HOST_LIB_DIR} NO_DEFAULT_PATH)
+        if (NOT FFMPEG_HOST_${lib})
+            message(STATUS "Host build skipped, lib${lib} not found in ${FFMPEG_HOST_LIB_DIR}")
+            return()
+        endif ()
+        add_library(${lib} SHARED IMPORTED)
+        set_target_properties(${lib} PROPERTIES IMPORTED_LOCATION ${FFMPEG_HOST_${lib}})
+    endforeach ()
+    # Libraries of a custom directory load each other from there, RPATH applies to them unlike RUNPATH
+    add_link_options(-Wl,--disable-new-dtags)
+elseif (PKG_CONFIG_FOUND)
+    pkg_check_modules(FFMPEG_HOST IMPORTED_TARGET
+            libavutil>=57 libavcodec>=59 libavformat>=59 libswscale>=6 libswresample>=4)
+    if (NOT FFMPEG_HOST_FOUND OR NOT FFMPEG_HOST_libavcodec_VERSION MATCHES "^59\\.")
+        message(STATUS "Host build skipped, FFmpeg 5 not found, set FFMPEG_HOST_LIB_DIR to its libraries")
+        return()
+    endif ()
+    foreach (lib ${FFMPEG_HOST_LIBS})
+        add_library(${lib} INTERFACE IMPORTED)
+        target_link_libraries(${lib} INTERFACE PkgConfig::FFMPEG_HOST)
+    endforeach ()
+else ()
+    message(STATUS "Host build skipped, no pkg-config to find FFmpeg, set FFMPEG_HOST_LIB_DIR to its libraries")
+    return()
+endif ()
+
+if (NOT PKG_CONFIG_FOUND)
+    message(STATUS "Host build skipped, no pkg-config to find EGL and GLES")
+    return()
+endif ()
+pkg_check_modules(EGL IMPORTED_TARGET egl)
+pkg_check_modules(GLES IMPORTED_TARGET glesv2)
+if (NOT EGL_FOUND OR NOT GLES_FOUND)
+    message(STATUS "Host build skipped, EGL or GLES development files not found")
+    return()
+endif ()
+
+include_directories(${ffmpeg_DIR}/lib/x86_64/include)
+# GCC rejects the compound literals some FFmpeg macros are made of, see HostCompat.h
+add_compile_options(-include ${CMAKE_CURRENT_LIST_DIR}/HostCompat.h)
+add_compile_definitions(__STDC_CONSTANT_MACROS)
+
+set(VIDEOSTREAMER_HOST_DEPS_FOUND TRUE)
@@ -0,0 +1,108 @@
+// Audio path played in real time through a virtual output, as on a device: a decoding thread feeds sine frames to
+// an audio streamer while the output thread pulls bursts on wall clock deadlines. Reports underruns of the output and
+// of the streamer, time spent in callbacks, drift of output and of audio master clock against wall clock, and
+// offset of master clock from the position heard. Measures start after a warmup, once buffer size settled.
+// Buffer starts at two bursts and grows on every output underrun, so the first ones are expected on a busy host.
+//
+// Options: --seconds per configuration.
+
+#include "HostTest.h"
+#include "AudioStreamerBuilder.h"
+#include "VirtualAudioOutput.h"
+#include "SyntheticAudio.h"
+#include "atomic"
+#include "cmath"
+#include "thread"
+
+static const int FRAME_SIZE = 1024;
+static const int64_t WARMUP_MS = 500;
+// Master clock is checked against output this often
+static const int64_t PROBE_PERIOD_MS = 10;
+
+static void runOutput(int srcSampleRate, int framesPerBurst, int64_t seconds) {
+    static const int SAMPLE_RATE = 48000;
+    MediaClock clock(ClockMode::AUDIO_MASTER);
+    // Streamer owns output, it stays valid until streamer is deleted
+    auto *output = new VirtualAudioOutput(VirtualClockMode::REAL_TIME);
+    AudioStreamerBuilder builder;
+    builder.setAudioTimeBase(av_make_q(1, srcSampleRate))
+            ->setSrcSampleRate(srcSampleRate)
+            ->setSrcChannelLayout(AV_CH_LAYOUT_STEREO)
+            ->setSrcNbSamples(FRAME_SIZE)
+            ->setSrcSampleFmt(AV_SAMPLE_FMT_FLTP)
+            ->setSampleRate(SAMPLE_RATE)
+            ->setChannelLayout(AV_CH_LAYOUT_STEREO)
+            ->setSampleFmt(AV_SAMPLE_FMT_S16)
+            ->setFramesPerBurst(framesPerBurst)
+            ->setAudioOutput(output)
+            ->setAudioClock(&clock);
+    AudioStreamer *streamer = builder.buildAudioStreamer();
+    REQUIRE(streamer);
+
+    SyntheticAudio audio;
+    REQUIRE(audio.init(srcSampleRate, FRAME_SIZE, 440.0));
+    std::atomic_bool isStopped = {false};
+    std::thread feeder(&SyntheticAudio::run, &audio, streamer, &isStopped);
+    std::this_thread::sleep_for(std::chrono::milliseconds(WARMUP_MS));
+
+    VirtualAudioOutputStats startOutputStats = output->getStats();
+    AudioStreamerStats startStats = streamer->getStats();
+    int64_t startNs = getWallTimeNs();
+    int64_t startClockUs = clock.getTimeUs(getMonotonicTimeNs());
+
+    // Master clock against position heard: samples taken out of streamer minus those still buffered by output.
+    // Silence played on underruns is not stream time. Position moves once per burst while clock moves on in between,
+    // so offset averages about minus half a burst.
+    double offsetSumUs = 0;
+    int64_t maxOffsetUs = 0;
+    int nbProbes = 0;
+    int64_t endNs = startNs + seconds * 1000000000;
+    while (getWallTimeNs() < endNs) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(PROBE_PERIOD_MS));
+        int64_t clockUs = clock.getTimeUs(getMonotonicTimeNs());
+        int64_t playedUs = streamer->getStats().mNbSamplesPlayed * 1000000 / SAMPLE_RATE;
+        int64_t heardUs = playedUs - output->getLatencyMs() * 1000;
+        int64_t offsetUs = clockUs - heardUs;
+        offsetSumUs += (double) offsetUs;
+        if (llabs(offsetUs) > llabs(maxOffsetUs)) maxOffsetUs = offsetUs;
+        nbProbes++;
+    }
+    int64_t wallUs = (getWallTimeNs() - startNs) / 1000;
+    int64_t clockUs = clock.getTimeUs(getMonotonicTimeNs()) - startClockUs;
+    VirtualAudioOutputStats outputStats = output->getStats();
+    AudioStreamerStats stats = streamer->getStats();
+    AudioBufferStats bufferStats = streamer->getBufferStats();
+
+    isStopped = true;
+    feeder.join();
+    delete streamer;
+
+    int64_t nbCallbacks = outputStats.mNbCallbacks - startOutputStats.mNbCallbacks;
+    int64_t outputUs = (outputStats.mNbSamples - startOutputStats.mNbSamples) * 1000000 / SAMPLE_RATE;
+    int64_t nbUnderruns = stats.mNbUnderruns - startStats.mNbUnderruns;
+    double avgOffsetUs = offsetSumUs / nbProbes;
+    printf("%5d Hz, burst %3d: output underruns %lld (%lld in warmup), late bursts %lld, streamer underruns %lld, "
+           "buffer %d samples\n", srcSampleRate, framesPerBurst,
+           (long long) (outputStats.mNbXRuns - startOutputStats.mNbXRuns), (long long) startOutputStats.mNbXRuns,
+           (long long) (outputStats.mNbLateBursts - startOutputStats.mNbLateBursts), (long long) nbUnderruns,
+           bufferStats.mBufferSize);
+    printf("%5d Hz, burst %3d: callback avg %6.1f us max %6lld us, output drift %+8.0f ppm, clock drift %+8.0f ppm, "
+           "clock offset avg %+7.0f us max %+7lld us\n", srcSampleRate, framesPerBurst,
+           (double) (outputStats.mTotalCallbackUs - startOutputStats.mTotalCallbackUs) / (double) nbCallbacks,
+           (long long) outputStats.mMaxCallbackUs, (double) (outputUs - wallUs) * 1e6 / (double) wallUs,
+           (double) (clockUs - wallUs) * 1e6 / (double) wallUs, avgOffsetUs, (long long) maxOffsetUs);
+
+    // Decoding thread always keeps up, master clock follows what is heard within a burst and some scheduling delay
+    CHECK(nbCallbacks > 0);
+    CHECK(nbUnderruns == 0);
+    CHECK(fabs(avgOffsetUs) < (double) framesPerBurst * 1000000 / SAMPLE_RATE + 5000);
+}
+
+int main(int argc, char **argv) {
+    int64_t seconds = getIntOption(argc, argv, "seconds", 10);
+    // Sample format conversion only, then resampling from 44.1 kHz, then a larger burst
+    runOutput(48000, 192, seconds);
+    runOutput(44100, 192, seconds);
+    runOutput(48000, 480, seconds);
+    return hostTestResult();
+}
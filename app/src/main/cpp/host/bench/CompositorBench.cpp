@@ -0,0 +1,125 @@
+// Cost of compositing 4, 9 and 16 video streamers in a grid on a 720p surface, every source a 720p stream.
+// Each pass takes a new frame of every streamer, uploads it into its layer and draws all tiles in one draw call.
+// Rendering thread CPU time of a pass and wall time until GPU finished it are reported, GPU is waited for with
+// glFinish. Frames are converted at the size of their tile as decoding threads would, that CPU time is timed apart.
+// Redraws without new frames tell drawing cost apart from uploads.
+//
+// Options: --frames per measure.
+
+#include "HostTest.h"
+#include "EglContext.h"
+#include "SyntheticSource.h"
+#include "VideoCompositor.h"
+#include "VideoStreamerBuilder.h"
+#include "vector"
+
+static const int WIDTH = 1280, HEIGHT = 720;
+static const int SRC_WIDTH = 1280, SRC_HEIGHT = 720;
+// Distinct source frames, generating them is left out of measures
+static const int NB_SOURCE_FRAMES = 8;
+// Frames fed before measuring, frame buffers leave buffering state
+static const int NB_WARMUP_FRAMES = 40;
+
+static void runTiles(int nbTiles, int nbFrames, const std::vector<AVFrame *> &frames) {
+    CompositorES3 *compositor = new CompositorES3();
+    REQUIRE(compositor->init());
+    compositor->resize(WIDTH, HEIGHT);
+    VideoCompositor videoCompositor(&compositor);
+
+    RendererES3 *noRenderer = nullptr;
+    std::vector<VideoStreamer *> streamers;
+    for (int i = 0; i < nbTiles; i++) {
+        VideoStreamerBuilder builder;
+        builder.setRenderer(&noRenderer)
+                ->setVideoTimeBase(av_make_q(1, 30))
+                ->setSrcWidth(SRC_WIDTH)
+                ->setSrcHeight(SRC_HEIGHT)
+                ->setSrcPixelFormat(AV_PIX_FMT_YUV420P)
+                ->setPixelFormat(GL_RGB)
+                ->setInternalPixelFormat(GL_RGB)
+                ->setYuvRenderingEnabled(false);
+        VideoStreamer *streamer = builder.buildVideoStreamer();
+        REQUIRE(streamer);
+        REQUIRE(videoCompositor.addSource(streamer, TileRect()));
+        streamers.push_back(streamer);
+    }
+    videoCompositor.setGridLayout();
+
+    int64_t index = 0;
+    auto feed = [&]() {
+        AVFrame *frame = frames[index % NB_SOURCE_FRAMES];
+        frame->pts = frame->best_effort_timestamp = index;
+        for (VideoStreamer *streamer : streamers) CHECK(streamer->onVideoFrame(frame));
+        index++;
+    };
+    // First pass sets viewport of every streamer, following frames are converted at tile size
+    videoCompositor.render();
+    for (int i = 0; i < NB_WARMUP_FRAMES; i++) {
+        feed();
+        videoCompositor.render();
+    }
+    glFinish();
+
+    int64_t convertTimeNs = 0, cpuTimeNs = 0, wallTimeNs = 0;
+    for (int i = 0; i < nbFrames; i++) {
+        int64_t convertStartNs = getThreadCpuTimeNs();
+        feed();
+        convertTimeNs += getThreadCpuTimeNs() - convertStartNs;
+
+        int64_t cpuStartNs = getThreadCpuTimeNs();
+        int64_t wallStartNs = getWallTimeNs();
+        videoCompositor.render();
+        cpuTimeNs += getThreadCpuTimeNs() - cpuStartNs;
+        glFinish();
+        wallTimeNs += getWallTimeNs() - wallStartNs;
+    }
+    printf("%2d tiles  new frames  cpu %8.1f us/pass  wall %8.1f us/pass  conversion %8.1f us/pass\n", nbTiles,
+           (double) cpuTimeNs / nbFrames / 1000.0, (double) wallTimeNs / nbFrames / 1000.0,
+           (double) convertTimeNs / nbFrames / 1000.0);
+
+    // Same pictures drawn again
+    cpuTimeNs = wallTimeNs = 0;
+    for (int i = 0; i < nbFrames; i++) {
+        int64_t cpuStartNs = getThreadCpuTimeNs();
+        int64_t wallStartNs = getWallTimeNs();
+        compositor->render();
+        cpuTimeNs += getThreadCpuTimeNs() - cpuStartNs;
+        glFinish();
+        wallTimeNs += getWallTimeNs() - wallStartNs;
+    }
+    printf("%2d tiles  redraw      cpu %8.1f us/pass  wall %8.1f us/pass\n", nbTiles,
+           (double) cpuTimeNs / nbFrames / 1000.0, (double) wallTimeNs / nbFrames / 1000.0);
+
+    // Every streamer kept up, each pass drew a frame of every one
+    for (VideoStreamer *streamer : streamers) {
+        CHECK(streamer->getFramePts() != AV_NOPTS_VALUE);
+        CHECK(streamer->getStats().mNbDisplayed >= nbFrames);
+    }
+    CHECK(glGetError() == GL_NO_ERROR);
+
+    for (VideoStreamer *streamer : streamers) delete streamer;
+    delete compositor;
+}
+
+int main(int argc, char **argv) {
+    int nbFrames = (int) getIntOption(argc, argv, "frames", 60);
+    EglContext context;
+    REQUIRE(context.create(WIDTH, HEIGHT));
+    printf("%s, %s, %dx%d surface, %dx%d sources\n", glGetString(GL_RENDERER), glGetString(GL_VERSION), WIDTH, HEIGHT,
+           SRC_WIDTH, SRC_HEIGHT);
+
+    SyntheticSource source;
+    REQUIRE(source.init(SRC_WIDTH, SRC_HEIGHT, AV_PIX_FMT_YUV420P));
+    std::vector<AVFrame *> frames;
+    for (int i = 0; i < NB_SOURCE_FRAMES; i++) {
+        AVFrame *frame = av_frame_clone(source.getFrame(i));
+        REQUIRE(frame);
+        REQUIRE(av_frame_make_writable(frame) >= 0);
+        frames.push_back(frame);
+    }
+
+    for (int nbTiles : {4, 9, 16}) runTiles(nbTiles, nbFrames, frames);
+
+    for (AVFrame *frame : frames) av_frame_free(&frame);
+    return hostTestResult();
+}
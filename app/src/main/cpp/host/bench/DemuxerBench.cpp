@@ -0,0 +1,205 @@
+// Demuxing and decoding throughput of Demuxer into sinks taking every frame right away, with heap allocations made
+// meanwhile by the whole process, FFmpeg included. A plain libav read and decode loop on one thread is measured too
+// as a reference. Most allocations of both come from decoders, so queueing packets is measured apart as well:
+// copies into pooled packets as Demuxer queues them, against newly allocated references to read packets.
+//
+// Options: --width, --height, --fps, --seconds of media written, --runs to average over.
+
+#include "HostTest.h"
+#include "AllocCounter.h"
+#include "SyntheticMedia.h"
+#include "Demuxer.h"
+#include "atomic"
+#include "vector"
+
+// Packets queued at a time when copying packets, as many as Demuxer keeps queued per stream before taking a break
+static const int NB_QUEUED_PACKETS = 26;
+
+class NullSink : public VideoSink, public AudioSink {
+public:
+    std::atomic_int64_t mNbVideoFrames = {0};
+    std::atomic_int64_t mNbAudioFrames = {0};
+
+    int onVideoFrame(AVFrame * /*frame*/) override {
+        mNbVideoFrames++;
+        return 1;
+    }
+
+    int onAudioFrame(AVFrame * /*frame*/) override {
+        mNbAudioFrames++;
+        return 1;
+    }
+};
+
+struct RunResult {
+    int64_t mWallTimeNs = 0;
+    int64_t mCpuTimeNs = 0;
+    int64_t mNbAllocs = 0;
+    int64_t mNbVideoFrames = 0;
+    int64_t mNbAudioFrames = 0;
+
+    void add(const RunResult &other) {
+        mWallTimeNs += other.mWallTimeNs;
+        mCpuTimeNs += other.mCpuTimeNs;
+        mNbAllocs += other.mNbAllocs;
+        mNbVideoFrames += other.mNbVideoFrames;
+        mNbAudioFrames += other.mNbAudioFrames;
+    }
+
+    void print(const char *name, int64_t mediaDurationMs, int nbRuns) const {
+        double wallS = (double) mWallTimeNs / 1e9;
+        printf("%-10s %8.2fx realtime %8.0f video fps %8.0f audio frames/s %6.1f%% cpu %9.0f allocs/s %6.1f allocs/frame\n",
+               name, (double) mediaDurationMs * nbRuns / 1000 / wallS, (double) mNbVideoFrames / wallS,
+               (double) mNbAudioFrames / wallS, 100.0 * (double) mCpuTimeNs / (double) mWallTimeNs,
+               (double) mNbAllocs / wallS, (double) mNbAllocs / (double) (mNbVideoFrames + mNbAudioFrames));
+    }
+};
+
+static RunResult runDemuxer(const char *path) {
+    Demuxer demuxer(path);
+    REQUIRE(demuxer.mState == DemuxerState::READY);
+    NullSink sink;
+    demuxer.addVideoSink(&sink);
+    demuxer.addAudioSink(&sink);
+
+    RunResult result;
+    int64_t nbAllocs = getNbAllocs();
+    int64_t cpuTimeNs = getProcessCpuTimeNs();
+    int64_t wallTimeNs = getWallTimeNs();
+    demuxer.start();
+    // Demuxing thread stops by itself at end of stream, once decoding threads are done
+    while (demuxer.mState != DemuxerState::STOPPED) usleep(1000);
+    result.mWallTimeNs = getWallTimeNs() - wallTimeNs;
+    result.mCpuTimeNs = getProcessCpuTimeNs() - cpuTimeNs;
+    result.mNbAllocs = getNbAllocs() - nbAllocs;
+    result.mNbVideoFrames = sink.mNbVideoFrames;
+    result.mNbAudioFrames = sink.mNbAudioFrames;
+    return result;
+}
+
+static RunResult runReference(const char *path) {
+    AVFormatContext *fmtCtx = nullptr;
+    REQUIRE(avformat_open_input(&fmtCtx, path, nullptr, nullptr) >= 0);
+    REQUIRE(avformat_find_stream_info(fmtCtx, nullptr) >= 0);
+    std::vector<AVCodecContext *> codecCtxs(fmtCtx->nb_streams);
+    for (unsigned i = 0; i < fmtCtx->nb_streams; i++) {
+        const AVCodec *codec = avcodec_find_decoder(fmtCtx->streams[i]->codecpar->codec_id);
+        codecCtxs[i] = avcodec_alloc_context3(codec);
+        REQUIRE(avcodec_parameters_to_context(codecCtxs[i], fmtCtx->streams[i]->codecpar) >= 0);
+        REQUIRE(avcodec_open2(codecCtxs[i], codec, nullptr) >= 0);
+    }
+    AVPacket *pkt = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+
+    RunResult result;
+    int64_t nbAllocs = getNbAllocs();
+    int64_t cpuTimeNs = getProcessCpuTimeNs();
+    int64_t wallTimeNs = getWallTimeNs();
+    bool isEnd = false;
+    while (!isEnd) {
+        isEnd = av_read_frame(fmtCtx, pkt) < 0;
+        for (unsigned i = 0; i < fmtCtx->nb_streams; i++) {
+            if (!isEnd && (int) i != pkt->stream_index) continue;
+            avcodec_send_packet(codecCtxs[i], isEnd ? nullptr : pkt);
+            while (avcodec_receive_frame(codecCtxs[i], frame) >= 0) {
+                if (codecCtxs[i]->codec_type == AVMEDIA_TYPE_VIDEO) result.mNbVideoFrames++;
+                else result.mNbAudioFrames++;
+                av_frame_unref(frame);
+            }
+        }
+        av_packet_unref(pkt);
+    }
+    result.mWallTimeNs = getWallTimeNs() - wallTimeNs;
+    result.mCpuTimeNs = getProcessCpuTimeNs() - cpuTimeNs;
+    result.mNbAllocs = getNbAllocs() - nbAllocs;
+
+    av_frame_free(&frame);
+    av_packet_free(&pkt);
+    for (AVCodecContext *codecCtx : codecCtxs) avcodec_free_context(&codecCtx);
+    avformat_close_input(&fmtCtx);
+    return result;
+}
+
+/** Read every packet and copy it, into a pooled packet as Demuxer queues it if pool is given, newly allocated
+ * otherwise. Copies stay queued for a while before being released as a decoder would, so that payloads of different
+ * sizes get recycled into each other. */
+static void runPacketCopies(const char *path, PacketPool *pool, int64_t *nbPackets, int64_t *nbAllocs,
+                            int64_t *timeNs) {
+    AVFormatContext *fmtCtx = nullptr;
+    REQUIRE(avformat_open_input(&fmtCtx, path, nullptr, nullptr) >= 0);
+    AVPacket *pkt = av_packet_alloc();
+    std::vector<AVPacket *> queued(NB_QUEUED_PACKETS, nullptr);
+    for (int64_t i = 0; av_read_frame(fmtCtx, pkt) >= 0; i++) {
+        AVPacket *&copy = queued[i % NB_QUEUED_PACKETS];
+        int64_t allocs = getNbAllocs();
+        int64_t startNs = getWallTimeNs();
+        if (pool) {
+            pool->release(copy);
+            copy = pool->acquire();
+            CHECK(copy && pool->copyPacket(copy, pkt) >= 0);
+        } else {
+            av_packet_free(&copy);
+            copy = av_packet_clone(pkt);
+            CHECK(copy);
+        }
+        *timeNs += getWallTimeNs() - startNs;
+        *nbAllocs += getNbAllocs() - allocs;
+        (*nbPackets)++;
+        av_packet_unref(pkt);
+    }
+    for (AVPacket *&copy : queued) {
+        if (pool) pool->release(copy);
+        else av_packet_free(&copy);
+        copy = nullptr;
+    }
+    av_packet_free(&pkt);
+    avformat_close_input(&fmtCtx);
+}
+
+int main(int argc, char **argv) {
+    SyntheticMediaOptions options;
+    options.mWidth = (int) getIntOption(argc, argv, "width", 640);
+    options.mHeight = (int) getIntOption(argc, argv, "height", 360);
+    options.mFrameRate = (int) getIntOption(argc, argv, "fps", 60);
+    options.mSampleRate = 48000;
+    options.mDurationMs = getIntOption(argc, argv, "seconds", 4) * 1000;
+    int nbRuns = (int) getIntOption(argc, argv, "runs", 3);
+
+    std::string dir = makeTempDir("DemuxerBench");
+    REQUIRE(!dir.empty());
+    std::string path = dir + "/media.nut";
+    REQUIRE(writeSyntheticMedia(path.c_str(), options));
+
+    int64_t nbVideoFrames = options.mDurationMs * options.mFrameRate / 1000;
+    printf("%dx%d mpeg4 %d fps, aac %d Hz stereo, %lld s, %d runs\n", options.mWidth, options.mHeight,
+           options.mFrameRate, options.mSampleRate, (long long) options.mDurationMs / 1000, nbRuns);
+    RunResult demuxer, reference;
+    for (int i = 0; i < nbRuns; i++) {
+        RunResult result = runDemuxer(path.c_str());
+        CHECK(result.mNbVideoFrames == nbVideoFrames);
+        CHECK(result.mNbAudioFrames > 0);
+        demuxer.add(result);
+
+        result = runReference(path.c_str());
+        CHECK(result.mNbVideoFrames == nbVideoFrames);
+        reference.add(result);
+    }
+    demuxer.print("Demuxer", options.mDurationMs, nbRuns);
+    reference.print("reference", options.mDurationMs, nbRuns);
+
+    PacketPool pool;
+    for (PacketPool *copyPool : {&pool, (PacketPool *) nullptr}) {
+        int64_t nbPackets = 0, nbAllocs = 0, timeNs = 0;
+        // Warm up pass fills pool up
+        runPacketCopies(path.c_str(), copyPool, &nbPackets, &nbAllocs, &timeNs);
+        nbPackets = nbAllocs = timeNs = 0;
+        for (int i = 0; i < nbRuns; i++) runPacketCopies(path.c_str(), copyPool, &nbPackets, &nbAllocs, &timeNs);
+        printf("%-10s %6.0f ns/packet %6.2f allocs/packet\n", copyPool ? "pooled" : "cloned",
+               (double) timeNs / (double) nbPackets, (double) nbAllocs / (double) nbPackets);
+        // Once filled up, pool recycles packets along with their payload references
+        if (copyPool) CHECK(nbAllocs == 0);
+    }
+
+    removeTempDir(dir);
+    return hostTestResult();
+}
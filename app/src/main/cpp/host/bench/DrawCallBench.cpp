@@ -0,0 +1,202 @@
+// GL calls issued and CPU time spent by every draw of RendererES3, for new pictures and for pictures drawn again.
+// Same picture is also drawn by plain GL setting every piece of state again on each draw, as renderer did before
+// static state was set once at init. GL entry points are wrapped by this program to count calls made from it,
+// CPU time is thread time of draw calls only, GPU is waited for apart.
+//
+// Options: --frames per measure.
+
+#include "HostTest.h"
+#include "RendererHarness.h"
+#include "atomic"
+#include "dlfcn.h"
+#include "vector"
+
+static std::atomic_int64_t sNbGlCalls = {0};
+
+// Count every call, then forward it to the driver definition found after this program
+#define COUNT_GL_CALLS(ret, name, params, args) \
+    extern "C" ret name params { \
+        static auto real = (ret (*) params) dlsym(RTLD_NEXT, #name); \
+        sNbGlCalls.fetch_add(1, std::memory_order_relaxed); \
+        return real args; \
+    }
+
+COUNT_GL_CALLS(void, glClear, (GLbitfield mask), (mask))
+COUNT_GL_CALLS(void, glClearColor, (GLfloat r, GLfloat g, GLfloat b, GLfloat a), (r, g, b, a))
+COUNT_GL_CALLS(void, glUseProgram, (GLuint program), (program))
+COUNT_GL_CALLS(void, glViewport, (GLint x, GLint y, GLsizei width, GLsizei height), (x, y, width, height))
+COUNT_GL_CALLS(void, glActiveTexture, (GLenum texture), (texture))
+COUNT_GL_CALLS(void, glBindTexture, (GLenum target, GLuint texture), (target, texture))
+COUNT_GL_CALLS(void, glPixelStorei, (GLenum pname, GLint param), (pname, param))
+COUNT_GL_CALLS(void, glTexSubImage2D,
+               (GLenum target, GLint level, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format,
+                GLenum type, const void *pixels),
+               (target, level, x, y, width, height, format, type, pixels))
+COUNT_GL_CALLS(void, glDrawArrays, (GLenum mode, GLint first, GLsizei count), (mode, first, count))
+COUNT_GL_CALLS(void, glUniform1i, (GLint location, GLint v0), (location, v0))
+COUNT_GL_CALLS(void, glUniform1f, (GLint location, GLfloat v0), (location, v0))
+COUNT_GL_CALLS(void, glUniform3fv, (GLint location, GLsizei count, const GLfloat *value), (location, count, value))
+COUNT_GL_CALLS(void, glUniformMatrix3fv, (GLint location, GLsizei count, GLboolean transpose, const GLfloat *value),
+               (location, count, transpose, value))
+COUNT_GL_CALLS(void, glBindBuffer, (GLenum target, GLuint buffer), (target, buffer))
+COUNT_GL_CALLS(void, glBufferData, (GLenum target, GLsizeiptr size, const void *data, GLenum usage),
+               (target, size, data, usage))
+COUNT_GL_CALLS(void *, glMapBufferRange, (GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access),
+               (target, offset, length, access))
+COUNT_GL_CALLS(GLboolean, glUnmapBuffer, (GLenum target), (target))
+COUNT_GL_CALLS(GLsync, glFenceSync, (GLenum condition, GLbitfield flags), (condition, flags))
+COUNT_GL_CALLS(GLenum, glClientWaitSync, (GLsync sync, GLbitfield flags, GLuint64 timeout), (sync, flags, timeout))
+COUNT_GL_CALLS(void, glDeleteSync, (GLsync sync), (sync))
+COUNT_GL_CALLS(void, glVertexAttribPointer,
+               (GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer),
+               (index, size, type, normalized, stride, pointer))
+COUNT_GL_CALLS(void, glEnableVertexAttribArray, (GLuint index), (index))
+COUNT_GL_CALLS(GLenum, glGetError, (), ())
+
+static const int SURFACE_WIDTH = 640, SURFACE_HEIGHT = 360;
+static const int WIDTH = 1280, HEIGHT = 720;
+
+struct Measure {
+    int64_t mNbGlCalls = 0;
+    int64_t mCpuTimeNs = 0;
+    int mNbFrames = 0;
+
+    void print(const char *path) const {
+        printf("%-32s %6.1f gl calls/draw  cpu %7.1f us/draw\n", path, (double) mNbGlCalls / mNbFrames,
+               (double) mCpuTimeNs / mNbFrames / 1000.0);
+    }
+};
+
+/** Run draw once per frame, only draw itself is counted and timed. First one is left out as it allocates storage. */
+template<typename Draw>
+static Measure measure(int nbFrames, Draw draw) {
+    draw(0);
+    glFinish();
+    Measure result;
+    for (int i = 1; i <= nbFrames; i++) {
+        int64_t nbGlCalls = sNbGlCalls;
+        int64_t cpuStartNs = getThreadCpuTimeNs();
+        draw(i);
+        result.mCpuTimeNs += getThreadCpuTimeNs() - cpuStartNs;
+        result.mNbGlCalls += sNbGlCalls - nbGlCalls;
+        result.mNbFrames++;
+        glFinish();
+    }
+    CHECK(RendererHarness::takeGlErrors() == 0);
+    return result;
+}
+
+/** Draw a texture with plain GL, setting program, samplers, attributes, bindings and viewport every time. */
+class StatefulDraw {
+private:
+    GLuint mProgram = 0;
+    GLint mTexUnitLocation = -1;
+    GLuint mBufferId = 0;
+    GLuint mTextureId = 0;
+
+public:
+    bool init(const std::vector<uint8_t> &rgba) {
+        mProgram = createProgram(VERTEX_SHADER, FRAGMENT_SHADER);
+        if (!mProgram) return false;
+        mTexUnitLocation = glGetUniformLocation(mProgram, "uTexUnit");
+        mBufferId = createVbo(sizeof(rect), rect, GL_STATIC_DRAW);
+        glGenTextures(1, &mTextureId);
+        glBindTexture(GL_TEXTURE_2D, mTextureId);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, WIDTH, HEIGHT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, WIDTH, HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+        return true;
+    }
+
+    ~StatefulDraw() {
+        glDeleteProgram(mProgram);
+        glDeleteBuffers(1, &mBufferId);
+        glDeleteTextures(1, &mTextureId);
+    }
+
+    void draw() {
+        // Vertex array of renderer is still bound, attributes set here go into it
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glViewport(0, 0, SURFACE_WIDTH, SURFACE_HEIGHT);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glUseProgram(mProgram);
+        glUniform1i(mTexUnitLocation, 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, mTextureId);
+        glBindBuffer(GL_ARRAY_BUFFER, mBufferId);
+        glVertexAttribPointer(POS_ATTRIB, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), BUFFER_OFFSET(0));
+        glVertexAttribPointer(TEX_COORD_ATTRIB, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat),
+                              BUFFER_OFFSET(2 * sizeof(GLfloat)));
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glEnableVertexAttribArray(POS_ATTRIB);
+        glEnableVertexAttribArray(TEX_COORD_ATTRIB);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        checkGlError("StatefulDraw::draw");
+    }
+};
+
+int main(int argc, char **argv) {
+    int nbFrames = (int) getIntOption(argc, argv, "frames", 200);
+    RendererHarness harness;
+    REQUIRE(harness.init(SURFACE_WIDTH, SURFACE_HEIGHT));
+    RendererES3 *renderer = *harness.getRenderer();
+    printf("%s, %s, %dx%d pictures\n", glGetString(GL_RENDERER), glGetString(GL_VERSION), WIDTH, HEIGHT);
+
+    std::vector<uint8_t> rgba[2];
+    std::vector<uint8_t> yuv[2][3];
+    for (int i = 0; i < 2; i++) {
+        rgba[i].assign((size_t) WIDTH * HEIGHT * 4, (uint8_t) (64 + i * 64));
+        yuv[i][0].assign((size_t) WIDTH * HEIGHT, (uint8_t) (64 + i * 64));
+        yuv[i][1].assign((size_t) WIDTH * HEIGHT / 4, 128);
+        yuv[i][2].assign((size_t) WIDTH * HEIGHT / 4, 128);
+    }
+    auto getYuvPicture = [&](int i) {
+        YuvPicture picture;
+        picture.mWidth = WIDTH;
+        picture.mHeight = HEIGHT;
+        picture.mChromaWidth = WIDTH / 2;
+        picture.mChromaHeight = HEIGHT / 2;
+        for (int p = 0; p < 3; p++) {
+            picture.mData[p] = yuv[i % 2][p].data();
+            picture.mLinesize[p] = p == 0 ? WIDTH : WIDTH / 2;
+        }
+        return picture;
+    };
+
+    Measure rgbaNew = measure(nbFrames, [&](int i) {
+        renderer->render(WIDTH, HEIGHT, GL_RGBA, GL_RGBA, WIDTH * 4, rgba[i % 2].data(), true);
+    });
+    rgbaNew.print("renderer rgba new picture");
+    Measure rgbaRedraw = measure(nbFrames, [&](int /*i*/) {
+        renderer->render(WIDTH, HEIGHT, GL_RGBA, GL_RGBA, WIDTH * 4, rgba[0].data(), false);
+    });
+    rgbaRedraw.print("renderer rgba redraw");
+    Measure yuvNew = measure(nbFrames, [&](int i) {
+        renderer->renderYuv(getYuvPicture(i), true);
+    });
+    yuvNew.print("renderer yuv420p new picture");
+    Measure yuvRedraw = measure(nbFrames, [&](int /*i*/) {
+        renderer->renderYuv(getYuvPicture(0), false);
+    });
+    yuvRedraw.print("renderer yuv420p redraw");
+
+    // Switching between programs every draw, as when a compositor or two streamers share a context
+    Measure alternating = measure(nbFrames, [&](int i) {
+        if (i % 2) renderer->render(WIDTH, HEIGHT, GL_RGBA, GL_RGBA, WIDTH * 4, rgba[0].data(), false);
+        else renderer->renderYuv(getYuvPicture(0), false);
+    });
+    alternating.print("renderer rgba/yuv alternating");
+
+    StatefulDraw stateful;
+    REQUIRE(stateful.init(rgba[0]));
+    Measure statefulRedraw = measure(nbFrames, [&](int /*i*/) {
+        stateful.draw();
+    });
+    statefulRedraw.print("state set every draw, redraw");
+
+    // Drawing a picture again is a clear, a draw and an error check, state only changes with pictures
+    CHECK(rgbaRedraw.mNbGlCalls == 3 * rgbaRedraw.mNbFrames);
+    CHECK(yuvRedraw.mNbGlCalls == 3 * yuvRedraw.mNbFrames);
+    CHECK(rgbaRedraw.mNbGlCalls < statefulRedraw.mNbGlCalls);
+    return hostTestResult();
+}
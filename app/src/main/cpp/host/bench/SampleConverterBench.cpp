@@ -0,0 +1,97 @@
+// Format-only conversions of stereo audio, through sample converter against swr_convert on the same buffers. Frames
+// are 1024 samples, as AAC decoder and encoder frames. Time is CPU time of the converting thread per sample frame,
+// least of several runs. Host builds are unoptimized unless configured with -DCMAKE_BUILD_TYPE=Release, as the app is,
+// and swr only has SIMD kernels if FFmpeg it links to was built with them.
+//
+// Options: --frames converted per run, --runs per conversion.
+
+#include "HostTest.h"
+#include "SampleConverter.h"
+#include "algorithm"
+
+extern "C" {
+#include "libavutil/channel_layout.h"
+#include "libavutil/mem.h"
+#include "libswresample/swresample.h"
+}
+
+static const int NB_CHANNELS = 2;
+static const int FRAME_SIZE = 1024;
+static const int SAMPLE_RATE = 48000;
+
+struct Conversion {
+    AVSampleFormat mSrcFmt;
+    AVSampleFormat mDstFmt;
+};
+
+static const Conversion CONVERSIONS[] = {
+        {AV_SAMPLE_FMT_FLTP, AV_SAMPLE_FMT_S16},
+        {AV_SAMPLE_FMT_S16,  AV_SAMPLE_FMT_FLTP},
+        {AV_SAMPLE_FMT_FLTP, AV_SAMPLE_FMT_FLT},
+        {AV_SAMPLE_FMT_FLT,  AV_SAMPLE_FMT_FLTP},
+        {AV_SAMPLE_FMT_S16,  AV_SAMPLE_FMT_S16P},
+        {AV_SAMPLE_FMT_S16P, AV_SAMPLE_FMT_S16},
+        {AV_SAMPLE_FMT_FLT,  AV_SAMPLE_FMT_S16},
+};
+
+/** Return least CPU time in ns per sample frame of converting nbFrames frames, over nbRuns runs. */
+template<typename Convert>
+static double measure(long nbFrames, long nbRuns, Convert convert) {
+    int64_t bestNs = INT64_MAX;
+    for (long run = 0; run < nbRuns; run++) {
+        int64_t startNs = getThreadCpuTimeNs();
+        for (long i = 0; i < nbFrames; i++) convert();
+        bestNs = std::min(bestNs, getThreadCpuTimeNs() - startNs);
+    }
+    return (double) bestNs / (double) (nbFrames * FRAME_SIZE);
+}
+
+int main(int argc, char **argv) {
+    long nbFrames = getIntOption(argc, argv, "frames", 20000);
+    long nbRuns = getIntOption(argc, argv, "runs", 5);
+
+    printf("%-12s %12s %12s\n", "conversion", "swr ns", "converter ns");
+    for (const Conversion &conversion : CONVERSIONS) {
+        uint8_t *src[NB_CHANNELS] = {nullptr}, *dst[NB_CHANNELS] = {nullptr};
+        REQUIRE(av_samples_alloc(src, nullptr, NB_CHANNELS, FRAME_SIZE, conversion.mSrcFmt, 0) >= 0);
+        REQUIRE(av_samples_alloc(dst, nullptr, NB_CHANNELS, FRAME_SIZE, conversion.mDstFmt, 0) >= 0);
+        // Half scale noise, any value converts at the same speed
+        int srcSize = av_samples_get_buffer_size(nullptr, NB_CHANNELS, FRAME_SIZE, conversion.mSrcFmt, 0);
+        uint32_t state = 1;
+        if (av_get_packed_sample_fmt(conversion.mSrcFmt) == AV_SAMPLE_FMT_FLT) {
+            for (int i = 0; i < srcSize / 4; i++) {
+                state = state * 1664525 + 1013904223;
+                ((float *) src[0])[i] = (float) (state >> 8) / (float) (1 << 24) - 0.5f;
+            }
+        } else {
+            for (int i = 0; i < srcSize / 2; i++) {
+                state = state * 1664525 + 1013904223;
+                ((int16_t *) src[0])[i] = (int16_t) (state >> 17);
+            }
+        }
+
+        int64_t layout = av_get_default_channel_layout(NB_CHANNELS);
+        SwrContext *swrCtx = swr_alloc_set_opts(nullptr, layout, conversion.mDstFmt, SAMPLE_RATE, layout,
+                                                conversion.mSrcFmt, SAMPLE_RATE, 0, nullptr);
+        REQUIRE(swrCtx && swr_init(swrCtx) >= 0);
+        SampleConverter *converter = SampleConverter::create(conversion.mSrcFmt, conversion.mDstFmt, NB_CHANNELS);
+        REQUIRE(converter);
+
+        double swrNs = measure(nbFrames, nbRuns, [&]() {
+            CHECK(swr_convert(swrCtx, dst, FRAME_SIZE, (const uint8_t **) src, FRAME_SIZE) == FRAME_SIZE);
+        });
+        double converterNs = measure(nbFrames, nbRuns, [&]() {
+            converter->convert(src, dst, FRAME_SIZE);
+        });
+        char name[32];
+        snprintf(name, sizeof(name), "%s->%s", av_get_sample_fmt_name(conversion.mSrcFmt),
+                 av_get_sample_fmt_name(conversion.mDstFmt));
+        printf("%-12s %12.3f %12.3f\n", name, swrNs, converterNs);
+
+        delete converter;
+        swr_free(&swrCtx);
+        av_freep(&src[0]);
+        av_freep(&dst[0]);
+    }
+    return hostTestResult();
+}
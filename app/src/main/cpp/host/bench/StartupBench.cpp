@@ -0,0 +1,118 @@
+// Time to first frame of a new surface: context and renderer creation, then a video streamer built and fed until a
+// first frame is on surface, as when app starts or surface is created again on rotation.
+// Program cache starts empty on every cold run and is kept between warm runs, runs without cache compile every time.
+// Mesa only gives program binaries with its own shader cache on, that cache is kept in a directory of this run.
+// It holds shaders compiled by earlier runs, so cold runs after the first one compile faster than on a fresh device.
+// Mesa llvmpipe also generates code for draws on first frame, no program cache covers that part.
+//
+// Options: --runs per cache state.
+
+#include "HostTest.h"
+#include "RendererHarness.h"
+#include "SyntheticMedia.h"
+#include "SyntheticSource.h"
+#include "VideoStreamerBuilder.h"
+#include "filesystem"
+
+static const int WIDTH = 640, HEIGHT = 360;
+static const int SRC_WIDTH = 1280, SRC_HEIGHT = 720;
+// Frames fed at most before giving up on seeing one
+static const int MAX_FRAMES = 30;
+
+struct Measure {
+    int64_t mInitTimeNs = 0;
+    int64_t mFirstFrameTimeNs = 0;
+    int mNbCachedPrograms = 0;
+    int mNbCompiledPrograms = 0;
+    int mNbRuns = 0;
+
+    void print(const char *name) const {
+        printf("%-12s init %7.2f ms  first frame %7.2f ms  programs cached %d, compiled %d per run\n", name,
+               (double) mInitTimeNs / mNbRuns / 1e6, (double) mFirstFrameTimeNs / mNbRuns / 1e6,
+               mNbCachedPrograms / mNbRuns, mNbCompiledPrograms / mNbRuns);
+    }
+};
+
+/** Create a surface and renderer, then draw a first frame through a new streamer. */
+static void runOnce(SyntheticSource *source, const char *programCacheDir, Measure *measure) {
+    int64_t startNs = getWallTimeNs();
+    RendererHarness harness;
+    REQUIRE(harness.init(WIDTH, HEIGHT, programCacheDir));
+    int64_t initTimeNs = getWallTimeNs() - startNs;
+
+    VideoStreamerBuilder builder;
+    builder.setRenderer(harness.getRenderer())
+            ->setVideoTimeBase(av_make_q(1, 30))
+            ->setSrcWidth(SRC_WIDTH)
+            ->setSrcHeight(SRC_HEIGHT)
+            ->setSrcPixelFormat(AV_PIX_FMT_YUV420P)
+            ->setPixelFormat(GL_RGB)
+            ->setInternalPixelFormat(GL_RGB)
+            ->setYuvRenderingEnabled(true);
+    VideoStreamer *streamer = builder.buildVideoStreamer();
+    REQUIRE(streamer);
+    for (int i = 0; i < MAX_FRAMES && streamer->getFramePts() == AV_NOPTS_VALUE; i++) {
+        CHECK(harness.drawFrame(streamer, source->getFrame(i)).mNbGlErrors == 0);
+    }
+    CHECK(streamer->getFramePts() != AV_NOPTS_VALUE);
+    measure->mFirstFrameTimeNs += getWallTimeNs() - startNs;
+    measure->mInitTimeNs += initTimeNs;
+    RendererStats stats = (*harness.getRenderer())->getStats();
+    measure->mNbCachedPrograms += stats.mNbCachedPrograms;
+    measure->mNbCompiledPrograms += stats.mNbCompiledPrograms;
+    measure->mNbRuns++;
+    delete streamer;
+}
+
+int main(int argc, char **argv) {
+    int nbRuns = (int) getIntOption(argc, argv, "runs", 10);
+    std::string driverCacheDir = makeTempDir("StartupBenchDriver");
+    REQUIRE(!driverCacheDir.empty());
+    setenv("MESA_SHADER_CACHE_DIR", driverCacheDir.c_str(), 1);
+    SyntheticSource source;
+    REQUIRE(source.init(SRC_WIDTH, SRC_HEIGHT, AV_PIX_FMT_YUV420P));
+
+    // Probe driver once, the first context of a process also pays for loading driver
+    bool isCacheSupported;
+    {
+        EglContext context;
+        REQUIRE(context.create(WIDTH, HEIGHT));
+        GLint nbFormats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &nbFormats);
+        isCacheSupported = nbFormats > 0;
+        printf("%s, %s, program binary formats: %d\n", glGetString(GL_RENDERER), glGetString(GL_VERSION), nbFormats);
+    }
+
+    Measure uncached;
+    for (int i = 0; i < nbRuns; i++) runOnce(&source, nullptr, &uncached);
+    uncached.print("no cache");
+
+    Measure cold;
+    for (int i = 0; i < nbRuns; i++) {
+        std::string dir = makeTempDir("StartupBench");
+        REQUIRE(!dir.empty());
+        runOnce(&source, dir.c_str(), &cold);
+        removeTempDir(dir);
+    }
+    cold.print("cold cache");
+
+    std::string dir = makeTempDir("StartupBench");
+    REQUIRE(!dir.empty());
+    Measure filling;
+    runOnce(&source, dir.c_str(), &filling);
+    Measure warm;
+    for (int i = 0; i < nbRuns; i++) runOnce(&source, dir.c_str(), &warm);
+    warm.print("warm cache");
+    removeTempDir(dir);
+    std::filesystem::remove_all(driverCacheDir);
+
+    CHECK(uncached.mNbCachedPrograms == 0 && uncached.mNbCompiledPrograms == 2 * nbRuns);
+    if (isCacheSupported) {
+        // Every program is compiled then stored on a cold start, taken back on every warm one
+        CHECK(cold.mNbCachedPrograms == 0 && cold.mNbCompiledPrograms == 2 * nbRuns);
+        CHECK(warm.mNbCachedPrograms == 2 * nbRuns && warm.mNbCompiledPrograms == 0);
+    } else {
+        printf("Driver has no program binary format, every start compiles\n");
+    }
+    return hostTestResult();
+}
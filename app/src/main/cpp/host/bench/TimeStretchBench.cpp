@@ -0,0 +1,234 @@
+// Time-stretching of stereo 48 kHz s16 audio, as AudioStreamer stretches it for playback speeds from 0.5 to 3.
+// Speed: CPU time of the stretching thread per second of audio output, as a real-time factor. A device runs it on
+// whatever core the decoding thread gets, pin this program to a little core with taskset to measure that case. Host
+// builds are unoptimized unless configured with -DCMAKE_BUILD_TYPE=Release, as the app is.
+// Quality: tones are stretched, then fitted back block by block with their own amplitude and phase, what is left is
+// distortion and noise added by stretching, reported as a ratio to signal. Pitch must be kept for the fit to hold.
+// Same signals are stretched by a reference WSOLA written plainly here: full Hann windows, exhaustive search for the
+// offset of highest normalized cross-correlation over a whole window, double precision. Streamer stretching must
+// stay close to it.
+//
+// Options: --seconds of audio stretched per speed.
+
+#include "HostTest.h"
+#include "TimeStretcher.h"
+#include "cmath"
+#include "vector"
+
+static const int SAMPLE_RATE = 48000;
+static const int NB_CHANNELS = 2;
+// Samples per decoded frame fed to stretcher
+static const int FRAME_SIZE = 1024;
+// Fit block, and margin left out at both ends of output where windows are partial
+static const int BLOCK_SIZE = 2048;
+static const int EDGE_SIZE = SAMPLE_RATE / 20;
+// Signal stretched for quality, a few fit blocks remain at the highest speed
+static const int QUALITY_SIZE = SAMPLE_RATE;
+// Reference parameters match those of streamer stretcher
+static const int WINDOW_MS = 20;
+static const int SEARCH_MS = 15;
+
+static const double SPEEDS[] = {0.5, 0.8, 1.0, 1.25, 1.5, 2.0, 3.0};
+
+/** Tones of one channel. */
+using Tones = std::vector<double>;
+
+/** Interleaved s16 samples, each channel a sum of its tones. */
+static std::vector<int16_t> makeSignal(const Tones tones[NB_CHANNELS], int nbSamples) {
+    std::vector<int16_t> samples((size_t) nbSamples * NB_CHANNELS);
+    for (int c = 0; c < NB_CHANNELS; c++) {
+        double amplitude = 0.6 / (double) tones[c].size();
+        for (int i = 0; i < nbSamples; i++) {
+            double value = 0;
+            for (double freq : tones[c]) value += amplitude * sin(2.0 * M_PI * freq * i / SAMPLE_RATE);
+            samples[(size_t) i * NB_CHANNELS + c] = (int16_t) lrint(value * 32767.0);
+        }
+    }
+    return samples;
+}
+
+/** Stretch through streamer stretcher frame by frame. */
+static std::vector<int16_t> stretch(const std::vector<int16_t> &input, double speed, int64_t *cpuTimeNs) {
+    TimeStretcher stretcher(SAMPLE_RATE, NB_CHANNELS, AV_SAMPLE_FMT_S16);
+    stretcher.setSpeed(speed);
+    auto nbInput = (int) (input.size() / NB_CHANNELS);
+    std::vector<int16_t> output, out;
+    output.reserve((size_t) (nbInput / speed + SAMPLE_RATE) * NB_CHANNELS);
+    int64_t startNs = getThreadCpuTimeNs();
+    for (int pos = 0; pos < nbInput; pos += FRAME_SIZE) {
+        int nbSamples = std::min(FRAME_SIZE, nbInput - pos);
+        out.resize((size_t) stretcher.getMaxOutput(nbSamples) * NB_CHANNELS);
+        int64_t tsMs = 0;
+        int nbOut = stretcher.process((const uint8_t *) &input[(size_t) pos * NB_CHANNELS], nbSamples,
+                                      (int64_t) pos * 1000 / SAMPLE_RATE, (uint8_t *) out.data(), &tsMs);
+        output.insert(output.end(), out.begin(), out.begin() + (long) nbOut * NB_CHANNELS);
+    }
+    if (cpuTimeNs) *cpuTimeNs = getThreadCpuTimeNs() - startNs;
+    return output;
+}
+
+/** Stretch with textbook WSOLA. Output frame k starts k hops into output, its input segment is searched around k hops
+ * times speed for what best continues the segment taken for frame k - 1. */
+static std::vector<int16_t> stretchReference(const std::vector<int16_t> &input, double speed) {
+    int windowSize = SAMPLE_RATE * WINDOW_MS / 1000;
+    int hopSize = windowSize / 2;
+    int searchSize = SAMPLE_RATE * SEARCH_MS / 1000;
+    auto nbInput = (int) (input.size() / NB_CHANNELS);
+    std::vector<double> window((size_t) windowSize);
+    // Periodic Hann windows half overlapping add up to 1
+    for (int i = 0; i < windowSize; i++) window[i] = 0.5 - 0.5 * cos(2.0 * M_PI * i / windowSize);
+    std::vector<double> x(input.begin(), input.end());
+    // Energy of every window, channels together, running sum over input
+    std::vector<double> energies((size_t) nbInput + 1);
+    for (int i = 0; i < nbInput; i++) {
+        const double *sample = &x[(size_t) i * NB_CHANNELS];
+        double sampleEnergy = 0;
+        for (int c = 0; c < NB_CHANNELS; c++) sampleEnergy += sample[c] * sample[c];
+        energies[i + 1] = energies[i] + sampleEnergy;
+    }
+
+    std::vector<double> output((size_t) (nbInput / speed + windowSize) * NB_CHANNELS);
+    int prevPos = 0;
+    int nbFrames = 0;
+    int windowLength = windowSize * NB_CHANNELS;
+    for (int k = 0;; k++) {
+        int pos = 0;
+        if (k > 0) {
+            auto target = (int) lround(k * hopSize * speed);
+            int continuation = prevPos + hopSize;
+            if (target + searchSize + windowSize > nbInput || continuation + windowSize > nbInput) break;
+            double bestCorrelation = -INFINITY;
+            const double *a = &x[(size_t) continuation * NB_CHANNELS];
+            for (int candidate = std::max(0, target - searchSize); candidate <= target + searchSize; candidate++) {
+                const double *b = &x[(size_t) candidate * NB_CHANNELS];
+                double dot = 0;
+                for (int i = 0; i < windowLength; i++) dot += a[i] * b[i];
+                double energy = energies[candidate + windowSize] - energies[candidate];
+                double correlation = dot / sqrt(energy + 1e-9);
+                if (correlation > bestCorrelation) {
+                    bestCorrelation = correlation;
+                    pos = candidate;
+                }
+            }
+        }
+        const double *segment = &x[(size_t) pos * NB_CHANNELS];
+        double *out = &output[(size_t) k * hopSize * NB_CHANNELS];
+        for (int i = 0; i < windowLength; i++) out[i] += window[i / NB_CHANNELS] * segment[i];
+        prevPos = pos;
+        nbFrames = k + 1;
+    }
+
+    // Last half window only has its rising half
+    std::vector<int16_t> samples((size_t) nbFrames * hopSize * NB_CHANNELS);
+    for (size_t i = 0; i < samples.size(); i++) samples[i] = (int16_t) lrint(av_clipd(output[i], -32768, 32767));
+    return samples;
+}
+
+/** Solve n x n system a * x = b in place by Gaussian elimination with partial pivoting, a row major. */
+static void solve(std::vector<double> &a, std::vector<double> &b, int n) {
+    for (int col = 0; col < n; col++) {
+        int pivot = col;
+        for (int row = col + 1; row < n; row++) {
+            if (fabs(a[row * n + col]) > fabs(a[pivot * n + col])) pivot = row;
+        }
+        for (int j = 0; j < n; j++) std::swap(a[col * n + j], a[pivot * n + j]);
+        std::swap(b[col], b[pivot]);
+        for (int row = col + 1; row < n; row++) {
+            double factor = a[row * n + col] / a[col * n + col];
+            for (int j = col; j < n; j++) a[row * n + j] -= factor * a[col * n + j];
+            b[row] -= factor * b[col];
+        }
+    }
+    for (int row = n - 1; row >= 0; row--) {
+        for (int j = row + 1; j < n; j++) b[row] -= a[row * n + j] * b[j];
+        b[row] /= a[row * n + row];
+    }
+}
+
+/** Return ratio in dB of signal energy to what is left once tones of each channel are fitted out of it, block by
+ * block. Phase jumps between blocks are free, only distortion and noise inside blocks count. */
+static double getToneSnrDb(const std::vector<int16_t> &samples, const Tones tones[NB_CHANNELS]) {
+    auto nbSamples = (int) (samples.size() / NB_CHANNELS);
+    double signalEnergy = 0, residualEnergy = 0;
+    for (int c = 0; c < NB_CHANNELS; c++) {
+        // A sine and a cosine per tone
+        int n = 2 * (int) tones[c].size();
+        std::vector<double> basis((size_t) n * BLOCK_SIZE);
+        for (int start = EDGE_SIZE; start + BLOCK_SIZE <= nbSamples - EDGE_SIZE; start += BLOCK_SIZE) {
+            std::vector<double> y(BLOCK_SIZE);
+            for (int i = 0; i < BLOCK_SIZE; i++) y[i] = samples[(size_t) (start + i) * NB_CHANNELS + c];
+            for (int t = 0; t < n / 2; t++) {
+                for (int i = 0; i < BLOCK_SIZE; i++) {
+                    double phase = 2.0 * M_PI * tones[c][t] * (start + i) / SAMPLE_RATE;
+                    basis[(size_t) 2 * t * BLOCK_SIZE + i] = sin(phase);
+                    basis[(size_t) (2 * t + 1) * BLOCK_SIZE + i] = cos(phase);
+                }
+            }
+            std::vector<double> a((size_t) n * n), b(n);
+            for (int p = 0; p < n; p++) {
+                for (int i = 0; i < BLOCK_SIZE; i++) b[p] += basis[(size_t) p * BLOCK_SIZE + i] * y[i];
+                for (int q = 0; q < n; q++) {
+                    for (int i = 0; i < BLOCK_SIZE; i++) {
+                        a[p * n + q] += basis[(size_t) p * BLOCK_SIZE + i] * basis[(size_t) q * BLOCK_SIZE + i];
+                    }
+                }
+            }
+            solve(a, b, n);
+            for (int i = 0; i < BLOCK_SIZE; i++) {
+                double fit = 0;
+                for (int p = 0; p < n; p++) fit += b[p] * basis[(size_t) p * BLOCK_SIZE + i];
+                signalEnergy += y[i] * y[i];
+                residualEnergy += (y[i] - fit) * (y[i] - fit);
+            }
+        }
+    }
+    return 10.0 * log10(signalEnergy / (residualEnergy + 1e-9));
+}
+
+static void runSignal(const char *name, const Tones tones[NB_CHANNELS]) {
+    std::vector<int16_t> input = makeSignal(tones, QUALITY_SIZE);
+    auto nbInput = (int) (input.size() / NB_CHANNELS);
+    for (double speed : SPEEDS) {
+        std::vector<int16_t> output = stretch(input, speed, nullptr);
+        std::vector<int16_t> reference = stretchReference(input, speed);
+        double snrDb = getToneSnrDb(output, tones);
+        double referenceSnrDb = getToneSnrDb(reference, tones);
+        auto nbOutput = (int) (output.size() / NB_CHANNELS);
+        printf("%-6s speed %.2f: signal to distortion and noise %6.1f dB, reference %6.1f dB, output %.3f of "
+               "input / speed\n", name, speed, snrDb, referenceSnrDb, nbOutput * speed / nbInput);
+
+        if (speed == 1.0) {
+            // Played as is
+            CHECK(output == input);
+        } else {
+            CHECK(snrDb > referenceSnrDb - 3.0);
+        }
+        // Output lasts input duration over speed, but for windows and search range kept at the end
+        int tailSize = SAMPLE_RATE * (WINDOW_MS + SEARCH_MS) / 1000;
+        CHECK(nbOutput <= nbInput / speed + 1);
+        CHECK(nbOutput >= (nbInput - tailSize) / speed - SAMPLE_RATE * WINDOW_MS / 1000);
+    }
+}
+
+int main(int argc, char **argv) {
+    int64_t seconds = getIntOption(argc, argv, "seconds", 20);
+
+    Tones tone[NB_CHANNELS] = {{1000.0}, {1000.0}};
+    Tones chord[NB_CHANNELS] = {{440.0, 1250.0}, {660.0, 2900.0}};
+    runSignal("tone", tone);
+    runSignal("chord", chord);
+
+    // Real-time factor on a signal closer to music, several tones on each channel
+    Tones music[NB_CHANNELS] = {{110.0, 440.0, 1250.0, 3100.0}, {220.0, 660.0, 1870.0, 4400.0}};
+    std::vector<int16_t> input = makeSignal(music, (int) (seconds * SAMPLE_RATE));
+    for (double speed : SPEEDS) {
+        int64_t cpuTimeNs = 0;
+        std::vector<int16_t> output = stretch(input, speed, &cpuTimeNs);
+        double outputSeconds = (double) output.size() / NB_CHANNELS / SAMPLE_RATE;
+        double realTimeFactor = outputSeconds * 1e9 / (double) cpuTimeNs;
+        printf("speed %.2f: %7.1f us cpu per second of output, %6.1fx real time\n", speed,
+               (double) cpuTimeNs / 1000.0 / outputSeconds, realTimeFactor);
+        CHECK(realTimeFactor > 1.0);
+    }
+    return hostTestResult();
+}
@@ -0,0 +1,100 @@
+// Decoding cost of trick play against decoding every frame. Normal playback decodes the whole media into sinks taking
+// frames right away, its process CPU time per second of media tells what playing every frame at a given speed costs.
+// Trick play then runs for a while at each speed from the start of media, only keyframes it shows are read and
+// decoded, its process CPU time per second of wall clock is compared against that. Audio is skipped by trick play.
+//
+// Options: --width, --height, --fps, --seconds of media written, --trick-seconds each speed runs for.
+
+#include "HostTest.h"
+#include "SyntheticMedia.h"
+#include "Demuxer.h"
+#include "atomic"
+
+class NullSink : public VideoSink, public AudioSink {
+public:
+    std::atomic_int64_t mNbVideoFrames = {0};
+
+    int onVideoFrame(AVFrame * /*frame*/) override {
+        mNbVideoFrames++;
+        return 1;
+    }
+
+    int onAudioFrame(AVFrame * /*frame*/) override {
+        return 1;
+    }
+};
+
+/** Decode the whole media, return process CPU time. */
+static int64_t runNormal(const char *path, int64_t *nbFrames) {
+    Demuxer demuxer(path);
+    REQUIRE(demuxer.mState == DemuxerState::READY);
+    NullSink sink;
+    demuxer.addVideoSink(&sink);
+    demuxer.addAudioSink(&sink);
+
+    int64_t cpuTimeNs = getProcessCpuTimeNs();
+    demuxer.start();
+    // Demuxing thread stops by itself at end of stream, once decoding threads are done
+    while (demuxer.mState != DemuxerState::STOPPED) usleep(1000);
+    cpuTimeNs = getProcessCpuTimeNs() - cpuTimeNs;
+    *nbFrames = sink.mNbVideoFrames;
+    return cpuTimeNs;
+}
+
+/** Trick play from start of media for seconds, return process CPU time. */
+static int64_t runTrickPlay(const char *path, double speed, int64_t seconds, int64_t *nbFrames) {
+    Demuxer demuxer(path);
+    REQUIRE(demuxer.mState == DemuxerState::READY);
+    NullSink sink;
+    demuxer.addVideoSink(&sink);
+    demuxer.addAudioSink(&sink);
+
+    int64_t cpuTimeNs = getProcessCpuTimeNs();
+    demuxer.setTrickPlay(speed);
+    demuxer.start();
+    usleep(seconds * 1000000);
+    demuxer.stop();
+    cpuTimeNs = getProcessCpuTimeNs() - cpuTimeNs;
+    *nbFrames = sink.mNbVideoFrames;
+    return cpuTimeNs;
+}
+
+int main(int argc, char **argv) {
+    SyntheticMediaOptions options;
+    options.mWidth = (int) getIntOption(argc, argv, "width", 1280);
+    options.mHeight = (int) getIntOption(argc, argv, "height", 720);
+    options.mFrameRate = (int) getIntOption(argc, argv, "fps", 30);
+    options.mDurationMs = getIntOption(argc, argv, "seconds", 20) * 1000;
+    int64_t trickSeconds = getIntOption(argc, argv, "trick-seconds", 2);
+
+    std::string dir = makeTempDir("TrickPlayBench");
+    REQUIRE(!dir.empty());
+    std::string path = dir + "/media.nut";
+    REQUIRE(writeSyntheticMedia(path.c_str(), options));
+    printf("%dx%d mpeg4 %d fps, keyframe every %d frames, %lld s\n", options.mWidth, options.mHeight,
+           options.mFrameRate, options.mGopSize, (long long) options.mDurationMs / 1000);
+
+    int64_t nbFrames = 0;
+    int64_t normalCpuNs = runNormal(path.c_str(), &nbFrames);
+    CHECK(nbFrames == options.mDurationMs * options.mFrameRate / 1000);
+    double cpuPerMediaSecondMs = (double) normalCpuNs / 1e6 / ((double) options.mDurationMs / 1000);
+    printf("normal       %5lld frames  %8.1f ms cpu per second of media\n", (long long) nbFrames,
+           cpuPerMediaSecondMs);
+
+    for (double speed : {4.0, 8.0}) {
+        // Stream time trick play goes through stays inside media, otherwise it keeps showing the last keyframe
+        if (speed * (double) trickSeconds * 1000 > (double) options.mDurationMs) continue;
+        int64_t cpuNs = runTrickPlay(path.c_str(), speed, trickSeconds, &nbFrames);
+        double cpuPerSecondMs = (double) cpuNs / 1e6 / (double) trickSeconds;
+        double everyFrameMs = cpuPerMediaSecondMs * speed;
+        printf("trick %4.1fx  %5lld frames  %8.1f ms cpu per second, every frame at that speed %8.1f ms, %5.1f%%\n",
+               speed, (long long) nbFrames, cpuPerSecondMs, everyFrameMs, 100.0 * cpuPerSecondMs / everyFrameMs);
+
+        // Only keyframes are decoded, far fewer than every frame
+        CHECK(nbFrames > 0);
+        CHECK(cpuPerSecondMs < everyFrameMs);
+    }
+
+    removeTempDir(dir);
+    return hostTestResult();
+}
@@ -0,0 +1,216 @@
+// Time to upload and draw a new picture every frame at 720p, 1080p and 4K, RGBA and YUV 4:2:0, through
+// RendererES3 onto a small surface. Redraws of pictures already uploaded tell drawing cost apart.
+// Pictures are also written ahead into unpack buffers of renderer, as VideoStreamer does from decoding thread, then
+// drawn without copying them. Writing ahead is timed apart, it is left off rendering thread.
+// Same bytes are uploaded with plain GL calls too: storage specified again by glTexImage2D every frame, as renderer
+// did before, and glTexSubImage2D into immutable storage, as it does now. Every measure waits for GPU with glFinish.
+// On a software GL driver, like Mesa llvmpipe, uploads are memory copies and numbers only compare paths.
+//
+// Options: --frames per measure.
+
+#include "HostTest.h"
+#include "RendererHarness.h"
+#include "vector"
+
+static const int SURFACE_WIDTH = 640, SURFACE_HEIGHT = 360;
+
+struct PictureSize {
+    const char *mName;
+    int mWidth, mHeight;
+};
+
+static const PictureSize SIZES[] = {
+        {"720p", 1280, 720},
+        {"1080p", 1920, 1080},
+        {"4K", 3840, 2160},
+};
+
+/** Two pictures of every plane, alternated so that every frame uploads other pixels. */
+struct TestPictures {
+    std::vector<uint8_t> mRgba[2];
+    std::vector<uint8_t> mYuv[2][3];
+
+    explicit TestPictures(int width, int height) {
+        for (int i = 0; i < 2; i++) {
+            mRgba[i].assign((size_t) width * height * 4, (uint8_t) (64 + i * 64));
+            mYuv[i][0].assign((size_t) width * height, (uint8_t) (64 + i * 64));
+            mYuv[i][1].assign((size_t) width * height / 4, 128);
+            mYuv[i][2].assign((size_t) width * height / 4, (uint8_t) (96 + i * 32));
+        }
+    }
+};
+
+struct Measure {
+    int64_t mCpuTimeNs = 0;
+    int64_t mWallTimeNs = 0;
+    int64_t mPrepareTimeNs = 0;
+    int64_t mBytes = 0;
+    int mNbFrames = 0;
+
+    void print(const char *size, const char *path) const {
+        printf("%-6s %-31s cpu %7.2f ms/frame  wall %7.2f ms/frame", size, path,
+               (double) mCpuTimeNs / mNbFrames / 1e6, (double) mWallTimeNs / mNbFrames / 1e6);
+        if (mBytes > 0) printf("  %8.1f MiB/s", (double) mBytes / ((double) mWallTimeNs / 1e9) / (1 << 20));
+        if (mPrepareTimeNs > 0) printf("  writing ahead %7.2f ms/frame", (double) mPrepareTimeNs / mNbFrames / 1e6);
+        printf("\n");
+    }
+};
+
+/** Run prepare then draw once per frame, only draw is timed with rendering costs.
+ * First frame is left out as it allocates storage. */
+template<typename Prepare, typename Draw>
+static Measure measure(int nbFrames, int64_t bytesPerFrame, Prepare prepare, Draw draw) {
+    prepare(0);
+    draw(0);
+    glFinish();
+    Measure result;
+    for (int i = 1; i <= nbFrames; i++) {
+        int64_t prepareStartNs = getThreadCpuTimeNs();
+        prepare(i);
+        result.mPrepareTimeNs += getThreadCpuTimeNs() - prepareStartNs;
+        int64_t cpuStartNs = getThreadCpuTimeNs();
+        int64_t wallStartNs = getWallTimeNs();
+        draw(i);
+        glFinish();
+        result.mCpuTimeNs += getThreadCpuTimeNs() - cpuStartNs;
+        result.mWallTimeNs += getWallTimeNs() - wallStartNs;
+        result.mBytes += bytesPerFrame;
+        result.mNbFrames++;
+    }
+    CHECK(RendererHarness::takeGlErrors() == 0);
+    return result;
+}
+
+template<typename Draw>
+static Measure measure(int nbFrames, int64_t bytesPerFrame, Draw draw) {
+    Measure result = measure(nbFrames, bytesPerFrame, [](int) {}, draw);
+    result.mPrepareTimeNs = 0;
+    return result;
+}
+
+/** Picture written into an unpack buffer of renderer, as a producer thread would before drawing. */
+struct WrittenAhead {
+    std::shared_ptr<UploadBufferPool> mPool;
+    int mIndex = -1;
+    uint8_t *mPtr = nullptr;
+
+    explicit WrittenAhead(RendererES3 *renderer) : mPool(renderer->getUploadPool()) {}
+
+    /** Copy planes one after another into a buffer, drawn picture buffer is given back first. */
+    void write(const std::vector<const std::vector<uint8_t> *> &planes) {
+        release();
+        size_t size = 0;
+        for (const std::vector<uint8_t> *plane : planes) size += plane->size();
+        mIndex = mPool->acquire((GLsizeiptr) size);
+        REQUIRE(mIndex >= 0);
+        mPtr = mPool->getPtr(mIndex);
+        size_t offset = 0;
+        for (const std::vector<uint8_t> *plane : planes) {
+            memcpy(mPtr + offset, plane->data(), plane->size());
+            offset += plane->size();
+        }
+    }
+
+    void release() {
+        if (mIndex >= 0) mPool->release(mIndex);
+        mIndex = -1;
+    }
+};
+
+static void runSize(const PictureSize &size, RendererES3 *renderer, int nbFrames) {
+    int width = size.mWidth, height = size.mHeight;
+    TestPictures pictures(width, height);
+
+    // Renderer, RGBA
+    int64_t rgbaBytes = (int64_t) width * height * 4;
+    int64_t nbUploads = renderer->getStats().mNbUploads;
+    measure(nbFrames, rgbaBytes, [&](int i) {
+        renderer->render(width, height, GL_RGBA, GL_RGBA, width * 4, pictures.mRgba[i % 2].data(), true);
+    }).print(size.mName, "renderer rgba");
+    CHECK(renderer->getStats().mNbUploads - nbUploads == nbFrames + 1);
+    measure(nbFrames, 0, [&](int /*i*/) {
+        renderer->render(width, height, GL_RGBA, GL_RGBA, width * 4, pictures.mRgba[0].data(), false);
+    }).print(size.mName, "renderer rgba redraw");
+
+    // Renderer, RGBA written ahead, buffers were mapped by draws above
+    WrittenAhead ahead(renderer);
+    int64_t nbPrefilled = renderer->getStats().mNbPrefilledUploads;
+    measure(nbFrames, rgbaBytes, [&](int i) {
+        ahead.write({&pictures.mRgba[i % 2]});
+    }, [&](int /*i*/) {
+        renderer->render(width, height, GL_RGBA, GL_RGBA, width * 4, ahead.mPtr, true);
+    }).print(size.mName, "renderer rgba written ahead");
+    CHECK(renderer->getStats().mNbPrefilledUploads - nbPrefilled == nbFrames + 1);
+    ahead.release();
+
+    // Renderer, YUV 4:2:0
+    int64_t yuvBytes = (int64_t) width * height * 3 / 2;
+    auto getYuvPicture = [&](int i) {
+        YuvPicture picture;
+        picture.mWidth = width;
+        picture.mHeight = height;
+        picture.mChromaWidth = width / 2;
+        picture.mChromaHeight = height / 2;
+        for (int p = 0; p < 3; p++) {
+            picture.mData[p] = pictures.mYuv[i % 2][p].data();
+            picture.mLinesize[p] = p == 0 ? width : width / 2;
+        }
+        return picture;
+    };
+    measure(nbFrames, yuvBytes, [&](int i) {
+        renderer->renderYuv(getYuvPicture(i), true);
+    }).print(size.mName, "renderer yuv420p");
+    measure(nbFrames, 0, [&](int /*i*/) {
+        renderer->renderYuv(getYuvPicture(0), false);
+    }).print(size.mName, "renderer yuv420p redraw");
+
+    // Renderer, YUV 4:2:0 written ahead
+    nbPrefilled = renderer->getStats().mNbPrefilledUploads;
+    measure(nbFrames, yuvBytes, [&](int i) {
+        const auto &yuv = pictures.mYuv[i % 2];
+        ahead.write({&yuv[0], &yuv[1], &yuv[2]});
+    }, [&](int i) {
+        YuvPicture picture = getYuvPicture(i);
+        picture.mData[0] = ahead.mPtr;
+        picture.mData[1] = ahead.mPtr + pictures.mYuv[0][0].size();
+        picture.mData[2] = picture.mData[1] + pictures.mYuv[0][1].size();
+        renderer->renderYuv(picture, true);
+    }).print(size.mName, "renderer yuv420p written ahead");
+    CHECK(renderer->getStats().mNbPrefilledUploads - nbPrefilled == nbFrames + 1);
+    ahead.release();
+
+    // Plain GL, same RGBA pixels into a texture of its own
+    GLuint textureId;
+    glGenTextures(1, &textureId);
+    glBindTexture(GL_TEXTURE_2D, textureId);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    measure(nbFrames, rgbaBytes, [&](int i) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                     pictures.mRgba[i % 2].data());
+    }).print(size.mName, "glTexImage2D every frame");
+    glDeleteTextures(1, &textureId);
+
+    glGenTextures(1, &textureId);
+    glBindTexture(GL_TEXTURE_2D, textureId);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+    measure(nbFrames, rgbaBytes, [&](int i) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE,
+                        pictures.mRgba[i % 2].data());
+    }).print(size.mName, "glTexSubImage2D immutable");
+    glDeleteTextures(1, &textureId);
+}
+
+int main(int argc, char **argv) {
+    int nbFrames = (int) getIntOption(argc, argv, "frames", 20);
+    RendererHarness harness;
+    REQUIRE(harness.init(SURFACE_WIDTH, SURFACE_HEIGHT));
+    RendererES3 *renderer = *harness.getRenderer();
+    printf("%s, %s\n", glGetString(GL_RENDERER), glGetString(GL_VERSION));
+    for (const PictureSize &size : SIZES) {
+        if (size.mWidth > RendererES3::getMaxTextureSize()) continue;
+        runSize(size, renderer, nbFrames);
+    }
+    return hostTestResult();
+}
@@ -0,0 +1,123 @@
+// Conversion of 720p and 1080p streams drawn on thumbnail and picture-in-picture surfaces, at full size as video
+// streamer did before it knew the viewport, and at the smallest size filling the viewport, as it does now.
+// Full size is what a streamer converts to on a surface as big as source. Frames are converted to RGB as decoding
+// thread would and drawn as rendering thread would, which tells streamer the viewport.
+// Reported are CPU time of the converting thread per frame, and bytes of every frame uploaded, which is what it takes
+// while it waits in frame buffer.
+//
+// Options: --frames per measure.
+
+#include "HostTest.h"
+#include "RendererHarness.h"
+#include "SyntheticSource.h"
+#include "VideoStreamerBuilder.h"
+#include "vector"
+
+struct PictureSize {
+    const char *mName;
+    int mWidth, mHeight;
+};
+
+static const PictureSize SRC_SIZES[] = {
+        {"720p", 1280, 720},
+        {"1080p", 1920, 1080},
+};
+
+static const PictureSize SURFACE_SIZES[] = {
+        {"thumbnail", 320, 180},
+        {"PiP", 480, 270},
+};
+
+// Distinct source frames, generating them is left out of measures
+static const int NB_SOURCE_FRAMES = 8;
+// Frames fed before measuring, frame buffer leaves buffering state and streamer learns viewport
+static const int NB_WARMUP_FRAMES = 40;
+
+struct Measure {
+    int64_t mCpuTimeNs = 0;
+    int64_t mNbPixels = 0;
+    int64_t mFrameBytes = 0;
+    int mNbFrames = 0;
+
+    void print(const char *src, const char *surface, const char *path) const {
+        printf("%-6s %-10s %-9s cpu %7.2f ms/frame  %8.0f pixels/frame  %8.1f KiB buffered/frame\n", src, surface, path,
+               (double) mCpuTimeNs / mNbFrames / 1e6, (double) mNbPixels / mNbFrames,
+               (double) mFrameBytes / mNbFrames / 1024.0);
+    }
+};
+
+/** Feed frames into a streamer drawing on a surface of given size, one drawn after each, only feeding is timed. */
+static Measure run(const std::vector<AVFrame *> &frames, const PictureSize &surface, int nbFrames) {
+    RendererHarness harness;
+    REQUIRE(harness.init(surface.mWidth, surface.mHeight));
+    const AVFrame *src = frames[0];
+    VideoStreamerBuilder builder;
+    builder.setRenderer(harness.getRenderer())
+            ->setVideoTimeBase(av_make_q(1, 30))
+            ->setSrcWidth(src->width)
+            ->setSrcHeight(src->height)
+            ->setSrcPixelFormat(AV_PIX_FMT_YUV420P)
+            ->setPixelFormat(GL_RGB)
+            ->setInternalPixelFormat(GL_RGB)
+            ->setYuvRenderingEnabled(false);
+    VideoStreamer *streamer = builder.buildVideoStreamer();
+    REQUIRE(streamer);
+
+    int64_t index = 0;
+    auto feed = [&]() {
+        AVFrame *frame = frames[index % NB_SOURCE_FRAMES];
+        frame->pts = frame->best_effort_timestamp = index;
+        CHECK(streamer->onVideoFrame(frame));
+        index++;
+    };
+    for (int i = 0; i < NB_WARMUP_FRAMES; i++) {
+        feed();
+        harness.draw(streamer);
+    }
+
+    Measure result;
+    int64_t nbPixels = streamer->getStats().mNbPixelsConverted;
+    for (int i = 0; i < nbFrames; i++) {
+        int64_t cpuStartNs = getThreadCpuTimeNs();
+        feed();
+        result.mCpuTimeNs += getThreadCpuTimeNs() - cpuStartNs;
+        FrameReport report = harness.draw(streamer);
+        CHECK(report.mNbGlErrors == 0);
+        REQUIRE(report.mUploadedBytes > 0);
+        result.mFrameBytes += report.mUploadedBytes;
+        result.mNbFrames++;
+    }
+    result.mNbPixels = streamer->getStats().mNbPixelsConverted - nbPixels;
+    delete streamer;
+    return result;
+}
+
+int main(int argc, char **argv) {
+    int nbFrames = (int) getIntOption(argc, argv, "frames", 100);
+
+    for (const PictureSize &srcSize : SRC_SIZES) {
+        SyntheticSource source;
+        REQUIRE(source.init(srcSize.mWidth, srcSize.mHeight, AV_PIX_FMT_YUV420P));
+        std::vector<AVFrame *> frames;
+        for (int i = 0; i < NB_SOURCE_FRAMES; i++) {
+            AVFrame *frame = av_frame_clone(source.getFrame(i));
+            REQUIRE(frame);
+            REQUIRE(av_frame_make_writable(frame) >= 0);
+            frames.push_back(frame);
+        }
+
+        Measure full = run(frames, srcSize, nbFrames);
+        for (const PictureSize &surface : SURFACE_SIZES) {
+            Measure fitted = run(frames, surface, nbFrames);
+            full.print(srcSize.mName, surface.mName, "full");
+            fitted.print(srcSize.mName, surface.mName, "viewport");
+
+            // Fitted frames are no bigger than viewport, rounded up to even sizes
+            CHECK(full.mNbPixels == (int64_t) srcSize.mWidth * srcSize.mHeight * nbFrames);
+            CHECK(fitted.mNbPixels <= (int64_t) (surface.mWidth + 1) * (surface.mHeight + 1) * nbFrames);
+            CHECK(fitted.mFrameBytes < full.mFrameBytes);
+        }
+        for (AVFrame *frame : frames) av_frame_free(&frame);
+    }
+    return hostTestResult();
+}
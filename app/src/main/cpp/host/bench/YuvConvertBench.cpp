@@ -0,0 +1,166 @@
+// Same-size YUV 4:2:0 to RGB conversion at 720p, 1080p and 4K, through the kernels VideoStreamer picks when no
+// scaling is needed, against the bicubic sws_scale it used before, set to the same BT.709 limited range matrix.
+// swscale is timed with the SIMD code of the FFmpeg it links to, if any, then with SIMD turned off, as in vendored
+// x86 builds configured with --disable-asm.
+// Time is CPU time of the converting thread per picture, least of several runs. Host builds are unoptimized unless
+// configured with -DCMAKE_BUILD_TYPE=Release, as the app is. Kernel output is checked against a floating point
+// conversion with the renderer's matrix.
+//
+// Options: --runs per conversion.
+
+#include "HostTest.h"
+#include "YuvConverter.h"
+#include "FFmpegHelper.h"
+#include "algorithm"
+#include "cmath"
+
+extern "C" {
+#include "libavutil/cpu.h"
+#include "libswscale/swscale.h"
+}
+
+struct PictureSize {
+    const char *mName;
+    int mWidth, mHeight;
+};
+
+static const PictureSize SIZES[] = {
+        {"720p", 1280, 720},
+        {"1080p", 1920, 1080},
+        {"4K", 3840, 2160},
+};
+
+static const AVPixelFormat SRC_PIX_FMTS[] = {AV_PIX_FMT_YUV420P, AV_PIX_FMT_NV12, AV_PIX_FMT_NV21};
+static const AVPixelFormat DST_PIX_FMTS[] = {AV_PIX_FMT_RGB24, AV_PIX_FMT_RGBA};
+
+/** Fill every plane with noise, so that values reach both ends of RGB and get clipped. */
+static void fillNoise(AVFrame *frame) {
+    uint32_t state = 1;
+    for (int plane = 0; plane < 3 && frame->data[plane]; plane++) {
+        // Chroma planes are half height, interleaved chroma is as wide in bytes as luma
+        int height = plane == 0 ? frame->height : (frame->height + 1) / 2;
+        for (int row = 0; row < height; row++) {
+            uint8_t *line = frame->data[plane] + (ptrdiff_t) row * frame->linesize[plane];
+            for (int i = 0; i < frame->linesize[plane]; i++) {
+                state = state * 1664525 + 1013904223;
+                line[i] = (uint8_t) (state >> 24);
+            }
+        }
+    }
+}
+
+/** Describe frame as VideoStreamer does for an 8 bit 4:2:0 frame of BT.709 limited range. */
+static YuvPicture getPicture(const AVFrame *frame) {
+    YuvPicture picture;
+    auto pixFmt = (AVPixelFormat) frame->format;
+    picture.mLayout = pixFmt == AV_PIX_FMT_YUV420P ? YuvLayout::PLANAR : YuvLayout::SEMI_PLANAR;
+    picture.mIsSwapped = pixFmt == AV_PIX_FMT_NV21;
+    picture.mWidth = frame->width;
+    picture.mHeight = frame->height;
+    picture.mChromaWidth = (frame->width + 1) / 2;
+    picture.mChromaHeight = (frame->height + 1) / 2;
+    picture.mMatrix = YuvMatrix::BT709;
+    picture.mIsFullRange = false;
+    for (int i = 0; i < 3; i++) {
+        picture.mData[i] = frame->data[i];
+        picture.mLinesize[i] = frame->linesize[i];
+    }
+    return picture;
+}
+
+/** Return largest difference in levels between any channel of dst and a floating point conversion of picture. */
+static int getMaxError(const YuvPicture &picture, const AVFrame *dst) {
+    GLfloat yuvToRgb[9], yuvOffset[3];
+    RendererES3::getYuvToRgb(picture.mMatrix, picture.mIsFullRange, 8, yuvToRgb, yuvOffset);
+    int bytesPerPixel = dst->format == AV_PIX_FMT_RGBA ? 4 : 3;
+    int maxError = 0;
+    for (int row = 0; row < picture.mHeight; row++) {
+        const uint8_t *y = picture.mData[0] + (ptrdiff_t) row * picture.mLinesize[0];
+        const uint8_t *u = picture.mData[1] + (ptrdiff_t) (row / 2) * picture.mLinesize[1];
+        const uint8_t *v = picture.mData[2] + (ptrdiff_t) (row / 2) * picture.mLinesize[2];
+        const uint8_t *rgb = dst->data[0] + (ptrdiff_t) row * dst->linesize[0];
+        for (int col = 0; col < picture.mWidth; col++) {
+            int cu, cv;
+            if (picture.mLayout == YuvLayout::PLANAR) {
+                cu = u[col / 2], cv = v[col / 2];
+            } else {
+                cu = u[col / 2 * 2 + picture.mIsSwapped], cv = u[col / 2 * 2 + !picture.mIsSwapped];
+            }
+            double yuv[3] = {y[col] / 255.0 - yuvOffset[0], cu / 255.0 - yuvOffset[1], cv / 255.0 - yuvOffset[2]};
+            for (int c = 0; c < 3; c++) {
+                double value = yuvToRgb[c] * yuv[0] + yuvToRgb[3 + c] * yuv[1] + yuvToRgb[6 + c] * yuv[2];
+                auto expected = (int) lrint(av_clipd(value * 255.0, 0, 255));
+                maxError = std::max(maxError, abs(rgb[col * bytesPerPixel + c] - expected));
+            }
+        }
+    }
+    return maxError;
+}
+
+/** Return least CPU time in ms of convert over nbRuns runs. */
+template<typename Convert>
+static double measure(long nbRuns, Convert convert) {
+    int64_t bestNs = INT64_MAX;
+    for (long run = 0; run < nbRuns; run++) {
+        int64_t startNs = getThreadCpuTimeNs();
+        convert();
+        bestNs = std::min(bestNs, getThreadCpuTimeNs() - startNs);
+    }
+    return (double) bestNs / 1e6;
+}
+
+/** Return least CPU time in ms of bicubic sws_scale over nbRuns runs, scaler CPU flags are taken when it is created. */
+static double measureSws(const AVFrame *src, AVFrame *dst, long nbRuns, bool isSimd) {
+    if (!isSimd) av_force_cpu_flags(0);
+    SwsContext *swsCtx = sws_getContext(src->width, src->height, (AVPixelFormat) src->format, dst->width, dst->height,
+                                        (AVPixelFormat) dst->format, SWS_BICUBIC, nullptr, nullptr, nullptr);
+    av_force_cpu_flags(-1);
+    REQUIRE(swsCtx);
+    const int *table = sws_getCoefficients(SWS_CS_ITU709);
+    sws_setColorspaceDetails(swsCtx, table, 0, table, 1, 0, 1 << 16, 1 << 16);
+    double ms = measure(nbRuns, [&]() {
+        CHECK(sws_scale_frame(swsCtx, dst, src) >= 0);
+    });
+    sws_freeContext(swsCtx);
+    return ms;
+}
+
+int main(int argc, char **argv) {
+    long nbRuns = getIntOption(argc, argv, "runs", 15);
+
+    printf("%-6s %-16s %10s %10s %10s\n", "size", "conversion", "kernel ms", "sws ms", "sws C ms");
+    for (const PictureSize &size : SIZES) {
+        for (AVPixelFormat srcPixFmt : SRC_PIX_FMTS) {
+            AVFrame *src = FFmpegHelper::allocatePictureFrame(size.mWidth, size.mHeight, srcPixFmt);
+            REQUIRE(src);
+            fillNoise(src);
+            YuvPicture picture = getPicture(src);
+            for (AVPixelFormat dstPixFmt : DST_PIX_FMTS) {
+                AVFrame *dst = FFmpegHelper::allocatePictureFrame(size.mWidth, size.mHeight, dstPixFmt);
+                REQUIRE(dst);
+
+                double swsMs = measureSws(src, dst, nbRuns, true);
+                double swsCMs = measureSws(src, dst, nbRuns, false);
+
+                char name[32];
+                snprintf(name, sizeof(name), "%s->%s", av_get_pix_fmt_name(srcPixFmt), av_get_pix_fmt_name(dstPixFmt));
+                // Planar pictures stay on swscale without SIMD kernels
+                if (!YuvConverter::isSupported(srcPixFmt, dstPixFmt)) {
+                    printf("%-6s %-16s %10s %10.2f %10.2f\n", size.mName, name, "swscale", swsMs, swsCMs);
+                    av_frame_free(&dst);
+                    continue;
+                }
+                double kernelMs = measure(nbRuns, [&]() {
+                    CHECK(YuvConverter::convert(picture, dst));
+                });
+                int maxError = getMaxError(picture, dst);
+                printf("%-6s %-16s %10.2f %10.2f %10.2f  max error %d\n", size.mName, name, kernelMs, swsMs, swsCMs,
+                       maxError);
+                CHECK(maxError <= 1);
+                av_frame_free(&dst);
+            }
+            av_frame_free(&src);
+        }
+    }
+    return hostTestResult();
+}
@@ -0,0 +1,56 @@
+#include "AllocCounter.h"
+
+#include "atomic"
+#include "cerrno"
+#include "cstddef"
+
+extern "C" {
+// C library allocators, interposed functions forward to them
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+}
+
+static std::atomic_int64_t sNbAllocs = {0};
+
+int64_t getNbAllocs() {
+    return sNbAllocs.load(std::memory_order_relaxed);
+}
+
+extern "C" {
+
+void *malloc(size_t size) {
+    sNbAllocs.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    sNbAllocs.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    sNbAllocs.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+void *memalign(size_t alignment, size_t size) {
+    sNbAllocs.fetch_add(1, std::memory_order_relaxed);
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    return memalign(alignment, size);
+}
+
+// FFmpeg allocates through av_malloc, which uses posix_memalign
+int posix_memalign(void **ptr, size_t alignment, size_t size) {
+    if (alignment < sizeof(void *) || (alignment & (alignment - 1))) return EINVAL;
+    void *p = memalign(alignment, size);
+    if (!p && size) return ENOMEM;
+    *ptr = p;
+    return 0;
+}
+
+}
@@ -0,0 +1,12 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include "cstdint"
+
+// Counts heap allocations of the whole process, FFmpeg libraries included, by interposing malloc and friends
+// over the C library ones. Only programs calling getNbAllocs() link it in, counting costs one atomic increment.
+
+/** Return number of malloc, calloc, realloc and aligned allocations made so far by every thread. */
+int64_t getNbAllocs();
+
+#endif //ALLOC_COUNTER_H
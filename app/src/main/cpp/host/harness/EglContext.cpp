@@ -0,0 +1,100 @@
+#include "EglContext.h"
+#include "EGL/eglext.h"
+#include "cstring"
+#include "JNILogHelper.h"
+
+#define LOG_TAG "EglContext"
+
+EglContext::~EglContext() {
+    destroy();
+}
+
+EGLDisplay EglContext::getDisplay() {
+    const char *extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (extensions && strstr(extensions, "EGL_MESA_platform_surfaceless")) {
+        auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay) {
+            EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+            if (display != EGL_NO_DISPLAY) return display;
+        }
+    }
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+bool EglContext::create(int width, int height, EGLContext shareContext) {
+    destroy();
+    mDisplay = getDisplay();
+    if (mDisplay == EGL_NO_DISPLAY || !eglInitialize(mDisplay, nullptr, nullptr)) {
+        LOGE("Failed to initialize EGL display, error 0x%x", eglGetError());
+        return false;
+    }
+    if (!eglBindAPI(EGL_OPENGL_ES_API)) {
+        LOGE("Failed to bind OpenGL ES API, error 0x%x", eglGetError());
+        return false;
+    }
+
+    const EGLint configAttribs[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT,
+            EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+            EGL_NONE
+    };
+    EGLConfig config;
+    EGLint nbConfigs = 0;
+    if (!eglChooseConfig(mDisplay, configAttribs, &config, 1, &nbConfigs) || nbConfigs < 1) {
+        LOGE("No EGL config with an OpenGL ES 3 pbuffer, error 0x%x", eglGetError());
+        return false;
+    }
+
+    const EGLint surfaceAttribs[] = {EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE};
+    mSurface = eglCreatePbufferSurface(mDisplay, config, surfaceAttribs);
+    if (mSurface == EGL_NO_SURFACE) {
+        LOGE("Failed to create %dx%d pbuffer, error 0x%x", width, height, eglGetError());
+        return false;
+    }
+
+    const EGLint contextAttribs[] = {EGL_CONTEXT_CLIENT_VERSION, 3, EGL_NONE};
+    mContext = eglCreateContext(mDisplay, config, shareContext, contextAttribs);
+    if (mContext == EGL_NO_CONTEXT) {
+        LOGE("Failed to create OpenGL ES 3 context, error 0x%x", eglGetError());
+        return false;
+    }
+    mWidth = width;
+    mHeight = height;
+    return makeCurrent();
+}
+
+bool EglContext::makeCurrent() {
+    if (!eglMakeCurrent(mDisplay, mSurface, mSurface, mContext)) {
+        LOGE("Failed to make context current, error 0x%x", eglGetError());
+        return false;
+    }
+    return true;
+}
+
+void EglContext::releaseCurrent() {
+    if (mDisplay != EGL_NO_DISPLAY) eglMakeCurrent(mDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+}
+
+void EglContext::destroy() {
+    if (mDisplay == EGL_NO_DISPLAY) return;
+    if (eglGetCurrentContext() == mContext) releaseCurrent();
+    if (mContext != EGL_NO_CONTEXT) eglDestroyContext(mDisplay, mContext);
+    if (mSurface != EGL_NO_SURFACE) eglDestroySurface(mDisplay, mSurface);
+    // Display is shared by every context of the process, it is left initialized
+    mDisplay = EGL_NO_DISPLAY;
+    mContext = EGL_NO_CONTEXT;
+    mSurface = EGL_NO_SURFACE;
+}
+
+EGLContext EglContext::getContext() const {
+    return mContext;
+}
+
+int EglContext::getWidth() const {
+    return mWidth;
+}
+
+int EglContext::getHeight() const {
+    return mHeight;
+}
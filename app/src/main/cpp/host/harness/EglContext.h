@@ -0,0 +1,41 @@
+#ifndef EGL_CONTEXT_H
+#define EGL_CONTEXT_H
+
+#include "EGL/egl.h"
+
+/** An OpenGL ES 3 context drawing into an offscreen pbuffer, for running renderers without a window.
+ * Mesa surfaceless platform is used when available, so no display server is needed. */
+class EglContext {
+private:
+    EGLDisplay mDisplay = EGL_NO_DISPLAY;
+    EGLContext mContext = EGL_NO_CONTEXT;
+    EGLSurface mSurface = EGL_NO_SURFACE;
+    int mWidth = 0, mHeight = 0;
+
+private:
+    static EGLDisplay getDisplay();
+
+public:
+    ~EglContext();
+
+    /** Create context with a pbuffer surface of given size and make it current on calling thread.
+     * @param shareContext context to share textures and buffers with, EGL_NO_CONTEXT for none
+     * @return true if context is current */
+    bool create(int width, int height, EGLContext shareContext = EGL_NO_CONTEXT);
+
+    /** Make context current on calling thread, it must not be current on another thread. */
+    bool makeCurrent();
+
+    /** Release context from calling thread so another thread can make it current. */
+    void releaseCurrent();
+
+    void destroy();
+
+    EGLContext getContext() const;
+
+    int getWidth() const;
+
+    int getHeight() const;
+};
+
+#endif //EGL_CONTEXT_H
@@ -0,0 +1,82 @@
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+// Minimal checks for host tests and benchmarks, a failed check is reported and counted but does not abort.
+// Each test program returns hostTestResult() from main, so that ctest sees failures.
+
+#include "cstdio"
+#include "cstdlib"
+#include "cstdint"
+#include "cstring"
+#include "ctime"
+
+inline int &hostTestFailures() {
+    static int nbFailures = 0;
+    return nbFailures;
+}
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            hostTestFailures()++; \
+        } \
+    } while (0)
+
+#define CHECK_NEAR(value, expected, tolerance) \
+    do { \
+        double v_ = (double) (value), e_ = (double) (expected); \
+        if (v_ < e_ - (tolerance) || v_ > e_ + (tolerance)) { \
+            fprintf(stderr, "%s:%d: check failed: %s = %g, expected %g +/- %g\n", __FILE__, __LINE__, #value, v_, e_, \
+                    (double) (tolerance)); \
+            hostTestFailures()++; \
+        } \
+    } while (0)
+
+/** Abort test program right away, for failures nothing else can be checked after. */
+#define REQUIRE(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: requirement failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(1); \
+        } \
+    } while (0)
+
+inline int hostTestResult() {
+    if (hostTestFailures() > 0) fprintf(stderr, "%d check(s) failed\n", hostTestFailures());
+    return hostTestFailures() > 0 ? 1 : 0;
+}
+
+/** CPU time spent by calling thread. */
+inline int64_t getThreadCpuTimeNs() {
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/** CPU time spent by every thread of the process. */
+inline int64_t getProcessCpuTimeNs() {
+    timespec ts{};
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+inline int64_t getWallTimeNs() {
+    timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/** Return value of integer option "--name=value" from command line, defaultValue if absent.
+ * Benchmarks run a short pass by default so ctest stays fast, options make them run longer. */
+inline long getIntOption(int argc, char **argv, const char *name, long defaultValue) {
+    size_t length = strlen(name);
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) == 0 && strncmp(argv[i] + 2, name, length) == 0 && argv[i][2 + length] == '=') {
+            return strtol(argv[i] + 3 + length, nullptr, 10);
+        }
+    }
+    return defaultValue;
+}
+
+#endif //HOST_TEST_H
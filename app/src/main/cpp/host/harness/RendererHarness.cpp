@@ -0,0 +1,95 @@
+#include "RendererHarness.h"
+#include "HostTest.h"
+
+void HarnessSummary::add(const FrameReport &report) {
+    mNbFrames++;
+    mCpuTimeNs += report.mCpuTimeNs;
+    mWallTimeNs += report.mWallTimeNs;
+    mUploadedBytes += report.mUploadedBytes;
+    mNbGlErrors += report.mNbGlErrors;
+}
+
+void HarnessSummary::print(const char *name) const {
+    if (mNbFrames == 0) return;
+    double bandwidth = mWallTimeNs > 0 ? (double) mUploadedBytes / ((double) mWallTimeNs / 1e9) / (1 << 20) : 0.0;
+    printf("%-28s frames %5d  cpu %8.1f us/frame  wall %8.1f us/frame  upload %8.1f MiB/s  gl errors %d\n",
+           name, mNbFrames, (double) mCpuTimeNs / mNbFrames / 1000.0, (double) mWallTimeNs / mNbFrames / 1000.0,
+           bandwidth, mNbGlErrors);
+}
+
+RendererHarness::~RendererHarness() {
+    // Renderer releases its GL objects only while its context is current
+    if (mRenderer) mContext.makeCurrent();
+    delete mRenderer;
+}
+
+bool RendererHarness::init(int surfaceWidth, int surfaceHeight, const char *programCacheDir) {
+    if (!mContext.create(surfaceWidth, surfaceHeight)) return false;
+    mRenderer = new RendererES3();
+    if (!mRenderer->init(programCacheDir)) {
+        delete mRenderer;
+        mRenderer = nullptr;
+        return false;
+    }
+    mRenderer->resize(surfaceWidth, surfaceHeight);
+    takeGlErrors();
+    return true;
+}
+
+RendererES3 **RendererHarness::getRenderer() {
+    return &mRenderer;
+}
+
+EglContext *RendererHarness::getContext() {
+    return &mContext;
+}
+
+int RendererHarness::takeGlErrors() {
+    static int64_t sLastNbErrors = 0;
+    int nbErrors = (int) (getNbGlErrors() - sLastNbErrors);
+    sLastNbErrors = getNbGlErrors();
+    while (glGetError() != GL_NO_ERROR) nbErrors++;
+    return nbErrors;
+}
+
+FrameReport RendererHarness::drawFrame(VideoStreamer *streamer, AVFrame *frame) {
+    int64_t cpuStartNs = getThreadCpuTimeNs();
+    int64_t wallStartNs = getWallTimeNs();
+    // Decoder retries a frame until buffer has room for it, each draw takes one frame out
+    for (int i = 0; i < 2 && !streamer->onVideoFrame(frame); i++) draw(streamer);
+    int64_t cpuTimeNs = getThreadCpuTimeNs() - cpuStartNs;
+    int64_t wallTimeNs = getWallTimeNs() - wallStartNs;
+
+    FrameReport report = draw(streamer);
+    report.mCpuTimeNs += cpuTimeNs;
+    report.mWallTimeNs += wallTimeNs;
+    return report;
+}
+
+FrameReport RendererHarness::draw(VideoStreamer *streamer, int64_t vsyncNs, int64_t vsyncPeriodNs) {
+    FrameReport report;
+    int64_t uploadedBytes = mRenderer->getStats().mNbUploadedBytes;
+    int64_t cpuStartNs = getThreadCpuTimeNs();
+    int64_t wallStartNs = getWallTimeNs();
+    streamer->render(vsyncNs, vsyncPeriodNs);
+    report.mCpuTimeNs = getThreadCpuTimeNs() - cpuStartNs;
+    // Uploads and draws only complete on GPU, wait for them so their cost is measured
+    glFinish();
+    report.mWallTimeNs = getWallTimeNs() - wallStartNs;
+    report.mUploadedBytes = mRenderer->getStats().mNbUploadedBytes - uploadedBytes;
+    report.mNbGlErrors = takeGlErrors();
+    return report;
+}
+
+void RendererHarness::readPixels(std::vector<uint8_t> *pixels) {
+    int width = mContext.getWidth(), height = mContext.getHeight();
+    std::vector<uint8_t> rows((size_t) width * height * 4);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rows.data());
+    // GL rows start from the bottom
+    pixels->resize(rows.size());
+    for (int y = 0; y < height; y++) {
+        memcpy(pixels->data() + (size_t) y * width * 4, rows.data() + (size_t) (height - 1 - y) * width * 4,
+               (size_t) width * 4);
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef RENDERER_HARNESS_H
+#define RENDERER_HARNESS_H
+
+#include "EglContext.h"
+#include "RendererES3.h"
+#include "VideoStreamer.h"
+#include "vector"
+
+/** Measures of a single frame going through a video streamer onto surface. */
+struct FrameReport {
+    int64_t mCpuTimeNs = 0; // Thread CPU time spent converting, buffering and drawing frame
+    int64_t mWallTimeNs = 0; // Time until GPU finished drawing, uploads included
+    int64_t mUploadedBytes = 0; // Bytes uploaded into textures for this frame
+    int mNbGlErrors = 0;
+};
+
+/** Totals of many frame reports. */
+struct HarnessSummary {
+    int mNbFrames = 0;
+    int64_t mCpuTimeNs = 0;
+    int64_t mWallTimeNs = 0;
+    int64_t mUploadedBytes = 0;
+    int mNbGlErrors = 0;
+
+    void add(const FrameReport &report);
+
+    /** Print average CPU time per frame, upload bandwidth and GL errors under given name. */
+    void print(const char *name) const;
+};
+
+/** Runs renderer on an offscreen surface the way GL thread of app does, so that drawing paths can be checked
+ * and measured without a device. Frames are fed into a video streamer as decoder would and drawn through it. */
+class RendererHarness {
+private:
+    EglContext mContext;
+    RendererES3 *mRenderer = nullptr;
+
+public:
+    ~RendererHarness();
+
+    /** Create context and renderer drawing on a surface of given size.
+     * @param programCacheDir where renderer caches program binaries, null for none */
+    bool init(int surfaceWidth, int surfaceHeight, const char *programCacheDir = nullptr);
+
+    /** Return renderer slot to build video streamers with, as app does. */
+    RendererES3 **getRenderer();
+
+    EglContext *getContext();
+
+    /** Feed frame into streamer as decoder would and draw once as GL thread would.
+     * Streamer has no clock, it draws frames in order once its buffer got out of buffering state. */
+    FrameReport drawFrame(VideoStreamer *streamer, AVFrame *frame);
+
+    /** Draw streamer again without feeding a frame. */
+    FrameReport draw(VideoStreamer *streamer, int64_t vsyncNs = 0, int64_t vsyncPeriodNs = 0);
+
+    /** Read surface back as RGBA, rows from top to bottom. */
+    void readPixels(std::vector<uint8_t> *pixels);
+
+    /** Return number of GL errors raised so far and clear pending ones. */
+    static int takeGlErrors();
+};
+
+#endif //RENDERER_HARNESS_H
@@ -0,0 +1,48 @@
+#include "SyntheticAudio.h"
+#include "FFmpegHelper.h"
+#include "cmath"
+#include "thread"
+
+SyntheticAudio::~SyntheticAudio() {
+    av_frame_free(&mFrame);
+}
+
+bool SyntheticAudio::init(int sampleRate, int frameSize, double frequency) {
+    mSampleRate = sampleRate;
+    mFrameSize = frameSize;
+    mFrequency = frequency;
+    mPts = 0;
+    mIsFilled = false;
+    av_frame_free(&mFrame);
+    mFrame = FFmpegHelper::allocateAudioFrame(sampleRate, AV_CH_LAYOUT_STEREO, frameSize, AV_SAMPLE_FMT_FLTP);
+    return mFrame != nullptr;
+}
+
+int64_t SyntheticAudio::getPts() const {
+    return mPts;
+}
+
+bool SyntheticAudio::feed(AudioSink *sink) {
+    if (!mIsFilled) {
+        if (av_frame_make_writable(mFrame) < 0) return false;
+        for (int c = 0; c < 2; c++) {
+            auto *samples = (float *) mFrame->data[c];
+            for (int i = 0; i < mFrameSize; i++) {
+                samples[i] = 0.5f * (float) sin(2.0 * M_PI * mFrequency * (double) (mPts + i) / mSampleRate);
+            }
+        }
+        mFrame->pts = mFrame->best_effort_timestamp = mPts;
+        mIsFilled = true;
+    }
+    if (!sink->onAudioFrame(mFrame)) return false;
+    mPts += mFrameSize;
+    mIsFilled = false;
+    return true;
+}
+
+void SyntheticAudio::run(AudioSink *sink, const std::atomic_bool *isStopped) {
+    while (!*isStopped) {
+        // Sample ring is full, a decoder would wait the same way
+        if (!feed(sink)) std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef SYNTHETIC_AUDIO_H
+#define SYNTHETIC_AUDIO_H
+
+#include "Sink.h"
+#include "atomic"
+#include "cstdint"
+
+/** Generates frames of a stereo sine standing in for decoded audio, float planar as AAC decoders output them.
+ * Frame pts count samples from 0, a frame is kept until a sink takes it, so that none is skipped. */
+class SyntheticAudio {
+private:
+    int mSampleRate = 0;
+    int mFrameSize = 0;
+    double mFrequency = 0;
+    AVFrame *mFrame = nullptr;
+    int64_t mPts = 0;
+    bool mIsFilled = false;
+
+public:
+    ~SyntheticAudio();
+
+    bool init(int sampleRate, int frameSize, double frequency);
+
+    /** Return pts of next frame fed, in samples. */
+    int64_t getPts() const;
+
+    /** Feed next frame into sink as decoder would.
+     * @return true if sink took it, false if sink is full */
+    bool feed(AudioSink *sink);
+
+    /** Feed frames as fast as sink takes them until stopped, waiting as decoder would while sink is full.
+     * Run on a thread of its own. */
+    void run(AudioSink *sink, const std::atomic_bool *isStopped);
+};
+
+#endif //SYNTHETIC_AUDIO_H
@@ -0,0 +1,164 @@
+#include "SyntheticMedia.h"
+#include "SyntheticSource.h"
+#include "JNILogHelper.h"
+
+extern "C" {
+#include "libavformat/avformat.h"
+#include "libavcodec/avcodec.h"
+#include "libavutil/channel_layout.h"
+}
+#include "cmath"
+#include "cstring"
+#include "dirent.h"
+#include "unistd.h"
+
+#define LOG_TAG "SyntheticMedia"
+
+namespace {
+
+/** One encoded stream of the file being written. */
+struct OutputStream {
+    AVCodecContext *mCodecCtx = nullptr;
+    AVStream *mStream = nullptr;
+    AVFrame *mFrame = nullptr;
+    int64_t mNextPts = 0;
+
+    ~OutputStream() {
+        avcodec_free_context(&mCodecCtx);
+        av_frame_free(&mFrame);
+    }
+};
+
+bool openStream(AVFormatContext *fmtCtx, OutputStream *ost, AVCodecID codecId,
+                const SyntheticMediaOptions &options) {
+    const AVCodec *codec = avcodec_find_encoder(codecId);
+    if (!codec) {
+        LOGE("No %s encoder", avcodec_get_name(codecId));
+        return false;
+    }
+    ost->mStream = avformat_new_stream(fmtCtx, nullptr);
+    ost->mCodecCtx = avcodec_alloc_context3(codec);
+    ost->mFrame = av_frame_alloc();
+    if (!ost->mStream || !ost->mCodecCtx || !ost->mFrame) return false;
+
+    AVCodecContext *codecCtx = ost->mCodecCtx;
+    if (codec->type == AVMEDIA_TYPE_VIDEO) {
+        codecCtx->width = options.mWidth;
+        codecCtx->height = options.mHeight;
+        codecCtx->pix_fmt = AV_PIX_FMT_YUV420P;
+        codecCtx->time_base = av_make_q(1, options.mFrameRate);
+        codecCtx->framerate = av_make_q(options.mFrameRate, 1);
+        codecCtx->gop_size = options.mGopSize;
+        codecCtx->max_b_frames = 0;
+        codecCtx->bit_rate = (int64_t) options.mWidth * options.mHeight * options.mFrameRate / 8;
+    } else {
+        codecCtx->sample_fmt = AV_SAMPLE_FMT_FLTP;
+        codecCtx->sample_rate = options.mSampleRate;
+        codecCtx->channel_layout = AV_CH_LAYOUT_STEREO;
+        codecCtx->channels = 2;
+        codecCtx->time_base = av_make_q(1, options.mSampleRate);
+        codecCtx->bit_rate = 128000;
+    }
+    if (fmtCtx->oformat->flags & AVFMT_GLOBALHEADER) codecCtx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    if (avcodec_open2(codecCtx, codec, nullptr) < 0) return false;
+    if (avcodec_parameters_from_context(ost->mStream->codecpar, codecCtx) < 0) return false;
+    ost->mStream->time_base = codecCtx->time_base;
+
+    if (codec->type == AVMEDIA_TYPE_AUDIO) {
+        ost->mFrame->format = codecCtx->sample_fmt;
+        ost->mFrame->channel_layout = codecCtx->channel_layout;
+        ost->mFrame->channels = codecCtx->channels;
+        ost->mFrame->sample_rate = codecCtx->sample_rate;
+        ost->mFrame->nb_samples = codecCtx->frame_size;
+        if (av_frame_get_buffer(ost->mFrame, 0) < 0) return false;
+    }
+    return true;
+}
+
+/** Send frame, null to flush, and write every packet encoder gives back. */
+bool encode(AVFormatContext *fmtCtx, OutputStream *ost, AVFrame *frame, AVPacket *pkt) {
+    if (avcodec_send_frame(ost->mCodecCtx, frame) < 0) return false;
+    int ret;
+    while ((ret = avcodec_receive_packet(ost->mCodecCtx, pkt)) >= 0) {
+        av_packet_rescale_ts(pkt, ost->mCodecCtx->time_base, ost->mStream->time_base);
+        pkt->stream_index = ost->mStream->index;
+        if (av_interleaved_write_frame(fmtCtx, pkt) < 0) return false;
+    }
+    return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF;
+}
+
+}
+
+bool writeSyntheticMedia(const char *path, const SyntheticMediaOptions &options) {
+    AVFormatContext *fmtCtx = nullptr;
+    if (avformat_alloc_output_context2(&fmtCtx, nullptr, nullptr, path) < 0) return false;
+
+    OutputStream video, audio;
+    SyntheticSource source;
+    AVPacket *pkt = av_packet_alloc();
+    bool isWritten = pkt != nullptr;
+    if (isWritten && options.mHasVideo) {
+        isWritten = openStream(fmtCtx, &video, AV_CODEC_ID_MPEG4, options) &&
+                    source.init(options.mWidth, options.mHeight, AV_PIX_FMT_YUV420P);
+    }
+    if (isWritten && options.mHasAudio) isWritten = openStream(fmtCtx, &audio, AV_CODEC_ID_AAC, options);
+    if (isWritten && !(fmtCtx->oformat->flags & AVFMT_NOFILE)) {
+        isWritten = avio_open(&fmtCtx->pb, path, AVIO_FLAG_WRITE) >= 0;
+    }
+    isWritten = isWritten && avformat_write_header(fmtCtx, nullptr) >= 0;
+
+    int64_t nbFrames = options.mHasVideo ? options.mDurationMs * options.mFrameRate / 1000 : 0;
+    int64_t nbSamples = options.mHasAudio ? options.mDurationMs * options.mSampleRate / 1000 : 0;
+    while (isWritten && (video.mNextPts < nbFrames || audio.mNextPts < nbSamples)) {
+        // Write whichever stream is behind, so that packets are interleaved
+        bool isVideoNext = video.mNextPts < nbFrames &&
+                           (audio.mNextPts >= nbSamples ||
+                            av_compare_ts(video.mNextPts, video.mCodecCtx->time_base,
+                                          audio.mNextPts, audio.mCodecCtx->time_base) <= 0);
+        if (isVideoNext) {
+            AVFrame *frame = source.getFrame(video.mNextPts);
+            isWritten = frame && encode(fmtCtx, &video, frame, pkt);
+            video.mNextPts++;
+        } else {
+            AVFrame *frame = audio.mFrame;
+            isWritten = av_frame_make_writable(frame) >= 0;
+            for (int i = 0; isWritten && i < frame->nb_samples; i++) {
+                double t = (double) (audio.mNextPts + i) / options.mSampleRate;
+                float value = (float) (0.5 * sin(2 * M_PI * 1000.0 * t));
+                ((float *) frame->data[0])[i] = value;
+                ((float *) frame->data[1])[i] = value;
+            }
+            frame->pts = audio.mNextPts;
+            isWritten = isWritten && encode(fmtCtx, &audio, frame, pkt);
+            audio.mNextPts += frame->nb_samples;
+        }
+    }
+    if (isWritten && options.mHasVideo) isWritten = encode(fmtCtx, &video, nullptr, pkt);
+    if (isWritten && options.mHasAudio) isWritten = encode(fmtCtx, &audio, nullptr, pkt);
+    isWritten = isWritten && av_write_trailer(fmtCtx) >= 0;
+    if (!isWritten) LOGE("Could not write synthetic media '%s'", path);
+
+    av_packet_free(&pkt);
+    if (!(fmtCtx->oformat->flags & AVFMT_NOFILE)) avio_closep(&fmtCtx->pb);
+    avformat_free_context(fmtCtx);
+    return isWritten;
+}
+
+std::string makeTempDir(const char *prefix) {
+    std::string dir = std::string(P_tmpdir) + "/" + prefix + "-XXXXXX";
+    if (!mkdtemp(&dir[0])) return "";
+    return dir;
+}
+
+void removeTempDir(const std::string &dir) {
+    if (dir.empty()) return;
+    DIR *d = opendir(dir.c_str());
+    if (d) {
+        while (dirent *entry = readdir(d)) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+            unlink((dir + "/" + entry->d_name).c_str());
+        }
+        closedir(d);
+    }
+    rmdir(dir.c_str());
+}
@@ -0,0 +1,34 @@
+#ifndef SYNTHETIC_MEDIA_H
+#define SYNTHETIC_MEDIA_H
+
+extern "C" {
+#include "libavutil/rational.h"
+}
+#include "cstdint"
+#include "string"
+
+/** Layout of a synthetic media file. Video is SyntheticSource color bars encoded with mpeg4,
+ * audio a 1 kHz tone encoded with aac, so any host FFmpeg build can write and decode it. */
+struct SyntheticMediaOptions {
+    int mWidth = 640, mHeight = 360;
+    int mFrameRate = 60;
+    int mGopSize = 30; // Frames between keyframes
+    int mSampleRate = 48000;
+    int64_t mDurationMs = 2000;
+    bool mHasVideo = true;
+    bool mHasAudio = true;
+};
+
+/** Write a synthetic media file, container is guessed from path extension.
+ * Video frame n has pts n in a 1/frameRate timebase, keyframes every gopSize frames.
+ * @return false if any stream could not be encoded or written */
+bool writeSyntheticMedia(const char *path, const SyntheticMediaOptions &options);
+
+/** Create an empty temporary directory for test files.
+ * @return directory path, empty if failed */
+std::string makeTempDir(const char *prefix);
+
+/** Remove a temporary directory and files in it, not recursing further. */
+void removeTempDir(const std::string &dir);
+
+#endif //SYNTHETIC_MEDIA_H
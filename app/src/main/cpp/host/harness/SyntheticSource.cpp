@@ -0,0 +1,82 @@
+#include "SyntheticSource.h"
+#include "JNILogHelper.h"
+
+extern "C" {
+#include "libavutil/pixdesc.h"
+}
+
+#define LOG_TAG "SyntheticSource"
+
+const uint8_t SyntheticSource::BAR_COLORS[NB_BARS][3] = {
+        {180, 180, 180}, {180, 180, 32}, {32, 180, 180}, {32, 180, 32},
+        {180, 32, 180}, {180, 32, 32}, {32, 32, 180}, {64, 64, 64}
+};
+
+SyntheticSource::~SyntheticSource() {
+    sws_freeContext(mSwsCtx);
+    av_frame_free(&mRgbFrame);
+    av_frame_free(&mFrame);
+}
+
+bool SyntheticSource::init(int width, int height, AVPixelFormat pixFmt, AVColorSpace colorSpace,
+                           AVColorRange colorRange) {
+    mWidth = width;
+    mHeight = height;
+    mPixFmt = pixFmt;
+    mColorSpace = colorSpace;
+    mColorRange = colorRange;
+    if (pixFmt == AV_PIX_FMT_YUVJ420P || pixFmt == AV_PIX_FMT_YUVJ422P || pixFmt == AV_PIX_FMT_YUVJ444P) {
+        mColorRange = AVCOL_RANGE_JPEG;
+    }
+
+    mRgbFrame = av_frame_alloc();
+    mFrame = av_frame_alloc();
+    if (!mRgbFrame || !mFrame) return false;
+    mRgbFrame->width = mFrame->width = width;
+    mRgbFrame->height = mFrame->height = height;
+    mRgbFrame->format = AV_PIX_FMT_RGB24;
+    mFrame->format = pixFmt;
+    if (av_frame_get_buffer(mRgbFrame, 0) < 0 || av_frame_get_buffer(mFrame, 0) < 0) return false;
+
+    if (pixFmt == AV_PIX_FMT_RGB24) return true;
+    mSwsCtx = sws_getContext(width, height, AV_PIX_FMT_RGB24, width, height, pixFmt,
+                             SWS_POINT | SWS_ACCURATE_RND | SWS_FULL_CHR_H_INT, nullptr, nullptr, nullptr);
+    if (!mSwsCtx) {
+        LOGE("Cannot convert RGB24 into %s", av_get_pix_fmt_name(pixFmt));
+        return false;
+    }
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(pixFmt);
+    if (!(desc->flags & AV_PIX_FMT_FLAG_RGB)) {
+        int swsColorSpace = colorSpace == AVCOL_SPC_BT709 ? SWS_CS_ITU709 :
+                            colorSpace == AVCOL_SPC_BT2020_NCL ? SWS_CS_BT2020 : SWS_CS_ITU601;
+        const int *coefs = sws_getCoefficients(swsColorSpace);
+        sws_setColorspaceDetails(mSwsCtx, coefs, 1, coefs, mColorRange == AVCOL_RANGE_JPEG, 0, 1 << 16, 1 << 16);
+    }
+    return true;
+}
+
+const uint8_t *SyntheticSource::getExpectedColor(int x, int y, int width, int height, int64_t index) {
+    int barWidth = (width + NB_BARS - 1) / NB_BARS;
+    int bar = (int) (((x - index * BAR_STEP) % (barWidth * NB_BARS) + barWidth * NB_BARS) % (barWidth * NB_BARS)) /
+              barWidth;
+    if (y >= height / 2) bar = NB_BARS - 1 - bar;
+    return BAR_COLORS[bar];
+}
+
+AVFrame *SyntheticSource::getFrame(int64_t index) {
+    if (av_frame_make_writable(mRgbFrame) < 0 || av_frame_make_writable(mFrame) < 0) return nullptr;
+    for (int y = 0; y < mHeight; y++) {
+        uint8_t *row = mRgbFrame->data[0] + (ptrdiff_t) y * mRgbFrame->linesize[0];
+        for (int x = 0; x < mWidth; x++) memcpy(row + 3 * x, getExpectedColor(x, y, mWidth, mHeight, index), 3);
+    }
+
+    if (mSwsCtx) {
+        if (sws_scale_frame(mSwsCtx, mFrame, mRgbFrame) < 0) return nullptr;
+    } else {
+        av_frame_copy(mFrame, mRgbFrame);
+    }
+    mFrame->pts = index;
+    mFrame->colorspace = mColorSpace;
+    mFrame->color_range = mColorRange;
+    return mFrame;
+}
@@ -0,0 +1,44 @@
+#ifndef SYNTHETIC_SOURCE_H
+#define SYNTHETIC_SOURCE_H
+
+extern "C" {
+#include "libavutil/frame.h"
+#include "libswscale/swscale.h"
+}
+
+/** Generates test pictures standing in for decoded video, in any pixel format swscale can write.
+ * Pictures are color bars, top half left to right and bottom half in reverse order, so flips show up too.
+ * Bars move right by BAR_STEP pixels every frame, every frame differs from previous one. */
+class SyntheticSource {
+public:
+    static const int NB_BARS = 8;
+    static const int BAR_STEP = 4;
+    // Colors away from black and white, so limited range pictures are not clipped
+    static const uint8_t BAR_COLORS[NB_BARS][3];
+
+private:
+    int mWidth = 0, mHeight = 0;
+    AVPixelFormat mPixFmt = AV_PIX_FMT_NONE;
+    AVColorSpace mColorSpace = AVCOL_SPC_BT709;
+    AVColorRange mColorRange = AVCOL_RANGE_MPEG;
+    SwsContext *mSwsCtx = nullptr;
+    AVFrame *mRgbFrame = nullptr;
+    AVFrame *mFrame = nullptr;
+
+public:
+    ~SyntheticSource();
+
+    /** Set format of generated frames, colorspace and range only matter to YUV formats.
+     * Full range is used anyway by YUVJ formats. */
+    bool init(int width, int height, AVPixelFormat pixFmt, AVColorSpace colorSpace = AVCOL_SPC_BT709,
+              AVColorRange colorRange = AVCOL_RANGE_MPEG);
+
+    /** Generate frame of given index, with pts set to index.
+     * @return frame owned by source, valid until next call, null if failed */
+    AVFrame *getFrame(int64_t index);
+
+    /** Return color of pixel at x, y of frame of given index. */
+    static const uint8_t *getExpectedColor(int x, int y, int width, int height, int64_t index);
+};
+
+#endif //SYNTHETIC_SOURCE_H
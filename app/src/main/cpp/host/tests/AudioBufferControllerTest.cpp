@@ -0,0 +1,139 @@
+// Buffer sizing of audio output, driven by synthetic underrun counts and play positions as an output callback would
+// feed them. Buffer starts at 2 bursts and grows one burst on every update that saw underruns, however many there were,
+// up to capacity. It shrinks one burst only once QUIET_PERIOD_MS of samples played without underrun since last glitch
+// or size change, and never below 2 bursts. Sizes a device accepts other than requested ones are followed.
+
+#include "HostTest.h"
+#include "AudioBufferController.h"
+
+static const int32_t BURST = 192;
+static const int SAMPLE_RATE = 48000;
+// Not a whole number of bursts, last growth is cut at it
+static const int32_t CAPACITY = BURST * 6 + BURST / 2;
+static const int64_t QUIET_SAMPLES = AudioBufferController::QUIET_PERIOD_MS * SAMPLE_RATE / 1000;
+static const int32_t MIN_SIZE = AudioBufferController::MIN_BURSTS * BURST;
+
+/** Output the controller sizes, it accepts every size it is asked for. */
+struct FakeOutput {
+    AudioBufferController mController;
+    int64_t mXRunCount = 3; // Counted before controller started
+    int64_t mPosition = 0;
+    int32_t mBufferSize = 0;
+
+    FakeOutput() {
+        mBufferSize = mController.init(BURST, CAPACITY, SAMPLE_RATE, mXRunCount);
+        mController.onBufferSizeSet(mBufferSize);
+    }
+
+    /** Play given samples with given number of new underruns, then update controller as a callback would.
+     * @return size controller asked for, 0 if none */
+    int32_t play(int64_t nbSamples, int nbXRuns = 0) {
+        mPosition += nbSamples;
+        mXRunCount += nbXRuns;
+        int32_t size = mController.update(mXRunCount, mPosition);
+        if (size > 0) {
+            mBufferSize = size;
+            mController.onBufferSizeSet(size);
+        }
+        return size;
+    }
+
+    /** Play bursts without underrun until controller asks for a size or maxSamples are played.
+     * @return samples played */
+    int64_t playQuiet(int64_t maxSamples) {
+        int64_t played = 0;
+        while (played < maxSamples) {
+            played += BURST;
+            if (play(BURST) > 0) break;
+        }
+        return played;
+    }
+};
+
+static void testGrowth() {
+    FakeOutput output;
+    CHECK(output.mBufferSize == MIN_SIZE);
+    // Underruns counted before init are not glitches of this output
+    CHECK(output.play(BURST) == 0);
+
+    // One burst per glitching update, several underruns at once count as one glitch
+    CHECK(output.play(BURST, 1) == MIN_SIZE + BURST);
+    CHECK(output.play(BURST, 4) == MIN_SIZE + 2 * BURST);
+    CHECK(output.play(BURST) == 0);
+    CHECK(output.play(BURST, 1) == MIN_SIZE + 3 * BURST);
+    CHECK(output.play(BURST, 1) == MIN_SIZE + 4 * BURST);
+
+    // Capped at capacity, then glitches leave size as is
+    CHECK(output.play(BURST, 1) == CAPACITY);
+    CHECK(output.play(BURST, 1) == 0);
+    CHECK(output.play(BURST, 2) == 0);
+    CHECK(output.mBufferSize == CAPACITY);
+
+    AudioBufferStats stats = output.mController.getStats();
+    CHECK(stats.mBufferSize == CAPACITY);
+    CHECK(stats.mNbGrows == 5);
+    CHECK(stats.mNbXRuns == 11);
+    CHECK(stats.mNbShrinks == 0);
+}
+
+static void testShrink() {
+    FakeOutput output;
+    for (int i = 0; i < 3; i++) output.play(BURST, 1);
+    CHECK(output.mBufferSize == MIN_SIZE + 3 * BURST);
+
+    // Right before a quiet period since last glitch nothing changes, one burst goes once it is reached
+    CHECK(output.play(QUIET_SAMPLES - 1) == 0);
+    CHECK(output.play(1) == MIN_SIZE + 2 * BURST);
+
+    // Each following step waits a whole quiet period again, played burst by burst
+    CHECK(output.playQuiet(2 * QUIET_SAMPLES) == QUIET_SAMPLES);
+    CHECK(output.mBufferSize == MIN_SIZE + BURST);
+
+    // A glitch starts the quiet period over and grows buffer back
+    CHECK(output.play(QUIET_SAMPLES / 2) == 0);
+    CHECK(output.play(BURST, 1) == MIN_SIZE + 2 * BURST);
+    CHECK(output.play(QUIET_SAMPLES - 1) == 0);
+    CHECK(output.play(1) == MIN_SIZE + BURST);
+    CHECK(output.playQuiet(2 * QUIET_SAMPLES) == QUIET_SAMPLES);
+    CHECK(output.mBufferSize == MIN_SIZE);
+
+    // Never below 2 bursts, however long output stays quiet
+    for (int i = 0; i < 5; i++) CHECK(output.play(QUIET_SAMPLES) == 0);
+    CHECK(output.mBufferSize == MIN_SIZE);
+
+    AudioBufferStats stats = output.mController.getStats();
+    CHECK(stats.mNbGrows == 4);
+    CHECK(stats.mNbShrinks == 4);
+    CHECK(stats.mBufferSize == MIN_SIZE);
+}
+
+static void testAcceptedSize() {
+    // Device rounds sizes up to whole bursts, following steps start from what it took
+    FakeOutput output;
+    CHECK(output.play(BURST, 1) == MIN_SIZE + BURST);
+    output.mController.onBufferSizeSet(MIN_SIZE + 2 * BURST);
+    CHECK(output.play(BURST, 1) == MIN_SIZE + 3 * BURST);
+    CHECK(output.play(QUIET_SAMPLES) == MIN_SIZE + 2 * BURST);
+    // Failed size changes leave last accepted size
+    output.mController.onBufferSizeSet(0);
+    CHECK(output.mController.getStats().mBufferSize == MIN_SIZE + 2 * BURST);
+}
+
+static void testSmallCapacity() {
+    // Capacity below 2 bursts is both smallest and largest size
+    AudioBufferController controller;
+    int32_t size = controller.init(BURST, BURST + BURST / 2, SAMPLE_RATE, 0);
+    CHECK(size == BURST + BURST / 2);
+    controller.onBufferSizeSet(size);
+    CHECK(controller.update(1, BURST) == 0);
+    CHECK(controller.update(1, BURST + QUIET_SAMPLES) == 0);
+    CHECK(controller.getStats().mNbXRuns == 1);
+}
+
+int main() {
+    testGrowth();
+    testShrink();
+    testAcceptedSize();
+    testSmallCapacity();
+    return hostTestResult();
+}
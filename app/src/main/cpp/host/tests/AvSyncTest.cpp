@@ -0,0 +1,156 @@
+// A/V offset of a media streamer played on virtual time: audio goes through a virtual output pulling bursts on the test
+// thread, video is drawn on every vsync of a fake 60 Hz display, and clock reads time of output, so that runs are
+// reproducible whatever the load of the host. Between vsyncs, output plays bursts up to the next vsync while a decoder
+// keeps audio ahead of it. Every new video frame is compared against audio heard when the frame reaches the screen,
+// offset is positive when video is ahead of audio.
+// With audio as master, audio heard is also counted apart from master clock, from samples taken out of the audio
+// streamer minus those buffered by output, so that a clock ignoring output latency shows up as video early. That
+// count moves once per burst. Following another clock audio is resampled, samples no longer count stream time, so
+// offsets of video and audio reported against master clock are used.
+// A frame is taken on the first vsync reaching the screen after it is due, pacer may also shift due times by up to
+// half a vsync to keep cadence, so offsets stay within a vsync and a burst rather than around 0.
+
+#include "HostTest.h"
+#include "RendererHarness.h"
+#include "SyntheticSource.h"
+#include "MediaStreamerBuilder.h"
+#include "VirtualAudioOutput.h"
+#include "SyntheticAudio.h"
+#include "FramePacer.h"
+#include "cmath"
+
+static const int WIDTH = 320, HEIGHT = 180;
+static const int FRAME_RATE = 30;
+static const int64_t VSYNC_PERIOD_NS = 1000000000 / 60;
+static const int SAMPLE_RATE = 48000;
+static const int FRAMES_PER_BURST = 192;
+static const int AUDIO_FRAME_SIZE = 1024;
+// Vsyncs played before measuring, audio buffer settles and clock starts. Audio following another clock starts
+// ahead by what was buffered before video started, it is brought back in step at most 10% faster or slower.
+static const int NB_WARMUP_VSYNCS = 30;
+static const int NB_RESAMPLED_WARMUP_VSYNCS = 120;
+static const int NB_VSYNCS = 120;
+// Audio decoded ahead of what was played. Sample ring holds seconds of audio, a decoder filling it would delay
+// corrections of audio following another clock by as much.
+static const int64_t AUDIO_LEAD_US = 200000;
+
+/** Feed audio ahead of what was played, as decoder would. */
+static void feedAudio(MediaStreamer *streamer, SyntheticAudio *audio) {
+    int64_t playedUs = streamer->mAudioStreamer->getStats().mNbSamplesPlayed * 1000000 / SAMPLE_RATE;
+    while (audio->getPts() * 1000000 / SAMPLE_RATE - playedUs <= AUDIO_LEAD_US && audio->feed(streamer)) {}
+}
+
+struct AvOffsets {
+    double mSumUs = 0;
+    int64_t mMaxUs = 0;
+    int mNbFrames = 0;
+
+    void add(int64_t offsetUs) {
+        mSumUs += (double) offsetUs;
+        if (llabs(offsetUs) > llabs(mMaxUs)) mMaxUs = offsetUs;
+        mNbFrames++;
+    }
+
+    double getAverageUs() const {
+        return mNbFrames > 0 ? mSumUs / mNbFrames : 0;
+    }
+};
+
+static void play(RendererHarness *harness, SyntheticSource *source, ClockMode mode, const char *name) {
+    // Streamer owns output, it stays valid until audio streamer is deleted
+    auto *output = new VirtualAudioOutput(VirtualClockMode::VIRTUAL);
+    MediaStreamerBuilder builder;
+    builder.setClockMode(mode)->setTimeSource(output);
+    builder.setAudioTimeBase(av_make_q(1, SAMPLE_RATE))
+            ->setSrcSampleRate(SAMPLE_RATE)
+            ->setSrcChannelLayout(AV_CH_LAYOUT_STEREO)
+            ->setSrcNbSamples(AUDIO_FRAME_SIZE)
+            ->setSrcSampleFmt(AV_SAMPLE_FMT_FLTP)
+            ->setFramesPerBurst(FRAMES_PER_BURST)
+            ->setAudioOutput(output);
+    builder.setRenderer(harness->getRenderer())
+            ->setVideoTimeBase(av_make_q(1, FRAME_RATE))
+            ->setSrcWidth(WIDTH)
+            ->setSrcHeight(HEIGHT)
+            ->setSrcPixelFormat(AV_PIX_FMT_YUV420P)
+            ->setPixelFormat(GL_RGB)
+            ->setInternalPixelFormat(GL_RGB)
+            ->setYuvRenderingEnabled(false);
+    MediaStreamer *streamer = builder.buildMediaStreamer();
+    REQUIRE(streamer);
+    AudioStreamer *audioStreamer = streamer->mAudioStreamer;
+    VideoStreamer *videoStreamer = streamer->mVideoStreamer;
+
+    SyntheticAudio audio;
+    REQUIRE(audio.init(SAMPLE_RATE, AUDIO_FRAME_SIZE, 1000.0));
+
+    AvOffsets measured, reported;
+    int64_t nextIndex = 0;
+    int64_t shownPts = AV_NOPTS_VALUE;
+    int nbWarmupVsyncs = mode == ClockMode::AUDIO_MASTER ? NB_WARMUP_VSYNCS : NB_RESAMPLED_WARMUP_VSYNCS;
+    for (int vsync = 0; vsync < nbWarmupVsyncs + NB_VSYNCS; vsync++) {
+        // Vsync times start after 0, which means no vsync to pacer. Frame is drawn within a burst after vsync.
+        int64_t vsyncNs = (vsync + 1) * VSYNC_PERIOD_NS;
+        while (output->getTimeNs() < vsyncNs) {
+            feedAudio(streamer, &audio);
+            REQUIRE(output->pullBursts(1) == 1);
+        }
+
+        // Decoder keeps video buffer full
+        while (streamer->onVideoFrame(source->getFrame(nextIndex))) nextIndex++;
+
+        int64_t nowNs = output->getTimeNs();
+        int64_t playedUs = audioStreamer->getStats().mNbSamplesPlayed * 1000000 / SAMPLE_RATE;
+        int64_t heardUs = playedUs - output->getLatencyMs() * 1000;
+        int64_t presentNs = FramePacer::getPresentTimeNs(nowNs, vsyncNs, VSYNC_PERIOD_NS);
+        CHECK(harness->draw(videoStreamer, vsyncNs, VSYNC_PERIOD_NS).mNbGlErrors == 0);
+
+        int64_t pts = videoStreamer->getFramePts();
+        if (pts == shownPts || pts == AV_NOPTS_VALUE) continue;
+        shownPts = pts;
+        if (vsync < nbWarmupVsyncs) continue;
+        if (mode == ClockMode::AUDIO_MASTER) {
+            int64_t heardAtPresentUs = heardUs + (presentNs - nowNs) / 1000;
+            measured.add(av_rescale_q(pts, av_make_q(1, FRAME_RATE), AV_TIME_BASE_Q) - heardAtPresentUs);
+        }
+        // Both offsets are against master clock, audio offset is 0 when audio is master
+        MediaClockStats clockStats = streamer->getClockStats();
+        reported.add(clockStats.mAvOffsetUs - clockStats.mAudioOffsetUs);
+    }
+
+    MediaClockStats stats = streamer->getClockStats();
+    AudioStreamerStats audioStats = audioStreamer->getStats();
+    printf("%-12s %3d frames  clock A/V offset avg %+7.0f us max %+7lld us  drift %+6lld us  corrections %lld  "
+           "resyncs %lld\n", name, reported.mNbFrames, reported.getAverageUs(), (long long) reported.mMaxUs,
+           (long long) audioStats.mDriftUs, (long long) audioStats.mNbDriftCorrections, (long long) stats.mNbResyncs);
+    if (measured.mNbFrames > 0) {
+        printf("%-12s %3d frames  measured A/V offset avg %+7.0f us max %+7lld us\n", name, measured.mNbFrames,
+               measured.getAverageUs(), (long long) measured.mMaxUs);
+    }
+
+    // Every frame of a 30 fps stream on 60 Hz is shown, in step with audio within a vsync and an audio burst
+    int64_t toleranceUs = VSYNC_PERIOD_NS / 1000 + (int64_t) FRAMES_PER_BURST * 1000000 / SAMPLE_RATE;
+    CHECK(reported.mNbFrames == NB_VSYNCS / 2);
+    CHECK(fabs(reported.getAverageUs()) < (double) toleranceUs);
+    CHECK(fabs(measured.getAverageUs()) < (double) toleranceUs);
+    CHECK(audioStats.mNbSamplesPlayed > 0);
+    // Resampled audio settles within drift threshold of master clock, with a few corrections rather than one a frame
+    CHECK(llabs(audioStats.mDriftUs) < 20000);
+    CHECK(audioStats.mNbDriftCorrections <= 4);
+
+    delete videoStreamer;
+    delete audioStreamer;
+    delete streamer;
+}
+
+int main() {
+    RendererHarness harness;
+    REQUIRE(harness.init(WIDTH, HEIGHT));
+    SyntheticSource source;
+    REQUIRE(source.init(WIDTH, HEIGHT, AV_PIX_FMT_YUV420P));
+
+    play(&harness, &source, ClockMode::AUDIO_MASTER, "audio master");
+    play(&harness, &source, ClockMode::VIDEO_MASTER, "video master");
+    play(&harness, &source, ClockMode::EXTERNAL, "external");
+    return hostTestResult();
+}
@@ -0,0 +1,172 @@
+// Compositor draws every tile of a pass even when a later tile needs bigger layers: texture array is reallocated
+// before any upload, or tiles already uploaded are uploaded again from their pictures. Tiles keep showing their picture
+// on passes without new frames, also after layers grew for another tile.
+// Video streamers are also composited end to end, each converted at the size of its tile and checked against source.
+// Frame buffers of streamers leave buffering state after some frames, only frames from then on are drawn.
+
+#include "HostTest.h"
+#include "EglContext.h"
+#include "SyntheticSource.h"
+#include "VideoCompositor.h"
+#include "VideoStreamerBuilder.h"
+#include "vector"
+
+static const int WIDTH = 320, HEIGHT = 180;
+static const int NB_TILES = 4;
+
+/** Read surface back as RGBA, rows from top to bottom. */
+static std::vector<uint8_t> readPixels() {
+    std::vector<uint8_t> rows((size_t) WIDTH * HEIGHT * 4), pixels(rows.size());
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, WIDTH, HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, rows.data());
+    for (int y = 0; y < HEIGHT; y++) {
+        memcpy(&pixels[(size_t) y * WIDTH * 4], &rows[(size_t) (HEIGHT - 1 - y) * WIDTH * 4], (size_t) WIDTH * 4);
+    }
+    return pixels;
+}
+
+/** Return pixel of surface at x, y of a tile in normalized tile coordinates. */
+static const uint8_t *getTilePixel(const std::vector<uint8_t> &pixels, const TileRect &rect, float x, float y) {
+    int surfaceX = (int) ((rect.mX + x * rect.mWidth) * WIDTH);
+    int surfaceY = (int) ((rect.mY + y * rect.mHeight) * HEIGHT);
+    return &pixels[((size_t) surfaceY * WIDTH + surfaceX) * 4];
+}
+
+static bool isColorNear(const uint8_t *actual, const uint8_t *expected, int tolerance) {
+    for (int c = 0; c < 3; c++) {
+        if (abs(actual[c] - expected[c]) > tolerance) return false;
+    }
+    return true;
+}
+
+/** A solid RGB picture. */
+struct SolidPicture {
+    int mWidth, mHeight;
+    uint8_t mColor[3];
+    std::vector<uint8_t> mPixels;
+
+    SolidPicture(int width, int height, uint8_t r, uint8_t g, uint8_t b) : mWidth(width), mHeight(height),
+                                                                          mColor{r, g, b} {
+        mPixels.resize((size_t) width * height * 3);
+        for (size_t i = 0; i < mPixels.size(); i++) mPixels[i] = mColor[i % 3];
+    }
+};
+
+/** Every tile shows its own color at its center. */
+static void checkTiles(CompositorES3 *compositor, const std::vector<TileRect> &rects,
+                       const std::vector<SolidPicture *> &pictures, const char *step) {
+    compositor->render();
+    std::vector<uint8_t> pixels = readPixels();
+    for (int i = 0; i < NB_TILES; i++) {
+        const uint8_t *actual = getTilePixel(pixels, rects[i], 0.5f, 0.5f);
+        if (!isColorNear(actual, pictures[i]->mColor, 2)) {
+            fprintf(stderr, "%s: tile %d is %d,%d,%d, expected %d,%d,%d\n", step, i, actual[0], actual[1], actual[2],
+                    pictures[i]->mColor[0], pictures[i]->mColor[1], pictures[i]->mColor[2]);
+            CHECK(false);
+        }
+    }
+}
+
+static void setPicture(CompositorES3 *compositor, int tile, const SolidPicture &picture, bool isNewFrame) {
+    compositor->setTilePicture(tile, picture.mWidth, picture.mHeight, GL_RGB, GL_RGB, picture.mWidth * 3,
+                               picture.mPixels.data(), isNewFrame);
+}
+
+/** Last tile of a pass, then another tile on a pass without new frames, grow layers. */
+static void testLayerGrowth() {
+    CompositorES3 compositor;
+    REQUIRE(compositor.init());
+    compositor.resize(WIDTH, HEIGHT);
+    std::vector<TileRect> rects;
+    CompositorES3::getGridLayout(NB_TILES, &rects);
+    compositor.setLayout(rects.data(), NB_TILES);
+
+    SolidPicture red(64, 36, 200, 40, 40), green(64, 36, 40, 200, 40), blue(64, 36, 40, 40, 200);
+    SolidPicture big(256, 144, 200, 200, 40), bigger(512, 288, 40, 200, 200);
+    std::vector<SolidPicture *> pictures = {&red, &green, &blue, &big};
+    for (int i = 0; i < NB_TILES; i++) setPicture(&compositor, i, *pictures[i], true);
+    checkTiles(&compositor, rects, pictures, "first pass");
+
+    // Same pictures again, nothing new
+    for (int i = 0; i < NB_TILES; i++) setPicture(&compositor, i, *pictures[i], false);
+    checkTiles(&compositor, rects, pictures, "redraw");
+
+    // Second tile grows past layers, others keep their picture without a new frame
+    pictures[1] = &bigger;
+    for (int i = 0; i < NB_TILES; i++) setPicture(&compositor, i, *pictures[i], i == 1);
+    checkTiles(&compositor, rects, pictures, "growing pass");
+    CHECK(glGetError() == GL_NO_ERROR);
+}
+
+/** Streamers of different sizes drawn in a grid, each tile shows the frame its streamer took. */
+static void testStreamers() {
+    CompositorES3 *compositor = new CompositorES3();
+    REQUIRE(compositor->init());
+    compositor->resize(WIDTH, HEIGHT);
+    VideoCompositor videoCompositor(&compositor);
+
+    static const int SIZES[NB_TILES][2] = {{320, 180}, {640, 360}, {160, 90}, {1280, 720}};
+    RendererES3 *noRenderer = nullptr;
+    std::vector<SyntheticSource> sources(NB_TILES);
+    std::vector<VideoStreamer *> streamers;
+    for (int i = 0; i < NB_TILES; i++) {
+        REQUIRE(sources[i].init(SIZES[i][0], SIZES[i][1], AV_PIX_FMT_YUV420P));
+        VideoStreamerBuilder builder;
+        builder.setRenderer(&noRenderer)
+                ->setVideoTimeBase(av_make_q(1, 30))
+                ->setSrcWidth(SIZES[i][0])
+                ->setSrcHeight(SIZES[i][1])
+                ->setSrcPixelFormat(AV_PIX_FMT_YUV420P)
+                ->setPixelFormat(GL_RGB)
+                ->setInternalPixelFormat(GL_RGB)
+                ->setYuvRenderingEnabled(false);
+        VideoStreamer *streamer = builder.buildVideoStreamer();
+        REQUIRE(streamer);
+        streamers.push_back(streamer);
+        CHECK(videoCompositor.addSource(streamer, TileRect()));
+    }
+    videoCompositor.setGridLayout();
+    std::vector<TileRect> rects;
+    CompositorES3::getGridLayout(NB_TILES, &rects);
+
+    int nbChecked = 0;
+    for (int64_t index = 0; index < 60; index++) {
+        for (int i = 0; i < NB_TILES; i++) streamers[i]->onVideoFrame(sources[i].getFrame(index));
+        videoCompositor.render();
+        bool isComplete = true;
+        for (VideoStreamer *streamer : streamers) isComplete = isComplete && streamer->getFramePts() != AV_NOPTS_VALUE;
+        if (!isComplete) continue;
+
+        // Center of second bar in top half, away from bar edges blurred by scaling
+        std::vector<uint8_t> pixels = readPixels();
+        for (int i = 0; i < NB_TILES; i++) {
+            int64_t pts = streamers[i]->getFramePts();
+            int srcWidth = SIZES[i][0], srcHeight = SIZES[i][1];
+            int barWidth = srcWidth / SyntheticSource::NB_BARS;
+            int srcX = (int) ((barWidth + barWidth / 2 + pts * SyntheticSource::BAR_STEP) % srcWidth);
+            int srcY = srcHeight / 4;
+            const uint8_t *expected = SyntheticSource::getExpectedColor(srcX, srcY, srcWidth, srcHeight, pts);
+            const uint8_t *actual = getTilePixel(pixels, rects[i], (float) srcX / (float) srcWidth,
+                                                 (float) srcY / (float) srcHeight);
+            if (!isColorNear(actual, expected, 8)) {
+                fprintf(stderr, "frame %lld: tile %d is %d,%d,%d, expected %d,%d,%d\n", (long long) pts, i, actual[0],
+                        actual[1], actual[2], expected[0], expected[1], expected[2]);
+                CHECK(false);
+            }
+        }
+        nbChecked++;
+    }
+    CHECK(nbChecked >= 10);
+    CHECK(glGetError() == GL_NO_ERROR);
+
+    for (VideoStreamer *streamer : streamers) delete streamer;
+    delete compositor;
+}
+
+int main() {
+    EglContext context;
+    REQUIRE(context.create(WIDTH, HEIGHT));
+    testLayerGrowth();
+    testStreamers();
+    return hostTestResult();
+}
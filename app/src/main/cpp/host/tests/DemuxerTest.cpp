@@ -0,0 +1,202 @@
+// Decoding threads write frames into a snapshot of the sink lists, taken under the sink lock, so sinks can be
+// added and removed while playing. A frame a seek made stale is dropped instead of being retried into full sinks.
+// Decoder degrades on lateness of presenting sinks only, a recorder next to them does not keep it from degrading.
+// Stepping backward past GOP cache decodes again from the keyframe before, while paused, and shows the previous frame
+// once decoded. Its GOP is cached on the way, so the next step is served from cache. Seeks flush every sink.
+
+#include "HostTest.h"
+#include "SyntheticMedia.h"
+#include "Demuxer.h"
+#include "TimeUtils.h"
+#include "atomic"
+
+/** Video sink counting frames it takes, refusing every frame while told to, like a full frame buffer. */
+class CountingSink : public VideoSink {
+public:
+    std::atomic_int64_t mNbFrames = {0};
+    std::atomic_int64_t mNbAttempts = {0};
+    std::atomic_int64_t mLastPts = {AV_NOPTS_VALUE};
+    std::atomic_bool mIsFull = {false};
+
+    explicit CountingSink(int64_t id) {
+        mId = id;
+    }
+
+    int onVideoFrame(AVFrame *frame) override {
+        mNbAttempts++;
+        mLastPts = frame->best_effort_timestamp;
+        if (mIsFull) return 0;
+        mNbFrames++;
+        return 1;
+    }
+};
+
+/** Sink showing frames against a clock they are always late for, taking them at a slow pace. */
+class LateSink : public CountingSink {
+public:
+    explicit LateSink(int64_t id) : CountingSink(id) {}
+
+    int onVideoFrame(AVFrame *frame) override {
+        usleep(5000);
+        return CountingSink::onVideoFrame(frame);
+    }
+
+    int64_t getLatenessMs() override {
+        return 500;
+    }
+
+    bool isPresenting() override {
+        return true;
+    }
+};
+
+/** Sink keeping timestamp of the last preview frame shown and counting flushes. */
+class PreviewSink : public CountingSink {
+public:
+    std::atomic_int64_t mPreviewPts = {AV_NOPTS_VALUE};
+    std::atomic_int64_t mNbFlushes = {0};
+
+    explicit PreviewSink(int64_t id) : CountingSink(id) {}
+
+    bool onPreviewFrame(AVFrame *frame) override {
+        mPreviewPts = frame->pts;
+        return true;
+    }
+
+    void onVideoFlush() override {
+        mNbFlushes++;
+    }
+};
+
+/** Wait up to timeoutMs for condition to hold. */
+template<typename Condition>
+static bool waitFor(Condition condition, int64_t timeoutMs) {
+    int64_t deadlineNs = getWallTimeNs() + timeoutMs * 1000000;
+    while (!condition()) {
+        if (getWallTimeNs() > deadlineNs) return false;
+        usleep(1000);
+    }
+    return true;
+}
+
+/** Every sink added gets frames, a removed sink gets none once removal returned. */
+static void testAddRemoveSinks(const char *path) {
+    Demuxer demuxer(path);
+    REQUIRE(demuxer.mState == DemuxerState::READY);
+    CountingSink first(1), second(2), third(3);
+    demuxer.addVideoSink(&first);
+    demuxer.addVideoSink(&second);
+    demuxer.addVideoSink(&third);
+    demuxer.start();
+
+    CHECK(waitFor([&] { return third.mNbFrames > 10; }, 5000));
+    CHECK(first.mNbFrames > 0);
+    CHECK(second.mNbFrames > 0);
+
+    demuxer.removeVideoSink(2);
+    int64_t nbAttempts = second.mNbAttempts;
+    CHECK(waitFor([&] { return first.mNbFrames > 60; }, 5000));
+    CHECK(second.mNbAttempts == nbAttempts);
+    demuxer.stop();
+
+    // Nothing lost for sinks that stayed
+    CHECK(first.mNbFrames == third.mNbFrames);
+}
+
+/** A sink that stays full while paused is retried forever, until a seek makes the frame stale. */
+static void testSeekAbortsRetries(const char *path) {
+    Demuxer demuxer(path);
+    REQUIRE(demuxer.mState == DemuxerState::READY);
+    CountingSink sink(1);
+    sink.mIsFull = true;
+    demuxer.addVideoSink(&sink);
+    demuxer.start();
+    CHECK(waitFor([&] { return sink.mNbAttempts > 0; }, 5000));
+    demuxer.pause();
+
+    // Retried every 10ms as long as it stays paused
+    int64_t nbAttempts = sink.mNbAttempts;
+    usleep(100000);
+    CHECK(sink.mNbAttempts > nbAttempts + 3);
+    AVRational timebase = demuxer.getVideoTimebase();
+    CHECK(ptsToMs(sink.mLastPts, timebase) < 1000);
+
+    // Retrying stops once seeking, nothing is read while paused
+    demuxer.seek(5000);
+    usleep(30000);
+    nbAttempts = sink.mNbAttempts;
+    usleep(100000);
+    CHECK(sink.mNbAttempts == nbAttempts);
+
+    // Frames after resuming are from where the seek landed
+    sink.mIsFull = false;
+    demuxer.resume();
+    CHECK(waitFor([&] { return sink.mNbFrames > 0; }, 5000));
+    CHECK(ptsToMs(sink.mLastPts, timebase) >= 4000);
+    demuxer.stop();
+}
+
+/** A late presenting sink degrades decoding even while a recorder, never late, takes frames too. */
+static void testLatenessIgnoresRecorders(const char *path) {
+    Demuxer demuxer(path);
+    REQUIRE(demuxer.mState == DemuxerState::READY);
+    LateSink presenting(1);
+    CountingSink recorder(2);
+    demuxer.addVideoSink(&presenting);
+    demuxer.addVideoSink(&recorder);
+    demuxer.start();
+
+    CHECK(waitFor([&] { return demuxer.getDegradationStats().mNbDegrades > 0; }, 5000));
+    demuxer.stop();
+}
+
+/** Step backward while paused, first from a frame cache does not hold, then from the frame it showed. */
+static void testStepBackward(const char *path) {
+    Demuxer demuxer(path);
+    REQUIRE(demuxer.mState == DemuxerState::READY);
+    PreviewSink sink(1);
+    // Sink stays full until paused, so that demuxer does not run through the whole media meanwhile
+    sink.mIsFull = true;
+    demuxer.addVideoSink(&sink);
+    demuxer.setGopCache(16 * 1024 * 1024);
+    demuxer.start();
+    CHECK(waitFor([&] { return sink.mNbAttempts > 0; }, 5000));
+    demuxer.pause();
+    sink.mIsFull = false;
+
+    // Timestamp of a frame from its index, first frame was the one refused
+    int64_t firstPts = sink.mLastPts;
+    int64_t frameDuration = av_rescale_q(1, av_make_q(1, 30), demuxer.getVideoTimebase());
+    auto getPts = [&](int64_t index) { return firstPts + index * frameDuration; };
+
+    // Middle of a GOP far from frames decoded so far, keyframes come every 30 frames
+    CHECK(!demuxer.stepBackward(getPts(200)));
+    CHECK(sink.mNbFlushes == 1);
+    CHECK(waitFor([&] { return sink.mPreviewPts != AV_NOPTS_VALUE; }, 5000));
+    CHECK(sink.mPreviewPts == getPts(199));
+
+    CHECK(demuxer.stepBackward(getPts(199)));
+    CHECK(sink.mPreviewPts == getPts(198));
+    CHECK(sink.mNbFlushes == 2);
+    demuxer.stop();
+}
+
+int main() {
+    std::string dir = makeTempDir("DemuxerTest");
+    REQUIRE(!dir.empty());
+    std::string path = dir + "/media.nut";
+    SyntheticMediaOptions options;
+    options.mWidth = 320;
+    options.mHeight = 180;
+    options.mFrameRate = 30;
+    options.mDurationMs = 8000;
+    REQUIRE(writeSyntheticMedia(path.c_str(), options));
+
+    testAddRemoveSinks(path.c_str());
+    testSeekAbortsRetries(path.c_str());
+    testLatenessIgnoresRecorders(path.c_str());
+    testStepBackward(path.c_str());
+
+    removeTempDir(dir);
+    return hostTestResult();
+}
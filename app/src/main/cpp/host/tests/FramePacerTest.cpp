@@ -0,0 +1,208 @@
+// Frame pacer driven by a fake vsync source, against a master clock re-anchored on every audio callback with some
+// error, like an audio clock. Every vsync shows the latest frame due by then, as VideoStreamer::render takes it out of
+// frame buffer. Cadence is checked from how many vsyncs each frame stays on screen: 24 fps on 60 Hz alternates 3 and
+// 2 vsyncs, 30 fps keeps every frame for 2 and 60 fps for 1. It must hold whatever phase frames have against vsyncs,
+// also with frame times right at a boundary between two vsyncs, and with draws starting late after their vsync.
+// Pacer also follows an audio clock drifting from vsyncs, and jumps on seeks instead of catching up slowly.
+
+#include "HostTest.h"
+#include "FramePacer.h"
+#include "TimeUtils.h"
+#include "random"
+#include "vector"
+
+static const int64_t VSYNC_PERIOD_NS = 16666667;
+// Audio clock is re-anchored once per callback
+static const int64_t AUDIO_CALLBACK_NS = 10000000;
+// Stream time at first vsync, clock of a stream that has not started is 0
+static const int64_t START_MS = 1000;
+// Phases of stream against vsyncs tried, evenly spread over a vsync
+static const int NB_PHASES = 16;
+
+/** How a fake playback runs. */
+struct PlaybackOptions {
+    int mFrameRate = 24;
+    int64_t mPhaseNs = 0; // Stream time at first vsync is START_MS plus this
+    int64_t mDriftPpm = 0; // Audio clock runs this many parts per million faster than vsyncs
+    int64_t mMaxJitterNs = 0; // Draws start up to this late after their vsync
+    int64_t mMaxClockErrorUs = 2000; // Error of audio clock at every callback, either way
+};
+
+/** Playback vsync after vsync. Every frame is in buffer before it is due. */
+class FakePlayback {
+private:
+    PlaybackOptions mOptions;
+    FramePacer mPacer;
+    AVRational mTimeBase;
+    std::mt19937 mRandom{42};
+    int64_t mVsyncNs = 1000000000;
+    int64_t mShownPts = AV_NOPTS_VALUE;
+    int64_t mStreamStartNs = 0;
+    int64_t mStreamStartMs = START_MS;
+    int64_t mCallbackIndex = -1;
+    int64_t mClockErrorUs = 0;
+
+public:
+    // Vsyncs every shown frame stayed on screen, in order
+    std::vector<int> mRuns;
+    int64_t mNbSkipped = 0;
+
+    explicit FakePlayback(const PlaybackOptions &options)
+            : mOptions(options), mTimeBase(av_make_q(1, options.mFrameRate)) {
+        mStreamStartNs = mVsyncNs - options.mPhaseNs;
+    }
+
+    /** Return master clock at given time, as last audio callback anchored it. */
+    int64_t getClockMs(int64_t nowNs) {
+        int64_t elapsedNs = nowNs - mStreamStartNs;
+        int64_t callbackIndex = elapsedNs / AUDIO_CALLBACK_NS;
+        if (callbackIndex != mCallbackIndex) {
+            mCallbackIndex = callbackIndex;
+            std::uniform_int_distribution<int64_t> error(-mOptions.mMaxClockErrorUs, mOptions.mMaxClockErrorUs);
+            mClockErrorUs = error(mRandom);
+        }
+        int64_t elapsedUs = elapsedNs / 1000;
+        elapsedUs += elapsedUs / 1000000 * mOptions.mDriftPpm;
+        return mStreamStartMs + (elapsedUs + mClockErrorUs) / 1000;
+    }
+
+    /** Draw on given number of vsyncs, the way VideoStreamer::render does. */
+    void run(int nbVsyncs) {
+        std::uniform_int_distribution<int64_t> jitter(0, mOptions.mMaxJitterNs);
+        for (int i = 0; i < nbVsyncs; i++) {
+            mVsyncNs += VSYNC_PERIOD_NS;
+            int64_t nowNs = mVsyncNs + jitter(mRandom);
+            int64_t dueUs = mPacer.getDueTimeUs(getClockMs(nowNs), nowNs, mVsyncNs, VSYNC_PERIOD_NS);
+            int64_t duePts = av_rescale_q_rnd(dueUs, AV_TIME_BASE_Q, mTimeBase, AV_ROUND_DOWN);
+
+            // Frame buffer drops every frame before the one due and never goes back
+            bool isNewFrame = mShownPts == AV_NOPTS_VALUE || duePts > mShownPts;
+            int nbDropped = 0;
+            if (isNewFrame) {
+                if (mShownPts != AV_NOPTS_VALUE) nbDropped = (int) (duePts - mShownPts - 1);
+                mShownPts = duePts;
+                mRuns.push_back(1);
+                mPacer.onFrameTaken(av_rescale_q(mShownPts, mTimeBase, AV_TIME_BASE_Q));
+            } else {
+                mRuns.back()++;
+            }
+            mNbSkipped += nbDropped;
+            mPacer.onFramePresented(isNewFrame, true, nbDropped);
+        }
+    }
+
+    /** Jump stream to given time, as a seek does. */
+    void seek(int64_t toMs) {
+        mStreamStartNs = mVsyncNs;
+        mStreamStartMs = toMs;
+        mShownPts = AV_NOPTS_VALUE;
+        mRuns.clear();
+        mNbSkipped = 0;
+    }
+
+    int64_t getShownMs() const {
+        return ptsToMs(mShownPts, mTimeBase);
+    }
+
+    FramePacerStats getStats() {
+        return mPacer.getStats();
+    }
+};
+
+/** Runs of vsyncs shown frames stayed on screen after settling, last run may be cut. */
+static std::vector<int> getSteadyRuns(const FakePlayback &playback, size_t nbSettling) {
+    if (playback.mRuns.size() < nbSettling + 2) return {};
+    return std::vector<int>(playback.mRuns.begin() + (long) nbSettling, playback.mRuns.end() - 1);
+}
+
+/** Return number of runs out of cadence of given frame rate on 60 Hz. */
+static int countBrokenRuns(const std::vector<int> &runs, int frameRate) {
+    int nbBroken = 0;
+    for (size_t i = 0; i < runs.size(); i++) {
+        bool isValid;
+        if (frameRate == 24) {
+            // 3:2 pulldown
+            isValid = (runs[i] == 2 || runs[i] == 3) && (i == 0 || runs[i] != runs[i - 1]);
+        } else {
+            isValid = runs[i] == 60 / frameRate;
+        }
+        nbBroken += !isValid;
+    }
+    return nbBroken;
+}
+
+/** Every phase of frames against vsyncs keeps cadence, none is skipped. */
+static void testCadence(int frameRate, int64_t maxJitterNs) {
+    int nbBrokenPhases = 0;
+    for (int phase = 0; phase < NB_PHASES; phase++) {
+        PlaybackOptions options;
+        options.mFrameRate = frameRate;
+        options.mPhaseNs = VSYNC_PERIOD_NS * phase / NB_PHASES;
+        options.mMaxJitterNs = maxJitterNs;
+        FakePlayback playback(options);
+        playback.run(1200);
+        std::vector<int> runs = getSteadyRuns(playback, 10);
+        REQUIRE(runs.size() > 100);
+        int nbBroken = countBrokenRuns(runs, frameRate);
+        if (nbBroken > 0 || playback.mNbSkipped > 0) {
+            fprintf(stderr, "%d fps, phase %d/%d: %d frames out of cadence, %lld skipped\n", frameRate, phase,
+                    NB_PHASES, nbBroken, (long long) playback.mNbSkipped);
+            nbBrokenPhases++;
+        }
+
+        // Counters of pacer match what was shown
+        FramePacerStats stats = playback.getStats();
+        CHECK(stats.mNbDisplayed == (int64_t) playback.mRuns.size());
+        CHECK(stats.mNbDisplayed + stats.mNbRepeated == 1200);
+        CHECK(stats.mNbDropped == playback.mNbSkipped);
+        CHECK(stats.mNbResyncs == 0);
+    }
+    CHECK(nbBrokenPhases == 0);
+}
+
+/** Audio clock drifting from vsyncs is followed without jumping, cadence only slips once in a while. */
+static void testDrift() {
+    // Clock gains 20ms over 20 s, a bit more than a vsync, 30 fps on 60 Hz slips about once
+    PlaybackOptions options;
+    options.mFrameRate = 30;
+    options.mDriftPpm = 1000;
+    FakePlayback playback(options);
+    playback.run(1200);
+    std::vector<int> runs = getSteadyRuns(playback, 10);
+    REQUIRE(!runs.empty());
+    int nbBroken = countBrokenRuns(runs, 30);
+    if (nbBroken > 2) fprintf(stderr, "drifting clock: %d frames out of cadence\n", nbBroken);
+    CHECK(nbBroken <= 2);
+    FramePacerStats stats = playback.getStats();
+    CHECK(stats.mNbResyncs == 0);
+    // Smoothed clock stays within clock error and a vsync of master clock
+    CHECK(llabs(stats.mClockErrorUs) < 2000 + VSYNC_PERIOD_NS / 1000);
+}
+
+/** A seek moves shown frames to the new position on the next vsync, cadence goes on from there. */
+static void testSeek() {
+    FakePlayback playback(PlaybackOptions{});
+    playback.run(120);
+    playback.seek(60000);
+    playback.run(1);
+    CHECK(playback.getStats().mNbResyncs == 1);
+    // Shown frame is due within presentation latency of new position
+    CHECK(playback.getShownMs() >= 60000 && playback.getShownMs() <= 60000 + 3 * VSYNC_PERIOD_NS / 1000000);
+
+    playback.run(600);
+    std::vector<int> runs = getSteadyRuns(playback, 10);
+    REQUIRE(!runs.empty());
+    CHECK(countBrokenRuns(runs, 24) == 0);
+    CHECK(playback.getStats().mNbResyncs == 1);
+}
+
+int main() {
+    for (int64_t maxJitterNs : {(int64_t) 0, VSYNC_PERIOD_NS / 4}) {
+        testCadence(60, maxJitterNs);
+        testCadence(30, maxJitterNs);
+        testCadence(24, maxJitterNs);
+    }
+    testDrift();
+    testSeek();
+    return hostTestResult();
+}
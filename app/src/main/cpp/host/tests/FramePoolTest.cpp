@@ -0,0 +1,93 @@
+// Frame pool keeps one buffer pool per format and size. Pools of sizes no longer requested, as after surface
+// resized, must be released on their own and their bytes handed back, and the high-water mark must hold.
+
+#include "HostTest.h"
+#include "FramePool.h"
+#include "vector"
+
+static AVFrame *getFrame(FramePool *pool, int width, int height) {
+    AVFrame *frame = av_frame_alloc();
+    frame->format = AV_PIX_FMT_RGB24;
+    frame->width = width;
+    frame->height = height;
+    REQUIRE(pool->getBuffer(frame, 0) == 0);
+    return frame;
+}
+
+/** Request frames of given size the way a streamer does, a few of them alive at once. */
+static void play(FramePool *pool, int width, int height, int nbFrames) {
+    std::vector<AVFrame *> frames;
+    for (int i = 0; i < nbFrames; i++) {
+        frames.push_back(getFrame(pool, width, height));
+        if (frames.size() > 3) {
+            av_frame_free(&frames.front());
+            frames.erase(frames.begin());
+        }
+    }
+    for (AVFrame *frame : frames) av_frame_free(&frame);
+}
+
+static void testIdlePoolsReleased() {
+    FramePool pool(0);
+    play(&pool, 1280, 720, 100);
+    int64_t bytes720 = pool.getStats().mBytesHeld;
+    CHECK(bytes720 > 0);
+    CHECK(pool.getNbPools() == 1);
+
+    // Surface resized a few times, only the last size keeps being requested
+    play(&pool, 640, 360, 100);
+    play(&pool, 1920, 1080, 1000);
+    CHECK(pool.getNbPools() == 1);
+    FramePoolStats stats = pool.getStats();
+    CHECK(stats.mNbReleasedPools == 2);
+
+    // Only buffers of current size are left
+    FramePool reference(0);
+    play(&reference, 1920, 1080, 100);
+    CHECK(stats.mBytesHeld == reference.getStats().mBytesHeld);
+    printf("bytes held at 720p %lld, after resizes %lld, pools released %lld\n", (long long) bytes720,
+           (long long) stats.mBytesHeld, (long long) stats.mNbReleasedPools);
+}
+
+static void testBuffersInUseOutliveRelease() {
+    FramePool pool(0);
+    AVFrame *kept = getFrame(&pool, 320, 240);
+    int64_t keptBytes = pool.getStats().mBytesHeld;
+    play(&pool, 640, 480, 1200);
+
+    // Pool of kept frame is gone, its buffer is still valid and counted until released
+    CHECK(pool.getNbPools() == 1);
+    memset(kept->data[0], 0x55, (size_t) kept->linesize[0] * kept->height);
+    int64_t bytesHeld = pool.getStats().mBytesHeld;
+    av_frame_free(&kept);
+    CHECK(pool.getStats().mBytesHeld == bytesHeld - keptBytes);
+
+    pool.trim();
+    CHECK(pool.getStats().mBytesHeld == 0);
+    CHECK(pool.getNbPools() == 0);
+}
+
+static void testHighWaterMark() {
+    // Room for a few 720p pictures only
+    const int64_t maxBytes = 4 * 1280 * 736 * 3;
+    FramePool pool(maxBytes);
+    play(&pool, 1280, 720, 100);
+    play(&pool, 1920, 1080, 1000);
+    FramePoolStats stats = pool.getStats();
+    CHECK(stats.mBytesHeld <= maxBytes);
+
+    // Once idle pools are released, larger pictures are pooled again instead of overflowing every time
+    int64_t overflows = stats.mOverflows;
+    play(&pool, 1280, 720, 1000);
+    CHECK(pool.getStats().mBytesHeld <= maxBytes);
+    CHECK(pool.getStats().mOverflows - overflows < 1000);
+    printf("high-water mark %lld, held %lld, overflows %lld\n", (long long) maxBytes,
+           (long long) pool.getStats().mBytesHeld, (long long) pool.getStats().mOverflows);
+}
+
+int main() {
+    testIdlePoolsReleased();
+    testBuffersInUseOutliveRelease();
+    testHighWaterMark();
+    return hostTestResult();
+}
@@ -0,0 +1,104 @@
+// Frames already late when they come from decoder are dropped before conversion, so that every frame converted is
+// also displayed. Playback runs vsync by vsync against an audio clock, on synthetic time so that runs are reproducible
+// whatever the load of the host: decoder runs ahead of the clock, stalls now and then long enough to fall behind, then
+// catches up in a burst of late frames.
+// Same playback without dropping late frames converts the whole burst and skips most of it when drawing.
+
+#include "HostTest.h"
+#include "RendererHarness.h"
+#include "SyntheticSource.h"
+#include "VideoStreamerBuilder.h"
+
+static const int WIDTH = 320, HEIGHT = 180;
+static const int FRAME_RATE = 60;
+static const int64_t VSYNC_PERIOD_NS = 1000000000 / FRAME_RATE;
+// Frames decoder keeps ahead of clock
+static const int LEAD_FRAMES = 30;
+// Every STALL_INTERVAL vsyncs decoder delivers nothing for STALL_VSYNCS vsyncs, as on a slow keyframe
+static const int STALL_INTERVAL = 100;
+static const int STALL_VSYNCS = 45;
+static const int NB_VSYNCS = 300;
+// GL thread draws this long after vsync
+static const int64_t DRAW_DELAY_NS = 2000000;
+
+/** Time set by test, read by clock and streamer. */
+class SyntheticTime : public TimeSource {
+public:
+    int64_t mTimeNs = 0;
+
+    int64_t getTimeNs() override {
+        return mTimeNs;
+    }
+};
+
+static VideoStreamerStats play(RendererHarness *harness, SyntheticSource *source, int64_t lateToleranceMs) {
+    SyntheticTime time;
+    MediaClock clock(ClockMode::AUDIO_MASTER);
+    clock.setTimeSource(&time);
+    VideoStreamerBuilder builder;
+    builder.setRenderer(harness->getRenderer())
+            ->setVideoClock(&clock)
+            ->setVideoTimeBase(av_make_q(1, FRAME_RATE))
+            ->setSrcWidth(WIDTH)
+            ->setSrcHeight(HEIGHT)
+            ->setSrcPixelFormat(AV_PIX_FMT_YUV420P)
+            ->setPixelFormat(GL_RGB)
+            ->setInternalPixelFormat(GL_RGB)
+            ->setYuvRenderingEnabled(false)
+            ->setLateFrameTolerance(lateToleranceMs);
+    VideoStreamer *streamer = builder.buildVideoStreamer();
+    REQUIRE(streamer);
+
+    int64_t nextIndex = 0;
+    auto decodeUpTo = [&](int64_t index) {
+        for (; nextIndex <= index; nextIndex++) CHECK(streamer->onVideoFrame(source->getFrame(nextIndex)));
+    };
+
+    int64_t stalledUntil = -1;
+    for (int vsync = 0; vsync < NB_VSYNCS; vsync++) {
+        // Vsync times start after 0, which means no vsync to pacer
+        int64_t vsyncNs = (vsync + 1) * VSYNC_PERIOD_NS;
+        time.mTimeNs = vsyncNs + DRAW_DELAY_NS;
+
+        // Audio heard drives clock, it started with the first vsync
+        clock.setAudioTime((time.mTimeNs - VSYNC_PERIOD_NS) / 1000, time.mTimeNs, clock.getSerial());
+
+        if (vsync > 0 && vsync % STALL_INTERVAL == 0) stalledUntil = vsync + STALL_VSYNCS;
+        if (vsync >= stalledUntil) decodeUpTo(vsync + LEAD_FRAMES);
+
+        harness->draw(streamer, vsyncNs, VSYNC_PERIOD_NS);
+    }
+    VideoStreamerStats stats = streamer->getStats();
+    delete streamer;
+    return stats;
+}
+
+static void print(const char *name, const VideoStreamerStats &stats) {
+    // Frames still buffered when playback ended are left out, they would have been displayed
+    int64_t nbConverted = stats.mNbDisplayed + stats.mNbDroppedUnshown;
+    printf("%-16s %4lld displayed %4lld dropped late %4lld skipped unshown, %.2f converted per displayed frame\n",
+           name, (long long) stats.mNbDisplayed, (long long) stats.mNbDroppedLate, (long long) stats.mNbDroppedUnshown,
+           (double) nbConverted / (double) stats.mNbDisplayed);
+}
+
+int main() {
+    RendererHarness harness;
+    REQUIRE(harness.init(WIDTH, HEIGHT));
+    SyntheticSource source;
+    REQUIRE(source.init(WIDTH, HEIGHT, AV_PIX_FMT_YUV420P));
+
+    VideoStreamerStats dropping = play(&harness, &source, 50);
+    VideoStreamerStats converting = play(&harness, &source, -1);
+    print("dropping late", dropping);
+    print("converting all", converting);
+
+    // Only frames within tolerance are converted and then skipped, late frames are converted for nothing otherwise
+    // while as many frames are displayed
+    CHECK(dropping.mNbDroppedLate > 0);
+    CHECK(converting.mNbDroppedLate == 0);
+    CHECK(dropping.mNbDroppedUnshown * 2 < converting.mNbDroppedUnshown);
+    CHECK(dropping.mNbConverted * converting.mNbDisplayed <
+          converting.mNbConverted * dropping.mNbDisplayed);
+    CHECK(dropping.mNbDisplayed == converting.mNbDisplayed);
+    return hostTestResult();
+}
@@ -0,0 +1,221 @@
+// Muxer rechunks decoded audio of any frame size into encoder frame size. Its output must be bit exact with a
+// reference transcode written the plain libav way: swresample, an AVAudioFifo and one encoder frame at a time.
+
+#include "HostTest.h"
+#include "MuxerBuilder.h"
+#include "string"
+#include "vector"
+#include "unistd.h"
+
+extern "C" {
+#include "libavutil/audio_fifo.h"
+}
+
+struct AudioCase {
+    const char *mName;
+    int mSrcSampleRate;
+    AVSampleFormat mSrcSampleFmt;
+    int mSampleRate;
+    std::vector<int> mChunkSizes; // Sizes of decoded frames, cycled through
+    int mNbFrames;
+};
+
+static const AudioCase CASES[] = {
+        // Sample format converted without resampler
+        {"s16 44100 converted", 44100, AV_SAMPLE_FMT_S16, 44100, {1152, 441, 2000}, 60},
+        // Same format, samples copied
+        {"fltp 44100 copied", 44100, AV_SAMPLE_FMT_FLTP, 44100, {1152}, 60},
+        // Resampled
+        {"fltp 48000 resampled", 48000, AV_SAMPLE_FMT_FLTP, 44100, {1024, 960, 1500}, 60},
+};
+
+struct EncodedPacket {
+    int64_t mPts;
+    std::vector<uint8_t> mData;
+};
+
+/** Deterministic stereo test signal, a tone with noise. */
+static void fillSamples(AVFrame *frame, int64_t firstSample) {
+    static uint32_t seed = 1;
+    for (int i = 0; i < frame->nb_samples; i++) {
+        for (int ch = 0; ch < 2; ch++) {
+            seed = seed * 1664525u + 1013904223u;
+            double noise = ((double) (seed >> 8) / (1 << 24) - 0.5) * 0.1;
+            double value = 0.5 * sin(2 * M_PI * 440.0 * (double) (firstSample + i) / frame->sample_rate + ch) + noise;
+            if (frame->format == AV_SAMPLE_FMT_S16) {
+                ((int16_t *) frame->data[0])[2 * i + ch] = (int16_t) lrint(value * 32767);
+            } else {
+                ((float *) frame->data[ch])[i] = (float) value;
+            }
+        }
+    }
+}
+
+/** Decoded frames fed to both muxer and reference. */
+static std::vector<AVFrame *> makeFrames(const AudioCase &c) {
+    std::vector<AVFrame *> frames;
+    int64_t nbSamples = 0;
+    for (int i = 0; i < c.mNbFrames; i++) {
+        AVFrame *frame = av_frame_alloc();
+        frame->format = c.mSrcSampleFmt;
+        frame->channel_layout = AV_CH_LAYOUT_STEREO;
+        frame->channels = 2;
+        frame->sample_rate = c.mSrcSampleRate;
+        frame->nb_samples = c.mChunkSizes[i % c.mChunkSizes.size()];
+        REQUIRE(av_frame_get_buffer(frame, 0) >= 0);
+        fillSamples(frame, nbSamples);
+        frame->pts = av_rescale(nbSamples, c.mSampleRate, c.mSrcSampleRate);
+        nbSamples += frame->nb_samples;
+        frames.push_back(frame);
+    }
+    return frames;
+}
+
+static void receivePackets(AVCodecContext *codecCtx, std::vector<EncodedPacket> *packets) {
+    AVPacket *packet = av_packet_alloc();
+    while (avcodec_receive_packet(codecCtx, packet) >= 0) {
+        packets->push_back({packet->pts, std::vector<uint8_t>(packet->data, packet->data + packet->size)});
+        av_packet_unref(packet);
+    }
+    av_packet_free(&packet);
+}
+
+static void encodeFifo(AVCodecContext *codecCtx, AVAudioFifo *fifo, bool partial, int64_t *nbEncoded,
+                       std::vector<EncodedPacket> *packets) {
+    while (av_audio_fifo_size(fifo) >= codecCtx->frame_size || (partial && av_audio_fifo_size(fifo) > 0)) {
+        AVFrame *frame = av_frame_alloc();
+        frame->format = codecCtx->sample_fmt;
+        frame->channel_layout = codecCtx->channel_layout;
+        frame->sample_rate = codecCtx->sample_rate;
+        frame->nb_samples = FFMIN(codecCtx->frame_size, av_audio_fifo_size(fifo));
+        REQUIRE(av_frame_get_buffer(frame, 0) >= 0);
+        av_audio_fifo_read(fifo, (void **) frame->data, frame->nb_samples);
+        frame->pts = *nbEncoded;
+        *nbEncoded += frame->nb_samples;
+        REQUIRE(avcodec_send_frame(codecCtx, frame) >= 0);
+        receivePackets(codecCtx, packets);
+        av_frame_free(&frame);
+    }
+}
+
+/** Plain libav transcode of frames into AAC packets, timestamps in 1/sample rate. */
+static std::vector<EncodedPacket> transcodeReference(const AudioCase &c, const std::vector<AVFrame *> &frames) {
+    const AVCodec *codec = avcodec_find_encoder_by_name("aac");
+    AVCodecContext *codecCtx = avcodec_alloc_context3(codec);
+    codecCtx->sample_fmt = AV_SAMPLE_FMT_FLTP;
+    codecCtx->sample_rate = c.mSampleRate;
+    codecCtx->channel_layout = AV_CH_LAYOUT_STEREO;
+    codecCtx->channels = 2;
+    codecCtx->time_base = av_make_q(1, c.mSampleRate);
+    if (av_guess_format("nut", nullptr, nullptr)->flags & AVFMT_GLOBALHEADER) {
+        codecCtx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+    REQUIRE(avcodec_open2(codecCtx, codec, nullptr) >= 0);
+
+    SwrContext *swrCtx = swr_alloc();
+    av_opt_set_int(swrCtx, "in_channel_count", 2, 0);
+    av_opt_set_int(swrCtx, "in_sample_rate", c.mSrcSampleRate, 0);
+    av_opt_set_sample_fmt(swrCtx, "in_sample_fmt", c.mSrcSampleFmt, 0);
+    av_opt_set_int(swrCtx, "out_channel_count", 2, 0);
+    av_opt_set_int(swrCtx, "out_sample_rate", c.mSampleRate, 0);
+    av_opt_set_sample_fmt(swrCtx, "out_sample_fmt", AV_SAMPLE_FMT_FLTP, 0);
+    REQUIRE(swr_init(swrCtx) >= 0);
+
+    AVAudioFifo *fifo = av_audio_fifo_alloc(AV_SAMPLE_FMT_FLTP, 2, 4096);
+    std::vector<EncodedPacket> packets;
+    int64_t nbEncoded = 0;
+    uint8_t **buffer = nullptr;
+    int bufferSize = 0;
+    for (AVFrame *frame : frames) {
+        int nbOut = swr_get_out_samples(swrCtx, frame->nb_samples);
+        if (nbOut > bufferSize) {
+            if (buffer) av_freep(&buffer[0]);
+            av_freep(&buffer);
+            av_samples_alloc_array_and_samples(&buffer, nullptr, 2, nbOut, AV_SAMPLE_FMT_FLTP, 0);
+            bufferSize = nbOut;
+        }
+        int ret = swr_convert(swrCtx, buffer, bufferSize, (const uint8_t **) frame->extended_data, frame->nb_samples);
+        REQUIRE(ret >= 0);
+        av_audio_fifo_write(fifo, (void **) buffer, ret);
+        encodeFifo(codecCtx, fifo, false, &nbEncoded, &packets);
+    }
+    // Drain resampler, then a last partial frame, then encoder
+    int ret = swr_convert(swrCtx, buffer, bufferSize, nullptr, 0);
+    if (ret > 0) av_audio_fifo_write(fifo, (void **) buffer, ret);
+    encodeFifo(codecCtx, fifo, true, &nbEncoded, &packets);
+    avcodec_send_frame(codecCtx, nullptr);
+    receivePackets(codecCtx, &packets);
+
+    if (buffer) av_freep(&buffer[0]);
+    av_freep(&buffer);
+    av_audio_fifo_free(fifo);
+    swr_free(&swrCtx);
+    avcodec_free_context(&codecCtx);
+    return packets;
+}
+
+/** Packets of a written file, timestamps in 1/sampleRate. */
+static std::vector<EncodedPacket> readPackets(const std::string &path, int sampleRate) {
+    std::vector<EncodedPacket> packets;
+    AVFormatContext *fmtCtx = nullptr;
+    REQUIRE(avformat_open_input(&fmtCtx, path.c_str(), nullptr, nullptr) >= 0);
+    AVRational timeBase = fmtCtx->streams[0]->time_base;
+    AVPacket *packet = av_packet_alloc();
+    while (av_read_frame(fmtCtx, packet) >= 0) {
+        int64_t pts = av_rescale_q(packet->pts, timeBase, av_make_q(1, sampleRate));
+        packets.push_back({pts, std::vector<uint8_t>(packet->data, packet->data + packet->size)});
+        av_packet_unref(packet);
+    }
+    av_packet_free(&packet);
+    avformat_close_input(&fmtCtx);
+    return packets;
+}
+
+static void runCase(const AudioCase &c) {
+    std::string path = std::string(P_tmpdir) + "/MuxerTest-" + std::to_string(getpid()) + ".nut";
+    std::vector<AVFrame *> frames = makeFrames(c);
+
+    MuxerBuilder builder;
+    builder.setFileName(path.c_str())
+            ->setAudioEncoder("aac")
+            ->setHasVideo(false)
+            ->setAudioTimeBase(av_make_q(1, c.mSampleRate))
+            ->setSrcSampleRate(c.mSrcSampleRate)
+            ->setSrcChannelLayout(AV_CH_LAYOUT_STEREO)
+            ->setSrcNbSamples(c.mChunkSizes[0])
+            ->setSrcSampleFmt(c.mSrcSampleFmt)
+            ->setSampleRate(c.mSampleRate);
+    Muxer *muxer = builder.buildMuxer();
+    REQUIRE(muxer);
+    for (AVFrame *frame : frames) CHECK(muxer->onAudioFrame(frame));
+    muxer->stop();
+    muxer->release();
+    delete muxer;
+
+    std::vector<EncodedPacket> written = readPackets(path, c.mSampleRate);
+    std::vector<EncodedPacket> expected = transcodeReference(c, frames);
+    unlink(path.c_str());
+    for (AVFrame *frame : frames) av_frame_free(&frame);
+
+    // Format shifts encoder delay away so that timestamps start at 0, only spacing of timestamps is compared
+    int nbMismatches = 0;
+    CHECK(written.size() == expected.size());
+    REQUIRE(!written.empty() && !expected.empty());
+    for (size_t i = 0; i < FFMIN(written.size(), expected.size()); i++) {
+        if (written[i].mPts - written[0].mPts != expected[i].mPts - expected[0].mPts ||
+            written[i].mData != expected[i].mData) {
+            if (nbMismatches++ < 4) {
+                fprintf(stderr, "%s: packet %zu differs, pts %lld size %zu, expected pts %lld size %zu\n", c.mName, i,
+                        (long long) written[i].mPts, written[i].mData.size(), (long long) expected[i].mPts,
+                        expected[i].mData.size());
+            }
+        }
+    }
+    CHECK(nbMismatches == 0);
+    printf("%-24s packets %zu, reference %zu, mismatches %d\n", c.mName, written.size(), expected.size(), nbMismatches);
+}
+
+int main() {
+    for (const AudioCase &c : CASES) runCase(c);
+    return hostTestResult();
+}
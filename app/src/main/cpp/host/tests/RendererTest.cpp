@@ -0,0 +1,114 @@
+// Draws synthetic frames of every pixel format path through VideoStreamer::render on an offscreen surface.
+// Surface is read back and compared against the colors frames were made of, then every path is measured
+// over moving frames: CPU time per frame, upload bandwidth and GL errors.
+// Frames due next are written into unpack buffers of renderer as they are fed, most draws upload them from there.
+
+#include "HostTest.h"
+#include "RendererHarness.h"
+#include "SyntheticSource.h"
+#include "VideoStreamerBuilder.h"
+
+static const int WIDTH = 320, HEIGHT = 180;
+
+struct RenderPath {
+    const char *mName;
+    AVPixelFormat mSrcPixFmt;
+    GLenum mPixFmt; // Output format when frames are converted on CPU
+    bool mIsYuvRenderingEnabled;
+    AVColorSpace mColorSpace;
+    int mTolerance; // Largest difference per channel from source colors
+};
+
+static const RenderPath PATHS[] = {
+        // Drawn as they are, converted by YUV shader
+        {"yuv420p shader", AV_PIX_FMT_YUV420P, GL_RGB, true, AVCOL_SPC_BT709, 3},
+        {"yuvj420p shader", AV_PIX_FMT_YUVJ420P, GL_RGB, true, AVCOL_SPC_BT709, 3},
+        {"yuv420p bt601 shader", AV_PIX_FMT_YUV420P, GL_RGB, true, AVCOL_SPC_SMPTE170M, 3},
+        {"yuv420p bt2020 shader", AV_PIX_FMT_YUV420P, GL_RGB, true, AVCOL_SPC_BT2020_NCL, 3},
+        {"yuv422p shader", AV_PIX_FMT_YUV422P, GL_RGB, true, AVCOL_SPC_BT709, 3},
+        {"yuv444p shader", AV_PIX_FMT_YUV444P, GL_RGB, true, AVCOL_SPC_BT709, 3},
+        {"nv12 shader", AV_PIX_FMT_NV12, GL_RGB, true, AVCOL_SPC_BT709, 3},
+        {"nv21 shader", AV_PIX_FMT_NV21, GL_RGB, true, AVCOL_SPC_BT709, 3},
+        {"yuv420p10le shader", AV_PIX_FMT_YUV420P10LE, GL_RGB, true, AVCOL_SPC_BT709, 3},
+        {"p010le shader", AV_PIX_FMT_P010LE, GL_RGB, true, AVCOL_SPC_BT709, 3},
+        // Converted on CPU by YUV kernels
+        {"yuv420p cpu rgb", AV_PIX_FMT_YUV420P, GL_RGB, false, AVCOL_SPC_BT709, 3},
+        {"nv12 cpu rgba", AV_PIX_FMT_NV12, GL_RGBA, false, AVCOL_SPC_BT709, 3},
+        // Converted on CPU by swscale
+        {"bgr24 sws rgb", AV_PIX_FMT_BGR24, GL_RGB, true, AVCOL_SPC_BT709, 0},
+        // Uploaded as they are
+        {"rgb24 direct", AV_PIX_FMT_RGB24, GL_RGB, true, AVCOL_SPC_BT709, 0},
+        {"rgba direct", AV_PIX_FMT_RGBA, GL_RGBA, true, AVCOL_SPC_BT709, 0},
+};
+
+/** Compare centers of every bar of both halves against source colors. */
+static void checkGolden(const RenderPath &path, const std::vector<uint8_t> &pixels, int64_t index) {
+    int barWidth = WIDTH / SyntheticSource::NB_BARS;
+    int nbMismatches = 0;
+    for (int y : {HEIGHT / 4, 3 * HEIGHT / 4}) {
+        for (int bar = 0; bar < SyntheticSource::NB_BARS; bar++) {
+            // Centers of moving bars, away from edges where chroma is interpolated
+            int x = (int) ((bar * barWidth + barWidth / 2 + index * SyntheticSource::BAR_STEP) % WIDTH);
+            const uint8_t *expected = SyntheticSource::getExpectedColor(x, y, WIDTH, HEIGHT, index);
+            const uint8_t *actual = &pixels[((size_t) y * WIDTH + x) * 4];
+            for (int c = 0; c < 3; c++) {
+                if (abs(actual[c] - expected[c]) > path.mTolerance && nbMismatches++ < 4) {
+                    fprintf(stderr, "%s: pixel %d,%d channel %d is %d, expected %d\n", path.mName, x, y, c,
+                            actual[c], expected[c]);
+                }
+            }
+        }
+    }
+    CHECK(nbMismatches == 0);
+}
+
+static void runPath(const RenderPath &path, RendererHarness *harness) {
+    SyntheticSource source;
+    if (!source.init(WIDTH, HEIGHT, path.mSrcPixFmt, path.mColorSpace)) {
+        fprintf(stderr, "%s: cannot generate source frames\n", path.mName);
+        CHECK(false);
+        return;
+    }
+
+    VideoStreamerBuilder builder;
+    builder.setRenderer(harness->getRenderer())
+            ->setVideoTimeBase(av_make_q(1, 30))
+            ->setSrcWidth(WIDTH)
+            ->setSrcHeight(HEIGHT)
+            ->setSrcPixelFormat(path.mSrcPixFmt)
+            ->setPixelFormat(path.mPixFmt)
+            ->setInternalPixelFormat((GLint) path.mPixFmt)
+            ->setYuvRenderingEnabled(path.mIsYuvRenderingEnabled);
+    VideoStreamer *streamer = builder.buildVideoStreamer();
+    REQUIRE(streamer);
+
+    // Buffer holds frames back until enough of them are in, frames come out in order after that
+    const int nbFrames = 60;
+    HarnessSummary summary;
+    std::vector<uint8_t> pixels;
+    for (int64_t i = 0; i < nbFrames; i++) {
+        AVFrame *frame = source.getFrame(i);
+        REQUIRE(frame);
+        FrameReport report = harness->drawFrame(streamer, frame);
+        summary.add(report);
+        CHECK(report.mNbGlErrors == 0);
+
+        int64_t shownPts = streamer->getFramePts();
+        if (shownPts != AV_NOPTS_VALUE && shownPts % 10 == 0) {
+            harness->readPixels(&pixels);
+            checkGolden(path, pixels, shownPts);
+        }
+    }
+    CHECK(streamer->getFramePts() != AV_NOPTS_VALUE);
+    // Frames due next were written into unpack buffers by decoding side, golden checks above cover them
+    CHECK(streamer->getStats().mNbStaged > 0);
+    summary.print(path.mName);
+    delete streamer;
+}
+
+int main() {
+    RendererHarness harness;
+    REQUIRE(harness.init(WIDTH, HEIGHT));
+    for (const RenderPath &path : PATHS) runPath(path, &harness);
+    return hostTestResult();
+}
@@ -0,0 +1,135 @@
+// Sample converter output must be bit-exact with swr converting the same samples, for every pair of s16, s16p, flt
+// and fltp, several channel counts and lengths around SIMD block sizes, from aligned and misaligned buffers. Float input
+// holds rounding ties, values clipped at both ends and random samples.
+
+#include "HostTest.h"
+#include "SampleConverter.h"
+#include "vector"
+
+extern "C" {
+#include "libavutil/channel_layout.h"
+#include "libavutil/mem.h"
+#include "libswresample/swresample.h"
+}
+
+static const AVSampleFormat FORMATS[] = {AV_SAMPLE_FMT_S16, AV_SAMPLE_FMT_S16P, AV_SAMPLE_FMT_FLT,
+                                         AV_SAMPLE_FMT_FLTP};
+static const int CHANNEL_COUNTS[] = {1, 2, 3, 6};
+static const int LENGTHS[] = {1, 7, 8, 15, 16, 17, 31, 33, 100, 1024};
+static const int SAMPLE_RATE = 48000;
+// Room for any length, offset by a sample
+static const int MAX_LENGTH = 1024 + 1;
+
+/** Samples of every plane of one buffer, planes are offset to misalign them. */
+struct Samples {
+    uint8_t *mData[8] = {nullptr};
+    uint8_t *mPlanes[8] = {nullptr};
+
+    Samples(AVSampleFormat sampleFmt, int nbChannels, bool isMisaligned) {
+        REQUIRE(av_samples_alloc(mData, nullptr, nbChannels, MAX_LENGTH, sampleFmt, 0) >= 0);
+        int nbPlanes = av_sample_fmt_is_planar(sampleFmt) ? nbChannels : 1;
+        int offset = isMisaligned ? av_get_bytes_per_sample(sampleFmt) * (nbPlanes == 1 ? nbChannels : 1) : 0;
+        for (int c = 0; c < nbPlanes; c++) mPlanes[c] = mData[c] + offset;
+    }
+
+    ~Samples() {
+        av_freep(&mData[0]);
+    }
+};
+
+static uint32_t nextRandom(uint32_t *state) {
+    *state = *state * 1664525 + 1013904223;
+    return *state >> 8;
+}
+
+/** Fill samples, float values cycle through ties, clipped and random values. */
+static void fill(Samples *samples, AVSampleFormat sampleFmt, int nbChannels, int nbSamples, uint32_t *state) {
+    bool isPlanar = av_sample_fmt_is_planar(sampleFmt);
+    int n = isPlanar ? nbSamples : nbSamples * nbChannels;
+    for (int c = 0; c < (isPlanar ? nbChannels : 1); c++) {
+        for (int i = 0; i < n; i++) {
+            uint32_t r = nextRandom(state);
+            if (av_get_packed_sample_fmt(sampleFmt) == AV_SAMPLE_FMT_S16) {
+                ((int16_t *) samples->mPlanes[c])[i] = (int16_t) r;
+                continue;
+            }
+            float value;
+            switch (i % 4) {
+                case 0:
+                    // Halfway between two s16 values
+                    value = ((float) (int) (r % 65536 - 32768) + 0.5f) / 32768.0f;
+                    break;
+                case 1:
+                    // Beyond full scale, up to 4x
+                    value = ((float) (r % 65536) / 65536.0f * 3.0f + 1.0f) * ((r & 0x10000) ? 1.0f : -1.0f);
+                    break;
+                default:
+                    value = (float) (r % (1 << 24)) / (float) (1 << 23) - 1.0f;
+                    break;
+            }
+            ((float *) samples->mPlanes[c])[i] = value;
+        }
+    }
+}
+
+static bool isEqual(const Samples &a, const Samples &b, AVSampleFormat sampleFmt, int nbChannels, int nbSamples) {
+    bool isPlanar = av_sample_fmt_is_planar(sampleFmt);
+    size_t size = (size_t) nbSamples * av_get_bytes_per_sample(sampleFmt) * (isPlanar ? 1 : nbChannels);
+    for (int c = 0; c < (isPlanar ? nbChannels : 1); c++) {
+        if (memcmp(a.mPlanes[c], b.mPlanes[c], size) != 0) return false;
+    }
+    return true;
+}
+
+static int run(AVSampleFormat srcFmt, AVSampleFormat dstFmt, int nbChannels, bool isMisaligned) {
+    SampleConverter *converter = SampleConverter::create(srcFmt, dstFmt, nbChannels);
+    REQUIRE(converter);
+    int64_t layout = av_get_default_channel_layout(nbChannels);
+    SwrContext *swrCtx = swr_alloc_set_opts(nullptr, layout, dstFmt, SAMPLE_RATE, layout, srcFmt, SAMPLE_RATE, 0,
+                                            nullptr);
+    REQUIRE(swrCtx && swr_init(swrCtx) >= 0);
+
+    Samples src(srcFmt, nbChannels, isMisaligned);
+    Samples expected(dstFmt, nbChannels, isMisaligned);
+    Samples converted(dstFmt, nbChannels, isMisaligned);
+    uint32_t state = 1;
+    int nbFailures = 0;
+    for (int length : LENGTHS) {
+        fill(&src, srcFmt, nbChannels, length, &state);
+        REQUIRE(swr_convert(swrCtx, expected.mPlanes, length, (const uint8_t **) src.mPlanes, length) == length);
+        converter->convert(src.mPlanes, converted.mPlanes, length);
+        if (!isEqual(expected, converted, dstFmt, nbChannels, length)) {
+            fprintf(stderr, "%s -> %s, %d channels, %d samples%s: output differs from swr\n",
+                    av_get_sample_fmt_name(srcFmt), av_get_sample_fmt_name(dstFmt), nbChannels, length,
+                    isMisaligned ? ", misaligned" : "");
+            nbFailures++;
+        }
+    }
+    swr_free(&swrCtx);
+    delete converter;
+    return nbFailures;
+}
+
+int main() {
+    int nbCases = 0, nbFailures = 0;
+    for (AVSampleFormat srcFmt : FORMATS) {
+        for (AVSampleFormat dstFmt : FORMATS) {
+            if (srcFmt == dstFmt) continue;
+            CHECK(SampleConverter::isSupported(srcFmt, dstFmt));
+            for (int nbChannels : CHANNEL_COUNTS) {
+                for (bool isMisaligned : {false, true}) {
+                    nbFailures += run(srcFmt, dstFmt, nbChannels, isMisaligned);
+                    nbCases += (int) (sizeof(LENGTHS) / sizeof(LENGTHS[0]));
+                }
+            }
+        }
+    }
+    printf("%d/%d conversions bit-exact with swr\n", nbCases - nbFailures, nbCases);
+    CHECK(nbFailures == 0);
+
+    // Anything else goes through a resampler
+    CHECK(!SampleConverter::isSupported(AV_SAMPLE_FMT_FLT, AV_SAMPLE_FMT_FLT));
+    CHECK(!SampleConverter::isSupported(AV_SAMPLE_FMT_S32, AV_SAMPLE_FMT_S16));
+    CHECK(!SampleConverter::isSupported(AV_SAMPLE_FMT_FLTP, AV_SAMPLE_FMT_DBL));
+    return hostTestResult();
+}
@@ -0,0 +1,123 @@
+// Seeking and leaving trick play drop what streamers buffered and start clock again from the new position: no frame
+// from before is shown afterwards, and clock follows audio read from the new position instead of playing out seconds
+// of audio still queued from the old one. Demuxer feeds a media streamer as app does, audio goes through a real-time
+// virtual output and video is drawn on every vsync of a fake 60 Hz display. Audio is master, frames of the new
+// position are only shown once clock got there.
+
+#include "HostTest.h"
+#include "RendererHarness.h"
+#include "SyntheticMedia.h"
+#include "Demuxer.h"
+#include "MediaStreamerBuilder.h"
+#include "VirtualAudioOutput.h"
+#include "unistd.h"
+
+static const int WIDTH = 320, HEIGHT = 180;
+static const int64_t VSYNC_PERIOD_NS = 1000000000 / 60;
+// Playback time given to streams to fill their buffers and start clock again
+static const int64_t PLAY_MS = 1000;
+
+/** Stream times of frames shown while playing, in millis. */
+struct ShownFrames {
+    int mNbFrames = 0;
+    int64_t mMinMs = INT64_MAX;
+    int64_t mMaxMs = INT64_MIN;
+};
+
+/** Draw on every vsync for durationMs, as GL thread would. */
+static ShownFrames play(RendererHarness *harness, VideoStreamer *streamer, AVRational timebase, int64_t durationMs) {
+    ShownFrames shown;
+    int64_t shownPts = streamer->getFramePts();
+    int64_t startNs = getWallTimeNs();
+    for (int64_t vsync = 0; vsync * VSYNC_PERIOD_NS < durationMs * 1000000; vsync++) {
+        int64_t vsyncNs = startNs + vsync * VSYNC_PERIOD_NS;
+        int64_t nowNs = getWallTimeNs();
+        if (nowNs < vsyncNs) usleep((vsyncNs - nowNs) / 1000);
+        CHECK(harness->draw(streamer, vsyncNs, VSYNC_PERIOD_NS).mNbGlErrors == 0);
+
+        int64_t pts = streamer->getFramePts();
+        if (pts == shownPts || pts == AV_NOPTS_VALUE) continue;
+        shownPts = pts;
+        int64_t ptsMs = ptsToMs(pts, timebase);
+        shown.mNbFrames++;
+        shown.mMinMs = std::min(shown.mMinMs, ptsMs);
+        shown.mMaxMs = std::max(shown.mMaxMs, ptsMs);
+    }
+    return shown;
+}
+
+int main() {
+    std::string dir = makeTempDir("SeekTest");
+    REQUIRE(!dir.empty());
+    std::string path = dir + "/media.nut";
+    SyntheticMediaOptions options;
+    options.mWidth = WIDTH;
+    options.mHeight = HEIGHT;
+    options.mFrameRate = 30;
+    // Long enough for demuxer to stay ahead of sinks rather than reach end of stream
+    options.mDurationMs = 30000;
+    REQUIRE(writeSyntheticMedia(path.c_str(), options));
+
+    RendererHarness harness;
+    REQUIRE(harness.init(WIDTH, HEIGHT));
+    Demuxer demuxer(path.c_str());
+    REQUIRE(demuxer.mState == DemuxerState::READY);
+    AVRational timebase = demuxer.getVideoTimebase();
+
+    MediaStreamerBuilder builder;
+    builder.setAudioTimeBase(demuxer.getAudioTimebase())
+            ->setSrcSampleRate(demuxer.getSampleRate())
+            ->setSrcChannelLayout(demuxer.getChannelLayout())
+            ->setSrcNbSamples(demuxer.getNbSamples())
+            ->setSrcSampleFmt(demuxer.getSampleFormat())
+            ->setAudioOutput(new VirtualAudioOutput(VirtualClockMode::REAL_TIME));
+    builder.setVideoTimeBase(timebase)
+            ->setSrcWidth(demuxer.getWidth())
+            ->setSrcHeight(demuxer.getHeight())
+            ->setSrcPixelFormat(demuxer.getPixelFormat())
+            ->setRenderer(harness.getRenderer());
+    MediaStreamer *streamer = builder.buildMediaStreamer();
+    REQUIRE(streamer);
+    VideoStreamer *videoStreamer = streamer->mVideoStreamer;
+    demuxer.addAudioSink(streamer);
+    demuxer.addVideoSink(streamer);
+    demuxer.start();
+
+    ShownFrames shown = play(&harness, videoStreamer, timebase, PLAY_MS);
+    printf("start:          %3d frames shown from %5lld to %5lld ms\n", shown.mNbFrames, (long long) shown.mMinMs,
+           (long long) shown.mMaxMs);
+    CHECK(shown.mNbFrames > 0);
+    CHECK(shown.mMaxMs < 2000);
+
+    // Sample ring holds seconds of audio from the start by now, none of it is heard after seeking
+    demuxer.seek(6000);
+    shown = play(&harness, videoStreamer, timebase, PLAY_MS);
+    printf("seek to 6000:   %3d frames shown from %5lld to %5lld ms\n", shown.mNbFrames, (long long) shown.mMinMs,
+           (long long) shown.mMaxMs);
+    CHECK(shown.mNbFrames >= 10);
+    CHECK(shown.mMinMs >= 5000);
+    CHECK(shown.mMaxMs < 6000 + PLAY_MS);
+
+    // Keyframes only, then playback again from the last keyframe decoded, which may be the one after the last shown
+    demuxer.setTrickPlay(8);
+    streamer->setTrickPlay(true);
+    shown = play(&harness, videoStreamer, timebase, PLAY_MS / 2);
+    CHECK(shown.mNbFrames > 0);
+    int64_t keyframeMs = shown.mMaxMs;
+    demuxer.setTrickPlay(0);
+    streamer->setTrickPlay(false);
+    shown = play(&harness, videoStreamer, timebase, PLAY_MS);
+    printf("trick play end: %3d frames shown from %5lld to %5lld ms, last keyframe shown at %5lld ms\n",
+           shown.mNbFrames, (long long) shown.mMinMs, (long long) shown.mMaxMs, (long long) keyframeMs);
+    CHECK(shown.mNbFrames >= 10);
+    CHECK(shown.mMinMs >= keyframeMs);
+    int64_t gopMs = (int64_t) options.mGopSize * 1000 / options.mFrameRate;
+    CHECK(shown.mMaxMs < keyframeMs + gopMs + PLAY_MS + 100);
+
+    demuxer.stop();
+    delete videoStreamer;
+    delete streamer->mAudioStreamer;
+    delete streamer;
+    removeTempDir(dir);
+    return hostTestResult();
+}
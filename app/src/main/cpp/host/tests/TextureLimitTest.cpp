@@ -0,0 +1,116 @@
+// Video streamers are built before their renderer exists, while max texture size is still the minimum every device
+// supports. A source bigger than that is scaled on CPU at first, frames then follow the real limit once a renderer
+// reported it: they are drawn as they are by YUV shader, the same as from a streamer built after renderer.
+// Surface is compared between both streamers, and against source colors for frames of either path. Bytes uploaded tell
+// which path a frame took: YUV planes of source size, or a scaled RGB picture.
+
+#include "HostTest.h"
+#include "RendererHarness.h"
+#include "SyntheticSource.h"
+#include "VideoStreamerBuilder.h"
+#include "map"
+
+static const int WIDTH = 320, HEIGHT = 180;
+// Above minimum max texture size, every desktop driver supports it
+static const int SRC_WIDTH = 2560, SRC_HEIGHT = 1440;
+// Bytes of Y, U and V planes of a source frame, lines need no padding at this width
+static const int64_t SRC_YUV_BYTES = (int64_t) SRC_WIDTH * SRC_HEIGHT * 3 / 2;
+// Frames decoded before surface exists
+static const int NB_EARLY_FRAMES = 30;
+static const int NB_FRAMES = 120;
+
+typedef std::map<int64_t, std::vector<uint8_t>> Pictures;
+
+static VideoStreamer *buildStreamer(RendererHarness *harness) {
+    VideoStreamerBuilder builder;
+    builder.setRenderer(harness->getRenderer())
+            ->setVideoTimeBase(av_make_q(1, 30))
+            ->setSrcWidth(SRC_WIDTH)
+            ->setSrcHeight(SRC_HEIGHT)
+            ->setSrcPixelFormat(AV_PIX_FMT_YUV420P)
+            ->setPixelFormat(GL_RGB)
+            ->setInternalPixelFormat(GL_RGB)
+            ->setYuvRenderingEnabled(true);
+    VideoStreamer *streamer = builder.buildVideoStreamer();
+    REQUIRE(streamer);
+    return streamer;
+}
+
+/** Compare centers of every bar of both halves against source colors, surface shows whole source scaled down. */
+static void checkGolden(const std::vector<uint8_t> &pixels, int64_t index) {
+    int barWidth = SRC_WIDTH / SyntheticSource::NB_BARS;
+    int nbMismatches = 0;
+    for (int y : {HEIGHT / 4, 3 * HEIGHT / 4}) {
+        int srcY = y * SRC_HEIGHT / HEIGHT;
+        for (int bar = 0; bar < SyntheticSource::NB_BARS; bar++) {
+            int srcX = (int) ((bar * barWidth + barWidth / 2 + index * SyntheticSource::BAR_STEP) % SRC_WIDTH);
+            int x = srcX * WIDTH / SRC_WIDTH;
+            const uint8_t *expected = SyntheticSource::getExpectedColor(srcX, srcY, SRC_WIDTH, SRC_HEIGHT, index);
+            const uint8_t *actual = &pixels[((size_t) y * WIDTH + x) * 4];
+            for (int c = 0; c < 3; c++) {
+                if (abs(actual[c] - expected[c]) > 4 && nbMismatches++ < 4) {
+                    fprintf(stderr, "frame %lld: pixel %d,%d channel %d is %d, expected %d\n", (long long) index,
+                            x, y, c, actual[c], expected[c]);
+                }
+            }
+        }
+    }
+    CHECK(nbMismatches == 0);
+}
+
+/** Feed and draw frames of given range, surface is read back for every tenth frame shown.
+ * @param firstSrcSizePts first frame expected to be drawn at source size, earlier ones are scaled on CPU */
+static void drawFrames(RendererHarness *harness, VideoStreamer *streamer, SyntheticSource *source, int64_t from,
+                       int64_t to, int64_t firstSrcSizePts, Pictures *pictures) {
+    for (int64_t i = from; i < to; i++) {
+        AVFrame *frame = source->getFrame(i);
+        REQUIRE(frame);
+        FrameReport report = harness->drawFrame(streamer, frame);
+        CHECK(report.mNbGlErrors == 0);
+
+        int64_t shownPts = streamer->getFramePts();
+        if (shownPts != AV_NOPTS_VALUE && report.mUploadedBytes > 0) {
+            CHECK((report.mUploadedBytes == SRC_YUV_BYTES) == (shownPts >= firstSrcSizePts));
+        }
+        if (shownPts == AV_NOPTS_VALUE || shownPts % 10 != 0 || pictures->count(shownPts)) continue;
+        std::vector<uint8_t> &pixels = (*pictures)[shownPts];
+        harness->readPixels(&pixels);
+        checkGolden(pixels, shownPts);
+    }
+}
+
+int main() {
+    RendererHarness harness;
+    SyntheticSource source;
+    REQUIRE(source.init(SRC_WIDTH, SRC_HEIGHT, AV_PIX_FMT_YUV420P));
+
+    // No renderer yet, as when decoding starts before surface is created
+    REQUIRE(RendererES3::getMaxTextureSize() < SRC_WIDTH);
+    VideoStreamer *early = buildStreamer(&harness);
+    for (int64_t i = 0; i < NB_EARLY_FRAMES; i++) CHECK(early->onVideoFrame(source.getFrame(i)));
+    CHECK(early->getStats().mNbConverted == NB_EARLY_FRAMES);
+
+    REQUIRE(harness.init(WIDTH, HEIGHT));
+    REQUIRE(RendererES3::getMaxTextureSize() >= SRC_WIDTH);
+    Pictures earlyPictures;
+    // Every frame since renderer came is kept at source size
+    drawFrames(&harness, early, &source, NB_EARLY_FRAMES, NB_FRAMES, NB_EARLY_FRAMES, &earlyPictures);
+    // Frames scaled before renderer came are drawn too
+    CHECK(earlyPictures.count(0) && earlyPictures.count(NB_EARLY_FRAMES - 10));
+    delete early;
+
+    VideoStreamer *late = buildStreamer(&harness);
+    Pictures latePictures;
+    drawFrames(&harness, late, &source, 0, NB_FRAMES, 0, &latePictures);
+    delete late;
+
+    // Same pixels on surface once early streamer follows renderer limit
+    int nbCompared = 0;
+    for (const auto &picture : earlyPictures) {
+        if (picture.first < NB_EARLY_FRAMES || !latePictures.count(picture.first)) continue;
+        CHECK(picture.second == latePictures[picture.first]);
+        nbCompared++;
+    }
+    CHECK(nbCompared >= 5);
+    return hostTestResult();
+}
@@ -0,0 +1,49 @@
+#include "AudioBufferController.h"
+#include "algorithm"
+
+int32_t AudioBufferController::init(int32_t framesPerBurst, int32_t capacity, int sampleRate, int64_t xRunCount) {
+    mFramesPerBurst = std::max(framesPerBurst, 1);
+    mMaxSize = std::max(capacity, mFramesPerBurst);
+    mMinSize = std::min(MIN_BURSTS * mFramesPerBurst, mMaxSize);
+    mQuietPeriodSamples = QUIET_PERIOD_MS * sampleRate / 1000;
+    mLastXRunCount = xRunCount;
+    mQuietSincePos = 0;
+    mBufferSize = mMinSize;
+    return mMinSize;
+}
+
+int32_t AudioBufferController::update(int64_t xRunCount, int64_t position) {
+    if (mFramesPerBurst == 0) return 0;
+    int32_t size = mBufferSize;
+
+    if (xRunCount > mLastXRunCount) {
+        // Glitched, one more burst of headroom whatever the number of underruns since last check
+        mNbXRuns += xRunCount - mLastXRunCount;
+        mLastXRunCount = xRunCount;
+        mQuietSincePos = position;
+        if (size >= mMaxSize) return 0;
+        mNbGrows++;
+        return std::min(size + mFramesPerBurst, mMaxSize);
+    }
+
+    if (position - mQuietSincePos >= mQuietPeriodSamples && size > mMinSize) {
+        // Quiet for long enough, try one burst less and wait another period before the next step
+        mQuietSincePos = position;
+        mNbShrinks++;
+        return std::max(size - mFramesPerBurst, mMinSize);
+    }
+    return 0;
+}
+
+void AudioBufferController::onBufferSizeSet(int32_t size) {
+    if (size > 0) mBufferSize = size;
+}
+
+AudioBufferStats AudioBufferController::getStats() {
+    AudioBufferStats stats;
+    stats.mBufferSize = mBufferSize.load();
+    stats.mNbGrows = mNbGrows.load();
+    stats.mNbShrinks = mNbShrinks.load();
+    stats.mNbXRuns = mNbXRuns.load();
+    return stats;
+}
@@ -0,0 +1,55 @@
+#ifndef AUDIO_BUFFER_CONTROLLER_H
+#define AUDIO_BUFFER_CONTROLLER_H
+
+#include "atomic"
+#include "cstdint"
+
+/** Snapshot of buffer sizing counters. */
+struct AudioBufferStats {
+    int32_t mBufferSize = 0; // Current buffer size in samples
+    int64_t mNbGrows = 0; // Times buffer grew after underruns
+    int64_t mNbShrinks = 0; // Times buffer shrank after a quiet period
+    int64_t mNbXRuns = 0; // Underruns seen
+};
+
+/** Sizes an audio output buffer from its underruns, starting from the lowest latency a device can take.
+ * Buffer grows one burst on every glitch and shrinks one burst after a long quiet period, so that it settles
+ * right above what the device needs. Time is counted in samples played, so that controller can run from
+ * a real-time audio callback: it never locks, allocates or logs. Stats can be read from any thread. */
+class AudioBufferController {
+public:
+    // Smallest buffer, one burst playing while the next one is written
+    static const int MIN_BURSTS = 2;
+    // How long output must play without underrun before buffer shrinks one burst
+    static const int64_t QUIET_PERIOD_MS = 10000;
+
+private:
+    int32_t mFramesPerBurst = 0;
+    int32_t mMinSize = 0, mMaxSize = 0;
+    int64_t mQuietPeriodSamples = 0;
+
+    int64_t mLastXRunCount = 0;
+    int64_t mQuietSincePos = 0; // Position of last glitch or size change
+
+    std::atomic_int32_t mBufferSize = {0};
+    std::atomic_int64_t mNbGrows = {0};
+    std::atomic_int64_t mNbShrinks = {0};
+    std::atomic_int64_t mNbXRuns = {0};
+
+public:
+    /** Reset controller for an output.
+     * @param xRunCount underruns output counted so far
+     * @return buffer size to start with */
+    int32_t init(int32_t framesPerBurst, int32_t capacity, int sampleRate, int64_t xRunCount);
+
+    /** Feed underrun count of output and number of samples played so far.
+     * @return new buffer size to set on output, 0 if it should stay the same */
+    int32_t update(int64_t xRunCount, int64_t position);
+
+    /** Record size output actually accepted, which may differ from requested one. */
+    void onBufferSizeSet(int32_t size);
+
+    AudioBufferStats getStats();
+};
+
+#endif //AUDIO_BUFFER_CONTROLLER_H
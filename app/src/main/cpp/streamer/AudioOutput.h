@@ -0,0 +1,62 @@
+#ifndef AUDIO_OUTPUT_H
+#define AUDIO_OUTPUT_H
+
+extern "C" {
+#include "libavutil/samplefmt.h"
+}
+#include "cstdint"
+
+/** Format of samples an audio output plays. Samples are always interleaved. */
+struct AudioOutputParams {
+    int mSampleRate = 0;
+    int mNbChannels = 0;
+    AVSampleFormat mSampleFmt = AV_SAMPLE_FMT_S16;
+    int mFramesPerBurst = 0; // Samples per callback, 0 to let output pick its own size
+};
+
+/** Source of samples pulled by an audio output. */
+class AudioOutputCallback {
+public:
+    /** Fill data with exactly nbSamples interleaved samples.
+     * Called from the real-time thread of output, must not lock, allocate or log. */
+    virtual void onAudioOutput(void *data, int32_t nbSamples) = 0;
+};
+
+/** A device or virtual sink pulling samples at its own pace. */
+class AudioOutput {
+public:
+    virtual ~AudioOutput() = default;
+
+    /** Open output for given format, samples are pulled from callback once started.
+     * @return true if output is ready to start */
+    virtual bool open(const AudioOutputParams &params, AudioOutputCallback *callback) = 0;
+
+    /** Start or resume pulling samples. */
+    virtual bool start() = 0;
+
+    /** Stop pulling samples until started again. */
+    virtual void pause() = 0;
+
+    /** Stop pulling samples and release output, callback is never called once this returns. */
+    virtual void close() = 0;
+
+    /** Return number of samples output consumes at once. Valid once opened. */
+    virtual int32_t getFramesPerBurst() = 0;
+
+    /** Return largest number of samples output can buffer ahead of playback. Valid once opened. */
+    virtual int32_t getBufferCapacity() = 0;
+
+    /** Ask output to buffer given number of samples ahead of playback, a bigger buffer survives longer stalls.
+     * Can be called from callback.
+     * @return buffer size actually set, 0 if failed */
+    virtual int32_t setBufferSize(int32_t size) = 0;
+
+    /** Return number of underruns since output was opened, each one is an audible glitch.
+     * Can be called from callback. */
+    virtual int64_t getXRunCount() = 0;
+
+    /** Return time in millis between a sample being handed to callback and being heard. */
+    virtual int64_t getLatencyMs() = 0;
+};
+
+#endif //AUDIO_OUTPUT_H
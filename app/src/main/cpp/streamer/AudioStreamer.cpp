@@ -1,5 +1,7 @@
 #include "AudioStreamer.h"
 #include "JNILogHelper.h"
+#include "algorithm"
+#include "cmath"
 
 #define LOG_TAG "AudioStreamer"
 
@@ -9,68 +11,89 @@ AudioStreamer::AudioStreamer() {
 }
 
 AudioStreamer::~AudioStreamer() {
-    delete mFrameBuffer;
+    // Stop callbacks before releasing what they read from
+    if (mOutput) mOutput->close();
+    delete mOutput;
+
+    AudioStreamerStats stats = getStats();
+    LOGD("Audio callbacks: %lld, underruns: %lld, partial fills: %lld, samples played: %lld",
+         (long long) stats.mNbCallbacks, (long long) stats.mNbUnderruns, (long long) stats.mNbPartialFills,
+         (long long) stats.mNbSamplesPlayed);
+    AudioBufferStats bufferStats = getBufferStats();
+    LOGD("Audio drift corrections: %lld, drift: %lldus", (long long) stats.mNbDriftCorrections,
+         (long long) stats.mDriftUs);
+    LOGD("Audio buffer: %d samples, output underruns: %lld, grows: %lld, shrinks: %lld", bufferStats.mBufferSize,
+         (long long) bufferStats.mNbXRuns, (long long) bufferStats.mNbGrows, (long long) bufferStats.mNbShrinks);
+
+    delete mTimeStretcher;
+    delete mSampleRing;
     if (mSwrCtx) swr_free(&mSwrCtx);
-    if (mFrame) av_frame_free(&mFrame);
+    delete mSampleConverter;
     if (mTmpFrame) av_frame_free(&mTmpFrame);
-
-    mOutStream->stop();
-    mOutStream->close();
 }
 
 bool AudioStreamer::initiate() {
     // Validate output sample format
-    AVSampleFormat dstSampleFmt = oboeSampleFmtToAvSampleFmt(mSampleFmt);
-    if (dstSampleFmt == AV_SAMPLE_FMT_NONE) {
-        LOGE("Failed to create initiate streamer, invalid sample format.");
+    if (!isOutputSampleFmt(mSampleFmt) || !mOutput) {
+        LOGE("Failed to initiate streamer, invalid sample format or output.");
         return false;
     }
-
-    oboe::AudioStreamBuilder builder;
-    builder.setFramesPerDataCallback(mNbSamples);
-    builder.setSampleRate(mSampleRate);
-    builder.setChannelCount(mNbChannels);
-    builder.setFormat(mSampleFmt);
-    builder.setDirection(oboe::Direction::Output);
-    builder.setCallback(this);
-    builder.openManagedStream(mOutStream);
-
-    auto result = mOutStream->requestStart();
-    if (result != oboe::Result::OK) {
-        LOGE("Failed to initiate oboe audio player, error %d", result);
+    AVSampleFormat dstSampleFmt = mSampleFmt;
+
+    mBytesPerSample = av_get_bytes_per_sample(dstSampleFmt) * mNbChannels;
+    // Ring must exist before first callback
+    if (!createSampleRing()) return false;
+
+    // Callback size is left to the output unless set, sample ring serves any size
+    AudioOutputParams params;
+    params.mSampleRate = mSampleRate;
+    params.mNbChannels = mNbChannels;
+    params.mSampleFmt = dstSampleFmt;
+    params.mFramesPerBurst = mFramesPerBurst;
+    if (!mOutput->open(params, this)) {
+        LOGE("Failed to open audio output.");
+        return false;
+    }
+    // Start at lowest latency, buffer grows if device glitches
+    int32_t bufferSize = mBufferController.init(mOutput->getFramesPerBurst(), mOutput->getBufferCapacity(),
+                                                mSampleRate, mOutput->getXRunCount());
+    mBufferController.onBufferSizeSet(mOutput->setBufferSize(bufferSize));
+    LOGD("Audio output burst: %d, buffer: %d samples", mOutput->getFramesPerBurst(),
+         mBufferController.getStats().mBufferSize);
+    if (!mOutput->start()) {
+        LOGE("Failed to start audio output.");
         return false;
     }
 
-    // Create frame buffer
-    if (!createFrameBuffer()) return false;
+    mOutputLatencyUs = mOutput->getLatencyMs() * 1000;
 
-    // Check if resampler is needed
-    if (mSrcSampleRate == mSampleRate && mSrcChannelLayout == mChannelLayout &&
-        mSrcNbChannels == mNbChannels && mSrcSampleFmt == dstSampleFmt && mSrcNbSamples == mNbSamples) {
+    // Check if resampler is needed, frames of any size go into sample ring
+    // Drift is corrected by resampler, even if formats match
+    bool isSameLayout = mSrcSampleRate == mSampleRate && mSrcChannelLayout == mChannelLayout &&
+                        mSrcNbChannels == mNbChannels && !isDriftCorrected();
+    if (isSameLayout && mSrcSampleFmt == dstSampleFmt) {
         LOGD("Input and output format matched, no resampler needed.");
+    } else if (isSameLayout && SampleConverter::isSupported(mSrcSampleFmt, dstSampleFmt)) {
+        mSampleConverter = SampleConverter::create(mSrcSampleFmt, dstSampleFmt, mNbChannels);
+        mTmpFrame = FFmpegHelper::allocateAudioFrame(mSampleRate, mChannelLayout, mNbSamples, dstSampleFmt);
+        if (!mTmpFrame) return false;
     } else {
         // Create resampler
         int ret = createResampler();
         if (!ret) return false;
     }
 
-    // Allocate audio frame for audio output
-    mFrame = FFmpegHelper::allocateAudioFrame(mSampleRate, mChannelLayout, mNbSamples, dstSampleFmt);
-    if (!mFrame) return false;
-
-    // Calculate buffer size
-    mAudioBufferSize = av_samples_get_buffer_size(mFrame->linesize, mNbChannels, mNbSamples, dstSampleFmt, 0);
-
     return true;
 }
 
-bool AudioStreamer::createFrameBuffer() {
-    AVSampleFormat dstSampleFmt = oboeSampleFmtToAvSampleFmt(mSampleFmt);
-    if (dstSampleFmt == AV_SAMPLE_FMT_NONE) {
-        LOGE("Failed to create frame buffer, invalid sample format.");
+bool AudioStreamer::createSampleRing() {
+    if (mBytesPerSample <= 0 || mSampleRate <= 0 || mNbSamples <= 0) {
+        LOGE("Failed to create sample ring, invalid sample format.");
         return false;
     }
-    mFrameBuffer = new FrameBuffer(256, mChannelLayout, mNbSamples, dstSampleFmt);
+    // As much audio as 256 decoded frames
+    mSampleRing = new SampleRing(256 * mNbSamples, mBytesPerSample, mSampleRate);
+    LOGD("Sample ring holds %d samples", mSampleRing->getCapacity());
     return true;
 }
 
@@ -79,16 +102,12 @@ bool AudioStreamer::createResampler() {
     int ret;
     // Make sure all attributes are set
     if (mSrcSampleRate == 0 || mSrcChannelLayout == 0 || mSrcNbSamples == 0 || mSrcSampleFmt == AV_SAMPLE_FMT_NONE ||
-        mSampleRate == 0 || mChannelLayout == 0 || mNbSamples == 0 || mSampleFmt == oboe::AudioFormat::Unspecified) {
+        mSampleRate == 0 || mChannelLayout == 0 || mNbSamples == 0 || mSampleFmt == AV_SAMPLE_FMT_NONE) {
         LOGE("Failed to create resampler, missing or invalid parameters.");
         return false;
     }
 
-    AVSampleFormat dstSampleFmt = oboeSampleFmtToAvSampleFmt(mSampleFmt);
-    if (dstSampleFmt == AV_SAMPLE_FMT_NONE) {
-        LOGE("Failed to create resampler, invalid sample format.");
-        return false;
-    }
+    AVSampleFormat dstSampleFmt = mSampleFmt;
 
     mSwrCtx = swr_alloc();
     if (!mSwrCtx) {
@@ -103,16 +122,19 @@ bool AudioStreamer::createResampler() {
     av_opt_set_int(mSwrCtx, "out_channel_count", mNbChannels, 0);
     av_opt_set_int(mSwrCtx, "out_sample_rate", mSampleRate, 0);
     av_opt_set_sample_fmt(mSwrCtx, "out_sample_fmt", dstSampleFmt, 0);
+    // Compensation needs resampling, enable it now rather than reinitializing resampler on first correction
+    if (isDriftCorrected()) av_opt_set_int(mSwrCtx, "flags", SWR_FLAG_RESAMPLE, 0);
 
     // Initialize the resampling context
-    if ((ret = swr_init(mSwrCtx)) < 0) {
+    if ((ret = FFmpegHelper::initResampler(mSwrCtx, mResamplerProfile, isDriftCorrected())) < 0) {
         LOGE("Failed to initialize the resampling context: %s", av_err2str(ret));
         return false;
     }
 
-    LOGV("Resampler created for conversion %d %d %s -> %d %d %s",
+    LOGV("Resampler created for conversion %d %d %s -> %d %d %s, %s profile",
          mSrcNbChannels, mSrcSampleRate, av_get_sample_fmt_name(mSrcSampleFmt),
-         mNbChannels, mSrcSampleRate, av_get_sample_fmt_name(dstSampleFmt));
+         mNbChannels, mSampleRate, av_get_sample_fmt_name(dstSampleFmt),
+         FFmpegHelper::getResamplerProfileName(mResamplerProfile));
 
     // Allocate frame for resampler output
     mTmpFrame = FFmpegHelper::allocateAudioFrame(mSampleRate, mChannelLayout, mNbSamples, dstSampleFmt);
@@ -122,67 +144,188 @@ bool AudioStreamer::createResampler() {
 }
 
 
-AVSampleFormat AudioStreamer::oboeSampleFmtToAvSampleFmt(oboe::AudioFormat sampleFmt) {
+bool AudioStreamer::isDriftCorrected() const {
+    return mClock && mClock->getMode() != ClockMode::AUDIO_MASTER;
+}
+
+void AudioStreamer::correctDrift(const AVFrame *srcFrame, int64_t tsMs) {
+    // A correction is spread over several frames, the next one is only sized once it is done
+    auto nbOutSamples = (int) av_rescale(srcFrame->nb_samples, mSampleRate, mSrcSampleRate);
+    bool isCorrecting = mNbCompensationLeft > 0;
+    if (isCorrecting) mNbCompensationLeft -= nbOutSamples;
+
+    int64_t nowNs = mClock->getNowNs();
+    if (!mClock->isStarted() || mClock->isPaused() || srcFrame->pts == AV_NOPTS_VALUE) return;
+
+    // Samples written now are heard once sample ring and output buffer ahead of them are played,
+    // master clock keeps running meanwhile at playback speed. Corrections already queued are part of the ring.
+    int64_t queuedUs = (int64_t) mSampleRing->getReadAvailable() * 1000000 / mSampleRate + mOutputLatencyUs;
+    queuedUs = (int64_t) ((double) queuedUs * mSpeed);
+    int64_t driftUs = tsMs * 1000 - (mClock->getTimeUs(nowNs) + queuedUs);
+    if (driftUs > NO_SYNC_THRESHOLD_US || driftUs < -NO_SYNC_THRESHOLD_US) {
+        mDriftCumUs = 0;
+        mNbDriftMeasures = 0;
+        return;
+    }
+
+    // Exponential average, so that a single late measure does not trigger a correction
+    static const double avgCoef = exp(log(0.01) / DRIFT_AVG_NB);
+    mDriftCumUs = (double) driftUs + avgCoef * mDriftCumUs;
+    if (mNbDriftMeasures < DRIFT_AVG_NB) {
+        mNbDriftMeasures++;
+        return;
+    }
+    auto avgDriftUs = (int64_t) (mDriftCumUs * (1.0 - avgCoef));
+    mDriftUs = avgDriftUs;
+    if (isCorrecting || (avgDriftUs < DRIFT_THRESHOLD_US && avgDriftUs > -DRIFT_THRESHOLD_US)) return;
+
+    // Audio ahead is slowed down with more samples, audio behind is sped up with fewer. Only part of average drift is
+    // corrected at once, since average lags behind drift, so that correction does not overshoot.
+    auto deltaSamples = (int) ((double) avgDriftUs * DRIFT_CORRECTION_GAIN * mSampleRate / 1000000);
+    int distance = std::max(nbOutSamples, abs(deltaSamples) * 100 / MAX_CORRECTION_PERCENT);
+    int ret = swr_set_compensation(mSwrCtx, deltaSamples, distance);
+    if (ret < 0) {
+        LOGE("Could not set resampler compensation: %s", av_err2str(ret));
+        return;
+    }
+    mNbCompensationLeft = distance - nbOutSamples;
+    mNbDriftCorrections++;
+}
+
+bool AudioStreamer::isOutputSampleFmt(AVSampleFormat sampleFmt) {
     switch (sampleFmt) {
-        case oboe::AudioFormat::I16:
-            return AV_SAMPLE_FMT_S16;
-        case oboe::AudioFormat::I32:
-            return AV_SAMPLE_FMT_S32;
-        case oboe::AudioFormat::Float:
-            return AV_SAMPLE_FMT_FLT;
+        case AV_SAMPLE_FMT_S16:
+        case AV_SAMPLE_FMT_S32:
+        case AV_SAMPLE_FMT_FLT:
+            return true;
         default:
-            return AV_SAMPLE_FMT_NONE;
+            return false;
     }
 }
 
 void AudioStreamer::pause() {
-    mOutStream->pause();
+    mOutput->pause();
 }
 
 void AudioStreamer::resume() {
-    mOutStream->start();
+    mOutput->start();
+}
+
+AudioStreamerStats AudioStreamer::getStats() {
+    AudioStreamerStats stats;
+    stats.mNbCallbacks = mNbCallbacks.load();
+    stats.mNbUnderruns = mNbUnderruns.load();
+    stats.mNbPartialFills = mNbPartialFills.load();
+    stats.mNbSamplesPlayed = mNbSamplesPlayed.load();
+    stats.mNbDriftCorrections = mNbDriftCorrections.load();
+    stats.mDriftUs = mDriftUs.load();
+    return stats;
+}
+
+AudioBufferStats AudioStreamer::getBufferStats() {
+    return mBufferController.getStats();
+}
+
+void AudioStreamer::setSpeed(double speed) {
+    if (speed > 0) mSpeed = speed;
+}
+
+int64_t AudioStreamer::getOutputLatencyMs() {
+    return mOutput ? mOutput->getLatencyMs() : 0;
 }
 
 int AudioStreamer::onAudioFrame(AVFrame *srcFrame) {
-    if (mFrameBuffer->isFull()) return false;
+    const uint8_t *samples = srcFrame->data[0];
+    int nbSamples = srcFrame->nb_samples;
+    int64_t tsMs = ptsToMs(srcFrame->pts, mTimeBase);
+    // Output timestamps are not safe to query from audio callback, refresh latency here
+    if (mClock) mOutputLatencyUs = mOutput->getLatencyMs() * 1000;
+
+    // Stretcher keeps running once created, so that going back to speed 1 continues seamlessly
+    double speed = mSpeed;
+    if (speed != 1.0 && !mTimeStretcher) mTimeStretcher = new TimeStretcher(mSampleRate, mNbChannels, mSampleFmt);
+    if (mTimeStretcher) mTimeStretcher->setSpeed(speed);
+
+    // Resampler and stretcher keep state, make sure their whole output fits before feeding them
+    int maxSamples = mSwrCtx ? swr_get_out_samples(mSwrCtx, srcFrame->nb_samples) : nbSamples;
+    int maxOutSamples = mTimeStretcher ? mTimeStretcher->getMaxOutput(maxSamples) : maxSamples;
+    if (maxOutSamples > mSampleRing->getWriteAvailable()) return false;
+
+    // Samples are copied into ring right away, the same storage is reused for every frame
+    if (mTmpFrame && maxSamples > mTmpFrame->nb_samples) {
+        av_frame_free(&mTmpFrame);
+        mTmpFrame = FFmpegHelper::allocateAudioFrame(mSampleRate, mChannelLayout, maxSamples, mSampleFmt);
+        if (!mTmpFrame) return 0;
+    }
 
-    AVFrame *frame = srcFrame;
     // Using resampler
     if (mSwrCtx) {
-        // Resample frame to output format
-        int ret = swr_convert_frame(mSwrCtx, mTmpFrame, srcFrame);
-        if (ret < 0) {
-            LOGE("Could not resample frame: %s", av_err2str(ret));
+        if (isDriftCorrected()) correctDrift(srcFrame, tsMs);
+        // Resample frame to output format, samples beyond what fits stay inside resampler until next frame
+        nbSamples = swr_convert(mSwrCtx, mTmpFrame->data, maxSamples,
+                                (const uint8_t **) srcFrame->extended_data, srcFrame->nb_samples);
+        if (nbSamples < 0) {
+            LOGE("Could not resample frame: %s", av_err2str(nbSamples));
             return 0;
         }
-        frame = mTmpFrame;
-        frame->pts = srcFrame->pts;
+        samples = mTmpFrame->data[0];
+    } else if (mSampleConverter) {
+        mSampleConverter->convert(srcFrame->extended_data, mTmpFrame->data, nbSamples);
+        samples = mTmpFrame->data[0];
     }
 
-    return mFrameBuffer->putFrame(frame);
+    if (mTimeStretcher) {
+        size_t size = (size_t) maxOutSamples * mBytesPerSample;
+        if (mStretchBuffer.size() < size) mStretchBuffer.resize(size);
+        int64_t stretchedTsMs = tsMs;
+        nbSamples = mTimeStretcher->process(samples, nbSamples, tsMs, mStretchBuffer.data(), &stretchedTsMs);
+        return mSampleRing->write(mStretchBuffer.data(), nbSamples, stretchedTsMs, (float) speed);
+    }
+    return mSampleRing->write(samples, nbSamples, tsMs);
 }
 
-oboe::DataCallbackResult AudioStreamer::onAudioReady(oboe::AudioStream *oboeStream, void *audioData, int32_t numFrames) {
-    auto *data = (int16_t *) audioData;
+void AudioStreamer::onAudioFlush() {
+    if (mSampleRing) mSampleRing->discard();
+    if (mTimeStretcher) mTimeStretcher->reset();
+    if (mSwrCtx) {
+        // Initiating resampler again drops samples it kept and any drift compensation
+        int ret = swr_init(mSwrCtx);
+        if (ret < 0) LOGE("Could not reset resampler: %s", av_err2str(ret));
+    }
+    mDriftCumUs = 0;
+    mNbDriftMeasures = 0;
+    mNbCompensationLeft = 0;
+    mDriftUs = 0;
+}
 
-    if (!mFrameBuffer || !mFrame) {
-        // Fill with silence
-        std::fill_n(data, numFrames * mNbChannels, 0);
-        return oboe::DataCallbackResult::Continue;
+void AudioStreamer::onAudioOutput(void *audioData, int32_t numFrames) {
+    auto *data = (uint8_t *) audioData;
+    mNbCallbacks++;
+
+    int nbRead = 0;
+    if (mSampleRing) {
+        int64_t tsMs = AV_NOPTS_VALUE;
+        float speed = 1.0f;
+        // Read before taking samples, samples read before a flush do not start clock again
+        int serial = mClock ? mClock->getSerial() : 0;
+        nbRead = mSampleRing->read(data, numFrames, &tsMs, &speed);
+        // First sample read now is heard once samples already buffered by output are played,
+        // they cover more stream time when played faster
+        if (tsMs != AV_NOPTS_VALUE && mClock) {
+            mClock->setAudioTime(tsMs * 1000 - (int64_t) ((float) mOutputLatencyUs * speed), mClock->getNowNs(),
+                                 serial);
+        }
     }
+    mNbSamplesPlayed += nbRead;
 
-    bool ret = mFrameBuffer->takeFrame(mFrame);
+    if (nbRead < numFrames) {
+        if (nbRead == 0) mNbUnderruns++;
+        else mNbPartialFills++;
+        // Fill the rest with silence, every supported format is silent at zero
+        memset(data + nbRead * mBytesPerSample, 0, (size_t) (numFrames - nbRead) * mBytesPerSample);
+    }
 
-    if (!ret) {
-        // Fill with silence
-        std::fill_n(data, numFrames * mNbChannels, 0);
-    } else {
-        // Set current time
-        int64_t ms = ptsToMs(mFrame->pts, mTimeBase);
-        if (mCurrentTsMs) mCurrentTsMs->store(ms);
-        // Copy samples
-        memcpy(data, mFrame->data[0], mAudioBufferSize);
-        mIsFrameConsumed = true;
-    }
-    return oboe::DataCallbackResult::Continue;
-}
\ No newline at end of file
+    mOutputPos += numFrames;
+    int32_t bufferSize = mBufferController.update(mOutput->getXRunCount(), mOutputPos);
+    if (bufferSize > 0) mBufferController.onBufferSizeSet(mOutput->setBufferSize(bufferSize));
+}
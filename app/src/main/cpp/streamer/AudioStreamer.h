@@ -8,32 +8,74 @@ extern "C" {
 
 #include "TimeUtils.h"
 #include "../ffmpeg/FFmpegHelper.h"
-#include "oboe/Oboe.h"
+#include "AudioOutput.h"
+#include "AudioBufferController.h"
 #include "Sink.h"
 #include "mutex"
-#include "FrameBuffer.h"
-
+#include "SampleRing.h"
+#include "MediaClock.h"
+#include "TimeStretcher.h"
+#include "../ffmpeg/SampleConverter.h"
+#include "vector"
+
+/** Sample counters of an audio streamer. */
+struct AudioStreamerStats {
+    int64_t mNbCallbacks = 0; // Audio callbacks served
+    int64_t mNbUnderruns = 0; // Callbacks with no sample available, filled with silence
+    int64_t mNbPartialFills = 0; // Callbacks with fewer samples available than requested, padded with silence
+    int64_t mNbSamplesPlayed = 0; // Samples taken out of sample ring
+    int64_t mNbDriftCorrections = 0; // Corrections started to follow master clock, each spread over several frames
+    int64_t mDriftUs = 0; // Average time audio is ahead of master clock, 0 when audio is master
+};
 
-class AudioStreamer : public AudioSink, public oboe::AudioStreamCallback {
+class AudioStreamer : public AudioSink, public AudioOutputCallback {
     friend class AudioStreamerBuilder;
     friend class MediaStreamerBuilder;
 
 private:
     // Resampler to convert source frame to desired format
     SwrContext *mSwrCtx = nullptr;
-    // Flag to check if frame is consumed
-    std::atomic_bool mIsFrameConsumed = {true};
-    // Storage for output frame
-    AVFrame *mFrame = nullptr;
-    // Storage for resampled frame
+    // Replaces resampler when only sample format or planarity differs
+    SampleConverter *mSampleConverter = nullptr;
+    // Storage for resampled or converted frame
     AVFrame *mTmpFrame = nullptr;
-    // Mutex to prevent reading and writing data to frame at the same time
-    std::mutex mMutex;
-    // Frame buffer for buffering
-    FrameBuffer *mFrameBuffer;
-    // Current time of stream in millis
-    std::atomic_int64_t *mCurrentTsMs = nullptr;
-
+    // Ring of output samples between decoding thread and audio callback
+    SampleRing *mSampleRing = nullptr;
+    // Playback speed, set from any thread and applied by decoding thread
+    std::atomic<double> mSpeed = {1.0};
+    // Changes speed of resampled frames keeping their pitch, created once speed first leaves 1
+    TimeStretcher *mTimeStretcher = nullptr;
+    // Storage for stretched samples, only used from decoding thread
+    std::vector<uint8_t> mStretchBuffer;
+    // Clock audio is played against, null to play at output pace
+    MediaClock *mClock = nullptr;
+    // Output latency taken off clock, measured on decoding thread since output timestamps cannot be queried from
+    // audio callback on every backend
+    std::atomic_int64_t mOutputLatencyUs = {0};
+
+    std::atomic_int64_t mNbCallbacks = {0};
+    std::atomic_int64_t mNbUnderruns = {0};
+    std::atomic_int64_t mNbPartialFills = {0};
+    std::atomic_int64_t mNbSamplesPlayed = {0};
+    std::atomic_int64_t mNbDriftCorrections = {0};
+    std::atomic_int64_t mDriftUs = {0};
+
+    // Drift of audio against master clock, averaged over frames, only used from decoding thread {
+    // Weight of a measure falls to 1% after this many frames
+    static const int DRIFT_AVG_NB = 20;
+    // Average drift under this is left alone
+    static const int64_t DRIFT_THRESHOLD_US = 20000;
+    // Drift over this is a discontinuity, e.g. a seek, rather than drift
+    static const int64_t NO_SYNC_THRESHOLD_US = 10000000;
+    // Largest change of playback rate when correcting drift
+    static const int MAX_CORRECTION_PERCENT = 10;
+    // Part of average drift corrected at once
+    static constexpr double DRIFT_CORRECTION_GAIN = 0.5;
+    double mDriftCumUs = 0;
+    int mNbDriftMeasures = 0;
+    // Output samples the correction under way is still spread over
+    int mNbCompensationLeft = 0;
+    // } Drift
 
     AVRational mTimeBase = {0, 1};
     // Audio input params {
@@ -49,23 +91,36 @@ private:
     uint64_t mChannelLayout = 0;
     int mNbChannels = 0;
     int mNbSamples = 0;
-    oboe::AudioFormat mSampleFmt = oboe::AudioFormat::I16; // Output sample format
-    int mAudioBufferSize = 0; // Size in byte per buffer
+    AVSampleFormat mSampleFmt = AV_SAMPLE_FMT_S16; // Output sample format, always interleaved
+    int mBytesPerSample = 0; // Size in byte of one sample of every channel
     // } Audio output params
 
-    oboe::ManagedStream mOutStream; // Output stream
+    int mFramesPerBurst = 0; // Samples per output callback, 0 to let output pick
+    ResamplerProfile mResamplerProfile = ResamplerProfile::DEFAULT;
+
+    AudioOutput *mOutput = nullptr; // Output pulling samples, owned by streamer
+    // Sizes output buffer from its underruns, only updated from audio callback
+    AudioBufferController mBufferController;
+    int64_t mOutputPos = 0; // Samples handed to output, only used from audio callback
 
 private:
     bool initiate();
 
-    /** Create frame buffer and allocate resources to it */
-    bool createFrameBuffer();
+    /** Create sample ring between decoding thread and audio callback. */
+    bool createSampleRing();
 
     /** Create a resampler to convert audio from input format to output format. */
     bool createResampler();
 
-    /** Return equivalent ffmpeg AVSampleFormat given oboe AudioFormat. */
-    static AVSampleFormat oboeSampleFmtToAvSampleFmt(oboe::AudioFormat sampleFmt);
+    /** Return true if audio follows another stream and is resampled to keep in step with master clock. */
+    bool isDriftCorrected() const;
+
+    /** Measure how far a frame written now will be from master clock when heard,
+     * and stretch or shrink it through resampler if audio drifted away. */
+    void correctDrift(const AVFrame *srcFrame, int64_t tsMs);
+
+    /** Return true if outputs can play given format. */
+    static bool isOutputSampleFmt(AVSampleFormat sampleFmt);
 
 public:
     AudioStreamer();
@@ -76,13 +131,32 @@ public:
 
     void resume();
 
+    AudioStreamerStats getStats();
+
+    AudioBufferStats getBufferStats();
+
+    /** Set playback speed of following frames, pitch is kept. Speed above 1 plays faster.
+     * Frames already in sample ring play at the speed they were stretched to. */
+    void setSpeed(double speed);
+
+    /** Return time in millis between a sample leaving streamer and being heard, follows buffer size changes. */
+    int64_t getOutputLatencyMs();
+
     /** Callback, will be called when there is an incoming frame from decoder.
-     * Incoming frames will be converted with resampler and stored in frame buffer. */
+     * Incoming frames will be converted with resampler, time-stretched to playback speed and stored in sample ring.
+     * @return false if sample ring has no room for frame, frame should be retried later */
     int onAudioFrame(AVFrame *srcFrame) override;
 
+    /** Drop samples buffered in sample ring, resampler and stretcher, e.g. on a seek. Must not be called while a frame
+     * is written. Audio callback skips samples of the ring on its next call. */
+    void onAudioFlush() override;
+
     /** Callback, will be called when stream needs more audio data.
-     * This will try to take a frame from frame buffer, return silence if no frame returns. */
-    oboe::DataCallbackResult onAudioReady(oboe::AudioStream *oboeStream, void *audioData, int32_t numFrames) override;
+     * Takes exactly numFrames samples out of sample ring whatever size decoded frames have,
+     * missing samples are filled with silence. Reports time heard to clock, then resizes output buffer if
+     * output glitched.
+     * Does not lock, allocate or log. */
+    void onAudioOutput(void *audioData, int32_t numFrames) override;
 };
 
 
@@ -1,5 +1,9 @@
 #include "AudioStreamerBuilder.h"
 #include "JNILogHelper.h"
+#include "VirtualAudioOutput.h"
+#ifdef __ANDROID__
+#include "OboeAudioOutput.h"
+#endif
 #define LOG_TAG "AudioStreamerBuilder"
 
 AudioStreamerBuilder *AudioStreamerBuilder::setAudioTimeBase(AVRational timebase) {
@@ -44,11 +48,31 @@ AudioStreamerBuilder *AudioStreamerBuilder::setNbSamples(int nbSamples) {
     return this;
 }
 
-AudioStreamerBuilder *AudioStreamerBuilder::setSampleFmt(oboe::AudioFormat sampleFmt) {
+AudioStreamerBuilder *AudioStreamerBuilder::setSampleFmt(AVSampleFormat sampleFmt) {
     mSampleFmt = sampleFmt;
     return this;
 }
 
+AudioStreamerBuilder *AudioStreamerBuilder::setFramesPerBurst(int framesPerBurst) {
+    mFramesPerBurst = framesPerBurst;
+    return this;
+}
+
+AudioStreamerBuilder *AudioStreamerBuilder::setResamplerProfile(ResamplerProfile profile) {
+    mResamplerProfile = profile;
+    return this;
+}
+
+AudioStreamerBuilder *AudioStreamerBuilder::setAudioOutput(AudioOutput *output) {
+    mOutput = output;
+    return this;
+}
+
+AudioStreamerBuilder *AudioStreamerBuilder::setAudioClock(MediaClock *clock) {
+    mAudioClock = clock;
+    return this;
+}
+
 AudioStreamer *AudioStreamerBuilder::buildAudioStreamer() {
     // Validate all parameters
     if (mSrcSampleRate <= 0 || mSrcChannelLayout == 0 || mSrcNbSamples <= 0 ||
@@ -71,7 +95,21 @@ AudioStreamer *AudioStreamerBuilder::buildAudioStreamer() {
     audioStreamer->mChannelLayout = (mChannelLayout == 0) ? mSrcChannelLayout : mChannelLayout;
     audioStreamer->mNbChannels = (mNbChannels <= 0) ? mSrcNbChannels : mNbChannels;
     audioStreamer->mNbSamples = (mNbSamples <= 0) ? mSrcNbSamples : mNbSamples;
-    audioStreamer->mSampleFmt = (mSampleFmt == oboe::AudioFormat::Unspecified) ? oboe::AudioFormat::I16 : mSampleFmt;
+    audioStreamer->mSampleFmt = (mSampleFmt == AV_SAMPLE_FMT_NONE) ? AV_SAMPLE_FMT_S16 : mSampleFmt;
+    audioStreamer->mFramesPerBurst = mFramesPerBurst;
+    audioStreamer->mResamplerProfile = mResamplerProfile;
+    audioStreamer->mClock = mAudioClock;
+
+    // Streamer owns output from now on, even if it fails to initiate
+    audioStreamer->mOutput = mOutput;
+    mOutput = nullptr;
+    if (!audioStreamer->mOutput) {
+#ifdef __ANDROID__
+        audioStreamer->mOutput = new OboeAudioOutput();
+#else
+        audioStreamer->mOutput = new VirtualAudioOutput();
+#endif
+    }
 
     int ret = audioStreamer->initiate();
     if (!ret) {
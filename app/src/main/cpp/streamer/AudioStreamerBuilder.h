@@ -19,8 +19,13 @@ protected:
     uint64_t mChannelLayout = 0;
     int mNbChannels = 0;
     int mNbSamples = 0;
-    oboe::AudioFormat mSampleFmt = oboe::AudioFormat::I16;
+    AVSampleFormat mSampleFmt = AV_SAMPLE_FMT_NONE;
+    int mFramesPerBurst = 0;
+    ResamplerProfile mResamplerProfile = ResamplerProfile::DEFAULT;
     // } Audio output params
+
+    AudioOutput *mOutput = nullptr;
+    MediaClock *mAudioClock = nullptr;
 public:
     /** Set audio stream time base. */
     AudioStreamerBuilder *setAudioTimeBase(AVRational timebase);
@@ -44,7 +49,20 @@ public:
     AudioStreamerBuilder *setNbSamples(int nbSamples);
     /** Set output sample format.
      * If this value is not set, use default value instead. */
-    AudioStreamerBuilder *setSampleFmt(oboe::AudioFormat sampleFmt);
+    AudioStreamerBuilder *setSampleFmt(AVSampleFormat sampleFmt);
+    /** Set number of samples output pulls per callback.
+     * If this value is not set, output picks its own size. */
+    AudioStreamerBuilder *setFramesPerBurst(int framesPerBurst);
+    /** Set how much resampling may cost for its quality.
+     * If this value is not set, default profile is used. */
+    AudioStreamerBuilder *setResamplerProfile(ResamplerProfile profile);
+    /** Set output samples are played on, streamer takes ownership of it.
+     * If this value is not set, Oboe is used on Android and a real time virtual output elsewhere. */
+    AudioStreamerBuilder *setAudioOutput(AudioOutput *output);
+    /** Set clock audio is played against, not owned by streamer. Audio drives clock in audio master mode,
+     * otherwise audio is resampled to keep in step with it.
+     * If this value is not set, audio plays at output pace. */
+    AudioStreamerBuilder *setAudioClock(MediaClock *clock);
 
     /** Build audio streamer from given parameters.
      * @return steamer or nullptr if failed to build streamer */
@@ -1,40 +1,16 @@
 #include "FrameBuffer.h"
 #include "../common/JNILogHelper.h"
+#include "../ffmpeg/FramePool.h"
 
 #define LOG_TAG "FrameBuffer"
 
-FrameNode::FrameNode(int width, int height, AVPixelFormat pixFmt) : mType(AVMEDIA_TYPE_VIDEO) {
+FrameNode::FrameNode(AVMediaType type) : mType(type) {
+    // Frame data is referenced from incoming frames, nothing is allocated until a frame is put in
     mFrame = av_frame_alloc();
     if (!mFrame) {
         LOGE("Cannot allocate frame data");
         return;
     }
-
-    mFrame->width = width;
-    mFrame->height = height;
-    mFrame->format = pixFmt;
-    int ret = av_frame_get_buffer(mFrame, 0);
-    if (ret < 0) {
-        LOGE("Cannot get frame buffer: %s", av_err2str(ret));
-        return;
-    }
-}
-
-FrameNode::FrameNode(uint64_t channelLayout, int nbSamples, AVSampleFormat sampleFmt) : mType(AVMEDIA_TYPE_AUDIO) {
-    mFrame = av_frame_alloc();
-    if (!mFrame) {
-        LOGE("Cannot allocate frame data");
-        return;
-    }
-
-    mFrame->channel_layout = channelLayout;
-    mFrame->format = sampleFmt;
-    mFrame->nb_samples = nbSamples;
-    int ret = av_frame_get_buffer(mFrame, 0);
-    if (ret < 0) {
-        LOGE("Cannot get frame buffer: %s", av_err2str(ret));
-        return;
-    }
 }
 
 FrameNode::~FrameNode() {
@@ -64,9 +40,7 @@ FrameBuffer::FrameBuffer(int size, uint64_t channelLayout, int nbSamples, AVSamp
 void FrameBuffer::allocateBuffer() {
     int i;
     for (i = 0; i < mSize; i++) {
-        FrameNode *newNode;
-        if (mType == AVMEDIA_TYPE_VIDEO) newNode = new FrameNode(mWidth, mHeight, mPixFmt);
-        else newNode = new FrameNode(mChannelLayout, mNbSamples, mSampleFmt);
+        auto *newNode = new FrameNode(mType);
 
         if (mHeadPtr == nullptr) {
             mHeadPtr = newNode;
@@ -103,7 +77,9 @@ bool FrameBuffer::isFull() {
 bool FrameBuffer::putFrame(AVFrame *inFrame) {
     // Check frame parameters before putting in
     if (mType == AVMEDIA_TYPE_VIDEO) {
-        if (inFrame->width != mWidth || inFrame->height != mHeight || inFrame->format != mPixFmt) {
+        // Picture size follows surface size and decoder resolution, format is fixed unless none was given
+        if (inFrame->width <= 0 || inFrame->height <= 0 || inFrame->format < 0 ||
+            (mPixFmt != AV_PIX_FMT_NONE && inFrame->format != mPixFmt)) {
             LOGE("Invalid format, expected %d %d %s, got %d %d %s",
                  mWidth, mHeight, av_get_pix_fmt_name(mPixFmt),
                  inFrame->width, inFrame->height, av_get_pix_fmt_name((AVPixelFormat) inFrame->format));
@@ -124,12 +100,30 @@ bool FrameBuffer::putFrame(AVFrame *inFrame) {
     if (mCount == mSize) return false;
 
     AVFrame *frame = mTailPtr->mFrame;
-    mTailPtr = mTailPtr->mNextPtr;
+    av_frame_unref(frame);
 
-    av_frame_copy(frame, inFrame);
-    frame->time_base = inFrame->time_base;
-    frame->pts = inFrame->pts;
+    int ret;
+    if (inFrame->buf[0]) {
+        // Share reference counted buffers instead of copying data
+        ret = av_frame_ref(frame, inFrame);
+    } else {
+        // Frame data is not reference counted, copy it into a pooled buffer
+        frame->format = inFrame->format;
+        frame->width = inFrame->width;
+        frame->height = inFrame->height;
+        frame->channel_layout = inFrame->channel_layout;
+        frame->nb_samples = inFrame->nb_samples;
+        ret = FramePool::getInstance()->getBuffer(frame, 0);
+        if (ret >= 0) ret = av_frame_copy(frame, inFrame);
+        if (ret >= 0) ret = av_frame_copy_props(frame, inFrame);
+    }
+    if (ret < 0) {
+        LOGE("Cannot put frame into buffer: %s", av_err2str(ret));
+        av_frame_unref(frame);
+        return false;
+    }
 
+    mTailPtr = mTailPtr->mNextPtr;
     mCount++;
 
     // Get out of buffering state if there are enough frames
@@ -138,80 +132,88 @@ bool FrameBuffer::putFrame(AVFrame *inFrame) {
     return true;
 }
 
-bool FrameBuffer::takeFrame(AVFrame *outFrame) {
-
-    if (mIsBuffering) return false;
-    if (mCount == 0) return false;
-
-    AVFrame *frame = mHeadPtr->mFrame;
-    av_frame_copy(outFrame, frame);
-    outFrame->pts = frame->pts;
+void FrameBuffer::popFrame(AVFrame *outFrame) {
+    // Hand the frame reference over to outFrame, its previous buffers go back to their pool
+    av_frame_unref(outFrame);
+    av_frame_move_ref(outFrame, mHeadPtr->mFrame);
     // Move head to next frame
     mHeadPtr = mHeadPtr->mNextPtr;
 
     mCount--;
     if (mCount == 0) mIsBuffering = true;
+}
+
+void FrameBuffer::dropFrame() {
+    av_frame_unref(mHeadPtr->mFrame);
+    // Move head to next frame
+    mHeadPtr = mHeadPtr->mNextPtr;
+    mCount--;
+}
+
+bool FrameBuffer::takeFrame(AVFrame *outFrame, bool isBuffered) {
+    std::unique_lock<std::mutex> lck(mMutex);
+    if (mIsBuffering && isBuffered) return false;
+    if (mCount == 0) return false;
+
+    popFrame(outFrame);
 
     return true;
 }
 
-bool FrameBuffer::takeFrame(AVFrame *outFrame, int64_t pts) {
+bool FrameBuffer::takeFrame(AVFrame *outFrame, int64_t pts, int *nbDropped) {
+    if (nbDropped) *nbDropped = 0;
 
+    std::unique_lock<std::mutex> lck(mMutex);
     if (mIsBuffering) return false;
     if (mCount == 0) return false;
 
-    AVFrame *frame = mHeadPtr->mFrame;
-    FrameNode *next;
     // Find the nearest smaller frame with given pts
     // If current frame if after pts, return nothing
-    if (frame->pts > pts) return false;
-    // If equal then return that frame (barely happens)
-    if (frame->pts == pts) {
-        av_frame_copy(outFrame, frame);
-        outFrame->pts = frame->pts;
-        // Move head to next frame
-        mHeadPtr = mHeadPtr->mNextPtr;
-
-        mCount--;
-        if (mCount == 0) mIsBuffering = true;
-        return true;
+    if (mHeadPtr->mFrame->pts > pts) return false;
+
+    // Drop frames that are already late, next frame is only valid if it was put in
+    while (mCount > 1 && mHeadPtr->mNextPtr->mFrame->pts <= pts) {
+        dropFrame();
+        if (nbDropped) (*nbDropped)++;
     }
 
-    next = mHeadPtr->mNextPtr;
-    while (true) {
-        // Check if there is a next frame
-        // There is no next frame, return current frame
-        if (mCount == 0) {
-            av_frame_copy(outFrame, frame);
-            outFrame->pts = frame->pts;
-            // Move head to next frame
-            mHeadPtr = mHeadPtr->mNextPtr;
-            mIsBuffering = true;
-            return true;
-        } else {
-            AVFrame *nextFrame = next->mFrame;
-            // If next frame is after pts, return current frame
-            if (nextFrame->pts > pts) {
-                av_frame_copy(outFrame, frame);
-                outFrame->pts = frame->pts;
-                // Move head to next frame
-                mHeadPtr = mHeadPtr->mNextPtr;
-                mCount--;
-                if (mCount == 0) mIsBuffering = true;
-                return true;
-            } else {
-                // Move head to next frame
-                mHeadPtr = mHeadPtr->mNextPtr;
-                frame = nextFrame;
-                next = next->mNextPtr;
-                mCount--;
-            }
-        }
+    popFrame(outFrame);
+    return true;
+}
+
+bool FrameBuffer::peekFrame(int index, AVFrame *outFrame) {
+    std::unique_lock<std::mutex> lck(mMutex);
+    if (index >= mCount) return false;
+    FrameNode *node = mHeadPtr;
+    for (int i = 0; i < index; i++) node = node->mNextPtr;
+    av_frame_unref(outFrame);
+    return av_frame_ref(outFrame, node->mFrame) >= 0;
+}
+
+bool FrameBuffer::replaceFrame(const AVFrame *oldFrame, AVFrame *newFrame) {
+    if (!oldFrame->buf[0]) return false;
+    std::unique_lock<std::mutex> lck(mMutex);
+    FrameNode *node = mHeadPtr;
+    for (int i = 0; i < mCount; i++, node = node->mNextPtr) {
+        // Data stays referenced by oldFrame, no other frame can have it
+        AVBufferRef *buf = node->mFrame->buf[0];
+        if (!buf || buf->buffer != oldFrame->buf[0]->buffer) continue;
+        av_frame_unref(node->mFrame);
+        av_frame_move_ref(node->mFrame, newFrame);
+        return true;
     }
+    return false;
 }
 
 void FrameBuffer::reset() {
+    std::unique_lock<std::mutex> lck(mMutex);
+    FrameNode *node = mHeadPtr;
+    do {
+        av_frame_unref(node->mFrame);
+        node = node->mNextPtr;
+    } while (node != mHeadPtr);
+
     mCount = 0;
     mIsBuffering = true;
     mTailPtr = mHeadPtr;
-}
\ No newline at end of file
+}
@@ -6,6 +6,7 @@ extern "C" {
 #include "libavutil/frame.h"
 }
 
+#include "atomic"
 #include "semaphore"
 #include "mutex"
 #include "condition_variable"
@@ -20,14 +21,13 @@ public:
 
     FrameNode *mNextPtr = nullptr; // Pointer to next node
 
-    FrameNode(int width, int height, AVPixelFormat pixFmt);
-
-    FrameNode(uint64_t channelLayout, int nbSamples, AVSampleFormat sampleFmt);
+    FrameNode(AVMediaType type);
 
     ~FrameNode();
 };
 
-/** A circular queue that holds every processed frame for audio/video player */
+/** A circular queue that holds every processed frame for audio/video player.
+ * Frames are held by reference, buffers are shared with producer and handed over to consumer without copying. */
 class FrameBuffer {
 private:
     std::atomic_int mCount = {0};
@@ -53,12 +53,21 @@ private:
     FrameNode *mHeadPtr = nullptr;
     // Stores the pointer of the next object for data to be written into
     FrameNode *mTailPtr = nullptr;
+    // Guards frames between head and tail while producer replaces some of them and consumer takes them out
+    std::mutex mMutex;
 private:
-    /** Allocate memory to 'size' frames */
+    /** Allocate 'size' empty frame nodes */
     void allocateBuffer();
 
+    /** Move head frame reference into outFrame and advance head. */
+    void popFrame(AVFrame *outFrame);
+
+    /** Release head frame and advance head. */
+    void dropFrame();
+
 public:
-    /** Constructor to create a picture buffer of 'size' */
+    /** Constructor to create a picture buffer of 'size'. Pictures of other sizes than given one are accepted too,
+     * pictures of any format if pixFmt is AV_PIX_FMT_NONE. */
     FrameBuffer(int size, int width, int height, AVPixelFormat pixFmt);
 
     /** Constructor to create an audio buffer of 'size' */
@@ -68,25 +77,35 @@ public:
 
     bool isFull();
 
-    /** Put a frame into the buffer, this method will block if buffer is full.
+    /** Put a frame into the buffer, frame data is referenced rather than copied if possible.
      * @return true if frame successfully put into buffer
      *         false if not */
     bool putFrame(AVFrame *inFrame);
 
     /** Try to take a frame out of buffer, do nothing if buffer is empty.
+     * @param isBuffered false to take a frame even while buffer is filling up, e.g. keyframes coming one at a time
      * @return true if a buffer was put into outFrame
      *         false if buffer is empty, nothing was done */
-    bool takeFrame(AVFrame *outFrame);
+    bool takeFrame(AVFrame *outFrame, bool isBuffered = true);
 
-    /** Take a frame out of buffer which is right before given pts.
+    /** Take a frame out of buffer which is right before given pts, earlier frames are dropped.
      * This method will block if buffer is empty.
+     * @param nbDropped if not null, receives number of frames dropped
      * @return true if a buffer was put into outFrame
      *         false if there is no frame before pts in the buffer */
-    bool takeFrame(AVFrame *outFrame, int64_t pts);
+    bool takeFrame(AVFrame *outFrame, int64_t pts, int *nbDropped = nullptr);
+
+    /** Reference into outFrame the frame at given position from head, from producer thread.
+     * @return false if buffer holds fewer frames */
+    bool peekFrame(int index, AVFrame *outFrame);
+
+    /** Replace a buffered frame whose data is shared with oldFrame by newFrame, moving its reference in.
+     * Producer prepares newFrame from a peeked frame meanwhile consumer may have taken that frame out.
+     * @return false if frame was taken out already, newFrame is left as is */
+    bool replaceFrame(const AVFrame *oldFrame, AVFrame *newFrame);
 
     /** Reset the frame buffer.
-     * This will only set counter to 0, change head and tail pointer to start
-     * and won't allocate or deallocate anything. */
+     * This will release every frame held, set counter to 0 and change head and tail pointer to start. */
     void reset();
 
 };
@@ -0,0 +1,97 @@
+#include "FramePacer.h"
+#include "JNILogHelper.h"
+
+#define LOG_TAG "FramePacer"
+
+int64_t FramePacer::getNextVsyncNs(int64_t nowNs, int64_t vsyncNs, int64_t vsyncPeriodNs) {
+    if (vsyncNs <= 0) return nowNs + vsyncPeriodNs;
+    if (vsyncNs > nowNs) return vsyncNs;
+    return vsyncNs + ((nowNs - vsyncNs) / vsyncPeriodNs + 1) * vsyncPeriodNs;
+}
+
+int64_t FramePacer::getPresentTimeNs(int64_t nowNs, int64_t vsyncNs, int64_t vsyncPeriodNs) {
+    if (vsyncPeriodNs <= 0) vsyncPeriodNs = DEFAULT_VSYNC_PERIOD_NS;
+    return getNextVsyncNs(nowNs, vsyncNs, vsyncPeriodNs) + PRESENT_LATENCY_VSYNCS * vsyncPeriodNs;
+}
+
+int64_t FramePacer::getDueTimeUs(int64_t clockMs, int64_t nowNs, int64_t vsyncNs, int64_t vsyncPeriodNs,
+                                 double speed) {
+    // Clock has not started yet, nothing to follow
+    if (clockMs <= 0) {
+        mIsLocked = false;
+        return clockMs * 1000;
+    }
+    if (vsyncPeriodNs <= 0) vsyncPeriodNs = DEFAULT_VSYNC_PERIOD_NS;
+
+    int64_t presentNs = getPresentTimeNs(nowNs, vsyncNs, vsyncPeriodNs);
+    int64_t clockUs = clockMs * 1000;
+
+    if (!mIsLocked) {
+        mClockUs = clockUs;
+        mClockTimeNs = nowNs;
+        mIsLocked = true;
+    }
+
+    // Advance smoothed clock to now, then pull it toward master clock by a fraction of their difference
+    int64_t smoothedUs = mClockUs + (int64_t) ((double) (nowNs - mClockTimeNs) * speed / 1000);
+    int64_t errorUs = clockUs - smoothedUs;
+    mClockErrorUs = errorUs;
+    if (errorUs > RESYNC_THRESHOLD_US || errorUs < -RESYNC_THRESHOLD_US) {
+        LOGD("Clock jumped by %lldms, resyncing", (long long) (errorUs / 1000));
+        mNbResyncs++;
+        smoothedUs = clockUs;
+    } else {
+        smoothedUs += errorUs / (1 << CLOCK_GAIN_SHIFT);
+    }
+    mClockUs = smoothedUs;
+    mClockTimeNs = nowNs;
+
+    // Stream time when picture reaches the screen, a frame is due if its time is closer to this vsync than the next
+    int64_t presentUs = smoothedUs + (int64_t) ((double) (presentNs - nowNs) * speed / 1000);
+    mVsyncPeriodUs = (int64_t) ((double) vsyncPeriodNs * speed / 1000);
+    mDueUs = presentUs + mVsyncPeriodUs / 2 + mPhaseUs;
+    return mDueUs;
+}
+
+void FramePacer::onFrameTaken(int64_t frameTimeUs) {
+    if (!mIsLocked || mVsyncPeriodUs <= 0) return;
+    // Frames of a previous position or late ones tell nothing about phase
+    int64_t marginUs = mDueUs - frameTimeUs;
+    if (marginUs < 0 || marginUs >= mVsyncPeriodUs) return;
+
+    // Frame barely became due, or was almost due a vsync earlier, jitter can move it to another vsync
+    int64_t stepUs = mVsyncPeriodUs >> PHASE_MARGIN_SHIFT;
+    if (marginUs < stepUs) {
+        mPhaseUs += stepUs;
+    } else if (marginUs > mVsyncPeriodUs - stepUs) {
+        mPhaseUs -= stepUs;
+    } else {
+        return;
+    }
+    // Stay within half a vsync of smoothed clock, a drifting clock then slips cadence once
+    if (mPhaseUs > mVsyncPeriodUs / 2) mPhaseUs -= mVsyncPeriodUs;
+    else if (mPhaseUs < -mVsyncPeriodUs / 2) mPhaseUs += mVsyncPeriodUs;
+    mNbPhaseShifts++;
+}
+
+void FramePacer::onFramePresented(bool isNewFrame, bool hasFrame, int nbDropped) {
+    if (isNewFrame) mNbDisplayed++;
+    else if (hasFrame) mNbRepeated++;
+    mNbDropped += nbDropped;
+}
+
+void FramePacer::reset() {
+    mIsLocked = false;
+    mPhaseUs = 0;
+}
+
+FramePacerStats FramePacer::getStats() {
+    FramePacerStats stats;
+    stats.mNbDisplayed = mNbDisplayed.load();
+    stats.mNbRepeated = mNbRepeated.load();
+    stats.mNbDropped = mNbDropped.load();
+    stats.mNbResyncs = mNbResyncs.load();
+    stats.mClockErrorUs = mClockErrorUs.load();
+    stats.mNbPhaseShifts = mNbPhaseShifts.load();
+    return stats;
+}
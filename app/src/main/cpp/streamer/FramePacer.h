@@ -0,0 +1,88 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include "atomic"
+#include "cstdint"
+
+/** Snapshot of frame pacing counters. */
+struct FramePacerStats {
+    int64_t mNbDisplayed = 0; // Vsyncs showing a new frame
+    int64_t mNbRepeated = 0; // Vsyncs showing the same frame again
+    int64_t mNbDropped = 0; // Frames skipped without ever being shown
+    int64_t mNbResyncs = 0; // Times smoothed clock jumped to master clock, e.g. after a seek
+    int64_t mClockErrorUs = 0; // Last difference between master clock and smoothed clock
+    int64_t mNbPhaseShifts = 0; // Times due time moved so that frames become due away from vsync boundaries
+};
+
+/** Decides which stream time each vsync shows, so that frames are picked with a steady cadence.
+ * Master clock is re-anchored on every audio callback and jitters with callback timing and latency estimates,
+ * picking frames against it directly makes frames near a boundary flip between vsyncs. Pacer follows master clock with a smoothed clock
+ * advancing in step with vsyncs, so that e.g. 24 fps on a 60 Hz display keeps a regular 3:2 pulldown.
+ * Frames whose time falls right at a boundary between vsyncs would still flip with any remaining jitter, so due time
+ * is shifted by a fraction of a vsync whenever a frame becomes due too close to a boundary, within half a vsync.
+ * Timing only comes from arguments, so pacer can be driven by any vsync source.
+ * Must be used from a single thread, stats can be read from any thread. */
+class FramePacer {
+private:
+    // Period assumed when vsync source gives none, 60 Hz
+    static const int64_t DEFAULT_VSYNC_PERIOD_NS = 16666667;
+    // A picture drawn now is latched at next vsync and shown from the one after
+    static const int PRESENT_LATENCY_VSYNCS = 1;
+    // Smoothed clock further than this from master clock jumps to it instead of converging
+    static const int64_t RESYNC_THRESHOLD_US = 100000;
+    // Fraction of clock error corrected every vsync, as a power of two
+    static const int CLOCK_GAIN_SHIFT = 4;
+    // Fraction of a vsync a frame must become due away from a boundary, also the step phase moves by, as a power of two
+    static const int PHASE_MARGIN_SHIFT = 3;
+
+    // Smoothed clock is mClockUs at vsync time mClockTimeNs, 0 until locked on master clock
+    int64_t mClockUs = 0;
+    int64_t mClockTimeNs = 0;
+    bool mIsLocked = false;
+    // Offset added to due time, within half a vsync
+    int64_t mPhaseUs = 0;
+    // Due time and vsync period in stream time of last draw
+    int64_t mDueUs = 0;
+    int64_t mVsyncPeriodUs = 0;
+
+    std::atomic_int64_t mNbDisplayed = {0};
+    std::atomic_int64_t mNbRepeated = {0};
+    std::atomic_int64_t mNbDropped = {0};
+    std::atomic_int64_t mNbResyncs = {0};
+    std::atomic_int64_t mClockErrorUs = {0};
+    std::atomic_int64_t mNbPhaseShifts = {0};
+
+private:
+    /** Return time of first vsync after nowNs, estimated from a past vsync. */
+    static int64_t getNextVsyncNs(int64_t nowNs, int64_t vsyncNs, int64_t vsyncPeriodNs);
+
+public:
+    /** Return monotonic time a picture drawn now reaches the screen.
+     * @param vsyncNs monotonic time of a recent vsync, 0 or less if unknown
+     * @param vsyncPeriodNs time between vsyncs, 0 or less if unknown */
+    static int64_t getPresentTimeNs(int64_t nowNs, int64_t vsyncNs, int64_t vsyncPeriodNs);
+
+    /** Return stream time in micros frames drawn now are due for: frames with a timestamp up to it should be shown.
+     * @param clockMs master clock, 0 or less if stream has not started
+     * @param nowNs current monotonic time
+     * @param vsyncNs monotonic time of a recent vsync, 0 or less if unknown
+     * @param vsyncPeriodNs time between vsyncs, 0 or less if unknown
+     * @param speed playback speed, stream time master clock advances per unit of monotonic time */
+    int64_t getDueTimeUs(int64_t clockMs, int64_t nowNs, int64_t vsyncNs, int64_t vsyncPeriodNs, double speed = 1.0);
+
+    /** Tell time of the frame taken against last due time, phase moves if it became due too close to a boundary. */
+    void onFrameTaken(int64_t frameTimeUs);
+
+    /** Count what the vsync shows.
+     * @param isNewFrame a new frame was taken for this vsync
+     * @param hasFrame a picture is shown at all, new or previous one
+     * @param nbDropped frames skipped to reach the taken frame */
+    void onFramePresented(bool isNewFrame, bool hasFrame, int nbDropped);
+
+    /** Forget smoothed clock and phase, e.g. after a seek. */
+    void reset();
+
+    FramePacerStats getStats();
+};
+
+#endif //FRAME_PACER_H
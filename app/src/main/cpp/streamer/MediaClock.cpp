@@ -0,0 +1,206 @@
+#include "MediaClock.h"
+#include "JNILogHelper.h"
+
+#define LOG_TAG "MediaClock"
+
+void ClockAnchor::set(int64_t ptsUs, int64_t mediaNs, int serial) {
+    // Readers retry while sequence is odd or changed under them
+    uint32_t seq = mSeq.load();
+    mSeq.store(seq + 1);
+    mPtsUs.store(ptsUs);
+    mMediaNs.store(mediaNs);
+    mSerial.store(serial);
+    mSeq.store(seq + 2);
+}
+
+bool ClockAnchor::isSet(int serial) const {
+    int64_t ptsUs;
+    return get(0, serial, &ptsUs);
+}
+
+bool ClockAnchor::get(int64_t mediaNs, int serial, int64_t *ptsUs) const {
+    uint32_t seq;
+    int64_t anchorPtsUs, anchorMediaNs;
+    int anchorSerial;
+    do {
+        seq = mSeq.load();
+        anchorPtsUs = mPtsUs.load();
+        anchorMediaNs = mMediaNs.load();
+        anchorSerial = mSerial.load();
+    } while ((seq & 1) || seq != mSeq.load());
+    if (seq == 0 || anchorSerial != serial) return false;
+
+    *ptsUs = anchorPtsUs + (mediaNs - anchorMediaNs) / 1000;
+    return true;
+}
+
+MediaClock::MediaClock(ClockMode mode) : mMode(mode) {
+}
+
+int64_t MediaClock::getMediaTimeNs(int64_t nowNs) const {
+    uint32_t seq;
+    bool isPaused;
+    double speed;
+    int64_t baseNs, baseMediaNs;
+    do {
+        seq = mBaseSeq.load();
+        isPaused = mIsPaused.load();
+        speed = mSpeed.load();
+        baseNs = mBaseNs.load();
+        baseMediaNs = mBaseMediaNs.load();
+    } while ((seq & 1) || seq != mBaseSeq.load());
+
+    // Time stands still from the moment clock is paused
+    if (isPaused) return baseMediaNs;
+    return baseMediaNs + (int64_t) ((double) (nowNs - baseNs) * speed);
+}
+
+void MediaClock::rebase(int64_t nowNs, bool isPaused, double speed) {
+    int64_t mediaNs = getMediaTimeNs(nowNs);
+    uint32_t seq = mBaseSeq.load();
+    mBaseSeq.store(seq + 1);
+    mIsPaused.store(isPaused);
+    mSpeed.store(speed);
+    mBaseNs.store(nowNs);
+    mBaseMediaNs.store(mediaNs);
+    mBaseSeq.store(seq + 2);
+}
+
+bool MediaClock::getMasterUs(int64_t mediaNs, int64_t *ptsUs) const {
+    int serial = mSerial;
+    switch (mMode) {
+        case ClockMode::AUDIO_MASTER:
+            return mAudio.get(mediaNs, serial, ptsUs);
+        case ClockMode::VIDEO_MASTER:
+            return mVideo.get(mediaNs, serial, ptsUs);
+        case ClockMode::EXTERNAL:
+            return mExternal.get(mediaNs, serial, ptsUs);
+    }
+    return false;
+}
+
+bool MediaClock::syncTo(ClockAnchor *clock, int64_t ptsUs, int64_t mediaNs, int serial) {
+    int64_t clockUs;
+    if (clock->get(mediaNs, serial, &clockUs)) {
+        int64_t errorUs = ptsUs - clockUs;
+        if (errorUs <= RESYNC_THRESHOLD_US && errorUs >= -RESYNC_THRESHOLD_US) return false;
+        mNbResyncs++;
+    }
+    clock->set(ptsUs, mediaNs, serial);
+    return true;
+}
+
+void MediaClock::syncExternalTo(ExternalOwner owner, int64_t ptsUs, int64_t mediaNs, int serial) {
+    int expected = OWNER_NONE;
+    if (!mExternalOwner.compare_exchange_strong(expected, owner) && expected != owner) return;
+    syncTo(&mExternal, ptsUs, mediaNs, serial);
+}
+
+ClockMode MediaClock::getMode() const {
+    return mMode;
+}
+
+void MediaClock::setTimeSource(TimeSource *timeSource) {
+    mTimeSource = timeSource;
+}
+
+int64_t MediaClock::getNowNs() const {
+    return mTimeSource ? mTimeSource->getTimeNs() : getMonotonicTimeNs();
+}
+
+bool MediaClock::isStarted() const {
+    int serial = mSerial;
+    switch (mMode) {
+        case ClockMode::AUDIO_MASTER:
+            return mAudio.isSet(serial);
+        case ClockMode::VIDEO_MASTER:
+            return mVideo.isSet(serial);
+        case ClockMode::EXTERNAL:
+            return mExternal.isSet(serial);
+    }
+    return false;
+}
+
+bool MediaClock::isPaused() const {
+    return mIsPaused;
+}
+
+int64_t MediaClock::getTimeUs(int64_t nowNs) const {
+    int64_t ptsUs;
+    if (!getMasterUs(getMediaTimeNs(nowNs), &ptsUs)) return 0;
+    return ptsUs;
+}
+
+int64_t MediaClock::getTimeMs(int64_t nowNs) const {
+    return getTimeUs(nowNs) / 1000;
+}
+
+int MediaClock::getSerial() const {
+    return mSerial;
+}
+
+void MediaClock::setAudioTime(int64_t ptsUs, int64_t nowNs, int serial) {
+    // Samples were read before a flush
+    if (serial != mSerial) return;
+    int64_t mediaNs = getMediaTimeNs(nowNs);
+    mAudio.set(ptsUs, mediaNs, serial);
+    if (mMode == ClockMode::AUDIO_MASTER) return;
+
+    if (mMode == ClockMode::EXTERNAL) syncExternalTo(OWNER_AUDIO, ptsUs, mediaNs, serial);
+    int64_t masterUs;
+    if (getMasterUs(mediaNs, &masterUs)) mAudioOffsetUs = ptsUs - masterUs;
+}
+
+void MediaClock::onVideoPresented(int64_t ptsUs, int64_t presentNs, int serial) {
+    // Frame was taken before a flush
+    if (serial != mSerial) return;
+    int64_t mediaNs = getMediaTimeNs(presentNs);
+    // Video master is only moved when it drifted away from frames, e.g. video stalled, so it runs smoothly
+    if (mMode == ClockMode::VIDEO_MASTER) syncTo(&mVideo, ptsUs, mediaNs, serial);
+    else mVideo.set(ptsUs, mediaNs, serial);
+    if (mMode == ClockMode::EXTERNAL) syncExternalTo(OWNER_VIDEO, ptsUs, mediaNs, serial);
+
+    int64_t masterUs;
+    if (!getMasterUs(mediaNs, &masterUs)) return;
+    int64_t offsetUs = ptsUs - masterUs;
+    mAvOffsetUs = offsetUs;
+    if (offsetUs < 0) offsetUs = -offsetUs;
+    if (offsetUs > mMaxAvOffsetUs) mMaxAvOffsetUs = offsetUs;
+    mNbVideoFrames++;
+}
+
+void MediaClock::flush() {
+    // Anchors of the previous serial read as never set from now on, next stream reporting owns external clock again
+    mSerial++;
+    mExternalOwner = OWNER_NONE;
+}
+
+void MediaClock::pause(int64_t nowNs) {
+    if (mIsPaused) return;
+    rebase(nowNs, true, mSpeed);
+}
+
+void MediaClock::resume(int64_t nowNs) {
+    if (!mIsPaused) return;
+    rebase(nowNs, false, mSpeed);
+}
+
+void MediaClock::setSpeed(double speed, int64_t nowNs) {
+    if (speed <= 0 || speed == mSpeed) return;
+    rebase(nowNs, mIsPaused, speed);
+}
+
+double MediaClock::getSpeed() const {
+    return mSpeed;
+}
+
+MediaClockStats MediaClock::getStats() {
+    MediaClockStats stats;
+    stats.mMode = mMode;
+    stats.mAvOffsetUs = mAvOffsetUs.load();
+    stats.mMaxAvOffsetUs = mMaxAvOffsetUs.load();
+    stats.mAudioOffsetUs = mAudioOffsetUs.load();
+    stats.mNbVideoFrames = mNbVideoFrames.load();
+    stats.mNbResyncs = mNbResyncs.load();
+    return stats;
+}
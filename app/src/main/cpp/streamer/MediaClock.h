@@ -0,0 +1,159 @@
+#ifndef MEDIA_CLOCK_H
+#define MEDIA_CLOCK_H
+
+#include "TimeUtils.h"
+#include "atomic"
+#include "cstdint"
+
+/** Stream every other stream is synchronized to. */
+enum class ClockMode {
+    AUDIO_MASTER, // Follow audio heard from output, video picks frames against it
+    VIDEO_MASTER, // Follow video frames shown, audio is resampled to keep in step
+    EXTERNAL // Free running monotonic clock started by first stream played, both streams follow it
+};
+
+/** Snapshot of clock counters, offsets are positive when stream is ahead of master clock. */
+struct MediaClockStats {
+    ClockMode mMode = ClockMode::AUDIO_MASTER;
+    int64_t mAvOffsetUs = 0; // Last video frame shown against master clock at the time it reached screen
+    int64_t mMaxAvOffsetUs = 0; // Largest absolute A/V offset seen
+    int64_t mAudioOffsetUs = 0; // Last audio heard against master clock, 0 when audio is master
+    int64_t mNbVideoFrames = 0; // Video frames offset was measured on
+    int64_t mNbResyncs = 0; // Times master clock jumped to a stream it follows
+};
+
+/** Stream time anchored at a point of media time, advancing with media time from there.
+ * Anchor is set for a clock serial, it reads as never set once clock moved to another serial.
+ * Lock-free: a single writer and any number of readers. */
+class ClockAnchor {
+private:
+    // Odd while writer is updating, 0 until first set
+    std::atomic_uint32_t mSeq = {0};
+    std::atomic_int64_t mPtsUs = {0};
+    std::atomic_int64_t mMediaNs = {0};
+    std::atomic_int mSerial = {0};
+
+public:
+    /** Anchor stream time ptsUs at media time mediaNs for clock serial. Writer only. */
+    void set(int64_t ptsUs, int64_t mediaNs, int serial);
+
+    bool isSet(int serial) const;
+
+    /** Return stream time at given media time.
+     * @return false if anchor was never set for serial */
+    bool get(int64_t mediaNs, int serial, int64_t *ptsUs) const;
+};
+
+/** Clock streams are played against, replacing a raw time shared between streams.
+ * Streams report the stream time they present along with the monotonic time it is seen or heard,
+ * clock interpolates between reports with monotonic time so it advances smoothly between audio callbacks.
+ * Time advances at playback speed and stops while clock is paused.
+ * Reports and reads never lock, they are safe from a real-time audio callback.
+ * Audio and video reports must each come from a single thread, pause, resume and speed changes from a single thread.
+ * A flush, e.g. on a seek, moves clock to a new serial. Reports carry the serial read before taking the samples or
+ * frame they report, so that those taken before the flush cannot start clock again at the old position. */
+class MediaClock {
+private:
+    // Master clock further than this from a stream it follows jumps to the stream instead, e.g. after a seek
+    static const int64_t RESYNC_THRESHOLD_US = 100000;
+
+    /** Stream started external clock, only that stream keeps it in sync afterwards. */
+    enum ExternalOwner {
+        OWNER_NONE, OWNER_AUDIO, OWNER_VIDEO
+    };
+
+    const ClockMode mMode;
+    // Monotonic time streams read, system monotonic clock if null
+    TimeSource *mTimeSource = nullptr;
+
+    ClockAnchor mAudio; // Written from audio callback
+    ClockAnchor mVideo; // Written from rendering thread
+    ClockAnchor mExternal; // Written by the stream owning it
+    std::atomic_int mExternalOwner = {OWNER_NONE};
+    // Anchors set at another serial are ignored
+    std::atomic_int mSerial = {0};
+
+    // Media time is monotonic time scaled by playback speed and stopped while paused, anchors are set in media time
+    // so that pausing or changing speed never makes them jump {
+    std::atomic_uint32_t mBaseSeq = {0};
+    std::atomic_bool mIsPaused = {false};
+    std::atomic<double> mSpeed = {1.0};
+    std::atomic_int64_t mBaseNs = {0}; // Monotonic time media time was last rebased at
+    std::atomic_int64_t mBaseMediaNs = {0}; // Media time at mBaseNs
+    // } Media time
+
+    std::atomic_int64_t mAvOffsetUs = {0};
+    std::atomic_int64_t mMaxAvOffsetUs = {0};
+    std::atomic_int64_t mAudioOffsetUs = {0};
+    std::atomic_int64_t mNbVideoFrames = {0};
+    std::atomic_int64_t mNbResyncs = {0};
+
+private:
+    /** Return media time at monotonic time nowNs. */
+    int64_t getMediaTimeNs(int64_t nowNs) const;
+
+    /** Restart media time from monotonic time nowNs with given pause state and speed. */
+    void rebase(int64_t nowNs, bool isPaused, double speed);
+
+    /** Return master stream time at given media time, false if master has not started. */
+    bool getMasterUs(int64_t mediaNs, int64_t *ptsUs) const;
+
+    /** Move clock a master follows to a stream time it is far from.
+     * @return true if clock jumped */
+    bool syncTo(ClockAnchor *clock, int64_t ptsUs, int64_t mediaNs, int serial);
+
+    /** Keep external clock in step with a stream, first stream reporting takes ownership of it. */
+    void syncExternalTo(ExternalOwner owner, int64_t ptsUs, int64_t mediaNs, int serial);
+
+public:
+    explicit MediaClock(ClockMode mode);
+
+    ClockMode getMode() const;
+
+    /** Read time from source instead of system monotonic clock, e.g. to play on virtual time in tests.
+     * Set before any stream reads or reports time. */
+    void setTimeSource(TimeSource *timeSource);
+
+    /** Return monotonic time streams pass to clock, from time source if any. */
+    int64_t getNowNs() const;
+
+    /** Return true once master stream has reported a time. */
+    bool isStarted() const;
+
+    bool isPaused() const;
+
+    /** Return master stream time in micros at given monotonic time, 0 if clock has not started. */
+    int64_t getTimeUs(int64_t nowNs) const;
+
+    /** Return master stream time in millis at given monotonic time, 0 if clock has not started. */
+    int64_t getTimeMs(int64_t nowNs) const;
+
+    /** Return serial reports are taken for, read it before taking what is reported. */
+    int getSerial() const;
+
+    /** Report audio stream time heard at monotonic time nowNs, output latency already taken off.
+     * Called from audio callback. Ignored if serial is not current. */
+    void setAudioTime(int64_t ptsUs, int64_t nowNs, int serial);
+
+    /** Report a video frame reaching screen at monotonic time presentNs. Called from rendering thread.
+     * Ignored if serial is not current. */
+    void onVideoPresented(int64_t ptsUs, int64_t presentNs, int serial);
+
+    /** Forget every stream time reported, e.g. after a seek, clock starts again from the next report as when it was
+     * created. Pause state and speed are kept. Streams must drop what they buffered before the flush first. */
+    void flush();
+
+    /** Stop time until resumed. */
+    void pause(int64_t nowNs);
+
+    void resume(int64_t nowNs);
+
+    /** Make stream time advance speed times faster than monotonic time from nowNs on. */
+    void setSpeed(double speed, int64_t nowNs);
+
+    double getSpeed() const;
+
+    MediaClockStats getStats();
+};
+
+#endif //MEDIA_CLOCK_H
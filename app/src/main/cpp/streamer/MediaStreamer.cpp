@@ -1,14 +1,18 @@
 #include "MediaStreamer.h"
 #include "JNILogHelper.h"
+#include "algorithm"
 
 #define LOG_TAG "MediaStreamer"
 
-MediaStreamer::MediaStreamer() {
-    mCurrentTsMs = new std::atomic_int64_t{0};
-}
+MediaStreamer::MediaStreamer() = default;
 
 MediaStreamer::~MediaStreamer() {
-    delete mCurrentTsMs;
+    MediaClockStats stats = getClockStats();
+    LOGD("Clock mode: %d, A/V offset: %lldus, max: %lldus over %lld frames, audio offset: %lldus, resyncs: %lld",
+         (int) stats.mMode, (long long) stats.mAvOffsetUs, (long long) stats.mMaxAvOffsetUs,
+         (long long) stats.mNbVideoFrames, (long long) stats.mAudioOffsetUs, (long long) stats.mNbResyncs);
+    // Streamers reading from clock are released before media streamer
+    delete mClock;
 }
 
 void MediaStreamer::pause() {
@@ -21,6 +25,7 @@ void MediaStreamer::pause() {
             break;
         case MediaStreamerState::RUNNING:
             mState = MediaStreamerState::PAUSED;
+            if (mClock) mClock->pause(mClock->getNowNs());
             break;
     }
 }
@@ -35,10 +40,35 @@ void MediaStreamer::resume() {
             break;
         case MediaStreamerState::PAUSED:
             mState = MediaStreamerState::RUNNING;
+            if (mClock) mClock->resume(mClock->getNowNs());
             break;
     }
 }
 
+void MediaStreamer::setSpeed(double speed) {
+    speed = std::min(std::max(speed, MIN_SPEED), MAX_SPEED);
+    LOGD("Playback speed set to %.2f", speed);
+    // Clock changes speed right away, audio once stretched samples reach output
+    if (mClock) mClock->setSpeed(speed, mClock->getNowNs());
+    if (mAudioStreamer) mAudioStreamer->setSpeed(speed);
+}
+
+bool MediaStreamer::isTrickPlaySpeed(double speed) {
+    return speed < 0 || speed > MAX_SPEED;
+}
+
+void MediaStreamer::setTrickPlay(bool isTrickPlay) {
+    if (isTrickPlay == mIsTrickPlay) return;
+    LOGD("Trick play %s", isTrickPlay ? "started" : "stopped");
+    mIsTrickPlay = isTrickPlay;
+    if (mVideoStreamer) mVideoStreamer->setTrickPlay(isTrickPlay);
+    // Demuxer skips audio while trick playing, output is held rather than left underrunning
+    if (mAudioStreamer) {
+        if (isTrickPlay) mAudioStreamer->pause();
+        else if (mState != MediaStreamerState::PAUSED) mAudioStreamer->resume();
+    }
+}
+
 void MediaStreamer::stop() {
     mState = MediaStreamerState::STOPPED;
 }
@@ -51,4 +81,39 @@ int MediaStreamer::onAudioFrame(AVFrame *frame) {
 int MediaStreamer::onVideoFrame(AVFrame *frame) {
     if (mVideoStreamer) return mVideoStreamer->onVideoFrame(frame);
     return 1;
-}
\ No newline at end of file
+}
+
+bool MediaStreamer::getPreferredSize(int *width, int *height) {
+    if (mVideoStreamer) return mVideoStreamer->getPreferredSize(width, height);
+    return false;
+}
+
+bool MediaStreamer::onPreviewFrame(AVFrame *frame) {
+    if (mVideoStreamer) return mVideoStreamer->onPreviewFrame(frame);
+    return false;
+}
+
+void MediaStreamer::onVideoFlush() {
+    if (mVideoStreamer) mVideoStreamer->onVideoFlush();
+    // Clock starts again from the first stream reporting the new position, once old frames are gone
+    if (mClock) mClock->flush();
+}
+
+void MediaStreamer::onAudioFlush() {
+    if (mAudioStreamer) mAudioStreamer->onAudioFlush();
+    if (mClock) mClock->flush();
+}
+
+int64_t MediaStreamer::getLatenessMs() {
+    if (mVideoStreamer) return mVideoStreamer->getLatenessMs();
+    return 0;
+}
+
+bool MediaStreamer::isPresenting() {
+    return mVideoStreamer != nullptr;
+}
+
+MediaClockStats MediaStreamer::getClockStats() {
+    if (mClock) return mClock->getStats();
+    return {};
+}
@@ -5,6 +5,7 @@
 #include "AudioStreamerBuilder.h"
 #include "VideoStreamer.h"
 #include "VideoStreamerBuilder.h"
+#include "MediaClock.h"
 
 enum class MediaStreamerState {
     INITIATE, READY, RUNNING, PAUSED, STOPPED
@@ -15,7 +16,13 @@ class MediaStreamer : public AudioSink, public VideoSink {
 
 private:
     std::atomic<MediaStreamerState> mState = {MediaStreamerState::INITIATE};
-    std::atomic_int64_t *mCurrentTsMs = nullptr;
+    // Range of playback speed
+    static constexpr double MIN_SPEED = 0.5;
+    static constexpr double MAX_SPEED = 3.0;
+    // Clock both streams are played against, owned by media streamer
+    MediaClock *mClock = nullptr;
+    // Video keyframes come paced by demuxer, audio is held
+    bool mIsTrickPlay = false;
 
     MediaStreamer();
 
@@ -25,10 +32,22 @@ public:
 
     ~MediaStreamer();
 
+    /** Stop stream time, video keeps showing current frame until resumed. */
     void pause();
 
     void resume();
 
+    /** Set playback speed, clamped between MIN_SPEED and MAX_SPEED. Audio keeps its pitch. */
+    void setSpeed(double speed);
+
+    /** Return true if speed cannot be played frame by frame and needs demuxer trick play, i.e. above MAX_SPEED
+     * or backward. */
+    static bool isTrickPlaySpeed(double speed);
+
+    /** Show video frames as they come from demuxer trick play and hold audio output, or go back to playback
+     * against clock. */
+    void setTrickPlay(bool isTrickPlay);
+
     void stop();
 
     /** Callback when there is an incoming audio frame, pass it to audio streamer. */
@@ -36,6 +55,24 @@ public:
 
     /** Callback when there is an incoming video frame, pass it to video streamer. */
     int onVideoFrame(AVFrame *frame) override;
+
+    /** Return how far frames coming into video streamer are behind. */
+    int64_t getLatenessMs() override;
+
+    bool isPresenting() override;
+
+    bool getPreferredSize(int *width, int *height) override;
+
+    /** Callback when a frame is to be shown out of playback order, pass it to video streamer. */
+    bool onPreviewFrame(AVFrame *frame) override;
+
+    /** Callback when video buffered so far is dropped, e.g. on a seek, flush video streamer then clock. */
+    void onVideoFlush() override;
+
+    /** Callback when audio buffered so far is dropped, e.g. on a seek, flush audio streamer then clock. */
+    void onAudioFlush() override;
+
+    MediaClockStats getClockStats();
 };
 
 #endif //MEDIA_STREAMER_H
@@ -6,6 +6,8 @@
 void MediaStreamerBuilder::cleanUp() {
     delete mAudioStreamer;
     delete mVideoStreamer;
+    delete mClock;
+    mClock = nullptr;
 }
 
 MediaStreamerBuilder *MediaStreamerBuilder::setHasAudio(bool hasAudio) {
@@ -18,7 +20,29 @@ MediaStreamerBuilder *MediaStreamerBuilder::setHasVideo(bool hasVideo) {
     return this;
 }
 
+MediaStreamerBuilder *MediaStreamerBuilder::setClockMode(ClockMode mode) {
+    mClockMode = mode;
+    return this;
+}
+
+MediaStreamerBuilder *MediaStreamerBuilder::setTimeSource(TimeSource *timeSource) {
+    mTimeSource = timeSource;
+    return this;
+}
+
 MediaStreamer *MediaStreamerBuilder::buildMediaStreamer() {
+    // Master stream must exist, otherwise clock would never start
+    ClockMode clockMode = mClockMode;
+    if ((clockMode == ClockMode::AUDIO_MASTER && !mHasAudio) || (clockMode == ClockMode::VIDEO_MASTER && !mHasVideo)) {
+        LOGD("No stream to drive clock mode %d, using external clock.", (int) clockMode);
+        clockMode = ClockMode::EXTERNAL;
+    }
+    // Streamers are built against clock
+    mClock = new MediaClock(clockMode);
+    mClock->setTimeSource(mTimeSource);
+    setAudioClock(mClock);
+    setVideoClock(mClock);
+
     if (mHasAudio) {
         mAudioStreamer = buildAudioStreamer();
         if (!mAudioStreamer) {
@@ -36,15 +60,11 @@ MediaStreamer *MediaStreamerBuilder::buildMediaStreamer() {
     }
 
     auto *mediaStreamer = new MediaStreamer();
+    mediaStreamer->mClock = mClock;
+    mClock = nullptr;
 
-    if (mHasAudio) {
-        mediaStreamer->mAudioStreamer = mAudioStreamer;
-        mAudioStreamer->mCurrentTsMs = mediaStreamer->mCurrentTsMs;
-    }
-    if (mHasVideo) {
-        mediaStreamer->mVideoStreamer = mVideoStreamer;
-        mVideoStreamer->mCurrentTsMs = mediaStreamer->mCurrentTsMs;
-    }
+    if (mHasAudio) mediaStreamer->mAudioStreamer = mAudioStreamer;
+    if (mHasVideo) mediaStreamer->mVideoStreamer = mVideoStreamer;
 
     mediaStreamer->mState = MediaStreamerState::READY;
     mediaStreamer->mState = MediaStreamerState::RUNNING;
@@ -6,9 +6,12 @@ class MediaStreamerBuilder : public AudioStreamerBuilder, public VideoStreamerBu
 private:
     bool mHasAudio = true;
     bool mHasVideo = true;
+    ClockMode mClockMode = ClockMode::AUDIO_MASTER;
+    TimeSource *mTimeSource = nullptr;
 
     AudioStreamer *mAudioStreamer = nullptr;
     VideoStreamer *mVideoStreamer = nullptr;
+    MediaClock *mClock = nullptr; // Handed to media streamer once built
 
     void cleanUp();
 public:
@@ -16,6 +19,14 @@ public:
 
     MediaStreamerBuilder *setHasVideo(bool hasVideo);
 
+    /** Set stream both streams are synchronized to.
+     * If this value is not set, audio is master, or external clock when there is no audio. */
+    MediaStreamerBuilder *setClockMode(ClockMode mode);
+
+    /** Set monotonic time clock and streams read, not owned. If this value is not set, system monotonic clock is used.
+     * Tests play on the clock of a virtual audio output this way. */
+    MediaStreamerBuilder *setTimeSource(TimeSource *timeSource);
+
     MediaStreamer *buildMediaStreamer();
 };
 
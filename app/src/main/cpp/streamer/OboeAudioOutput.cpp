@@ -0,0 +1,99 @@
+#include "OboeAudioOutput.h"
+#include "JNILogHelper.h"
+
+#define LOG_TAG "OboeAudioOutput"
+
+OboeAudioOutput::~OboeAudioOutput() {
+    close();
+}
+
+oboe::AudioFormat OboeAudioOutput::avSampleFmtToOboeSampleFmt(AVSampleFormat sampleFmt) {
+    switch (sampleFmt) {
+        case AV_SAMPLE_FMT_S16:
+            return oboe::AudioFormat::I16;
+        case AV_SAMPLE_FMT_S32:
+            return oboe::AudioFormat::I32;
+        case AV_SAMPLE_FMT_FLT:
+            return oboe::AudioFormat::Float;
+        default:
+            return oboe::AudioFormat::Invalid;
+    }
+}
+
+bool OboeAudioOutput::open(const AudioOutputParams &params, AudioOutputCallback *callback) {
+    oboe::AudioFormat sampleFmt = avSampleFmtToOboeSampleFmt(params.mSampleFmt);
+    if (sampleFmt == oboe::AudioFormat::Invalid) {
+        LOGE("Failed to open oboe output, unsupported sample format.");
+        return false;
+    }
+    mCallback = callback;
+
+    oboe::AudioStreamBuilder builder;
+    if (params.mFramesPerBurst > 0) builder.setFramesPerDataCallback(params.mFramesPerBurst);
+    builder.setSampleRate(params.mSampleRate);
+    builder.setChannelCount(params.mNbChannels);
+    builder.setFormat(sampleFmt);
+    builder.setDirection(oboe::Direction::Output);
+    builder.setCallback(this);
+    auto result = builder.openManagedStream(mOutStream);
+    if (result != oboe::Result::OK) {
+        LOGE("Failed to open oboe audio stream, error %d", result);
+        return false;
+    }
+    return true;
+}
+
+bool OboeAudioOutput::start() {
+    if (!mOutStream) return false;
+    auto result = mOutStream->requestStart();
+    if (result != oboe::Result::OK) {
+        LOGE("Failed to start oboe audio stream, error %d", result);
+        return false;
+    }
+    return true;
+}
+
+void OboeAudioOutput::pause() {
+    if (mOutStream) mOutStream->pause();
+}
+
+void OboeAudioOutput::close() {
+    if (!mOutStream) return;
+    mOutStream->stop();
+    mOutStream->close();
+    mOutStream.reset();
+}
+
+int32_t OboeAudioOutput::getFramesPerBurst() {
+    return mOutStream ? mOutStream->getFramesPerBurst() : 0;
+}
+
+int32_t OboeAudioOutput::getBufferCapacity() {
+    return mOutStream ? mOutStream->getBufferCapacityInFrames() : 0;
+}
+
+int32_t OboeAudioOutput::setBufferSize(int32_t size) {
+    if (!mOutStream) return 0;
+    auto result = mOutStream->setBufferSizeInFrames(size);
+    return result ? result.value() : 0;
+}
+
+int64_t OboeAudioOutput::getXRunCount() {
+    if (!mOutStream) return 0;
+    auto result = mOutStream->getXRunCount();
+    return result ? result.value() : 0;
+}
+
+int64_t OboeAudioOutput::getLatencyMs() {
+    if (!mOutStream) return 0;
+    // Measured from presentation timestamps when device gives them, buffered time otherwise
+    auto result = mOutStream->calculateLatencyMillis();
+    if (result) return (int64_t) result.value();
+    int32_t sampleRate = mOutStream->getSampleRate();
+    return sampleRate > 0 ? (int64_t) mOutStream->getBufferSizeInFrames() * 1000 / sampleRate : 0;
+}
+
+oboe::DataCallbackResult OboeAudioOutput::onAudioReady(oboe::AudioStream * /*oboeStream*/, void *audioData, int32_t numFrames) {
+    mCallback->onAudioOutput(audioData, numFrames);
+    return oboe::DataCallbackResult::Continue;
+}
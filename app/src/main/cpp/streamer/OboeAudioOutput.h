@@ -0,0 +1,42 @@
+#ifndef OBOE_AUDIO_OUTPUT_H
+#define OBOE_AUDIO_OUTPUT_H
+
+#include "AudioOutput.h"
+#include "oboe/Oboe.h"
+
+/** Plays samples on an Android audio device through Oboe. */
+class OboeAudioOutput : public AudioOutput, public oboe::AudioStreamCallback {
+private:
+    oboe::ManagedStream mOutStream; // Output stream
+    AudioOutputCallback *mCallback = nullptr;
+
+private:
+    /** Return equivalent oboe AudioFormat given ffmpeg AVSampleFormat. */
+    static oboe::AudioFormat avSampleFmtToOboeSampleFmt(AVSampleFormat sampleFmt);
+
+public:
+    ~OboeAudioOutput() override;
+
+    bool open(const AudioOutputParams &params, AudioOutputCallback *callback) override;
+
+    bool start() override;
+
+    void pause() override;
+
+    void close() override;
+
+    int32_t getFramesPerBurst() override;
+
+    int32_t getBufferCapacity() override;
+
+    int32_t setBufferSize(int32_t size) override;
+
+    int64_t getXRunCount() override;
+
+    int64_t getLatencyMs() override;
+
+    /** Callback, will be called when stream needs more audio data. */
+    oboe::DataCallbackResult onAudioReady(oboe::AudioStream *oboeStream, void *audioData, int32_t numFrames) override;
+};
+
+#endif //OBOE_AUDIO_OUTPUT_H
@@ -0,0 +1,109 @@
+#include "SampleRing.h"
+#include "cstring"
+#include "algorithm"
+
+SampleRing::SampleRing(int capacity, int bytesPerSample, int sampleRate)
+        : mBytesPerSample(bytesPerSample), mSampleRate(sampleRate) {
+    // Power of two capacity turns wrapping into a mask
+    mCapacity = 1;
+    while (mCapacity < capacity) mCapacity <<= 1;
+    mData.resize((size_t) (mCapacity * mBytesPerSample));
+}
+
+int SampleRing::getCapacity() const {
+    return (int) mCapacity;
+}
+
+int SampleRing::getWriteAvailable() const {
+    return (int) (mCapacity - (mWritePos.load(std::memory_order_relaxed) - mReadPos.load(std::memory_order_acquire)));
+}
+
+int SampleRing::getReadAvailable() const {
+    int64_t readPos = std::max(mReadPos.load(std::memory_order_acquire), mDiscardPos.load(std::memory_order_acquire));
+    return (int) (mWritePos.load(std::memory_order_acquire) - readPos);
+}
+
+void SampleRing::copyIn(int64_t pos, const uint8_t *src, int nbSamples) {
+    int64_t idx = pos & (mCapacity - 1);
+    int64_t first = std::min((int64_t) nbSamples, mCapacity - idx);
+    memcpy(mData.data() + idx * mBytesPerSample, src, (size_t) (first * mBytesPerSample));
+    if (first < nbSamples) {
+        memcpy(mData.data(), src + first * mBytesPerSample, (size_t) ((nbSamples - first) * mBytesPerSample));
+    }
+}
+
+void SampleRing::copyOut(int64_t pos, uint8_t *dst, int nbSamples) const {
+    int64_t idx = pos & (mCapacity - 1);
+    int64_t first = std::min((int64_t) nbSamples, mCapacity - idx);
+    memcpy(dst, mData.data() + idx * mBytesPerSample, (size_t) (first * mBytesPerSample));
+    if (first < nbSamples) {
+        memcpy(dst + first * mBytesPerSample, mData.data(), (size_t) ((nbSamples - first) * mBytesPerSample));
+    }
+}
+
+bool SampleRing::write(const uint8_t *samples, int nbSamples, int64_t tsMs, float speed) {
+    if (nbSamples <= 0) return true;
+    if (nbSamples > getWriteAvailable()) return false;
+
+    int64_t writePos = mWritePos.load(std::memory_order_relaxed);
+    copyIn(writePos, samples, nbSamples);
+
+    // Mark is published before samples, consumer always finds the mark of samples it reads
+    int64_t markWriteIdx = mMarkWriteIdx.load(std::memory_order_relaxed);
+    if (markWriteIdx - mMarkReadIdx.load(std::memory_order_acquire) < NB_MARKS) {
+        Mark &mark = mMarks[markWriteIdx % NB_MARKS];
+        mark.mPos = writePos;
+        mark.mTsMs = tsMs;
+        mark.mSpeed = speed;
+        mMarkWriteIdx.store(markWriteIdx + 1, std::memory_order_release);
+    }
+
+    mWritePos.store(writePos + nbSamples, std::memory_order_release);
+    return true;
+}
+
+int SampleRing::read(uint8_t *samples, int nbSamples, int64_t *tsMs, float *speed) {
+    int64_t readPos = mReadPos.load(std::memory_order_relaxed);
+    // Discarded samples are skipped, their marks are popped below on the way to the mark of samples written after them
+    int64_t discardPos = mDiscardPos.load(std::memory_order_acquire);
+    if (readPos < discardPos) {
+        readPos = discardPos;
+        mHasCurrentMark = false;
+        mReadPos.store(readPos, std::memory_order_release);
+    }
+    int available = (int) (mWritePos.load(std::memory_order_acquire) - readPos);
+    int nbRead = std::min(nbSamples, available);
+    if (nbRead <= 0) return 0;
+
+    // Latest mark at or before read position dates the first sample
+    int64_t markReadIdx = mMarkReadIdx.load(std::memory_order_relaxed);
+    int64_t markWriteIdx = mMarkWriteIdx.load(std::memory_order_acquire);
+    while (markReadIdx < markWriteIdx && mMarks[markReadIdx % NB_MARKS].mPos <= readPos) {
+        mCurrentMark = mMarks[markReadIdx % NB_MARKS];
+        mHasCurrentMark = true;
+        markReadIdx++;
+    }
+    mMarkReadIdx.store(markReadIdx, std::memory_order_release);
+    if (tsMs && mHasCurrentMark) {
+        double elapsedMs = (double) (readPos - mCurrentMark.mPos) * 1000 * mCurrentMark.mSpeed / mSampleRate;
+        *tsMs = mCurrentMark.mTsMs + (int64_t) elapsedMs;
+    }
+    if (speed && mHasCurrentMark) *speed = mCurrentMark.mSpeed;
+
+    copyOut(readPos, samples, nbRead);
+    mReadPos.store(readPos + nbRead, std::memory_order_release);
+    return nbRead;
+}
+
+void SampleRing::discard() {
+    mDiscardPos.store(mWritePos.load(std::memory_order_relaxed), std::memory_order_release);
+}
+
+void SampleRing::reset() {
+    mWritePos = 0;
+    mReadPos = 0;
+    mDiscardPos = 0;
+    mMarkWriteIdx = 0;
+    mMarkReadIdx = 0;
+    mHasCurrentMark = false;
+}
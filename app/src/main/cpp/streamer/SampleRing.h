@@ -0,0 +1,82 @@
+#ifndef SAMPLE_RING_H
+#define SAMPLE_RING_H
+
+#include "atomic"
+#include "cstdint"
+#include "vector"
+
+/** A lock-free single producer single consumer ring of interleaved audio samples.
+ * Producer writes whole decoded frames of any size, consumer reads any number of samples,
+ * so frames are split and joined at sample granularity. Reading never locks, allocates or logs,
+ * it is safe to call from a real-time audio callback. Every written frame carries a timestamp and a playback speed,
+ * reads return the timestamp of their first sample. */
+class SampleRing {
+private:
+    /** Timestamp of the sample at a ring position. */
+    struct Mark {
+        int64_t mPos = 0;
+        int64_t mTsMs = 0;
+        float mSpeed = 1.0f; // Stream time covered by one sample, in sample durations
+    };
+
+    // Number of frame timestamps kept, frames written while every mark is in use get none
+    static const int NB_MARKS = 512;
+
+    const int mBytesPerSample; // Bytes of one sample of every channel
+    const int mSampleRate;
+    int64_t mCapacity = 0; // In samples, power of two
+    std::vector<uint8_t> mData;
+
+    // Positions only grow, index inside ring is position modulo capacity {
+    std::atomic_int64_t mWritePos = {0}; // Written by producer only
+    std::atomic_int64_t mReadPos = {0}; // Written by consumer only
+    std::atomic_int64_t mDiscardPos = {0}; // Samples before it are skipped by consumer, written by producer only
+    // } Positions
+
+    // Marks are a ring of their own, pushed by producer and popped by consumer {
+    Mark mMarks[NB_MARKS];
+    std::atomic_int64_t mMarkWriteIdx = {0};
+    std::atomic_int64_t mMarkReadIdx = {0};
+    Mark mCurrentMark; // Last mark popped, only used by consumer
+    bool mHasCurrentMark = false;
+    // } Marks
+
+private:
+    /** Copy samples between ring and a linear buffer, wrapping around the end of ring. */
+    void copyIn(int64_t pos, const uint8_t *src, int nbSamples);
+
+    void copyOut(int64_t pos, uint8_t *dst, int nbSamples) const;
+
+public:
+    /** Create a ring holding at least capacity samples of bytesPerSample each. */
+    SampleRing(int capacity, int bytesPerSample, int sampleRate);
+
+    int getCapacity() const;
+
+    /** Return number of samples that can be written. Producer only. */
+    int getWriteAvailable() const;
+
+    /** Return number of samples that can be read, leaving out discarded ones. */
+    int getReadAvailable() const;
+
+    /** Write nbSamples samples starting at timestamp tsMs, nothing is written if they do not all fit.
+     * Producer only.
+     * @param speed playback speed samples were time-stretched to, stream time advances this much faster than samples
+     * @return true if samples were written */
+    bool write(const uint8_t *samples, int nbSamples, int64_t tsMs, float speed = 1.0f);
+
+    /** Read up to nbSamples samples. Consumer only, real-time safe.
+     * @param tsMs if not null, receives timestamp of first sample read, left untouched if nothing was read
+     * @param speed if not null, receives playback speed of first sample read, left untouched if nothing was read
+     * @return number of samples read */
+    int read(uint8_t *samples, int nbSamples, int64_t *tsMs, float *speed = nullptr);
+
+    /** Drop every sample written so far, e.g. after a seek. Producer only, consumer skips them on its next read.
+     * Their room is only given back to producer once consumer skipped them. */
+    void discard();
+
+    /** Drop every sample. Must not be called while producer or consumer is running. */
+    void reset();
+};
+
+#endif //SAMPLE_RING_H
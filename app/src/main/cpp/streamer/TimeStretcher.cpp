@@ -0,0 +1,241 @@
+#include "TimeStretcher.h"
+#include "algorithm"
+#include "cmath"
+#include "cstring"
+
+extern "C" {
+#include "libavutil/avutil.h"
+}
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/** Compute dot product of a and b along with energy of b, over n floats.
+ * Searching windows spends nearly all stretching time here, so it runs on SIMD where available. */
+static void getDotAndEnergy(const float *a, const float *b, int n, float *dot, float *energy) {
+    int i = 0;
+    float d = 0.0f, e = 0.0f;
+#if defined(__ARM_NEON)
+    float32x4_t d0 = vdupq_n_f32(0.0f), d1 = d0, e0 = d0, e1 = d0;
+    for (; i + 8 <= n; i += 8) {
+        float32x4_t a0 = vld1q_f32(a + i), a1 = vld1q_f32(a + i + 4);
+        float32x4_t b0 = vld1q_f32(b + i), b1 = vld1q_f32(b + i + 4);
+        d0 = vmlaq_f32(d0, a0, b0);
+        d1 = vmlaq_f32(d1, a1, b1);
+        e0 = vmlaq_f32(e0, b0, b0);
+        e1 = vmlaq_f32(e1, b1, b1);
+    }
+    float32x4_t dSum = vaddq_f32(d0, d1), eSum = vaddq_f32(e0, e1);
+#if defined(__aarch64__)
+    d = vaddvq_f32(dSum);
+    e = vaddvq_f32(eSum);
+#else
+    float32x2_t dPair = vadd_f32(vget_low_f32(dSum), vget_high_f32(dSum));
+    float32x2_t ePair = vadd_f32(vget_low_f32(eSum), vget_high_f32(eSum));
+    d = vget_lane_f32(vpadd_f32(dPair, dPair), 0);
+    e = vget_lane_f32(vpadd_f32(ePair, ePair), 0);
+#endif
+#elif defined(__SSE2__)
+    __m128 d0 = _mm_setzero_ps(), d1 = d0, e0 = d0, e1 = d0;
+    for (; i + 8 <= n; i += 8) {
+        __m128 a0 = _mm_loadu_ps(a + i), a1 = _mm_loadu_ps(a + i + 4);
+        __m128 b0 = _mm_loadu_ps(b + i), b1 = _mm_loadu_ps(b + i + 4);
+        d0 = _mm_add_ps(d0, _mm_mul_ps(a0, b0));
+        d1 = _mm_add_ps(d1, _mm_mul_ps(a1, b1));
+        e0 = _mm_add_ps(e0, _mm_mul_ps(b0, b0));
+        e1 = _mm_add_ps(e1, _mm_mul_ps(b1, b1));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, _mm_add_ps(d0, d1));
+    d = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    _mm_storeu_ps(lanes, _mm_add_ps(e0, e1));
+    e = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+    for (; i < n; i++) {
+        d += a[i] * b[i];
+        e += b[i] * b[i];
+    }
+    *dot = d;
+    *energy = e;
+}
+
+TimeStretcher::TimeStretcher(int sampleRate, int nbChannels, AVSampleFormat sampleFmt)
+        : mSampleRate(sampleRate), mNbChannels(nbChannels), mSampleFmt(sampleFmt),
+          mBytesPerSample(av_get_bytes_per_sample(sampleFmt) * nbChannels),
+          mHopSize(std::max(1, sampleRate * WINDOW_MS / 2000)),
+          mSearchSize(sampleRate * SEARCH_MS / 1000) {
+    // Squared sine rising half, it adds up to 1 with the falling half of previous window
+    mFadeIn.resize(mHopSize);
+    for (int i = 0; i < mHopSize; i++) {
+        double s = sin(M_PI / 2 * (i + 0.5) / mHopSize);
+        mFadeIn[i] = (float) (s * s);
+    }
+    mStep.resize((size_t) mHopSize * mNbChannels);
+}
+
+void TimeStretcher::toFloat(const uint8_t *src, float *dst, int nbSamples) const {
+    int n = nbSamples * mNbChannels;
+    switch (mSampleFmt) {
+        case AV_SAMPLE_FMT_S16: {
+            auto *s16 = (const int16_t *) src;
+            for (int i = 0; i < n; i++) dst[i] = (float) s16[i] * (1.0f / 32768.0f);
+            break;
+        }
+        case AV_SAMPLE_FMT_S32: {
+            auto *s32 = (const int32_t *) src;
+            for (int i = 0; i < n; i++) dst[i] = (float) ((double) s32[i] * (1.0 / 2147483648.0));
+            break;
+        }
+        default:
+            memcpy(dst, src, (size_t) n * sizeof(float));
+            break;
+    }
+}
+
+void TimeStretcher::fromFloat(const float *src, uint8_t *dst, int nbSamples) const {
+    int n = nbSamples * mNbChannels;
+    switch (mSampleFmt) {
+        case AV_SAMPLE_FMT_S16: {
+            auto *s16 = (int16_t *) dst;
+            for (int i = 0; i < n; i++) s16[i] = (int16_t) lrintf(av_clipf(src[i] * 32768.0f, -32768.0f, 32767.0f));
+            break;
+        }
+        case AV_SAMPLE_FMT_S32: {
+            auto *s32 = (int32_t *) dst;
+            for (int i = 0; i < n; i++) {
+                s32[i] = (int32_t) llrint(av_clipd((double) src[i] * 2147483648.0, -2147483648.0, 2147483647.0));
+            }
+            break;
+        }
+        default:
+            memcpy(dst, src, (size_t) n * sizeof(float));
+            break;
+    }
+}
+
+float TimeStretcher::getSimilarity(int pos) const {
+    float dot, energy;
+    getDotAndEnergy(mInput.data() + (size_t) mPos * mNbChannels, mInput.data() + (size_t) pos * mNbChannels,
+                    mHopSize * mNbChannels, &dot, &energy);
+    // Correlation normalized by window energy, squared keeping its sign to avoid a square root
+    return dot * fabsf(dot) / (energy + 1e-9f);
+}
+
+int TimeStretcher::findBestWindow(int target) const {
+    int start = std::max(0, target - mSearchSize);
+    int end = target + mSearchSize;
+
+    // Nominal position wins ties, e.g. in silence
+    int best = target;
+    float bestSimilarity = getSimilarity(target);
+    for (int pos = start; pos <= end; pos += COARSE_STEP) {
+        float similarity = getSimilarity(pos);
+        if (similarity > bestSimilarity) {
+            bestSimilarity = similarity;
+            best = pos;
+        }
+    }
+
+    int coarseBest = best;
+    int fineStart = std::max(start, coarseBest - COARSE_STEP + 1);
+    int fineEnd = std::min(end, coarseBest + COARSE_STEP - 1);
+    for (int pos = fineStart; pos <= fineEnd; pos++) {
+        if (pos == coarseBest) continue;
+        float similarity = getSimilarity(pos);
+        if (similarity > bestSimilarity) {
+            bestSimilarity = similarity;
+            best = pos;
+        }
+    }
+    return best;
+}
+
+int64_t TimeStretcher::getTsMs(double pos) const {
+    return mInputTsMs + (int64_t) (pos * 1000 / mSampleRate);
+}
+
+void TimeStretcher::discardInput() {
+    int keep = std::min(mPos, (int) mTargetPos - mSearchSize);
+    if (keep <= 0) return;
+
+    memmove(mInput.data(), mInput.data() + (size_t) keep * mNbChannels,
+            (size_t) (mInputSize - keep) * mNbChannels * sizeof(float));
+    mInputSize -= keep;
+    mInputTsMs = getTsMs(keep);
+    mPos -= keep;
+    mTargetPos -= keep;
+}
+
+void TimeStretcher::setSpeed(double speed) {
+    if (speed > 0) mSpeed = speed;
+}
+
+double TimeStretcher::getSpeed() const {
+    return mSpeed;
+}
+
+int TimeStretcher::getMaxOutput(int nbSamples) const {
+    int inputSize = mInputSize + nbSamples;
+    if (mSpeed == 1.0) return inputSize - mPos;
+    // Every step moves next window by a hop times speed, and outputs a hop
+    return ((int) (inputSize / (mHopSize * mSpeed)) + 1) * mHopSize;
+}
+
+int TimeStretcher::process(const uint8_t *samples, int nbSamples, int64_t tsMs, uint8_t *out, int64_t *outTsMs) {
+    if (nbSamples > 0) {
+        size_t size = (size_t) (mInputSize + nbSamples) * mNbChannels;
+        if (mInput.size() < size) mInput.resize(size);
+        toFloat(samples, mInput.data() + (size_t) mInputSize * mNbChannels, nbSamples);
+        // Date kept input from latest frame, timestamps follow stream even if frames are not contiguous
+        if (tsMs != AV_NOPTS_VALUE) mInputTsMs = tsMs - (int64_t) mInputSize * 1000 / mSampleRate;
+        mInputSize += nbSamples;
+    }
+
+    int nbOut = 0;
+    if (mSpeed == 1.0) {
+        // Play input as is from where previous window continues, stretching resumes seamlessly from there
+        nbOut = mInputSize - mPos;
+        if (nbOut > 0) {
+            *outTsMs = getTsMs(mPos);
+            fromFloat(mInput.data() + (size_t) mPos * mNbChannels, out, nbOut);
+            mPos += nbOut;
+        }
+        mTargetPos = mPos;
+    } else {
+        while (true) {
+            int target = (int) lround(mTargetPos);
+            // Whole search range and continuation of previous window must be there
+            if (target + mSearchSize + mHopSize > mInputSize || mPos + mHopSize > mInputSize) break;
+            int best = findBestWindow(target);
+            if (nbOut == 0) *outTsMs = getTsMs(mTargetPos);
+
+            // Cross-fade from continuation of previous window into new window
+            const float *prev = mInput.data() + (size_t) mPos * mNbChannels;
+            const float *next = mInput.data() + (size_t) best * mNbChannels;
+            for (int i = 0; i < mHopSize; i++) {
+                float fadeIn = mFadeIn[i], fadeOut = mFadeIn[mHopSize - 1 - i];
+                for (int c = 0; c < mNbChannels; c++) {
+                    int idx = i * mNbChannels + c;
+                    mStep[idx] = prev[idx] * fadeOut + next[idx] * fadeIn;
+                }
+            }
+            fromFloat(mStep.data(), out + (size_t) nbOut * mBytesPerSample, mHopSize);
+
+            nbOut += mHopSize;
+            mPos = best + mHopSize;
+            mTargetPos += mHopSize * mSpeed;
+        }
+    }
+
+    discardInput();
+    return nbOut;
+}
+
+void TimeStretcher::reset() {
+    mInputSize = 0;
+    mPos = 0;
+    mTargetPos = 0;
+}
@@ -0,0 +1,85 @@
+#ifndef TIME_STRETCHER_H
+#define TIME_STRETCHER_H
+
+extern "C" {
+#include "libavutil/samplefmt.h"
+}
+#include "cstdint"
+#include "vector"
+
+/** Changes playback speed of audio while keeping its pitch, with WSOLA (waveform similarity overlap-add).
+ * Output is made of half overlapping windows of input, taken speed times further apart in input than they are laid
+ * out in output. Each window is searched around its nominal position for where it best continues the previous one,
+ * so that overlapping windows add up in phase. Speed 1 plays input as is.
+ * Takes interleaved samples of any output format, stretched as float. Must be used from a single thread. */
+class TimeStretcher {
+private:
+    // Length of a window, windows overlap by half so every step outputs half a window
+    static const int WINDOW_MS = 20;
+    // How far around its nominal position a window is searched for
+    static const int SEARCH_MS = 15;
+    // Coarse search tries every this many positions, then every position around best one
+    static const int COARSE_STEP = 4;
+
+    const int mSampleRate;
+    const int mNbChannels;
+    const AVSampleFormat mSampleFmt;
+    const int mBytesPerSample; // Bytes of one sample of every channel
+    const int mHopSize; // Samples output per step, half a window
+    const int mSearchSize; // Search radius in samples
+    std::vector<float> mFadeIn; // Rising half window, falling half is the same read backward
+
+    double mSpeed = 1.0;
+
+    // Interleaved input not consumed yet, positions are sample indexes into it {
+    std::vector<float> mInput;
+    int mInputSize = 0; // In samples
+    int64_t mInputTsMs = 0; // Timestamp of first input sample
+    int mPos = 0; // Where previous window continues, output so far ends exactly before it
+    double mTargetPos = 0; // Nominal position of next window
+    // } Input
+
+    // Output of one step, before it is converted to sample format
+    std::vector<float> mStep;
+
+private:
+    /** Convert interleaved samples between sample format and float. */
+    void toFloat(const uint8_t *src, float *dst, int nbSamples) const;
+
+    void fromFloat(const float *src, uint8_t *dst, int nbSamples) const;
+
+    /** Return input position where a window around target best continues previous window. */
+    int findBestWindow(int target) const;
+
+    /** Return similarity of window at pos to continuation of previous window, higher is more alike. */
+    float getSimilarity(int pos) const;
+
+    /** Return timestamp of input sample at position. */
+    int64_t getTsMs(double pos) const;
+
+    /** Drop input no later window can start from. */
+    void discardInput();
+
+public:
+    TimeStretcher(int sampleRate, int nbChannels, AVSampleFormat sampleFmt);
+
+    /** Set playback speed, following output is stretched to it. Speed above 1 plays faster. */
+    void setSpeed(double speed);
+
+    double getSpeed() const;
+
+    /** Return most samples process() can output for given number of input samples at current speed. */
+    int getMaxOutput(int nbSamples) const;
+
+    /** Take input samples and output as many stretched samples as they allow, rest of input is kept for next call.
+     * @param tsMs timestamp of first input sample
+     * @param out receives output samples, must hold getMaxOutput(nbSamples) samples
+     * @param outTsMs receives timestamp of first output sample, left untouched if nothing was output
+     * @return number of samples output */
+    int process(const uint8_t *samples, int nbSamples, int64_t tsMs, uint8_t *out, int64_t *outTsMs);
+
+    /** Drop every sample kept, e.g. after a seek. */
+    void reset();
+};
+
+#endif //TIME_STRETCHER_H
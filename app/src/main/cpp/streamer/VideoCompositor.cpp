@@ -0,0 +1,76 @@
+#include "VideoCompositor.h"
+#include "JNILogHelper.h"
+#include "algorithm"
+
+#define LOG_TAG "VideoCompositor"
+
+VideoCompositor::VideoCompositor(CompositorES3 **compositor) : mCompositor(compositor) {
+}
+
+bool VideoCompositor::addSource(VideoStreamer *source, const TileRect &rect) {
+    if (!source) return false;
+    if (source->isYuvOutput()) {
+        LOGE("Cannot composite YUV frames, build video streamer with YUV rendering disabled.");
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lck(mMutex);
+    if (!mSources.empty() && source->getInternalPixelFormat() != mSources[0]->getInternalPixelFormat()) {
+        LOGE("Cannot composite sources of different pixel formats.");
+        return false;
+    }
+    mSources.push_back(source);
+    mRects.push_back(rect);
+    return true;
+}
+
+void VideoCompositor::removeSource(VideoStreamer *source) {
+    std::unique_lock<std::mutex> lck(mMutex);
+    auto it = std::find(mSources.begin(), mSources.end(), source);
+    if (it == mSources.end()) return;
+    mRects.erase(mRects.begin() + (it - mSources.begin()));
+    mSources.erase(it);
+}
+
+void VideoCompositor::setGridLayout() {
+    std::unique_lock<std::mutex> lck(mMutex);
+    CompositorES3::getGridLayout((int) mSources.size(), &mRects);
+}
+
+void VideoCompositor::setPictureInPictureLayout() {
+    std::unique_lock<std::mutex> lck(mMutex);
+    CompositorES3::getPictureInPictureLayout((int) mSources.size(), &mRects);
+}
+
+int VideoCompositor::getNbSources() {
+    std::unique_lock<std::mutex> lck(mMutex);
+    return (int) mSources.size();
+}
+
+void VideoCompositor::render(int64_t vsyncNs, int64_t vsyncPeriodNs) {
+    if (!mCompositor || !*mCompositor) return;
+    CompositorES3 *compositor = *mCompositor;
+
+    std::unique_lock<std::mutex> lck(mMutex);
+    compositor->setLayout(mRects.data(), (int) mRects.size());
+
+    for (int i = 0; i < (int) mSources.size(); i++) {
+        VideoStreamer *source = mSources[i];
+        // Frames of each source are converted to fit its tile
+        int tileWidth, tileHeight;
+        compositor->getTileSize(i, &tileWidth, &tileHeight);
+        source->setViewportSize(tileWidth, tileHeight);
+
+        bool isNewFrame;
+        const AVFrame *frame = source->pullFrame(vsyncNs, vsyncPeriodNs, &isNewFrame);
+        if (!frame) {
+            compositor->setTilePicture(i, 0, 0, GL_NONE, GL_NONE, 0, nullptr);
+            continue;
+        }
+        float sampleAspectRatio = frame->sample_aspect_ratio.num > 0 ? (float) av_q2d(frame->sample_aspect_ratio) : 1.0f;
+        compositor->setTilePicture(i, frame->width, frame->height, source->getPixelFormat(),
+                                   source->getInternalPixelFormat(), frame->linesize[0], frame->data[0], isNewFrame,
+                                   sampleAspectRatio);
+    }
+    compositor->render();
+}
@@ -0,0 +1,47 @@
+#ifndef VIDEO_COMPOSITOR_H
+#define VIDEO_COMPOSITOR_H
+
+#include "VideoStreamer.h"
+#include "../gles/CompositorES3.h"
+#include "vector"
+#include "mutex"
+
+/** Draws several video streamers on one surface through a compositor, each streamer into its own tile.
+ * Streamers are paced independently and converted at the size of their tile.
+ * Streamers must keep RGB frames, built with YUV rendering disabled.
+ * Tiles are uploaded and drawn in the context of the surface, no shared context is needed.
+ * App does not use it yet, its JNI layer holds a single streamer and renderer; host CompositorTest and
+ * CompositorBench drive it. */
+class VideoCompositor {
+private:
+    // OpenGLES compositor, recreated with surface
+    CompositorES3 **mCompositor;
+
+    std::mutex mMutex;
+    std::vector<VideoStreamer *> mSources;
+    std::vector<TileRect> mRects;
+
+public:
+    explicit VideoCompositor(CompositorES3 **compositor);
+
+    /** Add a streamer drawn into given area of surface. Compositor does not take ownership of it.
+     * @return false if streamer frames cannot be composited */
+    bool addSource(VideoStreamer *source, const TileRect &rect);
+
+    /** Stop drawing a streamer, following tiles move up one slot. */
+    void removeSource(VideoStreamer *source);
+
+    /** Lay every source out in a grid of equal tiles. */
+    void setGridLayout();
+
+    /** Draw first source over whole surface and others as small insets on top of it. */
+    void setPictureInPictureLayout();
+
+    int getNbSources();
+
+    /** Callback function. Will be called when surface needs a new frame.
+     * Takes the frame due of every source and draws all of them in one pass. */
+    void render(int64_t vsyncNs = 0, int64_t vsyncPeriodNs = 0);
+};
+
+#endif //VIDEO_COMPOSITOR_H
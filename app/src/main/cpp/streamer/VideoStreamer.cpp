@@ -1,33 +1,64 @@
 #include "VideoStreamer.h"
 #include "JNILogHelper.h"
+#include "YuvConverter.h"
 
 #define LOG_TAG "VideoStreamer"
 
+/** Unpack buffer a frame was written into, given back to its pool once every reference to frame is released. */
+struct UploadBufferRef {
+    std::shared_ptr<UploadBufferPool> mPool;
+    int mIndex;
+};
+
+static void releaseUploadBuffer(void *opaque, uint8_t * /*data*/) {
+    auto *ref = (UploadBufferRef *) opaque;
+    ref->mPool->release(ref->mIndex);
+    delete ref;
+}
+
 VideoStreamer::VideoStreamer() {
     // Generate an unique id for this sink based on time
     mId = getCurrentTimeMs();
 }
 
 VideoStreamer::~VideoStreamer() {
+    VideoStreamerStats stats = getStats();
+    LOGD("Frames converted: %lld, dropped late: %lld, displayed: %lld, repeated: %lld, dropped unshown: %lld, "
+         "written ahead into unpack buffers: %lld",
+         (long long) stats.mNbConverted, (long long) stats.mNbDroppedLate, (long long) stats.mNbDisplayed,
+         (long long) stats.mNbRepeated, (long long) stats.mNbDroppedUnshown, (long long) stats.mNbStaged);
+    if (stats.mNbConverted > 0) {
+        LOGD("Average pixels per frame: %lld, source frames have %d",
+             (long long) (stats.mNbPixelsConverted / stats.mNbConverted), mSrcWidth * mSrcHeight);
+    }
+
     delete mFrameBuffer;
     sws_freeContext(mSwsCtx);
     if (mFrame) av_frame_free(&mFrame);
+    av_frame_free(&mPreviewFrame);
     if (mTmpFrame) av_frame_free(&mTmpFrame);
+    av_frame_free(&mPeekedFrame);
+    av_frame_free(&mStagedFrame);
 }
 
 bool VideoStreamer::initiate() {
     // Validate output pixel format
-    AVPixelFormat dstPixFmt = glPixFmtToAvPixFmt(mPixFmt);
-    if (dstPixFmt == AV_PIX_FMT_NONE) {
+    if (glPixFmtToAvPixFmt(mPixFmt) == AV_PIX_FMT_NONE) {
         LOGE("Failed to initiate player, invalid picture format.");
         return false;
     }
 
+    // Output may change once a renderer reports its max texture size
+    fitOutputSize();
+    AVPixelFormat dstPixFmt = getOutputPixFmt();
+
     // Create frame buffer
     if (!createFrameBuffer()) return false;
 
-    // Check if scaler is needed
-    if (mSrcWidth == mWidth && mSrcHeight == mHeight && mSrcPixFmt == dstPixFmt) {
+    // Check if scaler is needed, sizes may still change later on with viewport
+    mConvertWidth = mWidth;
+    mConvertHeight = mHeight;
+    if (mIsYuvOutput || (mSrcWidth == mWidth && mSrcHeight == mHeight && mSrcPixFmt == dstPixFmt)) {
         LOGD("Input and output format matched, no scaler needed.");
     } else {
         // Create scaler
@@ -42,13 +73,42 @@ bool VideoStreamer::initiate() {
     return true;
 }
 
-bool VideoStreamer::createFrameBuffer() {
-    AVPixelFormat dstPixFmt = glPixFmtToAvPixFmt(mPixFmt);
-    if (dstPixFmt == AV_PIX_FMT_NONE) {
-        LOGE("Failed to create frame buffer, invalid picture format.");
-        return false;
+void VideoStreamer::fitOutputSize() {
+    int maxTextureSize = RendererES3::getMaxTextureSize();
+    if (maxTextureSize == mFittedTextureSize) return;
+    mFittedTextureSize = maxTextureSize;
+
+    // Renderer scales frames on GPU, scale on CPU only pictures too big to fit in a texture
+    int width, height;
+    if (mSrcWidth <= maxTextureSize && mSrcHeight <= maxTextureSize) {
+        width = mSrcWidth;
+        height = mSrcHeight;
+    } else if (mRequestedWidth > 0 && mRequestedHeight > 0 &&
+               mRequestedWidth <= maxTextureSize && mRequestedHeight <= maxTextureSize) {
+        width = mRequestedWidth;
+        height = mRequestedHeight;
+    } else {
+        // Largest even size fitting in a texture with source aspect ratio
+        double scale = FFMIN((double) maxTextureSize / mSrcWidth, (double) maxTextureSize / mSrcHeight);
+        width = FFMAX(2, (int) (mSrcWidth * scale) & ~1);
+        height = FFMAX(2, (int) (mSrcHeight * scale) & ~1);
     }
-    mFrameBuffer = new FrameBuffer(128, mWidth, mHeight, dstPixFmt);
+    mWidth = width;
+    mHeight = height;
+    if (width != mSrcWidth || height != mSrcHeight) {
+        LOGD("Picture %dx%d exceeds max texture size %d, scaling to %dx%d on CPU.", mSrcWidth, mSrcHeight,
+             maxTextureSize, width, height);
+    }
+
+    // Skip scaler entirely when decoded frames can be drawn as they are
+    bool isSameSize = width == mSrcWidth && height == mSrcHeight;
+    mIsYuvOutput = mIsYuvRenderingEnabled && isSameSize && isYuvRenderable(mSrcPixFmt);
+    if (mIsYuvOutput) LOGD("Drawing %s frames without conversion.", av_get_pix_fmt_name(mSrcPixFmt));
+}
+
+bool VideoStreamer::createFrameBuffer() {
+    // Format of frames changes with output params, frames already buffered are drawn in their own format
+    mFrameBuffer = new FrameBuffer(128, mWidth, mHeight, AV_PIX_FMT_NONE);
     return true;
 }
 
@@ -75,12 +135,12 @@ bool VideoStreamer::createScaler() {
     if (!mSwsCtx) {
         LOGE("Impossible to create scale context for the conversion fmt_:%s s:%dx%d -> fmt_:%s s:%dx%d",
              av_get_pix_fmt_name(mSrcPixFmt), mSrcWidth, mSrcHeight,
-             av_get_pix_fmt_name(dstPixFmt), mWidth, mHeight);
+             av_get_pix_fmt_name(dstPixFmt), mWidth.load(), mHeight.load());
         return false;
     }
     LOGD("Created scale context for the conversion fmt:%s s:%dx%d -> fmt:%s s:%dx%d",
          av_get_pix_fmt_name(mSrcPixFmt), mSrcWidth, mSrcHeight,
-         av_get_pix_fmt_name(dstPixFmt), mWidth, mHeight);
+         av_get_pix_fmt_name(dstPixFmt), mWidth.load(), mHeight.load());
 
     // Allocate frame for scaler output
     mTmpFrame = FFmpegHelper::allocatePictureFrame(mWidth, mHeight, dstPixFmt);
@@ -100,36 +160,435 @@ AVPixelFormat VideoStreamer::glPixFmtToAvPixFmt(GLenum pPixFmt) {
     }
 }
 
-int VideoStreamer::onVideoFrame(AVFrame *srcFrame) {
-    if (mFrameBuffer->isFull()) return false;
+AVPixelFormat VideoStreamer::getOutputPixFmt() const {
+    if (mIsYuvOutput) return mSrcPixFmt;
+    return glPixFmtToAvPixFmt(mPixFmt);
+}
+
+bool VideoStreamer::isYuvRenderable(AVPixelFormat pixFmt) {
+    switch (pixFmt) {
+        case AV_PIX_FMT_YUV420P:
+        case AV_PIX_FMT_YUVJ420P:
+        case AV_PIX_FMT_YUV422P:
+        case AV_PIX_FMT_YUVJ422P:
+        case AV_PIX_FMT_YUV444P:
+        case AV_PIX_FMT_YUVJ444P:
+        case AV_PIX_FMT_NV12:
+        case AV_PIX_FMT_NV21:
+        case AV_PIX_FMT_YUV420P10LE:
+        case AV_PIX_FMT_P010LE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool VideoStreamer::fillYuvPicture(const AVFrame *frame, YuvPicture *picture) {
+    auto pixFmt = (AVPixelFormat) frame->format;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(pixFmt);
+    if (!desc || !isYuvRenderable(pixFmt)) return false;
+
+    picture->mLayout = desc->nb_components == 3 && desc->comp[1].plane == desc->comp[2].plane ?
+                       YuvLayout::SEMI_PLANAR : YuvLayout::PLANAR;
+    picture->mIsSwapped = pixFmt == AV_PIX_FMT_NV21;
+    picture->mWidth = frame->width;
+    picture->mHeight = frame->height;
+    picture->mChromaWidth = AV_CEIL_RSHIFT(frame->width, desc->log2_chroma_w);
+    picture->mChromaHeight = AV_CEIL_RSHIFT(frame->height, desc->log2_chroma_h);
+    picture->mBitDepth = desc->comp[0].depth;
+    picture->mBitShift = desc->comp[0].shift;
+
+    switch (frame->colorspace) {
+        case AVCOL_SPC_BT709:
+            picture->mMatrix = YuvMatrix::BT709;
+            break;
+        case AVCOL_SPC_BT2020_NCL:
+        case AVCOL_SPC_BT2020_CL:
+            picture->mMatrix = YuvMatrix::BT2020;
+            break;
+        case AVCOL_SPC_BT470BG:
+        case AVCOL_SPC_SMPTE170M:
+        case AVCOL_SPC_FCC:
+            picture->mMatrix = YuvMatrix::BT601;
+            break;
+        default:
+            // Unspecified, standard definition pictures are most likely BT601
+            picture->mMatrix = frame->height < 720 ? YuvMatrix::BT601 : YuvMatrix::BT709;
+            break;
+    }
+    if (frame->sample_aspect_ratio.num > 0) picture->mSampleAspectRatio = (float) av_q2d(frame->sample_aspect_ratio);
+    picture->mIsFullRange = frame->color_range == AVCOL_RANGE_JPEG ||
+                            pixFmt == AV_PIX_FMT_YUVJ420P || pixFmt == AV_PIX_FMT_YUVJ422P || pixFmt == AV_PIX_FMT_YUVJ444P;
+
+    for (int i = 0; i < 3; i++) {
+        picture->mData[i] = frame->data[i];
+        picture->mLinesize[i] = frame->linesize[i];
+    }
+    return true;
+}
+
+void VideoStreamer::getConvertSize(int srcWidth, int srcHeight, int *width, int *height) {
+    // Never above max output size
+    double scale = FFMIN(1.0, FFMIN((double) mWidth / srcWidth, (double) mHeight / srcHeight));
+
+    // Renderer fits picture inside viewport, anything bigger than that is lost
+    int viewportWidth = mViewportWidth, viewportHeight = mViewportHeight;
+    if (viewportWidth > 0 && viewportHeight > 0) {
+        scale = FFMIN(scale, FFMIN((double) viewportWidth / srcWidth, (double) viewportHeight / srcHeight));
+    }
+
+    // Round up to even sizes so chroma subsampled formats are not cut
+    *width = FFMAX(2, ((int) ceil(srcWidth * scale) + 1) & ~1);
+    *height = FFMAX(2, ((int) ceil(srcHeight * scale) + 1) & ~1);
+    if (*width > srcWidth) *width = srcWidth;
+    if (*height > srcHeight) *height = srcHeight;
+}
+
+void VideoStreamer::setScalerColorspace(const AVFrame *srcFrame) {
+    YuvPicture picture;
+    if (!fillYuvPicture(srcFrame, &picture)) return;
+    int colorspace = picture.mMatrix == YuvMatrix::BT601 ? SWS_CS_ITU601 :
+                     picture.mMatrix == YuvMatrix::BT2020 ? SWS_CS_BT2020 : SWS_CS_ITU709;
+    const int *table = sws_getCoefficients(colorspace);
+
+    int *invTable, srcRange, *dstTable, dstRange, brightness, contrast, saturation;
+    if (sws_getColorspaceDetails(mSwsCtx, &invTable, &srcRange, &dstTable, &dstRange,
+                                 &brightness, &contrast, &saturation) < 0) {
+        return;
+    }
+    if (memcmp(invTable, table, 4 * sizeof(int)) == 0 && srcRange == picture.mIsFullRange) return;
+    sws_setColorspaceDetails(mSwsCtx, table, picture.mIsFullRange, dstTable, dstRange, brightness, contrast, saturation);
+}
+
+AVFrame *VideoStreamer::convertFrame(AVFrame *srcFrame) {
+    fitOutputSize();
+    // Renderer converts YUV frames itself, their size only changes with decoder resolution
+    if (mIsYuvOutput) return srcFrame;
+
+    AVPixelFormat dstPixFmt = getOutputPixFmt();
+    int width, height;
+    getConvertSize(srcFrame->width, srcFrame->height, &width, &height);
+    if (width == srcFrame->width && height == srcFrame->height && srcFrame->format == dstPixFmt) return srcFrame;
+
+    if (width != mConvertWidth || height != mConvertHeight) {
+        LOGD("Converting %dx%d frames to %dx%d", srcFrame->width, srcFrame->height, width, height);
+        mConvertWidth = width;
+        mConvertHeight = height;
+    }
 
-    AVFrame *frame = srcFrame;
-    // Using scaler
-    if (mSwsCtx) {
+    // Same size YUV to RGB needs no scaler, dedicated kernels convert it
+    YuvPicture picture;
+    bool isDirect = width == srcFrame->width && height == srcFrame->height &&
+                    YuvConverter::isSupported((AVPixelFormat) srcFrame->format, dstPixFmt) &&
+                    fillYuvPicture(srcFrame, &picture);
+
+    // Reuses current scaler if nothing changed
+    if (!isDirect) {
+        mSwsCtx = sws_getCachedContext(mSwsCtx, srcFrame->width, srcFrame->height, (AVPixelFormat) srcFrame->format,
+                                       width, height, dstPixFmt, SWS_BICUBIC, nullptr, nullptr, nullptr);
+    }
+    if (!isDirect && !mSwsCtx) {
+        LOGE("Impossible to create scale context for the conversion fmt:%s s:%dx%d -> fmt:%s s:%dx%d",
+             av_get_pix_fmt_name((AVPixelFormat) srcFrame->format), srcFrame->width, srcFrame->height,
+             av_get_pix_fmt_name(dstPixFmt), width, height);
+        return nullptr;
+    }
+    if (!isDirect) setScalerColorspace(srcFrame);
+
+    if (!mTmpFrame) mTmpFrame = av_frame_alloc();
+    if (!mTmpFrame) return nullptr;
+    if (mTmpFrame->width != width || mTmpFrame->height != height || mTmpFrame->format != dstPixFmt) {
+        // Drop storage of previous size, a new one is taken below
+        av_frame_unref(mTmpFrame);
+        mTmpFrame->width = width;
+        mTmpFrame->height = height;
+        mTmpFrame->format = dstPixFmt;
+    }
+    // Frame buffer may still hold previous output, scale into a fresh pooled buffer then
+    if (!FFmpegHelper::makeFrameWritable(mTmpFrame)) return nullptr;
+
+    if (isDirect) {
+        if (!YuvConverter::convert(picture, mTmpFrame)) return nullptr;
+    } else {
         // Scale frame to output format
         int ret = sws_scale_frame(mSwsCtx, mTmpFrame, srcFrame);
         if (ret < 0) {
             LOGE("Error scaling image: %s", av_err2str(ret));
-            return 0;
+            return nullptr;
         }
-        frame = mTmpFrame;
-        frame->pts = srcFrame->pts;
     }
+    mTmpFrame->pts = srcFrame->pts;
+    // Keep display aspect ratio of source whatever size picture is scaled to
+    AVRational sar = srcFrame->sample_aspect_ratio.num > 0 ? srcFrame->sample_aspect_ratio : av_make_q(1, 1);
+    mTmpFrame->sample_aspect_ratio = av_mul_q(sar, av_make_q(srcFrame->width * height, srcFrame->height * width));
+    return mTmpFrame;
+}
 
-    return mFrameBuffer->putFrame(frame);
+bool VideoStreamer::admitFrame(const AVFrame *frame) {
+    if (!mClock || mIsTrickPlay || mLateToleranceMs < 0 || frame->pts == AV_NOPTS_VALUE) return true;
+
+    // Clock has not started yet
+    if (!mClock->isStarted()) return true;
+    int64_t currentTsMs = mClock->getTimeMs(mClock->getNowNs());
+
+    int64_t latenessMs = currentTsMs - ptsToMs(frame->pts, mTimeBase);
+    mLatenessMs = latenessMs;
+    return latenessMs <= mLateToleranceMs;
 }
 
-void VideoStreamer::render() {
-    if (!mFrameBuffer || !*mRenderer) return;
+bool VideoStreamer::copyToUploadBuffer(const std::shared_ptr<UploadBufferPool> &pool, const AVFrame *src,
+                                       AVFrame *dst) {
+    // Lines padded so that every plane row length is a whole number of pixels
+    auto pixFmt = (AVPixelFormat) src->format;
+    int paddedWidth = FFALIGN(src->width, 16);
+    int size = av_image_get_buffer_size(pixFmt, paddedWidth, src->height, 1);
+    if (size <= 0) return false;
+    int index = pool->acquire(size);
+    if (index < 0) return false;
 
-    // If time is presented, take the nearest frame close to current time
+    auto *ref = new UploadBufferRef{pool, index};
+    dst->buf[0] = av_buffer_create(pool->getPtr(index), size, releaseUploadBuffer, ref, 0);
+    if (!dst->buf[0]) {
+        pool->release(index);
+        delete ref;
+        return false;
+    }
+    av_image_fill_arrays(dst->data, dst->linesize, dst->buf[0]->data, pixFmt, paddedWidth, src->height, 1);
+    dst->format = src->format;
+    dst->width = src->width;
+    dst->height = src->height;
+    if (av_frame_copy(dst, src) < 0 || av_frame_copy_props(dst, src) < 0) {
+        av_frame_unref(dst);
+        return false;
+    }
+    // Tells frame apart from frames in memory of their own, whoever references it
+    dst->opaque = ref;
+    return true;
+}
+
+bool VideoStreamer::isStaged(const AVFrame *frame) {
+    return frame->buf[0] && frame->opaque && frame->opaque == av_buffer_get_opaque(frame->buf[0]);
+}
+
+bool VideoStreamer::isStagingLost(const AVFrame *frame) {
+    return isStaged(frame) && ((UploadBufferRef *) frame->opaque)->mPool->isLost();
+}
+
+void VideoStreamer::stageFrames() {
+    std::shared_ptr<UploadBufferPool> pool;
+    {
+        std::unique_lock<std::mutex> lck(mUploadPoolMutex);
+        pool = mUploadPool;
+    }
+    if (!pool) return;
+    if (!mPeekedFrame) mPeekedFrame = av_frame_alloc();
+    if (!mStagedFrame) mStagedFrame = av_frame_alloc();
+    if (!mPeekedFrame || !mStagedFrame) return;
+
+    // Copied outside of frame buffer lock, drawing goes on meanwhile and may take frame out
+    for (int i = 0; i < UploadBufferPool::NB_BUFFERS && mFrameBuffer->peekFrame(i, mPeekedFrame); i++) {
+        if (isStaged(mPeekedFrame)) continue;
+        if (!copyToUploadBuffer(pool, mPeekedFrame, mStagedFrame)) break;
+        if (mFrameBuffer->replaceFrame(mPeekedFrame, mStagedFrame)) mNbStaged++;
+        av_frame_unref(mStagedFrame);
+    }
+    av_frame_unref(mPeekedFrame);
+}
+
+int VideoStreamer::onVideoFrame(AVFrame *srcFrame) {
+    // Buffers drawing mapped since last frame are filled, also while waiting on a full frame buffer
+    stageFrames();
+
+    // Drop late frames before spending time converting them, frame is consumed
+    if (!admitFrame(srcFrame)) {
+        mNbDroppedLate++;
+        return true;
+    }
+
+    if (mFrameBuffer->isFull()) return false;
+
+    // Preview frames are converted from another thread
+    std::unique_lock<std::mutex> lck(mMutex);
+    AVFrame *frame = convertFrame(srcFrame);
+    if (!frame) return 0;
+
+    bool ret = mFrameBuffer->putFrame(frame);
+    if (ret) {
+        mNbConverted++;
+        mNbPixelsConverted += frame->width * frame->height;
+    }
+    return ret;
+}
+
+int64_t VideoStreamer::getLatenessMs() {
+    return mLatenessMs;
+}
+
+bool VideoStreamer::isPresenting() {
+    return true;
+}
+
+bool VideoStreamer::onPreviewFrame(AVFrame *srcFrame) {
+    std::unique_lock<std::mutex> lck(mMutex);
+    if (!mPreviewFrame) mPreviewFrame = av_frame_alloc();
+    if (!mPreviewFrame) return false;
+
+    AVFrame *frame = convertFrame(srcFrame);
+    if (!frame) return false;
+    av_frame_unref(mPreviewFrame);
+    if (av_frame_ref(mPreviewFrame, frame) < 0) return false;
+    mHasPreviewFrame = true;
+    return true;
+}
+
+void VideoStreamer::onVideoFlush() {
+    if (mFrameBuffer) mFrameBuffer->reset();
+    mLatenessMs = 0;
+    mIsFlushed = true;
+}
+
+int64_t VideoStreamer::getFramePts() {
+    return mFramePts;
+}
+
+VideoStreamerStats VideoStreamer::getStats() {
+    VideoStreamerStats stats;
+    stats.mNbConverted = mNbConverted.load();
+    stats.mNbDroppedLate = mNbDroppedLate.load();
+    FramePacerStats pacerStats = mFramePacer.getStats();
+    stats.mNbDisplayed = pacerStats.mNbDisplayed;
+    stats.mNbRepeated = pacerStats.mNbRepeated;
+    stats.mNbDroppedUnshown = pacerStats.mNbDropped;
+    stats.mNbPixelsConverted = mNbPixelsConverted.load();
+    stats.mNbStaged = mNbStaged.load();
+    return stats;
+}
+
+bool VideoStreamer::getPreferredSize(int *width, int *height) {
+    if (mViewportWidth <= 0 || mViewportHeight <= 0) return false;
+    getConvertSize(mSrcWidth, mSrcHeight, width, height);
+    return true;
+}
+
+bool VideoStreamer::isYuvOutput() const {
+    return mIsYuvRenderingEnabled && isYuvRenderable(mSrcPixFmt);
+}
+
+GLenum VideoStreamer::getPixelFormat() const {
+    return mPixFmt;
+}
+
+GLint VideoStreamer::getInternalPixelFormat() const {
+    return mInternalPixFmt;
+}
+
+void VideoStreamer::setViewportSize(int width, int height) {
+    // Following frames are converted to fit viewport
+    if (width != mViewportWidth || height != mViewportHeight) {
+        LOGD("Viewport changed to %dx%d", width, height);
+        mViewportWidth = width;
+        mViewportHeight = height;
+    }
+}
+
+void VideoStreamer::setTrickPlay(bool isTrickPlay) {
+    // Lateness is not measured while trick playing, it starts over once frames follow clock again
+    mLatenessMs = 0;
+    mIsTrickPlay = isTrickPlay;
+}
+
+const AVFrame *VideoStreamer::pullFrame(int64_t vsyncNs, int64_t vsyncPeriodNs, bool *isNewFrame) {
+    *isNewFrame = false;
+    if (!mFrameBuffer || !mFrame) return nullptr;
+    // Frames paced so far were dropped by a flush
+    if (mIsFlushed.exchange(false)) mFramePacer.reset();
+
+    if (mHasPreviewFrame) {
+        std::unique_lock<std::mutex> lck(mMutex);
+        mHasPreviewFrame = false;
+        av_frame_unref(mFrame);
+        av_frame_move_ref(mFrame, mPreviewFrame);
+        mFramePts = mFrame->pts;
+        // Pacer starts over from whatever frame playback shows next
+        mFramePacer.reset();
+        *isNewFrame = true;
+        return mFrame;
+    }
+
+    // If time is presented, take the latest frame due when this draw reaches the screen
     // Otherwise just take whatever frame inside buffer
-    if (mCurrentTsMs) {
-        int64_t pts = msToPts(mCurrentTsMs->load(), mTimeBase);
-        mFrameBuffer->takeFrame(mFrame, pts);
+    bool isTaken;
+    int nbDropped = 0;
+    int64_t nowNs = mClock ? mClock->getNowNs() : getMonotonicTimeNs();
+    // Read before taking a frame, a frame taken before a flush does not start clock again
+    int serial = mClock ? mClock->getSerial() : 0;
+    if (!mClock) {
+        isTaken = mFrameBuffer->takeFrame(mFrame);
+    } else if (mIsTrickPlay) {
+        // Trick play paces frames itself, each keyframe is shown as soon as it comes, pacer starts over once frames
+        // follow clock again
+        isTaken = mFrameBuffer->takeFrame(mFrame, false);
+        mFramePacer.reset();
+    } else if (mClock->isPaused()) {
+        // Keep showing current frame, smoothed clock follows master again once it moves
+        isTaken = false;
+        mFramePacer.reset();
+    } else if (!mClock->isStarted() && mClock->getMode() != ClockMode::AUDIO_MASTER) {
+        // Nothing to wait for, first frame starts clock
+        isTaken = mFrameBuffer->takeFrame(mFrame);
     } else {
-        mFrameBuffer->takeFrame(mFrame);
+        int64_t dueTimeUs = mFramePacer.getDueTimeUs(mClock->getTimeMs(nowNs), nowNs, vsyncNs, vsyncPeriodNs,
+                                                     mClock->getSpeed());
+        // Last frame starting no later than due time, rounding to the nearest one would take frames early
+        int64_t duePts = av_rescale_q_rnd(dueTimeUs, AV_TIME_BASE_Q, mTimeBase, AV_ROUND_DOWN);
+        isTaken = mFrameBuffer->takeFrame(mFrame, duePts, &nbDropped);
+        if (isTaken && mFrame->pts != AV_NOPTS_VALUE) {
+            mFramePacer.onFrameTaken(av_rescale_q(mFrame->pts, mTimeBase, AV_TIME_BASE_Q));
+        }
+    }
+    bool hasFrame = mFrame->data[0] != nullptr;
+    if (isTaken) mFramePts = mFrame->pts;
+    mFramePacer.onFramePresented(isTaken, hasFrame, nbDropped);
+    if (isTaken && mClock && !mIsTrickPlay && mFrame->pts != AV_NOPTS_VALUE) {
+        int64_t presentNs = FramePacer::getPresentTimeNs(nowNs, vsyncNs, vsyncPeriodNs);
+        mClock->onVideoPresented(av_rescale_q(mFrame->pts, mTimeBase, AV_TIME_BASE_Q), presentNs, serial);
     }
 
-    (*mRenderer)->render(mWidth, mHeight, mPixFmt, mInternalPixFmt, mFrame->linesize[0], mFrame->data[0]);
-}
\ No newline at end of file
+    *isNewFrame = isTaken;
+    return hasFrame ? mFrame : nullptr;
+}
+
+void VideoStreamer::render(int64_t vsyncNs, int64_t vsyncPeriodNs) {
+    if (!mRenderer || !*mRenderer) return;
+    setViewportSize((*mRenderer)->getSurfaceWidth(), (*mRenderer)->getSurfaceHeight());
+    {
+        // Frames are written into unpack buffers of the renderer drawing them, a new renderer brings new buffers
+        std::shared_ptr<UploadBufferPool> pool = (*mRenderer)->getUploadPool();
+        std::unique_lock<std::mutex> lck(mUploadPoolMutex);
+        if (pool != mUploadPool) mUploadPool = pool;
+    }
+
+    bool isTaken;
+    const AVFrame *frame = pullFrame(vsyncNs, vsyncPeriodNs, &isTaken);
+    // Pixels written into buffers of a previous renderer went with its context
+    if (!frame || isStagingLost(frame)) {
+        (*mRenderer)->clearSurface();
+        return;
+    }
+
+    // Without a new frame the renderer re-presents the texture it already holds.
+    // Frames buffered before output params changed keep their own format.
+    if (frame->format != glPixFmtToAvPixFmt(mPixFmt)) {
+        YuvPicture picture;
+        if (fillYuvPicture(frame, &picture)) {
+            (*mRenderer)->renderYuv(picture, isTaken);
+        } else {
+            (*mRenderer)->clearSurface();
+        }
+        return;
+    }
+    // Frames may have any size up to max output size, scaled frames carry aspect ratio of source
+    float sampleAspectRatio = frame->sample_aspect_ratio.num > 0 ? (float) av_q2d(frame->sample_aspect_ratio) : 1.0f;
+    (*mRenderer)->render(frame->width, frame->height, mPixFmt, mInternalPixFmt, frame->linesize[0], frame->data[0],
+                         isTaken, sampleAspectRatio);
+}
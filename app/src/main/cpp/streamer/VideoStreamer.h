@@ -4,6 +4,7 @@
 extern "C" {
 #include "libswscale/swscale.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/imgutils.h"
 }
 
 #include "TimeUtils.h"
@@ -12,6 +13,19 @@ extern "C" {
 #include "../gles/RendererES3.h"
 #include "mutex"
 #include "FrameBuffer.h"
+#include "FramePacer.h"
+#include "MediaClock.h"
+
+/** Frame counters of a video streamer. */
+struct VideoStreamerStats {
+    int64_t mNbConverted = 0; // Frames converted and put into frame buffer
+    int64_t mNbDroppedLate = 0; // Frames dropped before conversion because they were already late
+    int64_t mNbDisplayed = 0; // Frames taken out of frame buffer for rendering
+    int64_t mNbRepeated = 0; // Draws showing previous frame again
+    int64_t mNbDroppedUnshown = 0; // Frames put into frame buffer but skipped when rendering
+    int64_t mNbPixelsConverted = 0; // Pixels of every frame put into frame buffer
+    int64_t mNbStaged = 0; // Buffered frames written into unpack buffers of renderer ahead of drawing
+};
 
 class VideoStreamer : public VideoSink {
     friend class VideoStreamerBuilder;
@@ -26,13 +40,49 @@ private:
     AVFrame *mTmpFrame = nullptr;
     // Mutex to prevent reading and writing data to frame at the same time
     std::mutex mMutex;
+    // Frame shown on next draw whatever clock says, set from any thread under mMutex
+    AVFrame *mPreviewFrame = nullptr;
+    std::atomic_bool mHasPreviewFrame = {false};
+    // Timestamp of frame last taken for drawing
+    std::atomic_int64_t mFramePts = {AV_NOPTS_VALUE};
     // Frame buffer for buffering
     FrameBuffer *mFrameBuffer;
-    // Current time of stream in millis
-    std::atomic_int64_t *mCurrentTsMs = nullptr;
+    // Clock frames are picked against, null to show frames as they come
+    MediaClock *mClock = nullptr;
+    // Frames come paced by trick play, they are shown as they come whatever clock says
+    std::atomic_bool mIsTrickPlay = {false};
+    // Frames this far behind current time are dropped before conversion, negative to never drop
+    int64_t mLateToleranceMs = 50;
+    // How far the last incoming frame was behind current time
+    std::atomic_int64_t mLatenessMs = {0};
+
+    std::atomic_int64_t mNbConverted = {0};
+    std::atomic_int64_t mNbDroppedLate = {0};
+    std::atomic_int64_t mNbPixelsConverted = {0};
+
+    // Size of surface frames are drawn on, reported by renderer, 0 until known {
+    std::atomic_int mViewportWidth = {0}, mViewportHeight = {0};
+    // } Size of surface frames are drawn on
+    // Size frames were last converted to
+    int mConvertWidth = 0, mConvertHeight = 0;
+
+    // Picks stream time every draw is due for, only used from rendering thread
+    FramePacer mFramePacer;
+    // Set on a flush, rendering thread starts pacer over on its next draw
+    std::atomic_bool mIsFlushed = {false};
 
     // OpenGLES Renderer
-    RendererES3 **mRenderer;
+    RendererES3 **mRenderer = nullptr;
+
+    // Unpack buffers of renderer frames due next are written into from decoding thread, set on drawing {
+    std::mutex mUploadPoolMutex;
+    std::shared_ptr<UploadBufferPool> mUploadPool;
+    // } Unpack buffers of renderer
+    // Frame of frame buffer being written into an unpack buffer and its copy, only used from decoding thread {
+    AVFrame *mPeekedFrame = nullptr;
+    AVFrame *mStagedFrame = nullptr;
+    // } Frame being written into an unpack buffer
+    std::atomic_int64_t mNbStaged = {0};
 
     AVRational mTimeBase = {0, 1};
     // Video input params {
@@ -41,7 +91,16 @@ private:
     // } Video input params
 
     // Video output params {
-    int mWidth = 0, mHeight = 0;
+    // Decoded YUV frames may be drawn as they are if they fit in a texture, color is converted by renderer then
+    bool mIsYuvRenderingEnabled = false;
+    // Output size asked for when source does not fit in a texture, 0 if not set
+    int mRequestedWidth = 0, mRequestedHeight = 0;
+    // Decoded YUV frames are drawn as they are, color is converted by renderer instead of scaler
+    std::atomic_bool mIsYuvOutput = {false};
+    // Largest size frames are converted to, frames are converted to a smaller size when surface is smaller
+    std::atomic_int mWidth = {0}, mHeight = {0};
+    // Max texture size output params were fitted to, 0 until fitted
+    int mFittedTextureSize = 0;
     GLenum mPixFmt = GL_RGB; // Output pixel format of video
     GLint mInternalPixFmt = GL_RGB; // Pixel format of video stored inside the buffer
     // } Video output params
@@ -51,28 +110,114 @@ private:
 
     bool initiate();
 
+    /** Fit largest output size into max texture size and draw YUV frames as they are if source fits in a texture.
+     * Max texture size is only known once a renderer is initiated, output is fitted again whenever it changed. */
+    void fitOutputSize();
+
     /** Create frame buffer and allocate resources to it */
     bool createFrameBuffer();
 
     /** Create a scaler to convert picture from input format to output format. */
     bool createScaler();
 
+    /** Compute smallest size a picture can be scaled to while still filling viewport, never above max output size. */
+    void getConvertSize(int srcWidth, int srcHeight, int *width, int *height);
+
+    /** Set matrix and range of YUV frame on scaler, which assumes BT601 limited range otherwise.
+     * Scaler is only reconfigured if they changed. */
+    void setScalerColorspace(const AVFrame *srcFrame);
+
+    /** Convert frame into scaler output frame at a size fitting viewport, reconfiguring scaler if sizes changed.
+     * @return converted frame, srcFrame if no conversion is needed, null if failed */
+    AVFrame *convertFrame(AVFrame *srcFrame);
+
     /** Return equivalent ffmpeg AVPixelFormat given gl pixel format. */
     static AVPixelFormat glPixFmtToAvPixFmt(GLenum pPixFmt);
 
+    /** Return pixel format of frames stored in frame buffer. */
+    AVPixelFormat getOutputPixFmt() const;
+
+    /** Describe planes and colorspace of a YUV frame for renderer.
+     * @return false if frame format cannot be drawn by renderer */
+    static bool fillYuvPicture(const AVFrame *frame, YuvPicture *picture);
+
+    /** Write frames due next into mapped unpack buffers of renderer, so that drawing uploads them without copying.
+     * Stops at first frame no buffer is mapped for, renderer maps buffers again as it draws. */
+    void stageFrames();
+
+    /** Copy frame into an unpack buffer taken from pool, dst references buffer.
+     * @return false if no buffer is mapped */
+    static bool copyToUploadBuffer(const std::shared_ptr<UploadBufferPool> &pool, const AVFrame *src, AVFrame *dst);
+
+    /** Return true if frame was written into an unpack buffer. */
+    static bool isStaged(const AVFrame *frame);
+
+    /** Return true if frame was written into an unpack buffer deleted with its renderer, pixels are gone. */
+    static bool isStagingLost(const AVFrame *frame);
+
+    /** Check frame against current time, a frame is late if it will never be displayed.
+     * @return true if frame should be converted and buffered, false if it should be dropped */
+    bool admitFrame(const AVFrame *frame);
+
 public:
     VideoStreamer();
 
+    /** Return true if renderer can draw frames of given pixel format without converting them. */
+    static bool isYuvRenderable(AVPixelFormat pixFmt);
+
     ~VideoStreamer();
 
     /** Callback, will be called when there is an incoming frame from decoder.
-     * Incoming frames will be converted with scaler and stored in frame buffer. */
+     * Late frames are dropped, other incoming frames will be converted with scaler and stored in frame buffer. */
     int onVideoFrame(AVFrame *srcFrame) override;
 
+    /** Return how far the last incoming frame was behind current time, so that decoder can degrade quality. */
+    int64_t getLatenessMs() override;
+
+    bool isPresenting() override;
+
+    /** Convert frame and show it on next draw, even while clock is paused. Playback takes over again with its next
+     * frame. */
+    bool onPreviewFrame(AVFrame *srcFrame) override;
+
+    /** Drop buffered frames, e.g. on a seek. Frame on screen and preview frame stay until the next frame is taken,
+     * pacer and lateness start over. */
+    void onVideoFlush() override;
+
+    /** Return timestamp of frame last taken for drawing, AV_NOPTS_VALUE if none was. */
+    int64_t getFramePts();
+
+    VideoStreamerStats getStats();
+
+    /** Return viewport fitting size of source pictures, so that decoder can output reduced resolution. */
+    bool getPreferredSize(int *width, int *height) override;
+
+    /** Return true if frames may be kept in YUV and color converted by renderer, once they fit in a texture. */
+    bool isYuvOutput() const;
+
+    GLenum getPixelFormat() const;
+
+    GLint getInternalPixelFormat() const;
+
+    /** Set size frames are drawn at on surface, following frames are converted to fit it. */
+    void setViewportSize(int width, int height);
+
+    /** Show frames as they come instead of against clock, for keyframes paced by trick play. */
+    void setTrickPlay(bool isTrickPlay);
+
+    /** Take the frame due at the vsync a picture drawn now is shown on, for a caller drawing frames itself.
+     * Returned frame stays valid until next call, it is the previous frame if no new one is due or clock is paused.
+     * Unless audio drives clock, first frame is taken right away and starts clock. A preview frame is taken first.
+     * @param isNewFrame receives whether returned frame differs from previous call
+     * @return frame to draw, null if no frame was taken yet */
+    const AVFrame *pullFrame(int64_t vsyncNs, int64_t vsyncPeriodNs, bool *isNewFrame);
+
     /** Callback function. Will be called when surface needs a new frame.
-     * This will try to take a frame from buffer. If there is no frame pulled out
-     * from buffer, re-draw the most recent frame. */
-    void render();
+     * This will try to take the frame due at the vsync picture is shown on. If there is no frame pulled out
+     * from buffer, re-draw the most recent frame without uploading it again.
+     * @param vsyncNs monotonic time of a recent vsync, 0 if unknown
+     * @param vsyncPeriodNs time between vsyncs, 0 if unknown */
+    void render(int64_t vsyncNs = 0, int64_t vsyncPeriodNs = 0);
 };
 
 
@@ -7,6 +7,11 @@ VideoStreamerBuilder *VideoStreamerBuilder::setRenderer(RendererES3 **renderer)
     return this;
 }
 
+VideoStreamerBuilder *VideoStreamerBuilder::setVideoClock(MediaClock *clock) {
+    mVideoClock = clock;
+    return this;
+}
+
 VideoStreamerBuilder *VideoStreamerBuilder::setVideoTimeBase(AVRational timebase) {
     mVideoTimeBase = timebase;
     return this;
@@ -47,6 +52,16 @@ VideoStreamerBuilder *VideoStreamerBuilder::setInternalPixelFormat(GLint interna
     return this;
 }
 
+VideoStreamerBuilder *VideoStreamerBuilder::setLateFrameTolerance(int64_t toleranceMs) {
+    mLateToleranceMs = toleranceMs;
+    return this;
+}
+
+VideoStreamerBuilder *VideoStreamerBuilder::setYuvRenderingEnabled(bool isEnabled) {
+    mIsYuvRenderingEnabled = isEnabled;
+    return this;
+}
+
 VideoStreamer *VideoStreamerBuilder::buildVideoStreamer() {
     // Validate all parameters
     if (mSrcWidth <= 0 || mSrcHeight <= 0 || mSrcPixFmt == AV_PIX_FMT_NONE) {
@@ -57,16 +72,20 @@ VideoStreamer *VideoStreamerBuilder::buildVideoStreamer() {
     auto *videoStreamer = new VideoStreamer();
     // Assign attributes
     videoStreamer->mRenderer = mRenderer;
+    videoStreamer->mClock = mVideoClock;
     videoStreamer->mTimeBase = mVideoTimeBase;
 
     videoStreamer->mSrcWidth = mSrcWidth;
     videoStreamer->mSrcHeight = mSrcHeight;
     videoStreamer->mSrcPixFmt = mSrcPixFmt;
 
-    videoStreamer->mWidth = (mWidth <= 0) ? mSrcWidth : mWidth;
-    videoStreamer->mHeight = (mHeight <= 0) ? mSrcHeight : mHeight;
+    // Output size and YUV drawing are fitted to max texture size, again once a renderer reports it
+    videoStreamer->mRequestedWidth = mWidth;
+    videoStreamer->mRequestedHeight = mHeight;
+    videoStreamer->mIsYuvRenderingEnabled = mIsYuvRenderingEnabled;
     videoStreamer->mPixFmt = mPixFmt;
     videoStreamer->mInternalPixFmt = mInternalPixFmt;
+    videoStreamer->mLateToleranceMs = mLateToleranceMs;
 
     // Initiate video streamer
     int ret = videoStreamer->initiate();
@@ -6,7 +6,8 @@
 class VideoStreamerBuilder {
 protected:
     // OpenGLES Renderer
-    RendererES3 **mRenderer;
+    RendererES3 **mRenderer = nullptr;
+    MediaClock *mVideoClock = nullptr;
 
     AVRational mVideoTimeBase = {0, 1};
     // Video input params {
@@ -20,9 +21,16 @@ protected:
     GLint mInternalPixFmt = GL_RGB; // Pixel format of video stored inside the buffer
     // } Video output params
 
+    int64_t mLateToleranceMs = 50;
+
+    bool mIsYuvRenderingEnabled = true;
+
 public:
     /** Set renderer of streamer */
     VideoStreamerBuilder *setRenderer(RendererES3 **renderer);
+    /** Set clock frames are picked against, not owned by streamer.
+     * If this value is not set, frames are shown as soon as they are buffered. */
+    VideoStreamerBuilder *setVideoClock(MediaClock *clock);
 
     /** Set video stream time base. */
     VideoStreamerBuilder *setVideoTimeBase(AVRational timebase);
@@ -36,11 +44,13 @@ public:
     VideoStreamerBuilder *setSrcPixelFormat(AVPixelFormat pixFmt);
 
     /** Set output picture width.
-     * If this value is not set, use input value instead. */
+     * Frames are scaled to surface by renderer, this is only used when input is too big to fit in a texture.
+     * If this value is not set or does not fit either, input is scaled down keeping its aspect ratio. */
     VideoStreamerBuilder *setWidth(int width);
 
     /** Set output picture height.
-     * If this value is not set, use input value instead. */
+     * Frames are scaled to surface by renderer, this is only used when input is too big to fit in a texture.
+     * If this value is not set or does not fit either, input is scaled down keeping its aspect ratio. */
     VideoStreamerBuilder *setHeight(int height);
 
     /** Set output picture format.
@@ -51,6 +61,14 @@ public:
      * If this value is not set, use default value instead.*/
     VideoStreamerBuilder *setInternalPixelFormat(GLint internalPixFmt);
 
+    /** Set how far behind current time in millis a frame can be before it is dropped without being converted.
+     * Negative value disables dropping. Default 50ms. */
+    VideoStreamerBuilder *setLateFrameTolerance(int64_t toleranceMs);
+
+    /** Set whether YUV frames may be drawn as they are, with color converted by renderer instead of scaler.
+     * Used only if input format can be drawn and input fits in a texture. Default true. */
+    VideoStreamerBuilder *setYuvRenderingEnabled(bool isEnabled);
+
     /** Build video streamer from given parameters.
      * @return steamer or nullptr if failed to build streamer */
     VideoStreamer *buildVideoStreamer();
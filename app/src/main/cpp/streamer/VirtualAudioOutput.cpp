@@ -0,0 +1,225 @@
+#include "VirtualAudioOutput.h"
+#include "JNILogHelper.h"
+#include "chrono"
+#include "cstring"
+#include "algorithm"
+
+#define LOG_TAG "VirtualAudioOutput"
+
+VirtualAudioOutput::VirtualAudioOutput(VirtualClockMode clockMode, const char *wavPath)
+        : mClockMode(clockMode), mWavPath(wavPath ? wavPath : "") {
+}
+
+VirtualAudioOutput::~VirtualAudioOutput() {
+    close();
+}
+
+bool VirtualAudioOutput::open(const AudioOutputParams &params, AudioOutputCallback *callback) {
+    int bytesPerSample = av_get_bytes_per_sample(params.mSampleFmt);
+    if (bytesPerSample <= 0 || av_sample_fmt_is_planar(params.mSampleFmt) || params.mSampleRate <= 0 ||
+        params.mNbChannels <= 0 || !callback) {
+        LOGE("Failed to open virtual output, invalid params.");
+        return false;
+    }
+    mParams = params;
+    if (mParams.mFramesPerBurst <= 0) mParams.mFramesPerBurst = DEFAULT_FRAMES_PER_BURST;
+    mCallback = callback;
+    mBytesPerSample = bytesPerSample * params.mNbChannels;
+    mBurst.resize((size_t) mParams.mFramesPerBurst * mBytesPerSample);
+    mBufferSize = 2 * mParams.mFramesPerBurst;
+
+    if (!mWavPath.empty() && !openWavFile()) return false;
+
+    // With a virtual clock, bursts are pulled by caller
+    if (mClockMode == VirtualClockMode::REAL_TIME) mThread = std::thread(&VirtualAudioOutput::threadOutput, this);
+    return true;
+}
+
+bool VirtualAudioOutput::start() {
+    std::unique_lock<std::mutex> lck(mMutex);
+    if (mIsClosed || !mCallback) return false;
+    mIsRunning = true;
+    mCond.notify_all();
+    return true;
+}
+
+void VirtualAudioOutput::pause() {
+    std::unique_lock<std::mutex> lck(mMutex);
+    mIsRunning = false;
+}
+
+void VirtualAudioOutput::close() {
+    {
+        std::unique_lock<std::mutex> lck(mMutex);
+        mIsClosed = true;
+        mIsRunning = false;
+        mCond.notify_all();
+    }
+    if (mThread.joinable()) mThread.join();
+    if (mCallback) {
+        mCallback = nullptr;
+        VirtualAudioOutputStats stats = getStats();
+        LOGD("Virtual output callbacks: %lld, samples: %lld, late bursts: %lld, underruns: %lld, "
+             "callback time avg: %lldus, max: %lldus",
+             (long long) stats.mNbCallbacks, (long long) stats.mNbSamples, (long long) stats.mNbLateBursts,
+             (long long) stats.mNbXRuns,
+             (long long) (stats.mNbCallbacks > 0 ? stats.mTotalCallbackUs / stats.mNbCallbacks : 0),
+             (long long) stats.mMaxCallbackUs);
+    }
+    closeWavFile();
+}
+
+void VirtualAudioOutput::threadOutput() {
+    using namespace std::chrono;
+    auto burstDuration = nanoseconds((int64_t) mParams.mFramesPerBurst * 1000000000 / mParams.mSampleRate);
+    steady_clock::time_point deadline;
+    bool isPaced = false;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lck(mMutex);
+            if (!mIsRunning && !mIsClosed) {
+                // Deadlines start over after a pause
+                isPaced = false;
+                mCond.wait(lck, [this] { return mIsRunning || mIsClosed; });
+            }
+            if (mIsClosed) return;
+        }
+
+        auto now = steady_clock::now();
+        if (!isPaced) {
+            deadline = now;
+            isPaced = true;
+        } else {
+            // Device keeps playing from its buffer while waiting, all but the burst being pulled covers lateness
+            auto lateness = now - deadline;
+            auto bufferedDuration = nanoseconds(
+                    (int64_t) (mBufferSize - mParams.mFramesPerBurst) * 1000000000 / mParams.mSampleRate);
+            if (lateness > burstDuration) mNbLateBursts++;
+            if (lateness > bufferedDuration) {
+                mNbXRuns++;
+                // Playback restarts from now, as a device would after an underrun
+                deadline = now;
+            }
+        }
+        std::this_thread::sleep_until(deadline);
+        deadline += burstDuration;
+        pullBurst();
+    }
+}
+
+void VirtualAudioOutput::pullBurst() {
+    using namespace std::chrono;
+    auto startTime = steady_clock::now();
+    mCallback->onAudioOutput(mBurst.data(), mParams.mFramesPerBurst);
+    int64_t callbackUs = duration_cast<microseconds>(steady_clock::now() - startTime).count();
+
+    mNbCallbacks++;
+    mNbSamples += mParams.mFramesPerBurst;
+    mTotalCallbackUs += callbackUs;
+    if (callbackUs > mMaxCallbackUs) mMaxCallbackUs = callbackUs;
+
+    if (mWavFile) {
+        fwrite(mBurst.data(), 1, mBurst.size(), mWavFile);
+        mWavDataSize += (int64_t) mBurst.size();
+    }
+}
+
+bool VirtualAudioOutput::openWavFile() {
+    mWavFile = fopen(mWavPath.c_str(), "wb");
+    if (!mWavFile) {
+        LOGE("Cannot open WAV file %s", mWavPath.c_str());
+        return false;
+    }
+    // Header is written with empty sizes, they are filled in once every sample is written
+    mWavDataSize = 0;
+    uint8_t header[44] = {};
+    fwrite(header, 1, sizeof(header), mWavFile);
+    return true;
+}
+
+static void putLe(uint8_t *dst, uint32_t value, int nbBytes) {
+    for (int i = 0; i < nbBytes; i++) dst[i] = (uint8_t) (value >> (8 * i));
+}
+
+void VirtualAudioOutput::closeWavFile() {
+    if (!mWavFile) return;
+
+    bool isFloat = mParams.mSampleFmt == AV_SAMPLE_FMT_FLT;
+    auto dataSize = (uint32_t) mWavDataSize;
+    uint8_t header[44];
+    memcpy(header, "RIFF", 4);
+    putLe(header + 4, 36 + dataSize, 4);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    putLe(header + 16, 16, 4);
+    putLe(header + 20, isFloat ? 3 : 1, 2); // IEEE float or PCM
+    putLe(header + 22, mParams.mNbChannels, 2);
+    putLe(header + 24, mParams.mSampleRate, 4);
+    putLe(header + 28, mParams.mSampleRate * mBytesPerSample, 4);
+    putLe(header + 32, mBytesPerSample, 2);
+    putLe(header + 34, 8 * mBytesPerSample / mParams.mNbChannels, 2);
+    memcpy(header + 36, "data", 4);
+    putLe(header + 40, dataSize, 4);
+
+    fseek(mWavFile, 0, SEEK_SET);
+    fwrite(header, 1, sizeof(header), mWavFile);
+    fclose(mWavFile);
+    mWavFile = nullptr;
+}
+
+int32_t VirtualAudioOutput::getFramesPerBurst() {
+    return mParams.mFramesPerBurst;
+}
+
+int32_t VirtualAudioOutput::getBufferCapacity() {
+    return NB_BURSTS_CAPACITY * mParams.mFramesPerBurst;
+}
+
+int32_t VirtualAudioOutput::setBufferSize(int32_t size) {
+    // At least a burst, as a device always holds the one it plays
+    size = std::max(mParams.mFramesPerBurst, std::min(size, getBufferCapacity()));
+    mBufferSize = size;
+    return size;
+}
+
+int64_t VirtualAudioOutput::getXRunCount() {
+    return mNbXRuns;
+}
+
+int64_t VirtualAudioOutput::getLatencyMs() {
+    return mParams.mSampleRate > 0 ? (int64_t) mBufferSize * 1000 / mParams.mSampleRate : 0;
+}
+
+void VirtualAudioOutput::addXRuns(int nbXRuns) {
+    mNbXRuns += nbXRuns;
+}
+
+int64_t VirtualAudioOutput::getPositionMs() {
+    return mParams.mSampleRate > 0 ? mNbSamples * 1000 / mParams.mSampleRate : 0;
+}
+
+int VirtualAudioOutput::pullBursts(int nbBursts) {
+    if (mClockMode != VirtualClockMode::VIRTUAL) return 0;
+    {
+        std::unique_lock<std::mutex> lck(mMutex);
+        if (!mIsRunning) return 0;
+    }
+    for (int i = 0; i < nbBursts; i++) pullBurst();
+    return nbBursts;
+}
+
+int64_t VirtualAudioOutput::getTimeNs() {
+    if (mClockMode != VirtualClockMode::VIRTUAL) return getMonotonicTimeNs();
+    return mParams.mSampleRate > 0 ? mNbSamples * 1000000000 / mParams.mSampleRate : 0;
+}
+
+VirtualAudioOutputStats VirtualAudioOutput::getStats() {
+    VirtualAudioOutputStats stats;
+    stats.mNbCallbacks = mNbCallbacks.load();
+    stats.mNbSamples = mNbSamples.load();
+    stats.mTotalCallbackUs = mTotalCallbackUs.load();
+    stats.mMaxCallbackUs = mMaxCallbackUs.load();
+    stats.mNbLateBursts = mNbLateBursts.load();
+    stats.mNbXRuns = mNbXRuns.load();
+    return stats;
+}
@@ -0,0 +1,117 @@
+#ifndef VIRTUAL_AUDIO_OUTPUT_H
+#define VIRTUAL_AUDIO_OUTPUT_H
+
+#include "AudioOutput.h"
+#include "TimeUtils.h"
+#include "atomic"
+#include "condition_variable"
+#include "cstdio"
+#include "mutex"
+#include "string"
+#include "thread"
+#include "vector"
+
+/** How a virtual output paces its bursts. */
+enum class VirtualClockMode {
+    REAL_TIME, // One burst per burst duration of wall clock, as a device would
+    VIRTUAL // No thread, whoever drives output pulls bursts, time only advances with samples pulled
+};
+
+/** Snapshot of virtual output counters. */
+struct VirtualAudioOutputStats {
+    int64_t mNbCallbacks = 0;
+    int64_t mNbSamples = 0; // Samples pulled, position of output clock
+    int64_t mTotalCallbackUs = 0; // Time spent inside callback
+    int64_t mMaxCallbackUs = 0;
+    int64_t mNbLateBursts = 0; // Real time bursts pulled more than one burst duration after their deadline
+    int64_t mNbXRuns = 0; // Real time bursts pulled later than buffered samples could cover, plus injected ones
+};
+
+/** Pulls samples from a thread instead of a device, so that the audio path runs anywhere, e.g. in Linux tests.
+ * With a virtual clock, output is also a time source, so that streamers and their clock can be played step by step.
+ * Samples are written into a WAV file if a path is given, discarded otherwise. */
+class VirtualAudioOutput : public AudioOutput, public TimeSource {
+private:
+    // Burst size used when params do not ask for one, a usual low latency device burst
+    static const int DEFAULT_FRAMES_PER_BURST = 192;
+    // Buffer capacity in bursts
+    static const int NB_BURSTS_CAPACITY = 16;
+
+    const VirtualClockMode mClockMode;
+    const std::string mWavPath;
+    FILE *mWavFile = nullptr;
+    int64_t mWavDataSize = 0;
+
+    AudioOutputParams mParams;
+    AudioOutputCallback *mCallback = nullptr;
+    int mBytesPerSample = 0;
+    std::vector<uint8_t> mBurst;
+    // Samples buffered ahead of playback, a burst pulled later than their duration is an underrun
+    std::atomic_int32_t mBufferSize = {0};
+
+    std::thread mThread;
+    std::mutex mMutex;
+    std::condition_variable mCond;
+    bool mIsRunning = false; // Pulling samples
+    bool mIsClosed = false; // Thread must exit
+
+    std::atomic_int64_t mNbCallbacks = {0};
+    std::atomic_int64_t mNbSamples = {0};
+    std::atomic_int64_t mTotalCallbackUs = {0};
+    std::atomic_int64_t mMaxCallbackUs = {0};
+    std::atomic_int64_t mNbLateBursts = {0};
+    std::atomic_int64_t mNbXRuns = {0};
+
+private:
+    void threadOutput();
+
+    /** Pull one burst from callback and write it out. */
+    void pullBurst();
+
+    bool openWavFile();
+
+    /** Write final sizes into WAV header and close file. */
+    void closeWavFile();
+
+public:
+    /** @param wavPath file samples are written to, null to discard them */
+    explicit VirtualAudioOutput(VirtualClockMode clockMode = VirtualClockMode::REAL_TIME, const char *wavPath = nullptr);
+
+    ~VirtualAudioOutput() override;
+
+    bool open(const AudioOutputParams &params, AudioOutputCallback *callback) override;
+
+    bool start() override;
+
+    void pause() override;
+
+    void close() override;
+
+    int32_t getFramesPerBurst() override;
+
+    int32_t getBufferCapacity() override;
+
+    int32_t setBufferSize(int32_t size) override;
+
+    int64_t getXRunCount() override;
+
+    /** Return duration of buffered samples. */
+    int64_t getLatencyMs() override;
+
+    /** Count underruns as if output had glitched, e.g. to exercise buffer sizing in tests. */
+    void addXRuns(int nbXRuns);
+
+    /** Return time of output clock in millis, computed from samples pulled so far. */
+    int64_t getPositionMs();
+
+    /** Pull bursts from callback on calling thread, with a virtual clock only.
+     * @return bursts pulled, 0 unless output is started */
+    int pullBursts(int nbBursts);
+
+    /** Return time of output clock with a virtual clock, monotonic time otherwise. */
+    int64_t getTimeNs() override;
+
+    VirtualAudioOutputStats getStats();
+};
+
+#endif //VIRTUAL_AUDIO_OUTPUT_H
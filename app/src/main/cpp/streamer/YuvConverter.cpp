@@ -0,0 +1,244 @@
+#include "YuvConverter.h"
+#include "JNILogHelper.h"
+#include "cmath"
+
+extern "C" {
+#include "libavutil/common.h"
+}
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+#define LOG_TAG "YuvConverter"
+
+/** Scalar counterpart of SIMD kernels, rounding and saturation happen at the same places. */
+static inline void getRgb(int y, int u, int v, const YuvConverter::Coefficients &k, uint8_t *rgb) {
+    int yTerm = ((y * k.mY) >> 8) + k.mYBias;
+    int cu = u - 128, cv = v - 128;
+    int r = yTerm + 2 * ((cv * k.mRV) >> 8);
+    int g = yTerm - (2 * ((cu * k.mGU) >> 8) + 2 * ((cv * k.mGV) >> 8));
+    int b = yTerm + 2 * ((cu * k.mBU) >> 8);
+    rgb[0] = av_clip_uint8(r >> 6);
+    rgb[1] = av_clip_uint8(g >> 6);
+    rgb[2] = av_clip_uint8(b >> 6);
+}
+
+#if defined(__ARM_NEON)
+static inline int16x8_t getChromaTerm(int16x8_t c, int k) {
+    int16x4_t lo = vshrn_n_s32(vmull_n_s16(vget_low_s16(c), (int16_t) k), 8);
+    int16x4_t hi = vshrn_n_s32(vmull_n_s16(vget_high_s16(c), (int16_t) k), 8);
+    int16x8_t term = vcombine_s16(lo, hi);
+    return vaddq_s16(term, term);
+}
+
+static inline int16x8_t getLumaTerm(uint8x8_t y, const YuvConverter::Coefficients &k) {
+    uint16x8_t y16 = vmovl_u8(y);
+    uint16x4_t lo = vshrn_n_u32(vmull_n_u16(vget_low_u16(y16), (uint16_t) k.mY), 8);
+    uint16x4_t hi = vshrn_n_u32(vmull_n_u16(vget_high_u16(y16), (uint16_t) k.mY), 8);
+    return vaddq_s16(vreinterpretq_s16_u16(vcombine_u16(lo, hi)), vdupq_n_s16((int16_t) k.mYBias));
+}
+
+/** Add chroma term shared by pairs of pixels to luma terms of 16 pixels, then shift and saturate to 8 bit. */
+static inline uint8x16_t addChroma(int16x8_t yLo, int16x8_t yHi, int16x8_t c) {
+    int16x8x2_t dup = vzipq_s16(c, c);
+    return vcombine_u8(vqmovun_s16(vshrq_n_s16(vqaddq_s16(yLo, dup.val[0]), 6)),
+                       vqmovun_s16(vshrq_n_s16(vqaddq_s16(yHi, dup.val[1]), 6)));
+}
+#elif defined(__SSSE3__)
+/** High 16 bits of (c << 8) * k, doubled. c << 8 is what chroma becomes once moved to the high byte of a lane. */
+static inline __m128i getChromaTerm(__m128i c, int k) {
+    __m128i term = _mm_mulhi_epi16(c, _mm_set1_epi16((int16_t) k));
+    return _mm_add_epi16(term, term);
+}
+
+static inline __m128i addChroma(__m128i yTerm, __m128i c) {
+    return _mm_srai_epi16(_mm_adds_epi16(yTerm, c), 6);
+}
+
+/** Interleave 16 pixels of R, G and B planes into 48 bytes. */
+static inline void storeRgb24(uint8_t *dst, __m128i r, __m128i g, __m128i b) {
+    const __m128i r0 = _mm_setr_epi8(0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1, 5);
+    const __m128i g0 = _mm_setr_epi8(-1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1);
+    const __m128i b0 = _mm_setr_epi8(-1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1);
+    const __m128i r1 = _mm_setr_epi8(-1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10, -1);
+    const __m128i g1 = _mm_setr_epi8(5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10);
+    const __m128i b1 = _mm_setr_epi8(-1, 5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1);
+    const __m128i r2 = _mm_setr_epi8(-1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1);
+    const __m128i g2 = _mm_setr_epi8(-1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1);
+    const __m128i b2 = _mm_setr_epi8(10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15);
+    _mm_storeu_si128((__m128i *) dst, _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(r, r0), _mm_shuffle_epi8(g, g0)),
+                                                   _mm_shuffle_epi8(b, b0)));
+    _mm_storeu_si128((__m128i *) (dst + 16), _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(r, r1), _mm_shuffle_epi8(g, g1)),
+                                                          _mm_shuffle_epi8(b, b1)));
+    _mm_storeu_si128((__m128i *) (dst + 32), _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(r, r2), _mm_shuffle_epi8(g, g2)),
+                                                          _mm_shuffle_epi8(b, b2)));
+}
+
+static inline void storeRgba(uint8_t *dst, __m128i r, __m128i g, __m128i b) {
+    const __m128i a = _mm_set1_epi8(-1);
+    __m128i rgLo = _mm_unpacklo_epi8(r, g), rgHi = _mm_unpackhi_epi8(r, g);
+    __m128i baLo = _mm_unpacklo_epi8(b, a), baHi = _mm_unpackhi_epi8(b, a);
+    _mm_storeu_si128((__m128i *) dst, _mm_unpacklo_epi16(rgLo, baLo));
+    _mm_storeu_si128((__m128i *) (dst + 16), _mm_unpackhi_epi16(rgLo, baLo));
+    _mm_storeu_si128((__m128i *) (dst + 32), _mm_unpacklo_epi16(rgHi, baHi));
+    _mm_storeu_si128((__m128i *) (dst + 48), _mm_unpackhi_epi16(rgHi, baHi));
+}
+#endif
+
+template<YuvLayout layout, bool isSwapped, int bytesPerPixel>
+void YuvConverter::convertRow(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst, int width,
+                              const Coefficients &k) {
+    int x = 0;
+#if defined(__ARM_NEON)
+    for (; x + STEP <= width; x += STEP) {
+        uint8x16_t y8 = vld1q_u8(y + x);
+        int16x8_t yLo = getLumaTerm(vget_low_u8(y8), k), yHi = getLumaTerm(vget_high_u8(y8), k);
+
+        uint8x8_t u8, v8;
+        if (layout == YuvLayout::SEMI_PLANAR) {
+            uint8x8x2_t uv = vld2_u8(u + x);
+            u8 = uv.val[isSwapped ? 1 : 0];
+            v8 = uv.val[isSwapped ? 0 : 1];
+        } else {
+            u8 = vld1_u8(u + x / 2);
+            v8 = vld1_u8(v + x / 2);
+        }
+        int16x8_t cu = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(u8)), vdupq_n_s16(128));
+        int16x8_t cv = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(v8)), vdupq_n_s16(128));
+
+        // Green is luma minus both chroma terms, subtracted at once as a negated sum
+        int16x8_t g = vnegq_s16(vaddq_s16(getChromaTerm(cu, k.mGU), getChromaTerm(cv, k.mGV)));
+        if (bytesPerPixel == 4) {
+            uint8x16x4_t rgba;
+            rgba.val[0] = addChroma(yLo, yHi, getChromaTerm(cv, k.mRV));
+            rgba.val[1] = addChroma(yLo, yHi, g);
+            rgba.val[2] = addChroma(yLo, yHi, getChromaTerm(cu, k.mBU));
+            rgba.val[3] = vdupq_n_u8(255);
+            vst4q_u8(dst + x * 4, rgba);
+        } else {
+            uint8x16x3_t rgb;
+            rgb.val[0] = addChroma(yLo, yHi, getChromaTerm(cv, k.mRV));
+            rgb.val[1] = addChroma(yLo, yHi, g);
+            rgb.val[2] = addChroma(yLo, yHi, getChromaTerm(cu, k.mBU));
+            vst3q_u8(dst + x * 3, rgb);
+        }
+    }
+#elif defined(__SSSE3__)
+    const __m128i zero = _mm_setzero_si128(), yScale = _mm_set1_epi16((int16_t) k.mY);
+    const __m128i yBias = _mm_set1_epi16((int16_t) k.mYBias), chromaBias = _mm_set1_epi16(-32768);
+    for (; x + STEP <= width; x += STEP) {
+        // Luma in the high byte of each lane is Y << 8
+        __m128i y8 = _mm_loadu_si128((const __m128i *) (y + x));
+        __m128i yLo = _mm_add_epi16(_mm_mulhi_epu16(_mm_unpacklo_epi8(zero, y8), yScale), yBias);
+        __m128i yHi = _mm_add_epi16(_mm_mulhi_epu16(_mm_unpackhi_epi8(zero, y8), yScale), yBias);
+
+        // Chroma as (C - 128) << 8, flipping the top bit subtracts 128 << 8
+        __m128i cu, cv;
+        if (layout == YuvLayout::SEMI_PLANAR) {
+            __m128i uv = _mm_loadu_si128((const __m128i *) (u + x));
+            __m128i first = _mm_slli_epi16(uv, 8), second = _mm_andnot_si128(_mm_set1_epi16(0xFF), uv);
+            cu = _mm_xor_si128(isSwapped ? second : first, chromaBias);
+            cv = _mm_xor_si128(isSwapped ? first : second, chromaBias);
+        } else {
+            cu = _mm_xor_si128(_mm_unpacklo_epi8(zero, _mm_loadl_epi64((const __m128i *) (u + x / 2))), chromaBias);
+            cv = _mm_xor_si128(_mm_unpacklo_epi8(zero, _mm_loadl_epi64((const __m128i *) (v + x / 2))), chromaBias);
+        }
+
+        __m128i rc = getChromaTerm(cv, k.mRV);
+        __m128i gc = _mm_sub_epi16(zero, _mm_add_epi16(getChromaTerm(cu, k.mGU), getChromaTerm(cv, k.mGV)));
+        __m128i bc = getChromaTerm(cu, k.mBU);
+        // Every chroma term covers two pixels
+        __m128i r = _mm_packus_epi16(addChroma(yLo, _mm_unpacklo_epi16(rc, rc)), addChroma(yHi, _mm_unpackhi_epi16(rc, rc)));
+        __m128i g = _mm_packus_epi16(addChroma(yLo, _mm_unpacklo_epi16(gc, gc)), addChroma(yHi, _mm_unpackhi_epi16(gc, gc)));
+        __m128i b = _mm_packus_epi16(addChroma(yLo, _mm_unpacklo_epi16(bc, bc)), addChroma(yHi, _mm_unpackhi_epi16(bc, bc)));
+        if (bytesPerPixel == 4) storeRgba(dst + x * 4, r, g, b);
+        else storeRgb24(dst + x * 3, r, g, b);
+    }
+#endif
+    for (; x < width; x++) {
+        int cu, cv;
+        if (layout == YuvLayout::SEMI_PLANAR) {
+            cu = u[(x & ~1) + (isSwapped ? 1 : 0)];
+            cv = u[(x & ~1) + (isSwapped ? 0 : 1)];
+        } else {
+            cu = u[x / 2];
+            cv = v[x / 2];
+        }
+        uint8_t *pixel = dst + x * bytesPerPixel;
+        getRgb(y[x], cu, cv, k, pixel);
+        if (bytesPerPixel == 4) pixel[3] = 255;
+    }
+}
+
+template<YuvLayout layout, bool isSwapped, int bytesPerPixel>
+void YuvConverter::convertPicture(const YuvPicture &picture, AVFrame *dst, const Coefficients &k) {
+    for (int row = 0; row < picture.mHeight; row++) {
+        int chromaRow = row / 2;
+        convertRow<layout, isSwapped, bytesPerPixel>(
+                picture.mData[0] + (ptrdiff_t) row * picture.mLinesize[0],
+                picture.mData[1] + (ptrdiff_t) chromaRow * picture.mLinesize[1],
+                layout == YuvLayout::PLANAR ? picture.mData[2] + (ptrdiff_t) chromaRow * picture.mLinesize[2] : nullptr,
+                dst->data[0] + (ptrdiff_t) row * dst->linesize[0], picture.mWidth, k);
+    }
+}
+
+YuvConverter::Coefficients YuvConverter::getCoefficients(YuvMatrix matrix, bool isFullRange) {
+    // Same matrix renderer draws YUV with, column major, columns are contributions of Y, U and V
+    float yuvToRgb[9], yuvOffset[3];
+    RendererES3::getYuvToRgb(matrix, isFullRange, 8, yuvToRgb, yuvOffset);
+
+    Coefficients k;
+    k.mY = (int) lrintf(yuvToRgb[0] * (1 << 14));
+    // Rounding of final shift by 6 bits is folded into luma offset
+    k.mYBias = 32 - (int) lrintf(yuvOffset[0] * 255.0f * yuvToRgb[0] * 64.0f);
+    k.mRV = (int) lrintf(yuvToRgb[6] * (1 << 13));
+    k.mGU = (int) lrintf(-yuvToRgb[4] * (1 << 13));
+    k.mGV = (int) lrintf(-yuvToRgb[7] * (1 << 13));
+    k.mBU = (int) lrintf(yuvToRgb[5] * (1 << 13));
+    return k;
+}
+
+bool YuvConverter::isSupported(AVPixelFormat srcPixFmt, AVPixelFormat dstPixFmt) {
+    if (dstPixFmt != AV_PIX_FMT_RGB24 && dstPixFmt != AV_PIX_FMT_RGBA) return false;
+    switch (srcPixFmt) {
+        case AV_PIX_FMT_YUV420P:
+        case AV_PIX_FMT_YUVJ420P:
+#if defined(__ARM_NEON) || defined(__SSSE3__)
+            return true;
+#else
+            // Table driven planar path of swscale beats plain C kernels
+            return false;
+#endif
+        case AV_PIX_FMT_NV12:
+        case AV_PIX_FMT_NV21:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool YuvConverter::convert(const YuvPicture &picture, AVFrame *dst) {
+    bool isRgba = dst->format == AV_PIX_FMT_RGBA;
+    if ((!isRgba && dst->format != AV_PIX_FMT_RGB24) || picture.mBitDepth != 8 ||
+        picture.mChromaWidth != (picture.mWidth + 1) / 2 || picture.mChromaHeight != (picture.mHeight + 1) / 2 ||
+        dst->width != picture.mWidth || dst->height != picture.mHeight) {
+        LOGE("Unsupported YUV to RGB conversion.");
+        return false;
+    }
+
+    Coefficients k = getCoefficients(picture.mMatrix, picture.mIsFullRange);
+    if (picture.mLayout == YuvLayout::PLANAR) {
+        if (isRgba) convertPicture<YuvLayout::PLANAR, false, 4>(picture, dst, k);
+        else convertPicture<YuvLayout::PLANAR, false, 3>(picture, dst, k);
+    } else if (picture.mIsSwapped) {
+        if (isRgba) convertPicture<YuvLayout::SEMI_PLANAR, true, 4>(picture, dst, k);
+        else convertPicture<YuvLayout::SEMI_PLANAR, true, 3>(picture, dst, k);
+    } else {
+        if (isRgba) convertPicture<YuvLayout::SEMI_PLANAR, false, 4>(picture, dst, k);
+        else convertPicture<YuvLayout::SEMI_PLANAR, false, 3>(picture, dst, k);
+    }
+    return true;
+}
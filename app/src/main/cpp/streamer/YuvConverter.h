@@ -0,0 +1,53 @@
+#ifndef YUV_CONVERTER_H
+#define YUV_CONVERTER_H
+
+extern "C" {
+#include "libavutil/frame.h"
+#include "libavutil/pixfmt.h"
+}
+#include "../gles/RendererES3.h"
+
+/** Converts 8 bit 4:2:0 YUV pictures, planar or semi-planar, into RGB24 or RGBA of the same size on CPU, for when
+ * renderer cannot draw YUV itself. Uses the renderer's matrix and range, in 6 bit fixed point with 16 bit lanes.
+ * A kernel is built per source layout and output format, on NEON or SSSE3 where available.
+ * SIMD and scalar code give the same output bit for bit. */
+class YuvConverter {
+public:
+    /** Fixed point YUV to RGB, terms are in 1/64 of an output level. */
+    struct Coefficients {
+        int mY = 0; // Luma scale in 1/2^14, applied to Y << 8 and keeping the high 16 bits
+        int mYBias = 0; // Luma offset and rounding of the final shift
+        // Chroma contributions in 1/2^13, applied to (C - 128) << 8 and keeping the high 16 bits, doubled {
+        int mRV = 0;
+        int mGU = 0; // Subtracted
+        int mGV = 0; // Subtracted
+        int mBU = 0;
+        // } Chroma contributions
+    };
+
+private:
+    // Pixels per SIMD step, a row of 16 luma samples shares 8 chroma samples
+    static const int STEP = 16;
+
+    /** Convert a row of pixels, chroma row is shared with the row above or below it.
+     * @param u chroma plane of U, or interleaved chroma for semi-planar layout
+     * @param v chroma plane of V, unused for semi-planar layout */
+    template<YuvLayout layout, bool isSwapped, int bytesPerPixel>
+    static void convertRow(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst, int width,
+                           const Coefficients &k);
+
+    template<YuvLayout layout, bool isSwapped, int bytesPerPixel>
+    static void convertPicture(const YuvPicture &picture, AVFrame *dst, const Coefficients &k);
+
+    static Coefficients getCoefficients(YuvMatrix matrix, bool isFullRange);
+
+public:
+    /** Return whether a picture of srcPixFmt converts into dstPixFmt. */
+    static bool isSupported(AVPixelFormat srcPixFmt, AVPixelFormat dstPixFmt);
+
+    /** Convert picture into dst, which must have picture's size and a writable buffer.
+     * @return false if formats are not supported */
+    static bool convert(const YuvPicture &picture, AVFrame *dst);
+};
+
+#endif //YUV_CONVERTER_H
@@ -2,8 +2,8 @@ package com.example.videostreamer
 
 class GLES3JNILib {
     companion object {
-        external fun init()
+        external fun init(cacheDir: String?)
         external fun resize(width: Int, height: Int)
-        external fun draw()
+        external fun draw(vsyncNs: Long, vsyncPeriodNs: Long)
     }
 }
\ No newline at end of file
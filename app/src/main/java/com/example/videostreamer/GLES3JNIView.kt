@@ -4,6 +4,7 @@ import android.content.Context
 import android.opengl.GLSurfaceView
 import android.util.AttributeSet
 import android.util.Log
+import android.view.Choreographer
 import javax.microedition.khronos.egl.EGLConfig
 import javax.microedition.khronos.opengles.GL10
 
@@ -13,6 +14,19 @@ class GLES3JNIView : GLSurfaceView {
         private const val DEBUG = true
     }
 
+    // Latest vsync time reported by choreographer, read from rendering thread
+    @Volatile
+    private var vsyncNs = 0L
+    @Volatile
+    private var vsyncPeriodNs = 0L
+
+    private val vsyncCallback = object : Choreographer.FrameCallback {
+        override fun doFrame(frameTimeNanos: Long) {
+            vsyncNs = frameTimeNanos
+            Choreographer.getInstance().postFrameCallback(this)
+        }
+    }
+
     constructor(ctx: Context) : super(ctx)
     constructor(ctx: Context, attrs: AttributeSet) : super(ctx, attrs)
 
@@ -22,10 +36,22 @@ class GLES3JNIView : GLSurfaceView {
         setRenderer(Renderer())
     }
 
+    override fun onAttachedToWindow() {
+        super.onAttachedToWindow()
+        val refreshRate = display?.refreshRate ?: 0f
+        vsyncPeriodNs = if (refreshRate > 0f) (1_000_000_000 / refreshRate).toLong() else 0L
+        Choreographer.getInstance().postFrameCallback(vsyncCallback)
+    }
+
+    override fun onDetachedFromWindow() {
+        Choreographer.getInstance().removeFrameCallback(vsyncCallback)
+        super.onDetachedFromWindow()
+    }
+
     inner class Renderer : GLSurfaceView.Renderer {
         override fun onSurfaceCreated(gl: GL10?, config: EGLConfig?) {
             Log.d(TAG, "onSurfaceCreated")
-            GLES3JNILib.init()
+            GLES3JNILib.init(context.cacheDir?.absolutePath)
         }
 
         override fun onSurfaceChanged(gl: GL10?, width: Int, height: Int) {
@@ -33,7 +59,7 @@ class GLES3JNIView : GLSurfaceView {
         }
 
         override fun onDrawFrame(gl: GL10?) {
-            GLES3JNILib.draw()
+            GLES3JNILib.draw(vsyncNs, vsyncPeriodNs)
         }
 
     }
@@ -2,11 +2,20 @@ package com.example.videostreamer
 
 import androidx.appcompat.app.AppCompatActivity
 import android.os.Bundle
+import android.util.Log
 import androidx.lifecycle.lifecycleScope
 import com.example.videostreamer.databinding.ActivityGlesBinding
 import kotlinx.coroutines.launch
 
 class GLESActivity : AppCompatActivity() {
+    companion object {
+        private const val TAG = "GLESActivity"
+        // Decoded GOPs kept for scrubbing and stepping backward, at half resolution a 1080p GOP of 60 frames
+        // takes about 45 MB
+        private const val GOP_CACHE_BYTES = 96L * 1024 * 1024
+        private const val GOP_CACHE_LOWRES = 1
+    }
+
     private lateinit var glSurfaceView: GLES3JNIView
     private lateinit var binding: ActivityGlesBinding
     private lateinit var mediaStreamer: MediaStreamer
@@ -26,6 +35,7 @@ class GLESActivity : AppCompatActivity() {
 
         lifecycleScope.launch {
             mediaStreamer.create()
+            mediaStreamer.setGopCache(GOP_CACHE_BYTES, GOP_CACHE_LOWRES)
             mediaStreamer.start()
         }
     }
@@ -34,6 +44,10 @@ class GLESActivity : AppCompatActivity() {
         super.onPause()
         glSurfaceView.onPause()
         mediaStreamer.pause()
+        mediaStreamer.getDegradationStats()?.let {
+            Log.d(TAG, "Video decoding level ${it.level}, ${it.nbDegrades} degrades, ${it.nbRecovers} recovers, " +
+                    "ms at each level ${it.timeAtLevelMs.contentToString()}")
+        }
     }
 
     override fun onResume() {
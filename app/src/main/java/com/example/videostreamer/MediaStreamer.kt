@@ -13,6 +13,15 @@ class MediaStreamer {
         }
     }
 
+    /** Counters of video decoding quality, lowered step by step while video is late. Level goes from 0, full
+     * quality, to 4, keyframes only. */
+    class DegradationStats(
+        val level: Int,
+        val nbDegrades: Long,
+        val nbRecovers: Long,
+        val timeAtLevelMs: LongArray
+    )
+
     companion object {
         private const val TAG = "MediaStreamer";
     }
@@ -36,6 +45,21 @@ class MediaStreamer {
 
     external fun resume()
 
+    /** Video decoding quality and time spent at each level so far, null if nothing is playing. */
+    external fun getDegradationStats(): DegradationStats?
+
+    /** Playback speed from 0.5 to 3, audio keeps its pitch. Faster or negative speeds show video keyframes only. */
+    external fun setSpeed(speed: Float)
+
+    /** Memory budget of decoded GOP cache, 0 disables it. Frames are cached scaled down by 2^lowres. */
+    external fun setGopCache(maxBytes: Long, lowres: Int)
+
+    /** Show frame at position and seek there, returns true if frame came from GOP cache without decoding. */
+    external fun scrub(positionMs: Long): Boolean
+
+    /** Show frame before the one on screen, returns false if it is not in GOP cache and shows once decoded. */
+    external fun stepBackward(): Boolean
+
     external fun stop()
 
     external fun clean()